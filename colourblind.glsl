@@ -73,3 +73,17 @@ mat3 M_Deuteranopia = mat3( 0.33066007266046, 0.3306600738776, -0.02785538261323
 mat3 M_Tritanopia = mat3( 1,                -4.486E-11,         3.1113E-10,
                              0.1273988631088,   0.87390929928361,  0.87390929725848,
                             -0.12739886341072,  0.12609070101523,  0.12609070067115 );
+
+// Achromatopsia (rod monochromacy): every channel becomes the luminance
+mat3 M_Achromatopsia = mat3( 0.2126, 0.2126, 0.2126,
+                             0.7152, 0.7152, 0.7152,
+                             0.0722, 0.0722, 0.0722 );
+
+// Blue cone monochromacy: every channel becomes the S row of M_LMS_From_RGB, scaled so that white stays white
+mat3 M_BlueConeMonochromacy = mat3( 0.01775658275397, 0.01775658275397, 0.01775658275397,
+                                    0.10946796102238, 0.10946796102238, 0.10946796102238,
+                                    0.87277545622365, 0.87277545622365, 0.87277545622365 );
+
+// Anomalous trichromacy (protanomaly etc.) is linear in LMS space, so the RGB matrix for a severity
+// from 0 to 1 is just a blend between the identity and the full simulation, e.g.:
+//     mat3 M_Protanomaly = mat3(1.0 - Severity) + Severity * M_Protanopia;
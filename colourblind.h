@@ -13,11 +13,8 @@
  * PERFORMANCE OF THIS SOFTWARE.
  */
 
-/* TODO:
- * - Achromatopsia
- * - Add working ColourDifference with Luv
- */
-
+#ifndef COLOURBLIND_H
+#define COLOURBLIND_H
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -27,11 +24,55 @@ extern "C" {
 #define Colo_rblind255    Colorblind255
 #define Colo_rblindRGB255 ColorblindRGB255
 #define Colo_rblindRGB    ColorblindRGB
+#define Colo_rblindImage      ColorblindImage
+#define Colo_rblindImageGamma ColorblindImageGamma
+#define Colo_rblindPlanar     ColorblindPlanar
+#define Colo_rblindImageThreaded      ColorblindImageThreaded
+#define Colo_rblindImageGammaThreaded ColorblindImageGammaThreaded
+#define Colo_rblindImages      ColorblindImages
+#define Colo_rblindImagesGamma ColorblindImagesGamma
+#define Colo_rblindImagesThreaded      ColorblindImagesThreaded
+#define Colo_rblindImagesGammaThreaded ColorblindImagesGammaThreaded
+#define Colo_rblindImageUnique      ColorblindImageUnique
+#define Colo_rblindImageGammaUnique ColorblindImageGammaUnique
+#define Colo_rblindRGB255Fixed      ColorblindRGB255Fixed
+#define Colo_rblindRGB255GammaFixed ColorblindRGB255GammaFixed
+#define Colo_rblindImageFixed       ColorblindImageFixed
+#define Colo_rblindImageGammaFixed  ColorblindImageGammaFixed
+#define Colo_rblindRGBSpace           ColorblindRGBSpace
+#define Colo_rblindImageSpace         ColorblindImageSpace
+#define Colo_rblindImageSpaceThreaded ColorblindImageSpaceThreaded
+#define Colo_rblindRGBAnomaly           ColorblindRGBAnomaly
+#define Colo_rblindRGB255GammaAnomaly   ColorblindRGB255GammaAnomaly
+#define Colo_rblindImageAnomaly         ColorblindImageAnomaly
+#define Colo_rblindImageGammaAnomaly    ColorblindImageGammaAnomaly
 #else/*I_PREFER_THE_AMERICAN_SPELLING_OF_COLOR_BECAUSE_I_AM_SILLY*/
 #define Colo_rblind       Colourblind
 #define Colo_rblind255    Colourblind255
 #define Colo_rblindRGB255 ColourblindRGB255
 #define Colo_rblindRGB    ColourblindRGB
+#define Colo_rblindImage      ColourblindImage
+#define Colo_rblindImageGamma ColourblindImageGamma
+#define Colo_rblindPlanar     ColourblindPlanar
+#define Colo_rblindImageThreaded      ColourblindImageThreaded
+#define Colo_rblindImageGammaThreaded ColourblindImageGammaThreaded
+#define Colo_rblindImages      ColourblindImages
+#define Colo_rblindImagesGamma ColourblindImagesGamma
+#define Colo_rblindImagesThreaded      ColourblindImagesThreaded
+#define Colo_rblindImagesGammaThreaded ColourblindImagesGammaThreaded
+#define Colo_rblindImageUnique      ColourblindImageUnique
+#define Colo_rblindImageGammaUnique ColourblindImageGammaUnique
+#define Colo_rblindRGB255Fixed      ColourblindRGB255Fixed
+#define Colo_rblindRGB255GammaFixed ColourblindRGB255GammaFixed
+#define Colo_rblindImageFixed       ColourblindImageFixed
+#define Colo_rblindImageGammaFixed  ColourblindImageGammaFixed
+#define Colo_rblindRGBSpace           ColourblindRGBSpace
+#define Colo_rblindImageSpace         ColourblindImageSpace
+#define Colo_rblindImageSpaceThreaded ColourblindImageSpaceThreaded
+#define Colo_rblindRGBAnomaly           ColourblindRGBAnomaly
+#define Colo_rblindRGB255GammaAnomaly   ColourblindRGB255GammaAnomaly
+#define Colo_rblindImageAnomaly         ColourblindImageAnomaly
+#define Colo_rblindImageGammaAnomaly    ColourblindImageGammaAnomaly
 #endif/*I_PREFER_THE_AMERICAN_SPELLING_OF_COLOR_BECAUSE_I_AM_SILLY*/
 
 /******************************************************************************
@@ -40,15 +81,141 @@ extern "C" {
 typedef struct cb_rgb_255 cb_rgb_255;
 typedef struct cb_rgb cb_rgb;
 
-typedef enum cb_impairment cb_impairment;
-typedef enum cb_guideline cb_guideline;
+typedef struct cb_lut cb_lut;
+typedef struct cb_pool cb_pool;
+typedef struct cb_palette cb_palette;
+typedef struct cb_pair cb_pair;
+typedef struct cb_contrast_map cb_contrast_map;
+typedef struct cb_contrast_stats cb_contrast_stats;
+typedef struct cb_sequence cb_sequence;
+typedef struct cb_stat_counts cb_stat_counts;
+typedef struct cb_cache_stats cb_cache_stats;
+
+/* The enums are defined here rather than with the structs, so that C++ can use them in the prototypes.
+ * cbAchromatopsia and cbBlueConeMonochromacy were added after cbTritanopia, which took cbImpairmentCount from 4 to 6:
+ * code built against the older header (or arrays sized by it) needs rebuilding, and switches gain two cases. */
+typedef enum cb_impairment {
+    cbUnimpaired, cbProtanopia, cbDeuteranopia, cbTritanopia, cbAchromatopsia, cbBlueConeMonochromacy,
+    cbImpairmentCount,
+    cbRodMonochromacy = cbAchromatopsia,
+    cbRedGreenDim = cbProtanopia, cbRedGreen     = cbDeuteranopia, cbBlueYellow  = cbTritanopia,
+    cbMissingRed  = cbProtanopia, cbMissingGreen = cbDeuteranopia, cbMissingBlue = cbTritanopia,
+} cb_impairment;
+typedef enum cb_anomaly {
+    cbProtanomaly, cbDeuteranomaly, cbTritanomaly, /* weak red, green and blue cones */
+    cbAnomalyCount
+} cb_anomaly;
+typedef enum cb_format {
+    cbRGB8, cbBGR8, cbRGBA8, cbBGRA8,
+    cbRGB16, cbRGBA16,   /* unsigned 16-bit components, 0-65535 */
+    cbRGB16F, cbRGBA16F, /* half-float components, not clamped */
+    cbFormatCount
+} cb_format;
+typedef enum cb_space {
+    cbSpaceSRGB, cbSpaceDisplayP3, cbSpaceRec2020, /* all with a D65 white */
+    cbSpaceCount
+} cb_space;
+typedef enum cb_transfer {
+    cbTransferLinear,
+    cbTransferSRGB,    /* the library's gamma curve (see cbGAMMA_FAST etc.); Display P3 uses it too */
+    cbTransferGamma24, /* a pure 2.4 power, as BT.1886 with a zero black level, for SDR Rec.709 and Rec.2020 */
+    cbTransferPQ,      /* SMPTE ST 2084, with linear 1 as 10000 cd/m2 */
+    cbTransferHLG,     /* ARIB STD-B67 / BT.2100, to and from scene light (without the system gamma) */
+    cbTransferCount
+} cb_transfer;
+typedef enum cb_gamma_tier {
+    cbGammaTier8Bit, cbGammaTier1e4, cbGammaTier1e6,
+    cbGammaTierCount
+} cb_gamma_tier;
+typedef enum cb_delta_e {
+    cbDeltaE_CIE76, cbDeltaE_CIEDE2000, cbDeltaE_CIELUV,
+    cbDeltaECount
+} cb_delta_e;
+#ifdef cbSTATS
+typedef enum cb_stat {
+    cbStatConversions, /* the single-colour functions from each impairment (e.g. DeuteranopiaRGB255); Items are colours */
+    cbStatImages,      /* the image and planar simulations (threaded ones count each tile); Items are pixels */
+    cbStatLuminance,   /* cbLuminance, cbLuminance255 and cbLuminanceImage; Items are colours */
+    cbStatContrast,    /* the cb*Luminance contrast scores, which the others call; Items are pairs */
+    cbStatGamma,       /* pow evaluations of the gamma curve, outside the tables; not timed */
+    cbStatFixed,       /* the fixed-point colours and 8-bit images (others go through cbStatImages); Items are pixels */
+    cbStatLut,         /* cbLutRGB, cbLutRGB255 and cbLutImage; Items are pixels */
+    cbStatUnique,      /* the Unique image functions, including their colours and fallbacks; Items are pixels */
+    cbStatCount
+} cb_stat;
+#endif/*cbSTATS*/
+/* APCA's guideline is only included if cbGUIDELINE_APCA is defined: its test takes several pows per pair, where
+ * the others take a few operations, so it would slow everything that checks every guideline (and it takes the
+ * last mask bit below cbCONTRAST_EDGE). cbLightnessContrast and cbAPCA are there either way. */
+#ifdef cbGUIDELINE_APCA
+#define cbGUIDELINE_APCA_BODY COL_GUIDELINE(APCA, LightnessContrast, Body, >=, 75.0)
+#else
+#define cbGUIDELINE_APCA_BODY
+#endif/*cbGUIDELINE_APCA*/
+#define COL_GUIDELINES \
+    COL_GUIDELINE(ISO9241_3, ContrastRatio,      Pass, >=, 3.0) \
+    COL_GUIDELINE(WCAG,      Contrast,        AALarge, >=, 4.0) \
+    COL_GUIDELINE(WCAG,      Contrast,       AAALarge, >=, 4.5) \
+    COL_GUIDELINE(WCAG,      Contrast,             AA, >=, 4.5) \
+    COL_GUIDELINE(WCAG,      Contrast,            AAA, >=, 7.0) \
+    COL_GUIDELINE(ISO9241_3, ContrastModulation, Pass, >=, 0.5) \
+    cbGUIDELINE_APCA_BODY \
+
+#define COL_GUIDELINE(source, testname, rating, comparison, value) cb## source ##_## testname ##_## rating,
+typedef enum cb_guideline    { COL_GUIDELINES cgGuidelineCount } cb_guideline;
+#undef COL_GUIDELINE
 
 /******************************************************************************
  * Constants
  ***********/
-char *cbImpairmentStrings[];
-char *cbGuidelineStrings[];
-float cbGuidelineScores[];
+/* The name tables hold string literals, which are const in C++ */
+#ifdef __cplusplus
+#define cbSTRING const char *
+#else
+#define cbSTRING char *
+#endif/*__cplusplus*/
+extern cbSTRING cbImpairmentStrings[];
+extern cbSTRING cbGuidelineStrings[];
+extern float cbGuidelineScores[];
+extern float cbImpairmentMatrices[][9];
+/* The values of cbImpairmentMatrices, which colourblind.hpp also uses at compile time.
+ * Achromatopsia makes every channel the luminance (as in cbLuminance), and blue cone monochromacy
+ * makes every channel the S cone response, scaled so that white stays white. */
+#define cbIMPAIRMENT_MATRICES                                       \
+{                                                                   \
+    /* Unimpaired */ {                                              \
+                     1,                  0,                  0,     \
+                     0,                  1,                  0,     \
+                     0,                  0,                  1 },   \
+    /* Protanopia */ {                                              \
+     0.17055699213417f,  0.82944301379913f,                  0,     \
+     0.17055699092998f,  0.82944300785005f,                  0,     \
+    -0.00451714424166f,  0.00451714427397f,                  1 },   \
+    /* Deuteranopia */ {                                            \
+     0.33066007266046f,  0.66933992517563f,                  0,     \
+     0.33066007387760f,  0.66933992719147f,                  0,     \
+    -0.02785538261323f,  0.02785538252318f,                  1 },   \
+    /* Tritanopia */ {                                              \
+                     1,  0.12739886310880f, -0.12739886341072f,     \
+                     0,  0.87390929928361f,  0.12609070101523f,     \
+                     0,  0.87390929725848f,  0.12609070067115f },   \
+    /* Achromatopsia */ {                                           \
+     0.2126f,            0.7152f,            0.0722f,               \
+     0.2126f,            0.7152f,            0.0722f,               \
+     0.2126f,            0.7152f,            0.0722f },             \
+    /* Blue cone monochromacy */ {                                  \
+     0.01775658275397f,  0.10946796102238f,  0.87277545622365f,     \
+     0.01775658275397f,  0.10946796102238f,  0.87277545622365f,     \
+     0.01775658275397f,  0.10946796102238f,  0.87277545622365f },   \
+}
+extern float cbDaltonisationMatrices[][9];
+#define cbANOMALY_STEPS 10 /* cbAnomalyMatrices has severities 0, 0.1, ... 1 */
+extern float cbAnomalyMatrices[][cbANOMALY_STEPS + 1][9]; /* [cbAnomalyCount][cbANOMALY_STEPS + 1][9] */
+extern float cbSpaceMatrices[][cbImpairmentCount][9]; /* [cbSpaceCount][cbImpairmentCount][9] */
+#ifdef cbSTATS
+#include <string.h> /* memset */
+extern cbSTRING cbStatStrings[];
+#endif/*cbSTATS*/
 
 /******************************************************************************
  * Function Prototypes
@@ -79,12 +246,254 @@ cb_rgb     TritanopiaRGB(cb_rgb RGB);
 cb_rgb_255 TritanopiaRGB255(cb_rgb_255 RGB);
 cb_rgb_255 TritanopiaRGB255Gamma(cb_rgb_255 RGB);
 
+/* Missing all three cones (rod monochromacy) - sees only luminance */
+void       Achromatopsia(float *Red, float *Green, float *Blue);
+void       Achromatopsia255(unsigned char *R, unsigned char *G, unsigned char *B);
+cb_rgb     AchromatopsiaRGB(cb_rgb RGB);
+cb_rgb_255 AchromatopsiaRGB255(cb_rgb_255 RGB);
+cb_rgb_255 AchromatopsiaRGB255Gamma(cb_rgb_255 RGB);
+
+/* Missing the first and second cones - sees only the third/short-wave/blue cone's response */
+void       BlueConeMonochromacy(float *Red, float *Green, float *Blue);
+void       BlueConeMonochromacy255(unsigned char *R, unsigned char *G, unsigned char *B);
+cb_rgb     BlueConeMonochromacyRGB(cb_rgb RGB);
+cb_rgb_255 BlueConeMonochromacyRGB255(cb_rgb_255 RGB);
+cb_rgb_255 BlueConeMonochromacyRGB255Gamma(cb_rgb_255 RGB);
+
 /* Applies the above impairment simulation (or no-op) based on the enum value given */
 void       Colo_rblind(cb_impairment Impairment, float *R, float *G, float *B);
 void       Colo_rblind255(cb_impairment Impairment, unsigned char *R, unsigned char *G, unsigned char *B);
 cb_rgb     Colo_rblindRGB(cb_impairment Impairment, cb_rgb RGB);
 cb_rgb_255 Colo_rblindRGB255(cb_impairment Impairment, cb_rgb_255 RGB);
 
+/* Applies the impairment simulation to every pixel of an image buffer, in place.
+ * Stride is the number of bytes from the start of one row to the start of the next,
+ * and Format gives the channel layout (see Types). Alpha channels are left untouched.
+ * These match the RGB255 and RGB255Gamma versions respectively, clamping results to 0-255 like them.
+ * 16-bit and half-float pixels (at any alignment) give the same results as the RGB versions
+ * on the converted values, rounded back to the format: within half a step for 16-bit (clamped to 0-65535),
+ * and within half-float precision (a relative 2^-11, not clamped) for halves. */
+void Colo_rblindImage(cb_impairment Impairment, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format);
+void Colo_rblindImageGamma(cb_impairment Impairment, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format);
+
+/* Simulates Count impairments of one image in a single pass, reading (and linearising) each pixel only once.
+ * Outputs[i] gets Impairments[i], in the same Width, Height and Format with OutputStride bytes between rows,
+ * and alpha copied from Pixels. The results are identical to copying Pixels into each output and calling the
+ * Image/ImageGamma function on it. Outputs shouldn't overlap each other or Pixels, but one of them can be Pixels.
+ * For a side-by-side composite, point Outputs[i] at pixel i*Width of the first row of one buffer and give its
+ * stride; for a stacked one, point them at row i*Height. */
+void Colo_rblindImages(cb_impairment *Impairments, int Count, unsigned char *Pixels, int Width, int Height, int Stride,
+                       cb_format Format, unsigned char **Outputs, int OutputStride);
+void Colo_rblindImagesGamma(cb_impairment *Impairments, int Count, unsigned char *Pixels, int Width, int Height, int Stride,
+                            cb_format Format, unsigned char **Outputs, int OutputStride);
+
+/* For images with few distinct colours, like UI screenshots and charts: finds the distinct colours with a hash
+ * table, simulates each one once and maps the pixels through the results, which are identical to the functions
+ * above. Only 8-bit formats are deduplicated. Once it has seen more than cbUNIQUE_MAX_COLOURS colours, or too
+ * many for the pixels so far to be worth it, it simulates the rest of the image directly.
+ * Returns the number of distinct colours it simulated (those seen before it fell back, if it did), and sets
+ * *FellBack (if it isn't null) to whether any of the image was simulated directly instead. */
+int Colo_rblindImageUnique(cb_impairment Impairment, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format,
+                           int *FellBack);
+int Colo_rblindImageGammaUnique(cb_impairment Impairment, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format,
+                                int *FellBack);
+
+/* Planar versions, for separate arrays of Count R, G and B values (0-1, in place). These run the matrix
+ * kernels directly on the arrays, and give identical results to the RGB versions. */
+void Colo_rblindPlanar(cb_impairment Impairment, float *R, float *G, float *B, int Count);
+/* Fills in Luminance[Count], identical to calling cbLuminance on each colour */
+void cbLuminancePlanar(float *R, float *G, float *B, float *Luminance, int Count);
+/* Fills in Luminance[Width*Height] from an image in any format, with the same results as cbLuminance */
+void cbLuminanceImage(unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format, float *Luminance);
+
+#ifdef cbTHREADS
+/* A pool of worker threads that can be reused across calls. ThreadCount includes the calling thread,
+ * which also does work; 0 uses one thread per CPU. A pool should only be used by one caller at a time. */
+cb_pool *cbPoolCreate(int ThreadCount);
+void     cbPoolDestroy(cb_pool *Pool);
+int      cbPoolThreadCount(cb_pool *Pool);
+/* Calls Job(Data, i) for every i from 0 to JobCount-1 across the pool's threads, returning once all are done.
+ * Each thread starts on its own share of the jobs and takes unstarted ones from the others when it runs out. */
+void     cbPoolFor(cb_pool *Pool, int JobCount, void (*Job)(void *Data, int Index), void *Data);
+
+/* As for the image functions above, but split into cache-sized tiles that are spread across the pool.
+ * The output is identical to the single-threaded versions. A null Pool runs on the calling thread. */
+void Colo_rblindImageThreaded(cb_pool *Pool, cb_impairment Impairment, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format);
+void Colo_rblindImageGammaThreaded(cb_pool *Pool, cb_impairment Impairment, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format);
+void Colo_rblindImagesThreaded(cb_pool *Pool, cb_impairment *Impairments, int Count, unsigned char *Pixels, int Width, int Height,
+                               int Stride, cb_format Format, unsigned char **Outputs, int OutputStride);
+void Colo_rblindImagesGammaThreaded(cb_pool *Pool, cb_impairment *Impairments, int Count, unsigned char *Pixels, int Width, int Height,
+                                    int Stride, cb_format Format, unsigned char **Outputs, int OutputStride);
+#endif/*cbTHREADS*/
+
+/* Fills Matrix (row-major, as in cbImpairmentMatrices) with a blend in linear RGB from unimpaired at Severity 0 to
+ * the full impairment at 1, e.g. to fade a simulation in. It's not a model of a weaker impairment: see below. */
+void       cbImpairmentMatrix(cb_impairment Impairment, float Severity, float *Matrix);
+
+/* Anomalous trichromacy (protanomaly etc.), where a cone's sensitivity is shifted towards another's rather than
+ * missing, using Machado, Oliveira & Fernandes' (2009) model. cbAnomalyMatrices holds their matrices for severities
+ * 0 (unimpaired), 0.1, ... 1, and cbAnomalyMatrix interpolates between those steps (giving each step exactly).
+ * At severity 1 it's their model of the dichromacy, which differs a little from Protanopia etc. above.
+ * The Anomaly functions round Severity to the nearest 1/cbANOMALY_CACHE_STEPS (100 by default), whose matrices
+ * are interpolated once, on first use (or by cbInitAnomalyMatrices) and cached, so a sweep of severities costs the
+ * same per image as the fixed impairments. They match cbMatrixRGB etc. with cbAnomalyMatrix at that severity. */
+void       cbAnomalyMatrix(cb_anomaly Anomaly, float Severity, float *Matrix);
+void       cbInitAnomalyMatrices(void);
+cb_rgb     Colo_rblindRGBAnomaly(cb_anomaly Anomaly, float Severity, cb_rgb RGB); /* linear in, linear out */
+cb_rgb_255 Colo_rblindRGB255GammaAnomaly(cb_anomaly Anomaly, float Severity, cb_rgb_255 RGB);
+void       Colo_rblindImageAnomaly(cb_anomaly Anomaly, float Severity,
+                                   unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format);
+void       Colo_rblindImageGammaAnomaly(cb_anomaly Anomaly, float Severity,
+                                        unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format);
+
+/* As for the functions above, but using a given 3x3 row-major matrix in linear RGB */
+void       cbMatrix(float *Matrix, float *R, float *G, float *B);
+cb_rgb     cbMatrixRGB(float *Matrix, cb_rgb RGB);
+cb_rgb_255 cbMatrixRGB255(float *Matrix, cb_rgb_255 RGB);
+cb_rgb_255 cbMatrixRGB255Gamma(float *Matrix, cb_rgb_255 RGB);
+void       cbMatrixPlanar(float *Matrix, float *R, float *G, float *B, int Count);
+void       cbMatrixImage(float *Matrix, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format);
+void       cbMatrixImageGamma(float *Matrix, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format);
+/* A null matrix copies the image unchanged */
+void       cbMatrixImages(float **Matrices, int Count, unsigned char *Pixels, int Width, int Height, int Stride,
+                          cb_format Format, unsigned char **Outputs, int OutputStride);
+void       cbMatrixImagesGamma(float **Matrices, int Count, unsigned char *Pixels, int Width, int Height, int Stride,
+                               cb_format Format, unsigned char **Outputs, int OutputStride);
+int        cbMatrixImageUnique(float *Matrix, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format, int *FellBack);
+int        cbMatrixImageGammaUnique(float *Matrix, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format,
+                                    int *FellBack);
+#ifdef cbTHREADS
+void       cbMatrixImageThreaded(cb_pool *Pool, float *Matrix, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format);
+void       cbMatrixImageGammaThreaded(cb_pool *Pool, float *Matrix, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format);
+void       cbMatrixImagesThreaded(cb_pool *Pool, float **Matrices, int Count, unsigned char *Pixels, int Width, int Height,
+                                  int Stride, cb_format Format, unsigned char **Outputs, int OutputStride);
+void       cbMatrixImagesGammaThreaded(cb_pool *Pool, float **Matrices, int Count, unsigned char *Pixels, int Width, int Height,
+                                       int Stride, cb_format Format, unsigned char **Outputs, int OutputStride);
+#endif/*cbTHREADS*/
+
+/* Daltonisation: corrects colours so that someone with Impairment can tell apart more of the ones they would
+ * confuse. The error between a colour and its simulation (what the impairment loses) is moved onto channels they
+ * can still see, by error redistribution (Fidaner et al.); each step is linear, so the whole correction is one
+ * matrix in linear RGB, from cbDaltonisationMatrices. The monochromacies have no hue to move the error into, so
+ * their matrices are the identity. Results are clamped to 0-255, as for the Image functions.
+ * cbDaltonisationMatrix blends from the identity at Strength 0 to the full correction at 1, like
+ * cbImpairmentMatrix; build it once and use it with the cbMatrix functions (or cbFixedMatrix). */
+void       cbDaltonisationMatrix(cb_impairment Impairment, float Strength, float *Matrix);
+cb_rgb     cbDaltoniseRGB(cb_impairment Impairment, cb_rgb RGB);
+cb_rgb_255 cbDaltoniseRGB255Gamma(cb_impairment Impairment, cb_rgb_255 RGB);
+void       cbDaltoniseImage(cb_impairment Impairment, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format);
+void       cbDaltoniseImageGamma(cb_impairment Impairment, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format);
+
+/* Wide-gamut images (Display P3, Rec.2020), simulated in their own linear RGB rather than converted to sRGB and
+ * clipped. cbSpaceMatrices[Space][Impairment] takes the space's primaries to LMS (through XYZ, as for sRGB), applies
+ * the impairment there and takes it back, all multiplied into one matrix; the sRGB ones are cbImpairmentMatrices.
+ * So an image costs the same to simulate in any space, apart from its transfer curve: 8-bit pixels go through
+ * tables whatever the curve, while 16-bit and half-float ones evaluate it (PQ and HLG cost about twice sRGB).
+ * cbSpaceImpairmentMatrix blends to a Severity as cbImpairmentMatrix does, for use with cbMatrixImageTransfer. */
+void       cbSpaceImpairmentMatrix(cb_space Space, cb_impairment Impairment, float Severity, float *Matrix);
+cb_rgb     Colo_rblindRGBSpace(cb_impairment Impairment, cb_space Space, cb_rgb RGB); /* linear in, linear out */
+void       Colo_rblindImageSpace(cb_impairment Impairment, cb_space Space, cb_transfer Transfer,
+                                 unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format);
+void       cbMatrixImageTransfer(float *Matrix, cb_transfer Transfer, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format);
+#ifdef cbTHREADS
+void       Colo_rblindImageSpaceThreaded(cb_pool *Pool, cb_impairment Impairment, cb_space Space, cb_transfer Transfer,
+                                         unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format);
+#endif/*cbTHREADS*/
+
+/* 16-bit fixed-point versions of the 8-bit functions, for CPUs without a fast FPU (and twice the SIMD width
+ * of floats). Matrices are in Q14 (1.0 = 16384, see cbFixedMatrix), and the Gamma versions go through integer
+ * tables holding linear values in Q14. Results saturate to 0-255, and are within 1 of the float Image and
+ * ImageGamma functions for every 8-bit colour (with the sRGB curve; the cbGAMMA_FAST and cbGAMMA_FASTER curves
+ * are too steep near black for Q14, and can be 3 out there). 16-bit and half-float images use the float functions.
+ * The tables are built (with floats) on first use, safely from any thread; cbInitFixedTables builds them up front. */
+void       cbInitFixedTables(void);
+cb_rgb_255 Colo_rblindRGB255Fixed(cb_impairment Impairment, cb_rgb_255 RGB);
+cb_rgb_255 Colo_rblindRGB255GammaFixed(cb_impairment Impairment, cb_rgb_255 RGB);
+void       Colo_rblindImageFixed(cb_impairment Impairment, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format);
+void       Colo_rblindImageGammaFixed(cb_impairment Impairment, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format);
+/* Rounds a float matrix (as from cbImpairmentMatrix) to Q14, keeping each row's sum, so greys that the float
+ * matrix keeps grey stay grey. Coefficients must be within +-2. */
+void       cbFixedMatrix(float *Matrix, short *Fixed);
+cb_rgb_255 cbFixedRGB255(short *Fixed, cb_rgb_255 RGB);
+cb_rgb_255 cbFixedRGB255Gamma(short *Fixed, cb_rgb_255 RGB);
+void       cbFixedImage(short *Fixed, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format);
+void       cbFixedImageGamma(short *Fixed, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format);
+
+/* 3D lookup tables that bake the whole RGB255Gamma chain (remove gamma, simulate, apply gamma)
+ * into a Size^3 lattice, evaluated with tetrahedral interpolation. Colours are sRGB 0-1 in and out.
+ * Sizes of 17, 33 or 65 are typical; Create/Load return 0 on failure. */
+cb_lut    *cbLutCreate(cb_impairment Impairment, int Size);
+void       cbLutDestroy(cb_lut *Lut);
+cb_rgb     cbLutRGB(cb_lut *Lut, cb_rgb RGB);
+cb_rgb_255 cbLutRGB255(cb_lut *Lut, cb_rgb_255 RGB);
+void       cbLutImage(cb_lut *Lut, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format);
+/* Largest difference (in 0-255 steps) from the exact RGB255Gamma path over every Step-th 8-bit colour */
+int        cbLutMaxError(cb_lut *Lut, cb_impairment Impairment, int Step);
+/* Read and write the Adobe/Resolve .cube format. Save returns 0 on failure. Load skips keywords it doesn't
+ * use (TITLE, LUT_1D_INPUT_RANGE...), and fails on 1D LUTs and on domains or input ranges other than 0-1. */
+int        cbLutSave(cb_lut *Lut, char *Path);
+cb_lut    *cbLutLoad(char *Path);
+
+/* A palette simulates all of its colours once per impairment, as one row through ColourblindImageGamma
+ * (or ColourblindImage if Gamma is 0), so results are clamped to 0-255 like the image functions. It caches
+ * their luminances, and fills in every score between every pair of colours under every impairment; the
+ * lightness contrasts (APCA's test, which is much slower) are filled in the first time any of them is asked for.
+ * The scores are identical to calling e.g. cbContrastRGB255 on the simulated colours. */
+cb_palette *cbPaletteCreate(cb_rgb_255 *Colours, int Count, int Gamma);
+void        cbPaletteDestroy(cb_palette *Palette);
+float       cbPaletteContrast(cb_palette *Palette, cb_impairment Impairment, int A, int B);
+float       cbPaletteContrastModulation(cb_palette *Palette, cb_impairment Impairment, int A, int B);
+float       cbPaletteContrastRatio(cb_palette *Palette, cb_impairment Impairment, int A, int B);
+float       cbPaletteLightnessContrast(cb_palette *Palette, cb_impairment Impairment, int A, int B);
+/* Fills Pairs with up to MaxPairs of the lowest-scoring pairs of different colours for the guideline's test,
+ * across all impairments, in order from the worst. Returns the number of pairs filled in. */
+int         cbPaletteWorstPairs(cb_palette *Palette, cb_guideline Guideline, cb_pair *Pairs, int MaxPairs);
+/* Colour differences between the simulated colours, identical to calling e.g. cbDeltaE2000RGB255 on them.
+ * Each colour is converted to CIELAB and CIELUV once, on creation, and the differences found when asked for. */
+float       cbPaletteDeltaE(cb_palette *Palette, cb_delta_e Metric, cb_impairment Impairment, int A, int B);
+/* Fills Differences[Count][Count] with every pair's difference under Impairment (using SIMD for the distances) */
+void        cbPaletteDifferences(cb_palette *Palette, cb_delta_e Metric, cb_impairment Impairment, float *Differences);
+/* Fills Pairs with up to MaxPairs of the pairs of different colours whose difference under Impairment is below
+ * Threshold (e.g. 2.3 for CIE76, or 1 to 2 for CIEDE2000), in order of A then B; their Score is the difference.
+ * Returns how many there are in total, which can be more than MaxPairs. */
+int         cbPaletteConfusedPairs(cb_palette *Palette, cb_delta_e Metric, cb_impairment Impairment, float Threshold,
+                                   cb_pair *Pairs, int MaxPairs);
+
+/* A contrast map finds where an image's local contrast fails each guideline under an impairment.
+ * The image is simulated as in the ImageGamma functions and its luminance taken once; then every pixel is
+ * scored on the lightest and darkest luminances in the (2*Radius+1)-pixel square around it (cut off at the
+ * edges of the image), so Radius should be about the size of the text or detail being checked.
+ * Windows where every pixel is the same colour (at 8 bits) have nothing to read, so only the others count
+ * as edges; Mask has cbCONTRAST_EDGE set on those, and bit (1 << Guideline) where they fail the guideline.
+ * The sliding minimum and maximum take the same time whatever the Radius. Create returns 0 on failure. */
+#define cbCONTRAST_EDGE 0x80
+/* Mask is a byte, so the guideline bits have to stay below cbCONTRAST_EDGE: this fails to compile otherwise */
+typedef char cbContrastEdgeAboveGuidelines[cgGuidelineCount <= 7 ? 1 : -1];
+cb_contrast_map *cbContrastMapCreate(cb_impairment Impairment, unsigned char *Pixels, int Width, int Height, int Stride,
+                                     cb_format Format, int Radius);
+void             cbContrastMapDestroy(cb_contrast_map *Map);
+/* Fills Scores[Height][Width] with the guideline's score for each pixel's window, as a heatmap */
+void             cbContrastMapScores(cb_contrast_map *Map, cb_guideline Guideline, float *Scores);
+
+/* A sequence simulates a stream of frames (e.g. screen recordings) under several impairments, only redoing the
+ * tiles that changed since the previous frame. It keeps the last input, and an output for each impairment with
+ * rows of Width pixels, packed; each frame's tiles are compared with memcmp, the changed ones copied in and
+ * simulated into every output (as the Images functions do, with Gamma 0 or 1), and the rest left as they were.
+ * Dirty marks the tiles that changed in the last frame, e.g. to upload only those; the first frame does them all.
+ * TileSize is the side of the square tiles in pixels (0 for cbSEQUENCE_TILE). Create returns 0 on failure,
+ * and Frame the number of dirty tiles. */
+cb_sequence *cbSequenceCreate(cb_impairment *Impairments, int Count, int Gamma, int Width, int Height, cb_format Format, int TileSize);
+void         cbSequenceDestroy(cb_sequence *Sequence);
+int          cbSequenceFrame(cb_sequence *Sequence, unsigned char *Pixels, int Stride);
+#ifdef cbTHREADS
+int          cbSequenceFrameThreaded(cb_pool *Pool, cb_sequence *Sequence, unsigned char *Pixels, int Stride);
+#endif/*cbTHREADS*/
+
+/* The contrast scores below are also available from precomputed luminances (see cbLuminance) */
+float cbContrastLuminance(float LumA, float LumB);
+float cbContrastModulationLuminance(float LumA, float LumB);
+float cbContrastRatioLuminance(float LumA, float LumB);
+
 /* WCAG-defined contrast: (L_H+0.5) / (L_L+0.5) */
 /* Results range from 1 (the same colour) to 21 (white with black) */
 float cbContrast(float RA, float GA, float BA, float RB, float GB, float BB);
@@ -104,13 +513,88 @@ float cbContrastRatio255(unsigned char RA, unsigned char GA, unsigned char BA, u
 float cbContrastRatioRGB(cb_rgb A, cb_rgb B);
 float cbContrastRatioRGB255(cb_rgb_255 A, cb_rgb_255 B);
 
+/* APCA lightness contrast (Lc, SAPC-APCA 0.0.98G-4g), which weighs contrast by how light the colours are and by
+ * polarity: from about 106 for black text on white down to 0, negative for light text on dark. These take the
+ * Text colour first and use APCA's own estimate of screen luminance (a plain 2.4 power per channel). */
+float cbAPCA(float RT, float GT, float BT, float RB, float GB, float BB);
+float cbAPCA255(unsigned char RT, unsigned char GT, unsigned char BT, unsigned char RB, unsigned char GB, unsigned char BB);
+float cbAPCARGB(cb_rgb Text, cb_rgb Background);
+float cbAPCARGB255(cb_rgb_255 Text, cb_rgb_255 Background);
+float cbAPCALuminance(float YText, float YBackground);
+/* The APCA guideline's test: |Lc| from the relative luminances the other tests use, so that it fits anywhere
+ * they do. As those don't say which colour is the text, it takes the lower of the two polarities.
+ * The relative luminance differs from APCA's estimate for saturated colours, by up to about 3.5 Lc at the
+ * contrasts used for text; use cbAPCA for reference values. */
+float cbLightnessContrastLuminance(float LumA, float LumB);
+float cbLightnessContrast(float RA, float GA, float BA, float RB, float GB, float BB);
+float cbLightnessContrast255(unsigned char RA, unsigned char GA, unsigned char BA, unsigned char RB, unsigned char GB, unsigned char BB);
+float cbLightnessContrastRGB(cb_rgb A, cb_rgb B);
+float cbLightnessContrastRGB255(cb_rgb_255 A, cb_rgb_255 B);
+
+/* Checks a pair against every guideline at once: the luminances are found once and each test in COL_GUIDELINES is
+ * scored once (not once per guideline that uses it). Returns a mask with bit (1 << Guideline) set for each
+ * guideline that passes, and fills Scores[cgGuidelineCount] with each guideline's score if it isn't null. */
+unsigned int cbGuidelinesLuminance(float LumA, float LumB, float *Scores);
+unsigned int cbGuidelinesRGB(cb_rgb A, cb_rgb B, float *Scores);
+unsigned int cbGuidelinesRGB255(cb_rgb_255 A, cb_rgb_255 B, float *Scores);
+/* The same for Count pairs of sRGB colours (As[i], Bs[i]) under each of ImpairmentCount impairments: Masks[j*Count + i]
+ * (and Scores[(j*Count + i) * cgGuidelineCount] onwards, if not null) are for pair i simulated with Impairments[j].
+ * The colours are simulated as by ColourblindImageGamma (or ColourblindImage if Gamma is 0), in runs through the
+ * image kernels, so the results are identical to simulating each colour that way and calling cbGuidelinesRGB255. */
+void cbGuidelinesBatch(cb_rgb_255 *As, cb_rgb_255 *Bs, int Count, cb_impairment *Impairments, int ImpairmentCount, int Gamma,
+                       unsigned int *Masks, float *Scores);
+#ifdef cbTHREADS
+void cbGuidelinesBatchThreaded(cb_pool *Pool, cb_rgb_255 *As, cb_rgb_255 *Bs, int Count, cb_impairment *Impairments,
+                               int ImpairmentCount, int Gamma, unsigned int *Masks, float *Scores);
+#endif/*cbTHREADS*/
+
+/* Perceptual colour differences, which also see the changes of hue that luminance contrast misses (and which
+ * dichromats confuse), so compare colours after simulating them. Around 1 to 2.3 is just noticeable.
+ * The colours are converted to CIELAB or CIELUV under a D65 white, with a fast cube root that's within 3e-7
+ * of the exact one. The differences are also available from precomputed coordinates (see cbLab and cbLuv). */
+void  cbLab(float R, float G, float B, float *Lab); /* fills in L*, a*, b* */
+void  cbLab255(unsigned char R, unsigned char G, unsigned char B, float *Lab);
+void  cbLuv(float R, float G, float B, float *Luv); /* fills in L*, u*, v* */
+void  cbLuv255(unsigned char R, unsigned char G, unsigned char B, float *Luv);
+float cbDeltaE76Lab(float *LabA, float *LabB);
+float cbDeltaE2000Lab(float *LabA, float *LabB);
+float cbDeltaEuvLuv(float *LuvA, float *LuvB);
+
+/* CIE 1976 Delta E*ab: the distance in CIELAB */
+float cbDeltaE76(float RA, float GA, float BA, float RB, float GB, float BB);
+float cbDeltaE76255(unsigned char RA, unsigned char GA, unsigned char BA, unsigned char RB, unsigned char GB, unsigned char BB);
+float cbDeltaE76RGB(cb_rgb A, cb_rgb B);
+float cbDeltaE76RGB255(cb_rgb_255 A, cb_rgb_255 B);
+
+/* CIEDE2000, which corrects CIELAB for the eye's varying sensitivity to lightness, chroma and hue */
+float cbDeltaE2000(float RA, float GA, float BA, float RB, float GB, float BB);
+float cbDeltaE2000255(unsigned char RA, unsigned char GA, unsigned char BA, unsigned char RB, unsigned char GB, unsigned char BB);
+float cbDeltaE2000RGB(cb_rgb A, cb_rgb B);
+float cbDeltaE2000RGB255(cb_rgb_255 A, cb_rgb_255 B);
+
+/* CIE 1976 Delta E*uv: the distance in CIELUV */
+float cbDeltaEuv(float RA, float GA, float BA, float RB, float GB, float BB);
+float cbDeltaEuv255(unsigned char RA, unsigned char GA, unsigned char BA, unsigned char RB, unsigned char GB, unsigned char BB);
+float cbDeltaEuvRGB(cb_rgb A, cb_rgb B);
+float cbDeltaEuvRGB255(cb_rgb_255 A, cb_rgb_255 B);
+
+/* Whether a pair of luminances meets the guideline (using its test and score from COL_GUIDELINES) */
+int cbGuidelinePassLuminance(cb_guideline Guideline, float LumA, float LumB);
+
+/* Finds the colour closest in lightness to Candidate that passes Guideline against Fixed unimpaired and under
+ * protanopia, deuteranopia and tritanopia, with both colours simulated as in the RGB255Gamma functions. The candidate is mixed towards black (which keeps
+ * its chromaticity) or white (which also desaturates it) in linear RGB. Each direction is scanned in 32 steps for
+ * the first amount that passes, which is then bisected, and the closer of the two directions is kept.
+ * Returns 0 if neither direction can pass, otherwise 1, with the colour in Result. */
+int cbNearestPassingRGB255(cb_rgb_255 Fixed, cb_rgb_255 Candidate, cb_guideline Guideline, cb_rgb_255 *Result);
+
 /* Gives a 'lightness' value for comparing colours */
 float cbLuminance(float R, float G, float B);
 float cbLuminance255(unsigned char R, unsigned char G, unsigned char B);
 float cbLuminanceRGB(cb_rgb RGB);
 float cbLuminanceRGB255(cb_rgb_255 RGB);
 
-/* Convert between 0-255 and 0-1 */
+/* Convert between 0-255 and 0-1, saturating values outside 0-1 */
 cb_rgb     cbNorm(cb_rgb_255 RGB);
 cb_rgb_255 cbDenorm(cb_rgb RGB);
 
@@ -122,7 +606,73 @@ cb_rgb cbApplyGammaRGB(cb_rgb RGB);
 void   cbRemoveGamma(float *R, float *G, float *B);
 cb_rgb cbRemoveGammaRGB(cb_rgb RGB);
 
+/* Table-driven conversions between sRGB 0-255 and Linear 0-1, giving identical results to the above.
+ * The tables are built on first use, safely from any thread; cbInitGammaTables builds them up front. */
+void          cbInitGammaTables(void);
+float         cbRemoveGammaTable(unsigned char X);
+unsigned char cbApplyGammaTable(float X); /* clamped to 0-255 */
+
+/* Conversions between encoded 0-1 and linear 0-1 values with any of the cb_transfer curves (see Types).
+ * cbTransferSRGB is the curve used everywhere else, so it matches cbRemoveGamma and cbApplyGamma.
+ * The image functions that take a cb_transfer convert 8-bit pixels with tables like the gamma ones,
+ * built on first use, safely from any thread; cbInitTransferTables builds them up front. */
+float cbRemoveTransfer(cb_transfer Transfer, float X);
+float cbApplyTransfer(cb_transfer Transfer, float X);
+void  cbInitTransferTables(cb_transfer Transfer);
+
+/* Polynomial approximations of the sRGB curves above, for float data where the tables don't apply.
+ * The tiers trade accuracy for speed; the largest absolute errors over every float in 0-1 are:
+ *   cbGammaTier8Bit  remove 1.6e-3, apply 1.8e-3 (under half an 8-bit step)
+ *   cbGammaTier1e4   remove 8.2e-5, apply 8.6e-5
+ *   cbGammaTier1e6   remove 4.9e-7, apply 2.6e-7
+ * 0 and 1 map to themselves exactly. The Planar versions convert Count values in place, using SIMD
+ * where available, and give identical results to the single-value ones.
+ * Defining cbGAMMA_POLY as one of the tiers makes the rest of the library use it for float conversions. */
+float cbRemoveGammaPoly(cb_gamma_tier Tier, float X);
+float cbApplyGammaPoly(cb_gamma_tier Tier, float X);
+void  cbRemoveGammaPlanar(cb_gamma_tier Tier, float *X, int Count);
+void  cbApplyGammaPlanar(cb_gamma_tier Tier, float *X, int Count);
+
+#ifdef cbSTATS
+/* Counters of the calls into each family of functions (cb_stat) and the items (colours, pixels or pairs) they
+ * handle, with the time spent in them if cbSTATS_TIME is also defined. Each thread counts into its own block,
+ * so counting never contends; Read sums them all into Counts[cbStatCount], and includes threads that have ended.
+ * Reset makes later Reads count from now. Call both from one thread at a time (e.g. a metrics poller).
+ * ThreadEnd hands the calling thread's block on to the next thread that starts counting, keeping its counts;
+ * pool threads call it as they exit, and other threads can before they do, so blocks don't pile up.
+ * Free frees every block and starts the counts again from zero. Call it once no other thread is counting,
+ * e.g. at shutdown after cbPoolDestroy; threads that count afterwards get new blocks. */
+void cbStatsRead(cb_stat_counts *Counts);
+void cbStatsReset(void);
+void cbStatsThreadEnd(void);
+void cbStatsFree(void);
+#ifndef cbNO_STDIO
+/* Writes a line for each family into Buffer, as snprintf does, and returns the length it needed */
+int  cbStatsReport(char *Buffer, int Size);
+#endif/*cbNO_STDIO*/
+#endif/*cbSTATS*/
+
+#ifdef cbCACHE
+/* With cbCACHE, the RGB255 and RGB255Gamma functions for each impairment (and so ColourblindRGB255) and
+ * cbLuminance255 (and so the 255 and RGB255 contrast scores) remember their results for each 8-bit colour
+ * in a shared, fixed-size cache of cbCACHE_ENTRIES, in sets of cbCACHE_WAYS. Lookups take no locks, and the
+ * results are identical to computing them. A miss in a full set replaces its ways in turn, or with
+ * cbCACHE_PROMOTE defined, hits move their entry up a way and misses replace the bottom one, which keeps
+ * often-used colours at the cost of a store on some hits. Read gives the hits and misses so far and how
+ * full it is; Clear empties it and zeroes them. */
+void cbCacheRead(cb_cache_stats *Stats);
+void cbCacheClear(void);
+#endif/*cbCACHE*/
+
+#ifdef __cplusplus
+}
+#endif
+#endif/*COLOURBLIND_H*/
+
 #ifdef cbIMPLEMENTATION
+#ifdef __cplusplus
+extern "C" {
+#endif
 typedef struct cb_rgb_255 {
     unsigned char R; /* Red */
     unsigned char G; /* Green */
@@ -133,36 +683,419 @@ typedef struct cb_rgb {
     float G; /* Green */
     float B; /* Blue */
 } cb_rgb;
-typedef enum cb_impairment {
-    cbUnimpaired, cbProtanopia, cbDeuteranopia, cbTritanopia,
-    cbImpairmentCount,
-    cbRedGreenDim = cbProtanopia, cbRedGreen     = cbDeuteranopia, cbBlueYellow  = cbTritanopia,
-    cbMissingRed  = cbProtanopia, cbMissingGreen = cbDeuteranopia, cbMissingBlue = cbTritanopia,
-} cb_impairment;
+#ifdef cbSTATS
+typedef struct cb_stat_counts {
+    unsigned long long Calls, Items;
+    unsigned long long Ticks; /* with cbSTATS_TIME: cycles (rdtsc) on x86, otherwise nanoseconds */
+} cb_stat_counts;
+#endif/*cbSTATS*/
+#ifdef cbCACHE
+typedef struct cb_cache_stats {
+    unsigned long long SimulatedHits, SimulatedMisses; /* simulated colours, for any impairment */
+    unsigned long long LuminanceHits, LuminanceMisses;
+    int Entries, Used;
+} cb_cache_stats;
+#endif/*cbCACHE*/
+typedef struct cb_lut {
+    int    Size;  /* lattice points along each axis */
+    float *Table; /* Size^3 RGB triples, with red changing fastest (as in .cube files) */
+} cb_lut;
 
-char *cbImpairmentStrings[] =
-{ "Unimpaired", "Protanopia", "Deuteranopia", "Tritanopia" };
+typedef struct cb_palette {
+    int Count, Gamma;
+    cb_rgb_255 *Colours;   /* [Count] */
+    cb_rgb_255 *Simulated; /* [cbImpairmentCount][Count] */
+    float *Luminance;      /* [cbImpairmentCount][Count] */
+    float *Lab, *Luv;      /* [cbImpairmentCount][3][Count], planes of L*, a*, b* and L*, u*, v* */
+    /* [cbImpairmentCount][Count][Count], named after the test names in COL_GUIDELINES */
+    float *Contrast, *ContrastModulation, *ContrastRatio, *LightnessContrast;
+    float *Powers;                /* [cbImpairmentCount][Count][cbAPCA_PowerCount], for LightnessContrast */
+    volatile long LightnessState; /* LightnessContrast is filled in on first use, as it costs the most */
+} cb_palette;
+typedef struct cb_pair {
+    int A, B; /* indices into the palette */
+    cb_impairment Impairment;
+    float Score;
+} cb_pair;
 
-#define COL_GUIDELINES \
-    COL_GUIDELINE(ISO9241_3, ContrastRatio,      Pass, >=, 3.0) \
-    COL_GUIDELINE(WCAG,      Contrast,        AALarge, >=, 4.0) \
-    COL_GUIDELINE(WCAG,      Contrast,       AAALarge, >=, 4.5) \
-    COL_GUIDELINE(WCAG,      Contrast,             AA, >=, 4.5) \
-    COL_GUIDELINE(WCAG,      Contrast,            AAA, >=, 7.0) \
-    COL_GUIDELINE(ISO9241_3, ContrastModulation, Pass, >=, 0.5) \
+#ifndef cbMALLOC
+#include <stdlib.h> /* malloc, free */
+#define cbMALLOC malloc
+#define cbFREE   free
+#endif/*cbMALLOC*/
+
+cbSTRING cbImpairmentStrings[] =
+{ "Unimpaired", "Protanopia", "Deuteranopia", "Tritanopia", "Achromatopsia", "BlueConeMonochromacy" };
+
+/* Atomics, for the tables built on first use, and relaxed 64-bit ones for the statistics and the caches */
+#if defined(_MSC_VER)
+#include <intrin.h> /* __rdtsc, _Interlocked* */
+#define cbTHREAD_LOCAL        __declspec(thread)
+#define cbAtomicLoadAcquire(p)     _InterlockedCompareExchange((volatile long *)(p), 0, 0)
+#define cbAtomicStoreRelease(p, v) ((void)_InterlockedExchange((volatile long *)(p), (v)))
+#define cbAtomicClaim(p, o, n)     (_InterlockedCompareExchange((volatile long *)(p), (n), (o)) == (o))
+#ifdef _M_IX86
+/* 32-bit x86 splits plain 64-bit loads and stores in two, so they all go through cmpxchg8b */
+static void cbAtomicStore64_(volatile long long *P, long long V) {
+    long long Old = *P;
+    for(long long Seen; (Seen = _InterlockedCompareExchange64(P, V, Old)) != Old; ) { Old = Seen; }
+}
+static void cbAtomicAdd64_(volatile long long *P, long long V) {
+    long long Old = *P;
+    for(long long Seen; (Seen = _InterlockedCompareExchange64(P, Old + V, Old)) != Old; ) { Old = Seen; }
+}
+#define cbAtomicLoad64(p)     ((unsigned long long)_InterlockedCompareExchange64((volatile long long *)(p), 0, 0))
+#define cbAtomicStore64(p, v) cbAtomicStore64_((volatile long long *)(p), (long long)(v))
+#define cbAtomicAdd64(p, v)   cbAtomicAdd64_((volatile long long *)(p), (long long)(v))
+#else
+#define cbAtomicLoad64(p)     (*(volatile unsigned long long *)(p))
+#define cbAtomicStore64(p, v) (*(volatile unsigned long long *)(p) = (v))
+#define cbAtomicAdd64(p, v)   _InterlockedExchangeAdd64((volatile long long *)(p), (long long)(v))
+#endif/*_M_IX86*/
+
+#elif defined(__GNUC__) || defined(__clang__)
+#define cbTHREAD_LOCAL        __thread
+#define cbAtomicLoadAcquire(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define cbAtomicStoreRelease(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+static int cbAtomicClaim(volatile long *P, long Old, long New)
+{ return __atomic_compare_exchange_n(P, &Old, New, 0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE); }
+#define cbAtomicLoad64(p)     __atomic_load_n((p), __ATOMIC_RELAXED)
+#define cbAtomicStore64(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define cbAtomicAdd64(p, v)   __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+#if defined(cbCACHE) && ! defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_8)
+/* the cache's entries are single 64-bit words, which mustn't fall back to libatomic's locks */
+#error "cbCACHE needs lock-free 64-bit atomics, which this target doesn't have"
+#endif
+
+#else
+#if defined(cbSTATS) || defined(cbCACHE)
+#error "cbSTATS and cbCACHE need atomics, which are only known for MSVC, GCC and Clang"
+#endif
+/* without atomics, call the cbInit functions up front if the library is used from several threads */
+#define cbAtomicLoadAcquire(p)     (*(p))
+#define cbAtomicStoreRelease(p, v) (*(p) = (v))
+#define cbAtomicClaim(p, o, n)     (*(p) == (o) ? (*(p) = (n), 1) : 0)
+#endif/*_MSC_VER*/
+
+/* Tables built on first use go through a state of 0 (not built), 1 (being built) and 2 (ready).
+ * The thread that claims the state builds them and the rest wait for it, so none of them can see
+ * half-filled tables. Begin returns whether the caller has to build them, and if so, then calls End. */
+static int cbOnceBegin(volatile long *State) {
+    if(cbAtomicLoadAcquire(State) == 2) { return 0; }
+    if(cbAtomicClaim(State, 0, 1))      { return 1; }
+    while(cbAtomicLoadAcquire(State) != 2) {} /* building takes well under a millisecond */
+    return 0;
+}
+static void cbOnceEnd(volatile long *State) { cbAtomicStoreRelease(State, 2); }
+
+/******************************************************************************
+ * Statistics
+ ************/
+#ifdef cbSTATS
+#include <string.h> /* memset */
+cbSTRING cbStatStrings[] = { "Conversions", "Images", "Luminance", "Contrast", "Gamma", "Fixed", "Lut", "Unique" };
+
+#ifdef _MSC_VER
+#define cbStatsHead()         ((cb_stats_block *)*(void *volatile *)&cbStatsBlocks)
+#define cbStatsPush(o, n)     (_InterlockedCompareExchangePointer((void *volatile *)&cbStatsBlocks, (n), (o)) == (o))
+#else
+#define cbStatsHead()         __atomic_load_n(&cbStatsBlocks, __ATOMIC_ACQUIRE)
+#define cbStatsPush(o, n)     __atomic_compare_exchange_n(&cbStatsBlocks, &(o), (n), 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)
+#endif/*_MSC_VER*/
+
+#ifdef cbSTATS_TIME
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#ifndef _MSC_VER
+#include <x86intrin.h> /* __rdtsc */
+#endif/*_MSC_VER*/
+#define cbStatsTicks() ((unsigned long long)__rdtsc())
+#else
+#include <time.h> /* clock_gettime */
+static unsigned long long cbStatsTicks(void) {
+    struct timespec Now;
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (unsigned long long)Now.tv_sec * 1000000000ull + (unsigned long long)Now.tv_nsec;
+}
+#endif
+#else
+#define cbStatsTicks() 0ull
+#endif/*cbSTATS_TIME*/
+
+/* Only the owning thread writes a block, so its counters are updated with plain (relaxed) loads and stores.
+ * Blocks are pushed onto the list on a thread's first count and stay there until cbStatsFree, so their counts
+ * outlive the thread; a block given up by cbStatsThreadEnd is claimed by the next thread to register, which
+ * carries on adding to its counts. The generation changes on every cbStatsFree, so that threads holding on to
+ * a freed block register again. */
+typedef struct cb_stats_block {
+    cb_stat_counts Counts[cbStatCount];
+    struct cb_stats_block *Next;
+    volatile long Owned;
+} cb_stats_block;
+static cbTHREAD_LOCAL cb_stats_block *cbStatsLocal;
+static cbTHREAD_LOCAL long cbStatsLocalGeneration;
+static cb_stats_block *cbStatsBlocks;
+static volatile long cbStatsGeneration;
+static cb_stat_counts cbStatsBaseline[cbStatCount];
+
+#define cbStatsOwn() (cbStatsLocal && cbStatsLocalGeneration == cbStatsGeneration ? cbStatsLocal : 0)
+
+static cb_stats_block *cbStatsRegister(void) {
+    cbStatsLocalGeneration = cbStatsGeneration;
+    for(cb_stats_block *Block = cbStatsHead(); Block; Block = Block->Next)
+    { if(cbAtomicClaim(&Block->Owned, 0, 1)) { return cbStatsLocal = Block; } }
+
+    cb_stats_block *Block = (cb_stats_block *)cbMALLOC(sizeof(cb_stats_block));
+    if(! Block) { return 0; }
+    memset(Block->Counts, 0, sizeof(Block->Counts));
+    Block->Owned = 1;
+    cb_stats_block *Head;
+    do { Block->Next = Head = cbStatsHead(); } while(! cbStatsPush(Head, Block));
+    return cbStatsLocal = Block;
+}
+
+void cbStatsThreadEnd(void) {
+    cb_stats_block *Block = cbStatsOwn();
+    if(Block) { cbAtomicStoreRelease(&Block->Owned, 0); }
+    cbStatsLocal = 0;
+}
+
+void cbStatsFree(void) {
+    cb_stats_block *Block = cbStatsHead();
+    cbStatsBlocks = 0, cbStatsLocal = 0;
+    cbAtomicStoreRelease(&cbStatsGeneration, cbStatsGeneration + 1);
+    memset(cbStatsBaseline, 0, sizeof(cbStatsBaseline));
+    while(Block) {
+        cb_stats_block *Next = Block->Next;
+        cbFREE(Block);
+        Block = Next;
+    }
+}
+
+static void cbStatsAdd(cb_stat Stat, unsigned long long Items, unsigned long long Start) {
+    cb_stats_block *Block = cbStatsOwn();
+    if(! Block) { Block = cbStatsRegister(); }
+    if(! Block) { return; }
+    cb_stat_counts *Counts = &Block->Counts[Stat];
+    cbAtomicStore64(&Counts->Calls, Counts->Calls + 1);
+    cbAtomicStore64(&Counts->Items, Counts->Items + Items);
+#ifdef cbSTATS_TIME
+    if(Stat != cbStatGamma) { cbAtomicStore64(&Counts->Ticks, Counts->Ticks + (cbStatsTicks() - Start)); }
+#else
+    (void)Start;
+#endif/*cbSTATS_TIME*/
+}
+
+static void cbStatsSum(cb_stat_counts *Counts) {
+    memset(Counts, 0, sizeof(cb_stat_counts) * cbStatCount);
+    for(cb_stats_block *Block = cbStatsHead(); Block; Block = Block->Next)
+    for(int s = 0; s < cbStatCount; ++s) {
+        Counts[s].Calls += cbAtomicLoad64(&Block->Counts[s].Calls);
+        Counts[s].Items += cbAtomicLoad64(&Block->Counts[s].Items);
+        Counts[s].Ticks += cbAtomicLoad64(&Block->Counts[s].Ticks);
+    }
+}
+void cbStatsRead(cb_stat_counts *Counts) {
+    cbStatsSum(Counts);
+    for(int s = 0; s < cbStatCount; ++s) {
+        Counts[s].Calls -= cbStatsBaseline[s].Calls;
+        Counts[s].Items -= cbStatsBaseline[s].Items;
+        Counts[s].Ticks -= cbStatsBaseline[s].Ticks;
+    }
+}
+void cbStatsReset(void) { cbStatsSum(cbStatsBaseline); }
+
+#ifndef cbNO_STDIO
+#include <stdio.h> /* snprintf */
+int cbStatsReport(char *Buffer, int Size) {
+    cb_stat_counts Counts[cbStatCount];
+    int Length = 0;
+    cbStatsRead(Counts);
+    for(int s = 0; s < cbStatCount; ++s) {
+        int Remaining = Size - Length > 0 ? Size - Length : 0;
+        Length += snprintf(Remaining ? Buffer + Length : 0, (size_t)Remaining, "%-12s %14llu calls %16llu items %18llu ticks\n",
+                           cbStatStrings[s], Counts[s].Calls, Counts[s].Items, Counts[s].Ticks);
+    }
+    return Length;
+}
+#endif/*cbNO_STDIO*/
+
+/* wrapped around a function's body; BEGIN declares the start time, so it goes before anything else */
+#define cbSTAT_BEGIN()             unsigned long long cbStatStart_ = cbStatsTicks()
+#define cbSTAT_END(Stat, Items)    cbStatsAdd((Stat), (unsigned long long)(Items), cbStatStart_)
+#define cbGammaPow(X, Y)           (cbStatsAdd(cbStatGamma, 1, 0), cbPOW(X, Y))
+#else
+#define cbSTAT_BEGIN()
+#define cbSTAT_END(Stat, Items)
+#define cbGammaPow(X, Y)           cbPOW(X, Y)
+#endif/*cbSTATS*/
+
+/******************************************************************************
+ * Caches
+ ********/
+#ifdef cbCACHE
+#include <string.h> /* memcpy, memset */
+/* Each entry is one 64-bit word, so it is read and written atomically without locks: the low 32 bits are a tag
+ * (valid, kind, gamma, impairment and the 24-bit colour) and the high 32 bits the value. Entries are grouped
+ * into sets of cbCACHE_WAYS, chosen by a hash of the tag, and a miss replaces an empty way if there is one,
+ * or else the next in turn from a per-thread counter. With cbCACHE_PROMOTE, a hit swaps its entry with the one
+ * above, so colours that keep hitting rise to the top and the last way holds the least recently promoted one,
+ * which a miss replaces. A reader that loses a race just sees a miss, and a swap that loses one can leave an
+ * entry in two ways or lose it, which only costs a later miss. */
+#ifndef cbCACHE_ENTRIES
+#define cbCACHE_ENTRIES (1 << 16) /* a power of 2; 512KB */
+#endif/*cbCACHE_ENTRIES*/
+#ifndef cbCACHE_WAYS
+#define cbCACHE_WAYS 4            /* a power of 2, up to cbCACHE_ENTRIES */
+#endif/*cbCACHE_WAYS*/
+#define cbCACHE_SHARDS 16
+
+enum { cbCacheSimulated, cbCacheLuminance, cbCacheKindCount };
+/* hit and miss counts, spread over cache lines by thread so that they rarely contend */
+typedef struct cb_cache_shard {
+    unsigned long long Hits[cbCacheKindCount], Misses[cbCacheKindCount];
+    char Padding[64 - 4 * sizeof(unsigned long long)];
+} cb_cache_shard;
+
+static unsigned long long cbCacheEntries[cbCACHE_ENTRIES];
+static cb_cache_shard     cbCacheShards[cbCACHE_SHARDS];
+static cbTHREAD_LOCAL unsigned int cbCacheVictim;
+
+static unsigned int cbCacheTag(int Kind, int Impairment, int Gamma, cb_rgb_255 RGB) {
+    return 0x80000000u | (unsigned int)Kind << 28 | (unsigned int)(Gamma != 0) << 27 | (unsigned int)Impairment << 24 |
+           (unsigned int)RGB.R << 16 | (unsigned int)RGB.G << 8 | RGB.B;
+}
+static cb_cache_shard *cbCacheShard(void) {
+    unsigned long long Thread = (unsigned long long)(size_t)&cbCacheVictim; /* a different address in each thread */
+    return &cbCacheShards[(Thread * 0x9E3779B97F4A7C15ull) >> 60 & (cbCACHE_SHARDS - 1)];
+}
+static unsigned long long *cbCacheSet(unsigned int Tag) {
+    unsigned int Hash = Tag * 0x9E3779B1u;
+    return cbCacheEntries + ((Hash >> 8) & (cbCACHE_ENTRIES / cbCACHE_WAYS - 1)) * cbCACHE_WAYS;
+}
+
+static int cbCacheFind(int Kind, unsigned int Tag, unsigned int *Value) {
+    unsigned long long *Set = cbCacheSet(Tag);
+    for(int w = 0; w < cbCACHE_WAYS; ++w) {
+        unsigned long long Entry = cbAtomicLoad64(&Set[w]);
+        if((unsigned int)Entry == Tag) {
+            *Value = (unsigned int)(Entry >> 32);
+#ifdef cbCACHE_PROMOTE
+            if(w > 0) {
+                cbAtomicStore64(&Set[w], cbAtomicLoad64(&Set[w - 1]));
+                cbAtomicStore64(&Set[w - 1], Entry);
+            }
+#endif/*cbCACHE_PROMOTE*/
+            cbAtomicAdd64(&cbCacheShard()->Hits[Kind], 1);
+            return 1;
+        }
+    }
+    cbAtomicAdd64(&cbCacheShard()->Misses[Kind], 1);
+    return 0;
+}
+static void cbCacheAdd(unsigned int Tag, unsigned int Value) {
+    unsigned long long *Set = cbCacheSet(Tag);
+    int Way = -1;
+    for(int w = 0; w < cbCACHE_WAYS && Way < 0; ++w) { if(! cbAtomicLoad64(&Set[w])) { Way = w; } }
+#ifdef cbCACHE_PROMOTE
+    if(Way < 0) { Way = cbCACHE_WAYS - 1; }
+#else
+    if(Way < 0) { Way = (int)(cbCacheVictim++ & (cbCACHE_WAYS - 1)); }
+#endif/*cbCACHE_PROMOTE*/
+    cbAtomicStore64(&Set[Way], (unsigned long long)Value << 32 | Tag);
+}
+
+#define cbCacheRGB255Value(RGB) ((unsigned int)(RGB).R << 16 | (unsigned int)(RGB).G << 8 | (RGB).B)
+static cb_rgb_255 cbCacheRGB255(cb_impairment Impairment, int Gamma, cb_rgb_255 RGB, cb_rgb_255 (*Simulate)(cb_rgb_255)) {
+    unsigned int Tag = cbCacheTag(cbCacheSimulated, Impairment, Gamma, RGB), Value;
+    if(cbCacheFind(cbCacheSimulated, Tag, &Value)) {
+        cb_rgb_255 Result = { (unsigned char)(Value >> 16), (unsigned char)(Value >> 8), (unsigned char)Value };
+        return Result;
+    }
+    cb_rgb_255 Result = Simulate(RGB);
+    cbCacheAdd(Tag, cbCacheRGB255Value(Result));
+    return Result;
+}
+static float cbCacheLuminance255(unsigned char R, unsigned char G, unsigned char B, float (*Luminance)(unsigned char, unsigned char, unsigned char)) {
+    cb_rgb_255 RGB = { R, G, B };
+    unsigned int Tag = cbCacheTag(cbCacheLuminance, 0, 1, RGB), Value;
+    float Result;
+    if(cbCacheFind(cbCacheLuminance, Tag, &Value)) { memcpy(&Result, &Value, sizeof(Result)); return Result; }
+    Result = Luminance(R, G, B);
+    memcpy(&Value, &Result, sizeof(Value));
+    cbCacheAdd(Tag, Value);
+    return Result;
+}
+
+void cbCacheRead(cb_cache_stats *Stats) {
+    memset(Stats, 0, sizeof(cb_cache_stats));
+    for(int s = 0; s < cbCACHE_SHARDS; ++s) {
+        Stats->SimulatedHits   += cbAtomicLoad64(&cbCacheShards[s].Hits[cbCacheSimulated]);
+        Stats->SimulatedMisses += cbAtomicLoad64(&cbCacheShards[s].Misses[cbCacheSimulated]);
+        Stats->LuminanceHits   += cbAtomicLoad64(&cbCacheShards[s].Hits[cbCacheLuminance]);
+        Stats->LuminanceMisses += cbAtomicLoad64(&cbCacheShards[s].Misses[cbCacheLuminance]);
+    }
+    Stats->Entries = cbCACHE_ENTRIES;
+    for(int i = 0; i < cbCACHE_ENTRIES; ++i) { Stats->Used += cbAtomicLoad64(&cbCacheEntries[i]) != 0; }
+}
+void cbCacheClear(void) {
+    for(int i = 0; i < cbCACHE_ENTRIES; ++i) { cbAtomicStore64(&cbCacheEntries[i], 0ull); }
+    for(int s = 0; s < cbCACHE_SHARDS; ++s)
+    for(int k = 0; k < cbCacheKindCount; ++k) {
+        cbAtomicStore64(&cbCacheShards[s].Hits[k], 0ull);
+        cbAtomicStore64(&cbCacheShards[s].Misses[k], 0ull);
+    }
+}
+
+#define cbCACHED_RGB255(Impairment, Gamma, RGB, Simulate) cbCacheRGB255((Impairment), (Gamma), (RGB), (Simulate))
+#define cbCACHED_LUMINANCE255(R, G, B, Luminance)         cbCacheLuminance255((R), (G), (B), (Luminance))
+#else
+#define cbCACHED_RGB255(Impairment, Gamma, RGB, Simulate) Simulate(RGB)
+#define cbCACHED_LUMINANCE255(R, G, B, Luminance)         Luminance((R), (G), (B))
+#endif/*cbCACHE*/
 
-#define COL_GUIDELINE(source, testname, rating, comparison, value) cb## source ##_## testname ##_## rating,
-typedef enum cb_guideline    { COL_GUIDELINES cgGuidelineCount } cb_guideline;
-#undef COL_GUIDELINE
 #define COL_GUIDELINE(source, testname, rating, comparison, value) #source " " #testname " " #rating,
-char *cbGuidelineStrings[] = { COL_GUIDELINES };
+cbSTRING cbGuidelineStrings[] = { COL_GUIDELINES };
 #undef COL_GUIDELINE
 #define COL_GUIDELINE(source, testname, rating, comparison, value) value,
 float cbGuidelineScores[]  = { COL_GUIDELINES };
 #undef COL_GUIDELINE
 
+typedef struct cb_contrast_stats {
+    int   Failures;       /* edge pixels that fail the guideline */
+    float Worst;          /* the lowest score of any edge pixel (0 if there are none) */
+    int   WorstX, WorstY; /* where it is (-1 if there are no edges) */
+} cb_contrast_stats;
+typedef struct cb_contrast_map {
+    int Width, Height, Radius;
+    cb_impairment Impairment;
+    int Edges;                 /* pixels with cbCONTRAST_EDGE set */
+    float *Luminance;          /* [Height][Width], of the simulated image */
+    float *Lightest, *Darkest; /* [Height][Width], the extremes of Luminance in the window around each pixel */
+    unsigned char *Mask;       /* [Height][Width] */
+    cb_contrast_stats Stats[cgGuidelineCount];
+} cb_contrast_map;
+
+typedef struct cb_sequence {
+    int Width, Height, Gamma;
+    cb_format Format;
+    int Count;
+    cb_impairment *Impairments; /* [Count] */
+    unsigned char *Previous;    /* [Height][OutputStride], the last frame */
+    unsigned char **Outputs;    /* [Count], each [Height][OutputStride] */
+    int OutputStride;           /* Width * the pixel size */
+    int TileSize, TilesAcross, TilesDown;
+    unsigned char *Dirty;       /* [TilesDown][TilesAcross], 1 where the tile changed in the last frame */
+    int DirtyTiles;             /* in the last frame; DirtyTiles / (TilesAcross * TilesDown) is the share redone */
+    long Frames, TotalDirtyTiles;
+} cb_sequence;
+
 
 /* assumes already normalized to 0-1 */
+#ifdef cbGAMMA_POLY
+#define cbApplyGammaComponent(X)  cbApplyGammaPoly(cbGAMMA_POLY, X)
+#define cbRemoveGammaComponent(X) cbRemoveGammaPoly(cbGAMMA_POLY, X)
+
+#else /* cbGAMMA_POLY */
 #ifdef cbGAMMA_FASTER
 #ifndef cbSQRT
 #include <math.h> /* sqrt, pow */
@@ -179,23 +1112,29 @@ float cbGuidelineScores[]  = { COL_GUIDELINES };
 #endif/*cbPOW*/
 
 #ifdef cbGAMMA_FAST
-#define cbApplyGammaComponent(X)  ((float)cbPOW(X, 0.454545454545454545454545454545454545454545))
-#define cbRemoveGammaComponent(X) ((float)cbPOW(X, 2.2))
+#define cbApplyGammaComponent(X)  ((float)cbGammaPow(X, 0.454545454545454545454545454545454545454545))
+#define cbRemoveGammaComponent(X) ((float)cbGammaPow(X, 2.2))
 
 #else /* cbGAMMA_FAST */
 #define cbApplyGammaComponent(X) \
     ((float)(X > 0.00313080495356037151702786377709   ? \
-        1.055 * cbPOW((X), 0.4166666666) - 0.055      : \
+        1.055 * cbGammaPow((X), 0.4166666666) - 0.055 : \
         X * 12.92))
 #define cbRemoveGammaComponent(X) \
     ((float)(X > 0.04045                ? \
-        cbPOW((X + 0.055) / 1.055, 2.4) : \
+        cbGammaPow((X + 0.055) / 1.055, 2.4) : \
         X / 12.92))
 #endif /* cbGAMMA_FAST */
 #endif /* cbGAMMA_FASTER */
+#endif /* cbGAMMA_POLY */
 
 #define cbNormComponent(X)   ((float)(X) / 255.f)
 #define cbDenormComponent(X) ((unsigned char)((X) * 255.f + 0.5f))
+/* like cbDenormComponent, but saturating rather than wrapping when out of range */
+#define cbClampDenormComponent(X) \
+    ((unsigned char)((X) <= 0.f ? 0   : \
+                     (X) >= 1.f ? 255 : \
+                     cbDenormComponent(X)))
 
 #define cbGamma(dir) \
 void dir##Gamma(float *R, float *G, float *B) { \
@@ -218,54 +1157,237 @@ out name(in RGB) { \
     return Result; \
 }
 cbDomain(cbNorm, cb_rgb_255, cb_rgb)
-cbDomain(cbDenorm, cb_rgb, cb_rgb_255)
 #undef cbDomain
+/* simulated colours can leave 0-1, so this saturates like the image functions */
+cb_rgb_255 cbDenorm(cb_rgb RGB) {
+    cb_rgb_255 Result =
+    { cbClampDenormComponent(RGB.R), cbClampDenormComponent(RGB.G), cbClampDenormComponent(RGB.B) };
+    return Result;
+}
+
+/******************************************************************************
+ * Transfer functions
+ ********************/
+#include <math.h> /* pow, exp, log */
+
+/* SMPTE ST 2084 */
+#define cbPQ_M1 0.1593017578125
+#define cbPQ_M2 78.84375
+#define cbPQ_C1 0.8359375
+#define cbPQ_C2 18.8515625
+#define cbPQ_C3 18.6875
+/* ITU-R BT.2100 */
+#define cbHLG_A 0.17883277
+#define cbHLG_B 0.28466892
+#define cbHLG_C 0.55991073
+
+float cbRemoveTransfer(cb_transfer Transfer, float X) {
+    switch(Transfer) {
+        case cbTransferSRGB:    return cbRemoveGammaComponent(X);
+        case cbTransferGamma24: return X > 0.f ? (float)pow(X, 2.4) : 0.f;
+        case cbTransferPQ: {
+            if(! (X > 0.f)) { return 0.f; }
+            double P = pow(X < 1.f ? X : 1.f, 1.0 / cbPQ_M2), Top = P - cbPQ_C1;
+            return Top > 0.0 ? (float)pow(Top / (cbPQ_C2 - cbPQ_C3 * P), 1.0 / cbPQ_M1) : 0.f;
+        }
+        case cbTransferHLG:
+            if(! (X > 0.f)) { return 0.f; }
+            return X <= 0.5f ? X * X / 3.f : (float)((exp((X - cbHLG_C) / cbHLG_A) + cbHLG_B) / 12.0);
+        default: return X;
+    }
+}
+
+float cbApplyTransfer(cb_transfer Transfer, float X) {
+    switch(Transfer) {
+        case cbTransferSRGB:    return cbApplyGammaComponent(X);
+        case cbTransferGamma24: return X > 0.f ? (float)pow(X, 1.0 / 2.4) : 0.f;
+        case cbTransferPQ: {
+            if(! (X > 0.f)) { return 0.f; }
+            double Y = pow(X, cbPQ_M1);
+            return (float)pow((cbPQ_C1 + cbPQ_C2 * Y) / (1.0 + cbPQ_C3 * Y), cbPQ_M2);
+        }
+        case cbTransferHLG:
+            if(! (X > 0.f)) { return 0.f; }
+            return X <= 1.f / 12.f ? (float)sqrt(3.0 * X) : (float)(cbHLG_A * log(12.0 * X - cbHLG_B) + cbHLG_C);
+        default: return X;
+    }
+}
+
+/* Finds the lowest linear value that rounds to each 8-bit output of a curve (used by the tables below),
+ * by bisecting on the bit patterns, which are ordered the same as the (positive) floats */
+static void cbFindEncodeThresholds(cb_transfer Transfer, float *Thresholds) {
+    union { float F; unsigned int U; } Lo, Hi, Mid;
+    Thresholds[0] = 0.f;
+    for(int Level = 1; Level < 256; ++Level) {
+        Lo.F = 0.f, Hi.F = 1.f;
+        while(Hi.U - Lo.U > 1) {
+            Mid.U = Lo.U + (Hi.U - Lo.U) / 2;
+            float Encoded = cbApplyTransfer(Transfer, Mid.F);
+            if(cbClampDenormComponent(Encoded) >= Level) { Hi = Mid; }
+            else                                         { Lo = Mid; }
+        }
+        Thresholds[Level] = Hi.F;
+    }
+    Thresholds[256] = 2.f; /* sentinel */
+}
+
+/******************************************************************************
+ * Gamma tables
+ **************/
+/* Decoding 8-bit values only has 256 possible inputs, so they are just precomputed.
+ * Encoding is done by finding the lowest linear value that rounds to each 8-bit output;
+ * a 4096-entry index gets within a step or two of the right threshold.
+ * Both are built with the same gamma curve as above, so the results are identical to it. */
+#define cbGAMMA_INDEX_SIZE 4096
+static float         cbGammaDecodeTable[256];
+static float         cbGammaEncodeThresholds[257];
+static unsigned char cbGammaEncodeIndex[cbGAMMA_INDEX_SIZE];
+static volatile long cbGammaTablesState;
+
+void cbInitGammaTables(void) {
+    if(! cbOnceBegin(&cbGammaTablesState)) { return; }
+    for(int i = 0; i < 256; ++i)
+    { cbGammaDecodeTable[i] = cbRemoveGammaComponent(cbNormComponent(i)); }
+    cbFindEncodeThresholds(cbTransferSRGB, cbGammaEncodeThresholds);
+
+    for(int i = 0, Level = 0; i < cbGAMMA_INDEX_SIZE; ++i) {
+        while(cbGammaEncodeThresholds[Level+1] <= (float)i / cbGAMMA_INDEX_SIZE) { ++Level; }
+        cbGammaEncodeIndex[i] = (unsigned char)Level;
+    }
+    cbOnceEnd(&cbGammaTablesState);
+}
+
+float cbRemoveGammaTable(unsigned char X) {
+    cbInitGammaTables();
+    return cbGammaDecodeTable[X];
+}
+
+/* expects the tables to have been initialised */
+static unsigned char cbApplyGammaTableUnchecked(float X) {
+    if(! (X > 0.f)) { return 0;   } /* also catches NaN */
+    if(X >= 1.f)    { return 255; }
+    int Level = cbGammaEncodeIndex[(int)(X * cbGAMMA_INDEX_SIZE)];
+    while(X >= cbGammaEncodeThresholds[Level+1]) { ++Level; }
+    return (unsigned char)Level;
+}
+unsigned char cbApplyGammaTable(float X) {
+    cbInitGammaTables();
+    return cbApplyGammaTableUnchecked(X);
+}
+
+/* The same for the other transfer curves. PQ and HLG put most of their 8-bit levels very close to black,
+ * where an evenly spaced index would be too coarse, so these are indexed by the top 16 bits of the float,
+ * 128 entries per octave. The sRGB curve keeps the tables above, which the rest of the library uses directly. */
+#define cbTRANSFER_INDEX_SIZE ((0x3F800000 >> 16) + 1)
+typedef struct cb_transfer_tables {
+    float         Decode[256];
+    float         EncodeThresholds[257];
+    unsigned char EncodeIndex[cbTRANSFER_INDEX_SIZE];
+    volatile long State; /* see cbOnceBegin */
+} cb_transfer_tables;
+static cb_transfer_tables cbTransferTables[cbTransferCount];
+
+void cbInitTransferTables(cb_transfer Transfer) {
+    if(Transfer == cbTransferSRGB) { cbInitGammaTables(); return; }
+    if(Transfer <= cbTransferLinear || Transfer >= cbTransferCount) { return; }
+    cb_transfer_tables *Tables = &cbTransferTables[Transfer];
+    if(! cbOnceBegin(&Tables->State)) { return; }
+    for(int i = 0; i < 256; ++i)
+    { Tables->Decode[i] = cbRemoveTransfer(Transfer, cbNormComponent(i)); }
+    cbFindEncodeThresholds(Transfer, Tables->EncodeThresholds);
+
+    union { float F; unsigned int U; } Start;
+    for(int i = 0, Level = 0; i < cbTRANSFER_INDEX_SIZE; ++i) {
+        Start.U = (unsigned int)i << 16;
+        while(Tables->EncodeThresholds[Level+1] <= Start.F) { ++Level; }
+        Tables->EncodeIndex[i] = (unsigned char)Level;
+    }
+    cbOnceEnd(&Tables->State);
+}
+
+/* expects the tables to have been initialised */
+static unsigned char cbApplyTransferTableUnchecked(const cb_transfer_tables *Tables, float X) {
+    if(! (X > 0.f)) { return 0;   } /* also catches NaN */
+    if(X >= 1.f)    { return 255; }
+    union { float F; unsigned int U; } Bits;
+    Bits.F = X;
+    int Level = Tables->EncodeIndex[Bits.U >> 16];
+    while(X >= Tables->EncodeThresholds[Level+1]) { ++Level; }
+    return (unsigned char)Level;
+}
+
+/* the conversions used by the 255 versions of functions */
+#ifdef cbGAMMA_TABLE
+#define cbRemoveGamma255Component(X)     cbRemoveGammaTable(X)
+#define cbApplyGammaDenormComponent(X)   cbApplyGammaTable(X)
+#else /* cbGAMMA_TABLE */
+/* clamped before the curve, as pow would give NaN for negative values */
+static unsigned char cbApplyGammaDenormClamped(float X) {
+    if(! (X > 0.f)) { return 0;   }
+    if(X >= 1.f)    { return 255; }
+    return cbDenormComponent(cbApplyGammaComponent(X));
+}
+#define cbRemoveGamma255Component(X)     cbRemoveGammaComponent(cbNormComponent(X))
+#define cbApplyGammaDenormComponent(X)   cbApplyGammaDenormClamped(X)
+#endif/* cbGAMMA_TABLE */
 
 /* Luminances */
+#define cbLUMINANCE(R, G, B) (0.2126f*(R) + 0.7152f*(G) + 0.0722f*(B))
 float cbLuminance(float R, float G, float B) {
+    cbSTAT_BEGIN();
     R = cbRemoveGammaComponent(R);
     G = cbRemoveGammaComponent(G);
     B = cbRemoveGammaComponent(B);
-    float Result = 0.2126f*R + 0.7152f*G + 0.0722f*B;
+    float Result = cbLUMINANCE(R, G, B);
+    cbSTAT_END(cbStatLuminance, 1);
+    return Result;
+}
+static float cbLuminance255Uncached(unsigned char R, unsigned char G, unsigned char B) {
+    float Rl = cbRemoveGamma255Component(R);
+    float Gl = cbRemoveGamma255Component(G);
+    float Bl = cbRemoveGamma255Component(B);
+    return cbLUMINANCE(Rl, Gl, Bl);
+}
+float cbLuminance255(unsigned char R, unsigned char G, unsigned char B) {
+    cbSTAT_BEGIN();
+    float Result = cbCACHED_LUMINANCE255(R, G, B, cbLuminance255Uncached);
+    cbSTAT_END(cbStatLuminance, 1);
     return Result;
 }
-float cbLuminance255(unsigned char R, unsigned char G, unsigned char B)
-{ return cbLuminance(cbNormComponent(R), cbNormComponent(G), cbNormComponent(B)); }
 float cbLuminanceRGB(cb_rgb RGB)
 { return cbLuminance(RGB.R, RGB.G, RGB.B); }
 float cbLuminanceRGB255(cb_rgb_255 RGB)
-{ return cbLuminance(cbNormComponent(RGB.R), cbNormComponent(RGB.G), cbNormComponent(RGB.B)); }
+{ return cbLuminance255(RGB.R, RGB.G, RGB.B); }
 
 /* prevents division by 0 */
-float cbContrast(float RA, float GA, float BA, float RB, float GB, float BB) {
-    float LumA = cbLuminance(RA, GA, BA);
-    float LumB = cbLuminance(RB, GB, BB);
+float cbContrastLuminance(float LumA, float LumB) {
+    cbSTAT_BEGIN();
     float High = LumA, Low = LumB;
     if(High < Low)
     { High = LumB, Low = LumA; }
 
     /* from http://www.w3.org/TR/2008/REC-WCAG20-20081211/#contrast-ratiodef */
     float Ratio = (High + 0.05f) / (Low  + 0.05f);
+    cbSTAT_END(cbStatContrast, 1);
     return Ratio;
 }
 
-float cbContrastRatio(float RA, float GA, float BA, float RB, float GB, float BB) {
-    float LumA = cbLuminance(RA, GA, BA);
-    float LumB = cbLuminance(RB, GB, BB);
+float cbContrastRatioLuminance(float LumA, float LumB) {
+    cbSTAT_BEGIN();
     float High = LumA, Low = LumB;
     if(High < Low)
     { High = LumB, Low = LumA; }
 
     float Ratio = High / Low;
+    cbSTAT_END(cbStatContrast, 1);
     return Ratio;
 }
 
-float cbContrastModulation(float RA, float GA, float BA, float RB, float GB, float BB) {
-    float LumA = cbLuminance(RA, GA, BA);
-    float LumB = cbLuminance(RB, GB, BB);
+float cbContrastModulationLuminance(float LumA, float LumB) {
+    cbSTAT_BEGIN();
     float High = LumA, Low  = LumB;
     if (High == Low) /* for black */
-    { return 0; }
+    { cbSTAT_END(cbStatContrast, 1); return 0; }
     else if (High < Low) {
         High = LumB;
         Low  = LumA;
@@ -273,22 +1395,233 @@ float cbContrastModulation(float RA, float GA, float BA, float RB, float GB, flo
 
     float Top    = High - Low;
     float Bottom = High + Low;
+    cbSTAT_END(cbStatContrast, 1);
     return Top/Bottom;
 }
 
+/* APCA's constants; Lc is worked out from these powers of the (soft-clamped) luminances */
+#define cbAPCA_BLACK_THRESHOLD 0.022f
+#define cbAPCA_BLACK_CLAMP     1.414
+#define cbAPCA_DELTA_MIN       0.0005f
+#define cbAPCA_SCALE           1.14f
+#define cbAPCA_LOW_CLIP        0.1f
+#define cbAPCA_OFFSET          0.027f
+enum { cbAPCA_Y, cbAPCA_NormalBackground, cbAPCA_NormalText, cbAPCA_ReverseBackground, cbAPCA_ReverseText, cbAPCA_PowerCount };
+static void cbAPCAPowers(float Y, float *Powers) {
+    if(Y < cbAPCA_BLACK_THRESHOLD) { Y += (float)pow(cbAPCA_BLACK_THRESHOLD - Y, cbAPCA_BLACK_CLAMP); }
+    Powers[cbAPCA_Y]                 = Y;
+    Powers[cbAPCA_NormalBackground]  = (float)pow(Y, 0.56);
+    Powers[cbAPCA_NormalText]        = (float)pow(Y, 0.57);
+    Powers[cbAPCA_ReverseBackground] = (float)pow(Y, 0.65);
+    Powers[cbAPCA_ReverseText]       = (float)pow(Y, 0.62);
+}
+static float cbAPCAFromPowers(const float *Text, const float *Background) {
+    float Difference = Background[cbAPCA_Y] - Text[cbAPCA_Y];
+    if(Difference < cbAPCA_DELTA_MIN && Difference > -cbAPCA_DELTA_MIN) { return 0.f; }
+    if(Difference > 0.f) { /* dark text on light */
+        float S = (Background[cbAPCA_NormalBackground] - Text[cbAPCA_NormalText]) * cbAPCA_SCALE;
+        return S < cbAPCA_LOW_CLIP ? 0.f : (S - cbAPCA_OFFSET) * 100.f;
+    }
+    float S = (Background[cbAPCA_ReverseBackground] - Text[cbAPCA_ReverseText]) * cbAPCA_SCALE;
+    return S > -cbAPCA_LOW_CLIP ? 0.f : (S + cbAPCA_OFFSET) * 100.f;
+}
+
+float cbAPCALuminance(float YText, float YBackground) {
+    float Text[cbAPCA_PowerCount], Background[cbAPCA_PowerCount];
+    cbAPCAPowers(YText, Text);
+    cbAPCAPowers(YBackground, Background);
+    return cbAPCAFromPowers(Text, Background);
+}
+float cbLightnessContrastLuminance(float LumA, float LumB) {
+    cbSTAT_BEGIN();
+    float A[cbAPCA_PowerCount], B[cbAPCA_PowerCount];
+    cbAPCAPowers(LumA, A);
+    cbAPCAPowers(LumB, B);
+    float AOnB = fabsf(cbAPCAFromPowers(A, B)), BOnA = fabsf(cbAPCAFromPowers(B, A));
+    cbSTAT_END(cbStatContrast, 1);
+    return AOnB < BOnA ? AOnB : BOnA;
+}
+
+/* APCA's screen luminance, from sRGB 0-1 */
+static float cbAPCAScreenLuminance(float R, float G, float B) {
+    return 0.2126729f * (float)pow(R > 0.f ? R : 0.f, 2.4) + 0.7151522f * (float)pow(G > 0.f ? G : 0.f, 2.4) +
+           0.0721750f * (float)pow(B > 0.f ? B : 0.f, 2.4);
+}
+float cbAPCA(float RT, float GT, float BT, float RB, float GB, float BB)
+{ return cbAPCALuminance(cbAPCAScreenLuminance(RT, GT, BT), cbAPCAScreenLuminance(RB, GB, BB)); }
+float cbAPCA255(unsigned char RT, unsigned char GT, unsigned char BT, unsigned char RB, unsigned char GB, unsigned char BB) {
+    return cbAPCA(cbNormComponent(RT), cbNormComponent(GT), cbNormComponent(BT),
+                  cbNormComponent(RB), cbNormComponent(GB), cbNormComponent(BB));
+}
+float cbAPCARGB(cb_rgb Text, cb_rgb Background)
+{ return cbAPCA(Text.R, Text.G, Text.B, Background.R, Background.G, Background.B); }
+float cbAPCARGB255(cb_rgb_255 Text, cb_rgb_255 Background)
+{ return cbAPCA255(Text.R, Text.G, Text.B, Background.R, Background.G, Background.B); }
+
 #define cbOTHER_VERSIONS(fn) \
+float fn(float RA, float GA, float BA, float RB, float GB, float BB) \
+{ return fn##Luminance(cbLuminance(RA, GA, BA), cbLuminance(RB, GB, BB)); } \
 float fn##255(unsigned char RA, unsigned char GA, unsigned char BA, unsigned char RB, unsigned char GB, unsigned char BB) \
-{ return fn(cbNormComponent(RA), cbNormComponent(GA), cbNormComponent(BA), \
-            cbNormComponent(RB), cbNormComponent(GB), cbNormComponent(BB)); } \
+{ return fn##Luminance(cbLuminance255(RA, GA, BA), cbLuminance255(RB, GB, BB)); } \
 float fn##RGB(cb_rgb A, cb_rgb B) \
-{ return fn(A.R, A.G, A.B, B.R, B.G, B.B); } \
+{ return fn##Luminance(cbLuminanceRGB(A), cbLuminanceRGB(B)); } \
 float fn##RGB255(cb_rgb_255 A, cb_rgb_255 B) \
-{ return fn(cbNormComponent(A.R), cbNormComponent(A.G), cbNormComponent(A.B), \
-            cbNormComponent(B.R), cbNormComponent(B.G), cbNormComponent(B.B)); }
+{ return fn##Luminance(cbLuminanceRGB255(A), cbLuminanceRGB255(B)); }
 
 cbOTHER_VERSIONS(cbContrast)
 cbOTHER_VERSIONS(cbContrastRatio)
 cbOTHER_VERSIONS(cbContrastModulation)
+cbOTHER_VERSIONS(cbLightnessContrast)
+#undef cbOTHER_VERSIONS
+
+int cbGuidelinePassLuminance(cb_guideline Guideline, float LumA, float LumB) {
+    switch(Guideline) {
+#define COL_GUIDELINE(source, testname, rating, comparison, value) \
+        case cb## source ##_## testname ##_## rating: return cb## testname ##Luminance(LumA, LumB) comparison value;
+        COL_GUIDELINES
+#undef COL_GUIDELINE
+        default: return 0;
+    }
+}
+
+unsigned int cbGuidelinesLuminance(float LumA, float LumB, float *Scores) {
+    /* one score per test, named after it (so a guideline with a new test needs one adding here) */
+    float Contrast           = cbContrastLuminance(LumA, LumB);
+    float ContrastRatio      = cbContrastRatioLuminance(LumA, LumB);
+    float ContrastModulation = cbContrastModulationLuminance(LumA, LumB);
+#ifdef cbGUIDELINE_APCA
+    float LightnessContrast  = cbLightnessContrastLuminance(LumA, LumB);
+#endif/*cbGUIDELINE_APCA*/
+    unsigned int Mask = 0;
+#define COL_GUIDELINE(source, testname, rating, comparison, value) \
+    if(Scores) { Scores[cb## source ##_## testname ##_## rating] = testname; } \
+    if(testname comparison value) { Mask |= 1u << cb## source ##_## testname ##_## rating; }
+    COL_GUIDELINES
+#undef COL_GUIDELINE
+    return Mask;
+}
+unsigned int cbGuidelinesRGB(cb_rgb A, cb_rgb B, float *Scores)
+{ return cbGuidelinesLuminance(cbLuminanceRGB(A), cbLuminanceRGB(B), Scores); }
+unsigned int cbGuidelinesRGB255(cb_rgb_255 A, cb_rgb_255 B, float *Scores)
+{ return cbGuidelinesLuminance(cbLuminanceRGB255(A), cbLuminanceRGB255(B), Scores); }
+
+/******************************************************************************
+ * Colour difference
+ *******************/
+/* Linear sRGB to CIE XYZ (IEC 61966-2-1), with the white point being its rows' sums so white has no colour */
+#define cbXYZ(R, G, B, X, Y, Z) \
+    ((X) = 0.4124f*(R) + 0.3576f*(G) + 0.1805f*(B), \
+     (Y) = 0.2126f*(R) + 0.7152f*(G) + 0.0722f*(B), \
+     (Z) = 0.0193f*(R) + 0.1192f*(G) + 0.9505f*(B))
+#define cbWHITE_X (0.4124f + 0.3576f + 0.1805f)
+#define cbWHITE_Y 1.f
+#define cbWHITE_Z (0.0193f + 0.1192f + 0.9505f)
+#define cbLAB_EPSILON (216.f/24389.f)
+#define cbLAB_KAPPA   (24389.f/27.f)
+
+/* The cube root for CIELAB's f(t), where t is above cbLAB_EPSILON: an estimate from a third of the exponent bits,
+ * refined by two steps of Halley's method (each of which triples the correct bits) */
+static float cbCubeRoot(float X) {
+    union { float F; unsigned int U; } Bits;
+    Bits.F = X;
+    Bits.U = Bits.U / 3 + 709921077u;
+    float Y = Bits.F, Y3 = Y*Y*Y;
+    Y *= (Y3 + 2.f*X) / (2.f*Y3 + X);
+    Y3 = Y*Y*Y;
+    Y *= (Y3 + 2.f*X) / (2.f*Y3 + X);
+    return Y;
+}
+static float cbLabF(float T)
+{ return T > cbLAB_EPSILON ? cbCubeRoot(T) : (cbLAB_KAPPA*T + 16.f) / 116.f; }
+
+static void cbLabLinear(float R, float G, float B, float *Lab) {
+    float X, Y, Z;
+    cbXYZ(R, G, B, X, Y, Z);
+    float FX = cbLabF(X / cbWHITE_X), FY = cbLabF(Y / cbWHITE_Y), FZ = cbLabF(Z / cbWHITE_Z);
+    Lab[0] = 116.f*FY - 16.f;
+    Lab[1] = 500.f*(FX - FY);
+    Lab[2] = 200.f*(FY - FZ);
+}
+static void cbLuvLinear(float R, float G, float B, float *Luv) {
+    float X, Y, Z;
+    cbXYZ(R, G, B, X, Y, Z);
+    float Denominator = X + 15.f*Y + 3.f*Z;
+    float WhiteDenominator = cbWHITE_X + 15.f*cbWHITE_Y + 3.f*cbWHITE_Z;
+    float L = 116.f*cbLabF(Y / cbWHITE_Y) - 16.f;
+    /* black has no chromaticity, but its L* of 0 zeroes u* and v* anyway */
+    float U = Denominator > 0.f ? 4.f*X / Denominator : 0.f, V = Denominator > 0.f ? 9.f*Y / Denominator : 0.f;
+    Luv[0] = L;
+    Luv[1] = 13.f*L*(U - 4.f*cbWHITE_X / WhiteDenominator);
+    Luv[2] = 13.f*L*(V - 9.f*cbWHITE_Y / WhiteDenominator);
+}
+
+void cbLab(float R, float G, float B, float *Lab)
+{ cbLabLinear(cbRemoveGammaComponent(R), cbRemoveGammaComponent(G), cbRemoveGammaComponent(B), Lab); }
+void cbLab255(unsigned char R, unsigned char G, unsigned char B, float *Lab)
+{ cbLabLinear(cbRemoveGamma255Component(R), cbRemoveGamma255Component(G), cbRemoveGamma255Component(B), Lab); }
+void cbLuv(float R, float G, float B, float *Luv)
+{ cbLuvLinear(cbRemoveGammaComponent(R), cbRemoveGammaComponent(G), cbRemoveGammaComponent(B), Luv); }
+void cbLuv255(unsigned char R, unsigned char G, unsigned char B, float *Luv)
+{ cbLuvLinear(cbRemoveGamma255Component(R), cbRemoveGamma255Component(G), cbRemoveGamma255Component(B), Luv); }
+
+float cbDeltaE76Lab(float *LabA, float *LabB) {
+    float DL = LabA[0] - LabB[0], Da = LabA[1] - LabB[1], Db = LabA[2] - LabB[2];
+    return sqrtf(DL*DL + Da*Da + Db*Db);
+}
+float cbDeltaEuvLuv(float *LuvA, float *LuvB)
+{ return cbDeltaE76Lab(LuvA, LuvB); }
+
+/* from Sharma, Wu and Dalal, "The CIEDE2000 Color-Difference Formula: Implementation Notes,
+ * Supplementary Test Data, and Mathematical Observations" (2005), with angles in degrees as there */
+float cbDeltaE2000Lab(float *LabA, float *LabB) {
+    const float Degrees = 57.2957795f, Radians = 0.0174532925f, Pow25To7 = 6103515625.f;
+    float L1 = LabA[0], a1 = LabA[1], b1 = LabA[2], L2 = LabB[0], a2 = LabB[1], b2 = LabB[2];
+    float MeanC = 0.5f*(sqrtf(a1*a1 + b1*b1) + sqrtf(a2*a2 + b2*b2));
+    float MeanC7 = MeanC*MeanC*MeanC*MeanC*MeanC*MeanC*MeanC;
+    float G = 0.5f*(1.f - sqrtf(MeanC7 / (MeanC7 + Pow25To7)));
+    float ap1 = (1.f + G)*a1, ap2 = (1.f + G)*a2;
+    float Cp1 = sqrtf(ap1*ap1 + b1*b1), Cp2 = sqrtf(ap2*ap2 + b2*b2);
+    float hp1 = Cp1 == 0.f ? 0.f : atan2f(b1, ap1)*Degrees, hp2 = Cp2 == 0.f ? 0.f : atan2f(b2, ap2)*Degrees;
+    if(hp1 < 0.f) { hp1 += 360.f; }
+    if(hp2 < 0.f) { hp2 += 360.f; }
+
+    float DL = L2 - L1, DC = Cp2 - Cp1, Dh = 0.f, MeanH = hp1 + hp2;
+    if(Cp1*Cp2 != 0.f) {
+        Dh = hp2 - hp1;
+        if(Dh > 180.f) { Dh -= 360.f; }
+        else if(Dh < -180.f) { Dh += 360.f; }
+        if(fabsf(hp1 - hp2) <= 180.f) { MeanH *= 0.5f; }
+        else { MeanH = MeanH < 360.f ? 0.5f*(MeanH + 360.f) : 0.5f*(MeanH - 360.f); }
+    }
+    float DH = 2.f*sqrtf(Cp1*Cp2)*sinf(0.5f*Dh*Radians);
+
+    float MeanL = 0.5f*(L1 + L2), MeanCp = 0.5f*(Cp1 + Cp2);
+    float T = 1.f - 0.17f*cosf((MeanH - 30.f)*Radians) + 0.24f*cosf(2.f*MeanH*Radians)
+                  + 0.32f*cosf((3.f*MeanH + 6.f)*Radians) - 0.20f*cosf((4.f*MeanH - 63.f)*Radians);
+    float HueOffset = (MeanH - 275.f) / 25.f;
+    float DTheta = 30.f*expf(-HueOffset*HueOffset);
+    float MeanCp7 = MeanCp*MeanCp*MeanCp*MeanCp*MeanCp*MeanCp*MeanCp;
+    float RC = 2.f*sqrtf(MeanCp7 / (MeanCp7 + Pow25To7));
+    float L50 = (MeanL - 50.f)*(MeanL - 50.f);
+    float SL = 1.f + 0.015f*L50 / sqrtf(20.f + L50), SC = 1.f + 0.045f*MeanCp, SH = 1.f + 0.015f*MeanCp*T;
+    float RT = -sinf(2.f*DTheta*Radians)*RC;
+    float TermL = DL / SL, TermC = DC / SC, TermH = DH / SH;
+    return sqrtf(TermL*TermL + TermC*TermC + TermH*TermH + RT*TermC*TermH);
+}
+
+#define cbOTHER_VERSIONS(fn, space) \
+float fn(float RA, float GA, float BA, float RB, float GB, float BB) \
+{ float A[3], B[3]; cb##space(RA, GA, BA, A), cb##space(RB, GB, BB, B); return fn##space(A, B); } \
+float fn##255(unsigned char RA, unsigned char GA, unsigned char BA, unsigned char RB, unsigned char GB, unsigned char BB) \
+{ float A[3], B[3]; cb##space##255(RA, GA, BA, A), cb##space##255(RB, GB, BB, B); return fn##space(A, B); } \
+float fn##RGB(cb_rgb A, cb_rgb B) \
+{ return fn(A.R, A.G, A.B, B.R, B.G, B.B); } \
+float fn##RGB255(cb_rgb_255 A, cb_rgb_255 B) \
+{ return fn##255(A.R, A.G, A.B, B.R, B.G, B.B); }
+
+cbOTHER_VERSIONS(cbDeltaE76, Lab)
+cbOTHER_VERSIONS(cbDeltaE2000, Lab)
+cbOTHER_VERSIONS(cbDeltaEuv, Luv)
 #undef cbOTHER_VERSIONS
 
 /******************************************************************************
@@ -296,92 +1629,2582 @@ cbOTHER_VERSIONS(cbContrastModulation)
  *****************/
 /* http://ixora.io/projects/colorblindness/color-blindness-simulation-research/ */
 
-void Protanopia(float *Red, float *Green, float *Blue) {
-    float R = *Red, G = *Green, B = *Blue;
-    *Red   =  0.17055699213417f*R + 0.82944301379913f*G + 2.91188E-9f *B;
-    *Green =  0.17055699092998f*R + 0.82944300785005f*G - 5.98679E-10f*B;
-    *Blue  = -0.00451714424166f*R + 0.00451714427397f*G +              B;
-}
+/* Row-major, so that e.g. Red = M[0]*R + M[1]*G + M[2]*B */
+float cbImpairmentMatrices[cbImpairmentCount][9] = cbIMPAIRMENT_MATRICES;
 
-void Deuteranopia(float *Red, float *Green, float *Blue) {
-    float R = *Red, G = *Green, B = *Blue;
-    *Red   =  0.33066007266046f*R + 0.66933992517563f*G + 3.559314E-9f*B;
-    *Green =  0.33066007387760f*R + 0.66933992719147f*G - 1.758327E-9f*B;
-    *Blue  = -0.02785538261323f*R + 0.02785538252318f*G +              B;
-}
+/* Machado, Oliveira & Fernandes, "A Physiologically-based Model for Simulation of Color Vision Deficiency" (2009):
+ * each cone's sensitivity shifted by up to 20nm towards another's, as linear RGB matrices for severities k/10 */
+float cbAnomalyMatrices[cbAnomalyCount][cbANOMALY_STEPS + 1][9] = {
+    { /* Protanomaly */
+        /* 0.0 */ {          1,          0,          0,
+                             0,          1,          0,
+                             0,          0,          1 },
+        /* 0.1 */ {  0.856167f,  0.182038f, -0.038205f,
+                     0.029342f,  0.955115f,  0.015544f,
+                    -0.002880f, -0.001563f,  1.004443f },
+        /* 0.2 */ {  0.734766f,  0.334872f, -0.069637f,
+                     0.051840f,  0.919198f,  0.028963f,
+                    -0.004928f, -0.004209f,  1.009137f },
+        /* 0.3 */ {  0.630323f,  0.465641f, -0.095964f,
+                     0.069181f,  0.890046f,  0.040773f,
+                    -0.006308f, -0.007724f,  1.014032f },
+        /* 0.4 */ {  0.539009f,  0.579343f, -0.118352f,
+                     0.082546f,  0.866121f,  0.051332f,
+                    -0.007136f, -0.011959f,  1.019095f },
+        /* 0.5 */ {  0.458064f,  0.679578f, -0.137642f,
+                     0.092785f,  0.846313f,  0.060902f,
+                    -0.007494f, -0.016807f,  1.024301f },
+        /* 0.6 */ {  0.385450f,  0.769005f, -0.154455f,
+                     0.100526f,  0.829802f,  0.069673f,
+                    -0.007442f, -0.022190f,  1.029632f },
+        /* 0.7 */ {  0.319627f,  0.849633f, -0.169261f,
+                     0.106241f,  0.815969f,  0.077790f,
+                    -0.007025f, -0.028051f,  1.035076f },
+        /* 0.8 */ {  0.259411f,  0.923008f, -0.182420f,
+                     0.110296f,  0.804340f,  0.085364f,
+                    -0.006276f, -0.034346f,  1.040622f },
+        /* 0.9 */ {  0.203876f,  0.990338f, -0.194214f,
+                     0.112975f,  0.794542f,  0.092483f,
+                    -0.005222f, -0.041043f,  1.046265f },
+        /* 1.0 */ {  0.152286f,  1.052583f, -0.204868f,
+                     0.114503f,  0.786281f,  0.099216f,
+                    -0.003882f, -0.048116f,  1.051998f },
+    },
+    { /* Deuteranomaly */
+        /* 0.0 */ {          1,          0,          0,
+                             0,          1,          0,
+                             0,          0,          1 },
+        /* 0.1 */ {  0.866435f,  0.177704f, -0.044139f,
+                     0.049567f,  0.939063f,  0.011370f,
+                    -0.003453f,  0.007233f,  0.996220f },
+        /* 0.2 */ {  0.760729f,  0.319078f, -0.079807f,
+                     0.090568f,  0.889315f,  0.020117f,
+                    -0.006027f,  0.013325f,  0.992702f },
+        /* 0.3 */ {  0.675425f,  0.433850f, -0.109275f,
+                     0.125303f,  0.847755f,  0.026942f,
+                    -0.007950f,  0.018572f,  0.989378f },
+        /* 0.4 */ {  0.605511f,  0.528560f, -0.134071f,
+                     0.155318f,  0.812366f,  0.032316f,
+                    -0.009376f,  0.023176f,  0.986200f },
+        /* 0.5 */ {  0.547494f,  0.607765f, -0.155259f,
+                     0.181692f,  0.781742f,  0.036566f,
+                    -0.010410f,  0.027275f,  0.983136f },
+        /* 0.6 */ {  0.498864f,  0.674741f, -0.173604f,
+                     0.205199f,  0.754872f,  0.039929f,
+                    -0.011131f,  0.030969f,  0.980162f },
+        /* 0.7 */ {  0.457771f,  0.731899f, -0.189670f,
+                     0.226409f,  0.731012f,  0.042579f,
+                    -0.011595f,  0.034333f,  0.977261f },
+        /* 0.8 */ {  0.422823f,  0.781057f, -0.203881f,
+                     0.245752f,  0.709602f,  0.044646f,
+                    -0.011843f,  0.037423f,  0.974421f },
+        /* 0.9 */ {  0.392952f,  0.823610f, -0.216562f,
+                     0.263559f,  0.690210f,  0.046232f,
+                    -0.011910f,  0.040281f,  0.971630f },
+        /* 1.0 */ {  0.367322f,  0.860646f, -0.227968f,
+                     0.280085f,  0.672501f,  0.047413f,
+                    -0.011820f,  0.042940f,  0.968881f },
+    },
+    { /* Tritanomaly */
+        /* 0.0 */ {          1,          0,          0,
+                             0,          1,          0,
+                             0,          0,          1 },
+        /* 0.1 */ {  0.926670f,  0.092514f, -0.019184f,
+                     0.021191f,  0.964503f,  0.014306f,
+                     0.008437f,  0.054813f,  0.936750f },
+        /* 0.2 */ {  0.895720f,  0.133330f, -0.029050f,
+                     0.029997f,  0.945400f,  0.024603f,
+                     0.013027f,  0.104707f,  0.882266f },
+        /* 0.3 */ {  0.905871f,  0.127791f, -0.033662f,
+                     0.026856f,  0.941251f,  0.031893f,
+                     0.013410f,  0.148296f,  0.838294f },
+        /* 0.4 */ {  0.948035f,  0.089490f, -0.037526f,
+                     0.014364f,  0.946792f,  0.038844f,
+                     0.010853f,  0.193991f,  0.795156f },
+        /* 0.5 */ {  1.017277f,  0.027029f, -0.044306f,
+                    -0.006113f,  0.958479f,  0.047634f,
+                     0.006379f,  0.248708f,  0.744913f },
+        /* 0.6 */ {  1.104996f, -0.046633f, -0.058363f,
+                    -0.032137f,  0.971635f,  0.060503f,
+                     0.001336f,  0.317922f,  0.680742f },
+        /* 0.7 */ {  1.193214f, -0.109812f, -0.083402f,
+                    -0.058496f,  0.979410f,  0.079086f,
+                    -0.002346f,  0.403492f,  0.598854f },
+        /* 0.8 */ {  1.257728f, -0.139648f, -0.118081f,
+                    -0.078003f,  0.975409f,  0.102594f,
+                    -0.003316f,  0.501214f,  0.502102f },
+        /* 0.9 */ {  1.278864f, -0.125333f, -0.153531f,
+                    -0.084748f,  0.957674f,  0.127074f,
+                    -0.000989f,  0.601151f,  0.399838f },
+        /* 1.0 */ {  1.255528f, -0.076749f, -0.178779f,
+                    -0.078411f,  0.930809f,  0.147602f,
+                     0.004733f,  0.691367f,  0.303900f },
+    },
+};
 
-void Tritanopia(float *Red, float *Green, float *Blue) {
-    float R = *Red, G = *Green, B = *Blue;
-    *Red   =              R + 0.12739886310880f*G - 0.12739886341072f*B;
-    *Green = -4.486E-11f *R + 0.87390929928361f*G + 0.12609070101523f*B;
-    *Blue  =  3.1113E-10f*R + 0.87390929725848f*G + 0.12609070067115f*B;
+/* cbImpairmentMatrices folded into I + E(I - S), where S simulates the impairment (so I - S gives the lost error)
+ * and E redistributes the error: for red-green impairments, onto green and blue as [0 0 0, .7 1 0, .7 0 1];
+ * for tritanopia, onto red and green as [1 0 .7, 0 1 .7, 0 0 0] */
+float cbDaltonisationMatrices[cbImpairmentCount][9] = {
+    /* Unimpaired */ {
+                     1,                  0,                  0,
+                     0,                  1,                  0,
+                     0,                  0,                  1 },
+    /* Protanopia */ {
+                     1,                  0,                  0,
+     0.41005311457610f,  0.58994688249056f,                  0,
+     0.58512724974774f, -0.58512725393336f,                  1 },
+    /* Deuteranopia */ {
+                     1,                  0,                  0,
+     0.13787787526008f,  0.86212212518559f,                  0,
+     0.49639333175091f, -0.49639333014612f,                  1 },
+    /* Tritanopia */ {
+                     1, -0.73913537118974f,  0.73913537294091f,
+                     0,  0.51435419263545f,  0.48564580851496f,
+                     0,                  0,                  1 },
+    /* Achromatopsia */ {
+                     1,                  0,                  0,
+                     0,                  1,                  0,
+                     0,                  0,                  1 },
+    /* Blue cone monochromacy */ {
+                     1,                  0,                  0,
+                     0,                  1,                  0,
+                     0,                  0,                  1 },
+};
+
+/* cbImpairmentMatrices for each cb_space: the simulation matrix is M^-1 D M, where M takes the space's linear RGB to
+ * LMS (its primaries to XYZ, then Hunt-Pointer-Estevez) and D is the dichromat's projection in LMS, which doesn't
+ * depend on the space. Achromatopsia keeps the space's own luminance row, and blue cone monochromacy its S row. */
+float cbSpaceMatrices[cbSpaceCount][cbImpairmentCount][9] = {
+    /* sRGB */ cbIMPAIRMENT_MATRICES,
+    { /* Display P3 */
+        /* Unimpaired */ {
+                         1,                  0,                  0,
+                         0,                  1,                  0,
+                         0,                  0,                  1 },
+        /* Protanopia */ {
+         0.17402616707536f,  0.82597358906861f,                  0,
+         0.17402621871158f,  0.82597383266697f,                  0,
+        -0.00752193789583f,  0.00752193567510f,                  1 },
+        /* Deuteranopia */ {
+         0.37687101555720f,  0.62312879527797f,                  0,
+         0.37687113054844f,  0.62312898385928f,                  0,
+        -0.01628950660254f,  0.01628950165750f,                  1 },
+        /* Tritanopia */ {
+         0.99815266677306f,  0.09234882408623f, -0.09050150816499f,
+         0.00263811252333f,  0.86811984660723f,  0.12924206558311f,
+        -0.01768251192717f,  0.88395485965879f,  0.13372748661971f },
+        /* Achromatopsia */ {
+         0.22900360000000f,  0.69172672500000f,  0.07926967500000f,
+         0.22900360000000f,  0.69172672500000f,  0.07926967500000f,
+         0.22900360000000f,  0.69172672500000f,  0.07926967500000f },
+        /* Blue cone monochromacy */ {
+                         0,  0.04143219097563f,  0.95856780902437f,
+                         0,  0.04143219097563f,  0.95856780902437f,
+                         0,  0.04143219097563f,  0.95856780902437f },
+    },
+    { /* Rec.2020 */
+        /* Unimpaired */ {
+                         1,                  0,                  0,
+                         0,                  1,                  0,
+                         0,                  0,                  1 },
+        /* Protanopia */ {
+         0.17094456797390f,  0.79910824133587f,  0.02994703711069f,
+         0.17752691169048f,  0.82888572620039f, -0.00641260500465f,
+        -0.00469814546697f,  0.00452843877095f,  1.00016970582571f },
+        /* Deuteranopia */ {
+         0.44253942042067f,  0.53732395129956f,  0.02013652233294f,
+         0.45957972243833f,  0.55702124698385f, -0.01660088207785f,
+        -0.01216250747071f,  0.01172317256370f,  1.00043933259549f },
+        /* Tritanopia */ {
+         0.99188527684159f,  0.09406902088419f, -0.08595431374187f,
+         0.01034410590192f,  0.88008710893510f,  0.10956880557923f,
+        -0.08232064458802f,  0.95429286788780f,  0.12802761422331f },
+        /* Achromatopsia */ {
+         0.26272171736164f,  0.67798927550226f,  0.05928900713610f,
+         0.26272171736164f,  0.67798927550226f,  0.05928900713610f,
+         0.26272171736164f,  0.67798927550226f,  0.05928900713610f },
+        /* Blue cone monochromacy */ {
+                         0,  0.02578210450451f,  0.97421789549549f,
+                         0,  0.02578210450451f,  0.97421789549549f,
+                         0,  0.02578210450451f,  0.97421789549549f },
+    },
+};
+
+#define cbMATRIX(nopia) \
+void nopia(float *Red, float *Green, float *Blue) { \
+    float *M = cbImpairmentMatrices[cb##nopia]; \
+    float R = *Red, G = *Green, B = *Blue; \
+    *Red   = M[0]*R + M[1]*G + M[2]*B; \
+    *Green = M[3]*R + M[4]*G + M[5]*B; \
+    *Blue  = M[6]*R + M[7]*G + M[8]*B; \
 }
+cbMATRIX(Protanopia)
+cbMATRIX(Deuteranopia)
+cbMATRIX(Tritanopia)
+cbMATRIX(Achromatopsia)
+cbMATRIX(BlueConeMonochromacy)
+#undef cbMATRIX
 
 /* assumes value in 0-1 */
 #define cbNOPIA(nopia) \
 cb_rgb nopia ##RGB(cb_rgb RGB) { \
+    cbSTAT_BEGIN(); \
     nopia(&RGB.R, &RGB.G, &RGB.B); \
+    cbSTAT_END(cbStatConversions, 1); \
     return RGB; \
 } \
 /* take and return rgb as 0-255 */ \
-cb_rgb_255 nopia ##RGB255(cb_rgb_255 RGB) {\
+static cb_rgb_255 nopia ##RGB255Uncached(cb_rgb_255 RGB) {\
     cb_rgb RGBNorm = cbNorm(RGB);\
     nopia(&RGBNorm.R, &RGBNorm.G, &RGBNorm.B); \
-    cb_rgb_255 Result   = cbDenorm(RGBNorm);\
+    return cbDenorm(RGBNorm);\
+} \
+cb_rgb_255 nopia ##RGB255(cb_rgb_255 RGB) {\
+    cbSTAT_BEGIN(); \
+    cb_rgb_255 Result = cbCACHED_RGB255(cb ##nopia, 0, RGB, nopia ##RGB255Uncached); \
+    cbSTAT_END(cbStatConversions, 1); \
     return Result;\
 } \
 /* take and return gamma-corrected rgb as 0-255 */ \
-cb_rgb_255 nopia ##RGB255Gamma(cb_rgb_255 RGB) {\
-    cb_rgb RGBNorm = cbRemoveGammaRGB(cbNorm(RGB)); \
+static cb_rgb_255 nopia ##RGB255GammaUncached(cb_rgb_255 RGB) {\
+    cb_rgb RGBNorm = { cbRemoveGamma255Component(RGB.R), \
+                       cbRemoveGamma255Component(RGB.G), \
+                       cbRemoveGamma255Component(RGB.B) }; \
     nopia(&RGBNorm.R, &RGBNorm.G, &RGBNorm.B); \
-    cb_rgb_255 Result = cbDenorm(cbApplyGammaRGB(RGBNorm)); \
+    cb_rgb_255 Result = { cbApplyGammaDenormComponent(RGBNorm.R), \
+                          cbApplyGammaDenormComponent(RGBNorm.G), \
+                          cbApplyGammaDenormComponent(RGBNorm.B) }; \
+    return Result;\
+} \
+cb_rgb_255 nopia ##RGB255Gamma(cb_rgb_255 RGB) {\
+    cbSTAT_BEGIN(); \
+    cb_rgb_255 Result = cbCACHED_RGB255(cb ##nopia, 1, RGB, nopia ##RGB255GammaUncached); \
+    cbSTAT_END(cbStatConversions, 1); \
     return Result;\
 } \
 void nopia ##255(unsigned char *R, unsigned char *G, unsigned char *B) { \
+    cbSTAT_BEGIN(); \
     float Rf = cbNormComponent(*R), Gf = cbNormComponent(*G), Bf = cbNormComponent(*B); \
     nopia(&Rf, &Gf, &Bf); \
-    *R = cbDenormComponent(Rf); \
-    *G = cbDenormComponent(Gf); \
-    *B = cbDenormComponent(Bf); \
+    *R = cbClampDenormComponent(Rf); \
+    *G = cbClampDenormComponent(Gf); \
+    *B = cbClampDenormComponent(Bf); \
+    cbSTAT_END(cbStatConversions, 1); \
 }
 
 cbNOPIA(Protanopia)
 cbNOPIA(Deuteranopia)
 cbNOPIA(Tritanopia)
+cbNOPIA(Achromatopsia)
+cbNOPIA(BlueConeMonochromacy)
 #undef cbNOPIA
 
 cb_rgb Colo_rblindRGB(cb_impairment Impairment, cb_rgb RGB) {
     switch(Impairment) {
-        case cbProtanopia:   return ProtanopiaRGB(  RGB);
-        case cbDeuteranopia: return DeuteranopiaRGB(RGB);
-        case cbTritanopia:   return TritanopiaRGB(  RGB);
-        default:             return RGB;
+        case cbProtanopia:           return ProtanopiaRGB(          RGB);
+        case cbDeuteranopia:         return DeuteranopiaRGB(        RGB);
+        case cbTritanopia:           return TritanopiaRGB(          RGB);
+        case cbAchromatopsia:        return AchromatopsiaRGB(       RGB);
+        case cbBlueConeMonochromacy: return BlueConeMonochromacyRGB(RGB);
+        default:                     return RGB;
     }
 }
 cb_rgb_255 Colo_rblindRGB255(cb_impairment Impairment, cb_rgb_255 RGB) {
     switch(Impairment) {
-        case cbProtanopia:   return ProtanopiaRGB255(  RGB);
-        case cbDeuteranopia: return DeuteranopiaRGB255(RGB);
-        case cbTritanopia:   return TritanopiaRGB255(  RGB);
-        default:             return RGB;
+        case cbProtanopia:           return ProtanopiaRGB255(          RGB);
+        case cbDeuteranopia:         return DeuteranopiaRGB255(        RGB);
+        case cbTritanopia:           return TritanopiaRGB255(          RGB);
+        case cbAchromatopsia:        return AchromatopsiaRGB255(       RGB);
+        case cbBlueConeMonochromacy: return BlueConeMonochromacyRGB255(RGB);
+        default:                     return RGB;
     }
 }
 void Colo_rblind255(cb_impairment Impairment, unsigned char *R, unsigned char *G, unsigned char *B) {
     switch(Impairment) {
-        case cbProtanopia:   Protanopia255(  R, G, B); break;
-        case cbDeuteranopia: Deuteranopia255(R, G, B); break;
-        case cbTritanopia:   Tritanopia255(  R, G, B);
+        case cbProtanopia:           Protanopia255(          R, G, B); break;
+        case cbDeuteranopia:         Deuteranopia255(        R, G, B); break;
+        case cbTritanopia:           Tritanopia255(          R, G, B); break;
+        case cbAchromatopsia:        Achromatopsia255(       R, G, B); break;
+        case cbBlueConeMonochromacy: BlueConeMonochromacy255(R, G, B);
     }
 }
 void Colo_rblind(cb_impairment Impairment, float *R, float *G, float *B) {
     switch(Impairment) {
-        case cbProtanopia:   Protanopia(  R, G, B); break;
-        case cbDeuteranopia: Deuteranopia(R, G, B); break;
-        case cbTritanopia:   Tritanopia(  R, G, B);
+        case cbProtanopia:           Protanopia(          R, G, B); break;
+        case cbDeuteranopia:         Deuteranopia(        R, G, B); break;
+        case cbTritanopia:           Tritanopia(          R, G, B); break;
+        case cbAchromatopsia:        Achromatopsia(       R, G, B); break;
+        case cbBlueConeMonochromacy: BlueConeMonochromacy(R, G, B);
     }
 }
 
-#endif/* cbIMPLEMENTATION */
-#ifdef __cplusplus
+void cbImpairmentMatrix(cb_impairment Impairment, float Severity, float *Matrix) {
+    float *Full = cbImpairmentMatrices[Impairment > cbUnimpaired && Impairment < cbImpairmentCount ? Impairment : cbUnimpaired];
+    float *None = cbImpairmentMatrices[cbUnimpaired];
+    Severity = Severity < 0.f ? 0.f : Severity > 1.f ? 1.f : Severity;
+    for(int i = 0; i < 9; ++i) { Matrix[i] = (1.f - Severity) * None[i] + Severity * Full[i]; } /* exact at both ends */
 }
-#endif
+
+void cbAnomalyMatrix(cb_anomaly Anomaly, float Severity, float *Matrix) {
+    float *A = cbImpairmentMatrices[cbUnimpaired], *B = A, t = 0.f;
+    if(Anomaly >= 0 && Anomaly < cbAnomalyCount && Severity > 0.f) { /* false for NaN */
+        float Step = Severity >= 1.f ? cbANOMALY_STEPS : Severity * cbANOMALY_STEPS;
+        int Lower = (int)Step < cbANOMALY_STEPS ? (int)Step : cbANOMALY_STEPS - 1;
+        A = cbAnomalyMatrices[Anomaly][Lower], B = cbAnomalyMatrices[Anomaly][Lower + 1], t = Step - Lower;
+    }
+    for(int i = 0; i < 9; ++i) { Matrix[i] = (1.f - t) * A[i] + t * B[i]; } /* exact at each step */
+}
+
+#ifndef cbANOMALY_CACHE_STEPS
+#define cbANOMALY_CACHE_STEPS 100
+#endif/*cbANOMALY_CACHE_STEPS*/
+static float cbAnomalyCache[cbAnomalyCount][cbANOMALY_CACHE_STEPS + 1][9];
+static volatile long cbAnomalyCacheState;
+
+void cbInitAnomalyMatrices(void) {
+    if(! cbOnceBegin(&cbAnomalyCacheState)) { return; }
+    for(int Anomaly = 0; Anomaly < cbAnomalyCount; ++Anomaly)
+    for(int i = 0; i <= cbANOMALY_CACHE_STEPS; ++i)
+    { cbAnomalyMatrix((cb_anomaly)Anomaly, (float)i / cbANOMALY_CACHE_STEPS, cbAnomalyCache[Anomaly][i]); }
+    cbOnceEnd(&cbAnomalyCacheState);
+}
+
+/* The cached matrix nearest Severity, or 0 for none */
+static float *cbAnomalyCached(cb_anomaly Anomaly, float Severity) {
+    if(Anomaly < 0 || Anomaly >= cbAnomalyCount || ! (Severity > 0.f)) { return 0; }
+    cbInitAnomalyMatrices();
+    int Step = Severity >= 1.f ? cbANOMALY_CACHE_STEPS : (int)(Severity * cbANOMALY_CACHE_STEPS + 0.5f);
+    return Step ? cbAnomalyCache[Anomaly][Step] : 0;
+}
+
+void cbMatrix(float *M, float *Red, float *Green, float *Blue) {
+    float R = *Red, G = *Green, B = *Blue;
+    *Red   = M[0]*R + M[1]*G + M[2]*B;
+    *Green = M[3]*R + M[4]*G + M[5]*B;
+    *Blue  = M[6]*R + M[7]*G + M[8]*B;
+}
+cb_rgb cbMatrixRGB(float *Matrix, cb_rgb RGB) {
+    cbMatrix(Matrix, &RGB.R, &RGB.G, &RGB.B);
+    return RGB;
+}
+cb_rgb_255 cbMatrixRGB255(float *Matrix, cb_rgb_255 RGB) {
+    cb_rgb RGBNorm = cbNorm(RGB);
+    cbMatrix(Matrix, &RGBNorm.R, &RGBNorm.G, &RGBNorm.B);
+    return cbDenorm(RGBNorm);
+}
+cb_rgb_255 cbMatrixRGB255Gamma(float *Matrix, cb_rgb_255 RGB) {
+    cb_rgb RGBNorm = { cbRemoveGamma255Component(RGB.R),
+                       cbRemoveGamma255Component(RGB.G),
+                       cbRemoveGamma255Component(RGB.B) };
+    cbMatrix(Matrix, &RGBNorm.R, &RGBNorm.G, &RGBNorm.B);
+    cb_rgb_255 Result = { cbApplyGammaDenormComponent(RGBNorm.R),
+                          cbApplyGammaDenormComponent(RGBNorm.G),
+                          cbApplyGammaDenormComponent(RGBNorm.B) };
+    return Result;
+}
+
+/******************************************************************************
+ * Images
+ ********/
+#include <stddef.h> /* ptrdiff_t */
+#include <string.h> /* memcpy, memcmp, memset */
+
+enum { cbComponent8, cbComponent16, cbComponentHalf };
+/* Byte offsets of R, G and B within a pixel, followed by the pixel size in bytes and the component type */
+static const int cbFormatLayouts[cbFormatCount][5] = {
+    /* cbRGB8    */ { 0, 1, 2,  3, cbComponent8 },
+    /* cbBGR8    */ { 2, 1, 0,  3, cbComponent8 },
+    /* cbRGBA8   */ { 0, 1, 2,  4, cbComponent8 },
+    /* cbBGRA8   */ { 2, 1, 0,  4, cbComponent8 },
+    /* cbRGB16   */ { 0, 2, 4,  6, cbComponent16 },
+    /* cbRGBA16  */ { 0, 2, 4,  8, cbComponent16 },
+    /* cbRGB16F  */ { 0, 2, 4,  6, cbComponentHalf },
+    /* cbRGBA16F */ { 0, 2, 4,  8, cbComponentHalf },
+};
+#define cbNorm16Component(X) ((float)(X) / 65535.f)
+#define cbClampDenorm16Component(X) \
+    ((unsigned short)((X) > 0.f ? (X) < 1.f ? (X) * 65535.f + 0.5f : 65535.f : 0.f))
+
+/* Matrix kernels work in place on a run of pixels that have been split into separate R, G and B arrays.
+ * The SIMD versions do the same operations in the same order as the scalar one, so results are identical. */
+typedef void cb_matrix_kernel(const float *M, float *R, float *G, float *B, int Count);
+
+static void cbMatrixKernelScalar(const float *M, float *R, float *G, float *B, int Count) {
+    for(int i = 0; i < Count; ++i) {
+        float r = R[i], g = G[i], b = B[i];
+        R[i] = M[0]*r + M[1]*g + M[2]*b;
+        G[i] = M[3]*r + M[4]*g + M[5]*b;
+        B[i] = M[6]*r + M[7]*g + M[8]*b;
+    }
+}
+
+#ifndef cbNO_SIMD
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define cbSSE2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h> /* __cpuid */
+#endif/*_MSC_VER*/
+#if defined(__GNUC__) || defined(_MSC_VER)
+#define cbAVX2
+#endif/*__GNUC__ || _MSC_VER*/
+#endif/*__SSE2__*/
+#endif/*cbNO_SIMD*/
+
+#ifdef cbSSE2
+#define cbMATRIX_ROW(set1, add, mul, m0, m1, m2) \
+    add(add(mul(set1(M[m0]), r), mul(set1(M[m1]), g)), mul(set1(M[m2]), b))
+static void cbMatrixKernelSSE2(const float *M, float *R, float *G, float *B, int Count) {
+    int i = 0;
+    for(; i + 4 <= Count; i += 4) {
+        __m128 r = _mm_loadu_ps(R+i), g = _mm_loadu_ps(G+i), b = _mm_loadu_ps(B+i);
+        _mm_storeu_ps(R+i, cbMATRIX_ROW(_mm_set1_ps, _mm_add_ps, _mm_mul_ps, 0, 1, 2));
+        _mm_storeu_ps(G+i, cbMATRIX_ROW(_mm_set1_ps, _mm_add_ps, _mm_mul_ps, 3, 4, 5));
+        _mm_storeu_ps(B+i, cbMATRIX_ROW(_mm_set1_ps, _mm_add_ps, _mm_mul_ps, 6, 7, 8));
+    }
+    cbMatrixKernelScalar(M, R+i, G+i, B+i, Count-i);
+}
+#endif/*cbSSE2*/
+
+#ifdef cbAVX2
+#ifdef __GNUC__
+#define cbTARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define cbTARGET_AVX2
+#endif/*__GNUC__*/
+cbTARGET_AVX2
+static void cbMatrixKernelAVX2(const float *M, float *R, float *G, float *B, int Count) {
+    int i = 0;
+    for(; i + 8 <= Count; i += 8) {
+        __m256 r = _mm256_loadu_ps(R+i), g = _mm256_loadu_ps(G+i), b = _mm256_loadu_ps(B+i);
+        _mm256_storeu_ps(R+i, cbMATRIX_ROW(_mm256_set1_ps, _mm256_add_ps, _mm256_mul_ps, 0, 1, 2));
+        _mm256_storeu_ps(G+i, cbMATRIX_ROW(_mm256_set1_ps, _mm256_add_ps, _mm256_mul_ps, 3, 4, 5));
+        _mm256_storeu_ps(B+i, cbMATRIX_ROW(_mm256_set1_ps, _mm256_add_ps, _mm256_mul_ps, 6, 7, 8));
+    }
+    /* the compiler doesn't always do this before the tail call, and non-VEX code (e.g. libm) slows right down without it */
+    _mm256_zeroupper();
+    cbMatrixKernelSSE2(M, R+i, G+i, B+i, Count-i);
+}
+
+static int cbCpuHasAVX2(void) {
+#ifdef __GNUC__
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    int Info[4];
+    __cpuid(Info, 0);
+    if(Info[0] < 7) { return 0; }
+    __cpuid(Info, 1);
+    /* the OS has to save the YMM registers for us as well */
+    if(!(Info[2] & (1 << 27)) || !(Info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6) { return 0; }
+    __cpuidex(Info, 7, 0);
+    return (Info[1] >> 5) & 1;
+#endif/*__GNUC__*/
+}
+#endif/*cbAVX2*/
+#undef cbMATRIX_ROW
+
+/* picks the widest kernel the CPU supports; detection only happens on the first call */
+static cb_matrix_kernel *cbMatrixKernel(void) {
+    static cb_matrix_kernel *Kernel;
+    static volatile long State; /* see cbOnceBegin; pool threads can all get here first */
+    if(cbOnceBegin(&State)) {
+        cb_matrix_kernel *Best = cbMatrixKernelScalar;
+#ifdef cbSSE2
+        Best = cbMatrixKernelSSE2;
+#endif/*cbSSE2*/
+#ifdef cbAVX2
+        if(cbCpuHasAVX2()) { Best = cbMatrixKernelAVX2; }
+#endif/*cbAVX2*/
+        Kernel = Best;
+        cbOnceEnd(&State);
+    }
+    return Kernel;
+}
+
+/* IEEE half-precision conversions; float to half rounds to nearest even */
+static float cbHalfToFloat(unsigned short Half) {
+    union { unsigned int U; float F; } Result;
+    unsigned int Sign = (unsigned int)(Half & 0x8000) << 16, Exponent = (Half >> 10) & 0x1F, Mantissa = Half & 0x3FF;
+    if(Exponent == 0) { /* zero or subnormal */
+        Result.F = (float)Mantissa * (1.f / 16777216.f);
+        Result.U |= Sign;
+    }
+    else if(Exponent == 0x1F) { Result.U = Sign | 0x7F800000 | (Mantissa << 13); } /* infinity or NaN */
+    else                      { Result.U = Sign | ((Exponent + 112) << 23) | (Mantissa << 13); }
+    return Result.F;
+}
+static unsigned short cbFloatToHalf(float Float) {
+    union { float F; unsigned int U; } X;
+    X.F = Float;
+    unsigned int Sign = (X.U >> 16) & 0x8000, Abs = X.U & 0x7FFFFFFF;
+    if(Abs >= 0x7F800000) { return (unsigned short)(Sign | 0x7C00 | (Abs > 0x7F800000 ? 0x200 : 0)); } /* infinity or NaN */
+    if(Abs >= 0x477FF000) { return (unsigned short)(Sign | 0x7C00); } /* rounds up past the largest half */
+    if(Abs < 0x38800000) { /* subnormal: let the FPU round to a multiple of 2^-24 by adding 0.5 */
+        X.U = Abs;
+        X.F += 0.5f;
+        return (unsigned short)(Sign | (X.U - 0x3F000000));
+    }
+    return (unsigned short)(Sign | ((Abs + 0xFFF + ((Abs >> 13) & 1) - 0x38000000) >> 13));
+}
+
+/* 16-bit components are copied rather than cast to unsigned short *, which would break strict aliasing and
+ * need 2-byte alignment; compilers turn the memcpy into a plain load or store */
+static unsigned short cbLoad16(const unsigned char *P) { unsigned short X; memcpy(&X, P, sizeof(X)); return X; }
+static void cbStore16(unsigned char *P, unsigned short X) { memcpy(P, &X, sizeof(X)); }
+
+/* cbRemoveGammaComponent on each value, through the SIMD kernels with cbGAMMA_POLY */
+static void cbRemoveGammaArrays(float *R, float *G, float *B, int Count) {
+#ifdef cbGAMMA_POLY
+    cbRemoveGammaPlanar(cbGAMMA_POLY, R, Count);
+    cbRemoveGammaPlanar(cbGAMMA_POLY, G, Count);
+    cbRemoveGammaPlanar(cbGAMMA_POLY, B, Count);
+#else /* cbGAMMA_POLY */
+    for(int i = 0; i < Count; ++i) {
+        R[i] = cbRemoveGammaComponent(R[i]);
+        G[i] = cbRemoveGammaComponent(G[i]);
+        B[i] = cbRemoveGammaComponent(B[i]);
+    }
+#endif/*cbGAMMA_POLY*/
+}
+
+/* Moves a run of Count pixels between the buffer and separate arrays of R, G and B values in 0-1.
+ * Gamma is the cb_transfer the pixels are encoded with, so 0 leaves them as they are and 1 is the sRGB curve.
+ * 8-bit values use the gamma or transfer tables, so call cbInitTransferTables(Gamma) first. */
+static void cbLoadPixels(unsigned char *P, int Count, cb_format Format, int Gamma, float *R, float *G, float *B) {
+    int iR = cbFormatLayouts[Format][0], iG = cbFormatLayouts[Format][1],
+        iB = cbFormatLayouts[Format][2], Size = cbFormatLayouts[Format][3];
+    switch(cbFormatLayouts[Format][4]) {
+        case cbComponent8: {
+            if(Gamma) {
+                const float *Decode = Gamma == cbTransferSRGB ? cbGammaDecodeTable : cbTransferTables[Gamma].Decode;
+                for(int i = 0; i < Count; ++i) {
+                    R[i] = Decode[P[i*Size + iR]];
+                    G[i] = Decode[P[i*Size + iG]];
+                    B[i] = Decode[P[i*Size + iB]];
+                }
+            } else {
+                for(int i = 0; i < Count; ++i) {
+                    R[i] = cbNormComponent(P[i*Size + iR]);
+                    G[i] = cbNormComponent(P[i*Size + iG]);
+                    B[i] = cbNormComponent(P[i*Size + iB]);
+                }
+            }
+        } break;
+
+        case cbComponent16: {
+            for(int i = 0; i < Count; ++i) {
+                R[i] = cbNorm16Component(cbLoad16(P + i*Size + iR));
+                G[i] = cbNorm16Component(cbLoad16(P + i*Size + iG));
+                B[i] = cbNorm16Component(cbLoad16(P + i*Size + iB));
+            }
+        } break;
+
+        case cbComponentHalf: {
+            for(int i = 0; i < Count; ++i) {
+                R[i] = cbHalfToFloat(cbLoad16(P + i*Size + iR));
+                G[i] = cbHalfToFloat(cbLoad16(P + i*Size + iG));
+                B[i] = cbHalfToFloat(cbLoad16(P + i*Size + iB));
+            }
+        } break;
+    }
+    if(Gamma > cbTransferSRGB && cbFormatLayouts[Format][4] != cbComponent8) {
+        for(int i = 0; i < Count; ++i) {
+            R[i] = cbRemoveTransfer((cb_transfer)Gamma, R[i]);
+            G[i] = cbRemoveTransfer((cb_transfer)Gamma, G[i]);
+            B[i] = cbRemoveTransfer((cb_transfer)Gamma, B[i]);
+        }
+    }
+    if(Gamma == cbTransferSRGB && cbFormatLayouts[Format][4] != cbComponent8)
+    { cbRemoveGammaArrays(R, G, B, Count); }
+}
+
+/* Halves are stored as they are; the integer formats are clamped */
+static void cbStorePixels(unsigned char *P, int Count, cb_format Format, int Gamma, float *R, float *G, float *B) {
+    int iR = cbFormatLayouts[Format][0], iG = cbFormatLayouts[Format][1],
+        iB = cbFormatLayouts[Format][2], Size = cbFormatLayouts[Format][3];
+    if(Gamma > cbTransferSRGB && cbFormatLayouts[Format][4] != cbComponent8) {
+        for(int i = 0; i < Count; ++i) {
+            R[i] = cbApplyTransfer((cb_transfer)Gamma, R[i]);
+            G[i] = cbApplyTransfer((cb_transfer)Gamma, G[i]);
+            B[i] = cbApplyTransfer((cb_transfer)Gamma, B[i]);
+        }
+    }
+    if(Gamma == cbTransferSRGB && cbFormatLayouts[Format][4] != cbComponent8) {
+#ifdef cbGAMMA_POLY
+        cbApplyGammaPlanar(cbGAMMA_POLY, R, Count);
+        cbApplyGammaPlanar(cbGAMMA_POLY, G, Count);
+        cbApplyGammaPlanar(cbGAMMA_POLY, B, Count);
+#else /* cbGAMMA_POLY */
+        for(int i = 0; i < Count; ++i) {
+            R[i] = cbApplyGammaComponent(R[i]);
+            G[i] = cbApplyGammaComponent(G[i]);
+            B[i] = cbApplyGammaComponent(B[i]);
+        }
+#endif/*cbGAMMA_POLY*/
+    }
+    switch(cbFormatLayouts[Format][4]) {
+        case cbComponent8: {
+            if(Gamma == cbTransferSRGB) {
+                for(int i = 0; i < Count; ++i) {
+                    P[i*Size + iR] = cbApplyGammaTableUnchecked(R[i]);
+                    P[i*Size + iG] = cbApplyGammaTableUnchecked(G[i]);
+                    P[i*Size + iB] = cbApplyGammaTableUnchecked(B[i]);
+                }
+            } else if(Gamma) {
+                const cb_transfer_tables *Tables = &cbTransferTables[Gamma];
+                for(int i = 0; i < Count; ++i) {
+                    P[i*Size + iR] = cbApplyTransferTableUnchecked(Tables, R[i]);
+                    P[i*Size + iG] = cbApplyTransferTableUnchecked(Tables, G[i]);
+                    P[i*Size + iB] = cbApplyTransferTableUnchecked(Tables, B[i]);
+                }
+            } else {
+                for(int i = 0; i < Count; ++i) {
+                    P[i*Size + iR] = cbClampDenormComponent(R[i]);
+                    P[i*Size + iG] = cbClampDenormComponent(G[i]);
+                    P[i*Size + iB] = cbClampDenormComponent(B[i]);
+                }
+            }
+        } break;
+
+        case cbComponent16: {
+            for(int i = 0; i < Count; ++i) {
+                cbStore16(P + i*Size + iR, cbClampDenorm16Component(R[i]));
+                cbStore16(P + i*Size + iG, cbClampDenorm16Component(G[i]));
+                cbStore16(P + i*Size + iB, cbClampDenorm16Component(B[i]));
+            }
+        } break;
+
+        case cbComponentHalf: {
+            for(int i = 0; i < Count; ++i) {
+                cbStore16(P + i*Size + iR, cbFloatToHalf(R[i]));
+                cbStore16(P + i*Size + iG, cbFloatToHalf(G[i]));
+                cbStore16(P + i*Size + iB, cbFloatToHalf(B[i]));
+            }
+        } break;
+    }
+}
+
+#define cbIMAGE_CHUNK 256
+/* Uncounted, for the paths that count their pixels under a statistic of their own */
+static void cbTransformImageRows(const float *M, int Gamma, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format) {
+    float R[cbIMAGE_CHUNK], G[cbIMAGE_CHUNK], B[cbIMAGE_CHUNK];
+    cb_matrix_kernel *Kernel = cbMatrixKernel();
+    int Size = cbFormatLayouts[Format][3];
+    cbInitTransferTables((cb_transfer)Gamma);
+
+    for(int y = 0; y < Height; ++y) {
+        unsigned char *Row = Pixels + (ptrdiff_t)y * Stride;
+        for(int x = 0; x < Width; x += cbIMAGE_CHUNK) {
+            unsigned char *P = Row + (ptrdiff_t)x * Size;
+            int Count = Width - x < cbIMAGE_CHUNK ? Width - x : cbIMAGE_CHUNK;
+            cbLoadPixels(P, Count, Format, Gamma, R, G, B);
+            Kernel(M, R, G, B, Count);
+            cbStorePixels(P, Count, Format, Gamma, R, G, B);
+        }
+    }
+}
+
+static void cbTransformImage(const float *M, int Gamma, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format) {
+    cbSTAT_BEGIN();
+    cbTransformImageRows(M, Gamma, Pixels, Width, Height, Stride, Format);
+    cbSTAT_END(cbStatImages, (long long)Width * Height);
+}
+
+void Colo_rblindImage(cb_impairment Impairment, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format) {
+    if(Impairment > cbUnimpaired && Impairment < cbImpairmentCount)
+    { cbTransformImage(cbImpairmentMatrices[Impairment], 0, Pixels, Width, Height, Stride, Format); }
+}
+void Colo_rblindImageGamma(cb_impairment Impairment, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format) {
+    if(Impairment > cbUnimpaired && Impairment < cbImpairmentCount)
+    { cbTransformImage(cbImpairmentMatrices[Impairment], 1, Pixels, Width, Height, Stride, Format); }
+}
+void cbMatrixImage(float *Matrix, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format)
+{ cbTransformImage(Matrix, 0, Pixels, Width, Height, Stride, Format); }
+void cbMatrixImageGamma(float *Matrix, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format)
+{ cbTransformImage(Matrix, 1, Pixels, Width, Height, Stride, Format); }
+
+/* As above, but from Pixels into each of Count outputs, which start Offset bytes into the Outputs.
+ * Each run is loaded once and copied (with its alpha) to every output before the matrix overwrites the colour.
+ * The matrices are either given, or looked up from Impairments if that isn't null; a null matrix (or an
+ * unimpaired one, which the single image versions skip) leaves the copy as it is. */
+static void cbTransformImages(float **Matrices, cb_impairment *Impairments, int Count, int Gamma, unsigned char *Pixels, int Width, int Height, int Stride,
+                              cb_format Format, unsigned char **Outputs, ptrdiff_t Offset, int OutputStride) {
+    cbSTAT_BEGIN();
+    float LoadedR[cbIMAGE_CHUNK], LoadedG[cbIMAGE_CHUNK], LoadedB[cbIMAGE_CHUNK];
+    float R[cbIMAGE_CHUNK], G[cbIMAGE_CHUNK], B[cbIMAGE_CHUNK];
+    cb_matrix_kernel *Kernel = cbMatrixKernel();
+    int Size = cbFormatLayouts[Format][3];
+    cbInitTransferTables((cb_transfer)Gamma);
+
+    for(int y = 0; y < Height; ++y) {
+        unsigned char *Row = Pixels + (ptrdiff_t)y * Stride;
+        ptrdiff_t OutputRow = Offset + (ptrdiff_t)y * OutputStride;
+        for(int x = 0; x < Width; x += cbIMAGE_CHUNK) {
+            unsigned char *P = Row + (ptrdiff_t)x * Size;
+            int Run = Width - x < cbIMAGE_CHUNK ? Width - x : cbIMAGE_CHUNK;
+            cbLoadPixels(P, Run, Format, Gamma, LoadedR, LoadedG, LoadedB);
+            /* an output that is the source itself is written last, after the others have copied the run */
+            for(int n = 0, InPlace = -1; n <= Count; ++n) {
+                int i = n < Count ? n : InPlace;
+                if(i < 0) { break; }
+                unsigned char *Out = Outputs[i] + OutputRow + (ptrdiff_t)x * Size;
+                if(Out == P && n < Count) { InPlace = i; continue; }
+                float *M = Matrices ? Matrices[i] : 0;
+                if(Impairments && Impairments[i] > cbUnimpaired && Impairments[i] < cbImpairmentCount)
+                { M = cbImpairmentMatrices[Impairments[i]]; }
+                if(Out != P) { memcpy(Out, P, (size_t)Run * Size); }
+                if(! M) { continue; }
+                memcpy(R, LoadedR, Run * sizeof(float));
+                memcpy(G, LoadedG, Run * sizeof(float));
+                memcpy(B, LoadedB, Run * sizeof(float));
+                Kernel(M, R, G, B, Run);
+                cbStorePixels(Out, Run, Format, Gamma, R, G, B);
+            }
+        }
+    }
+    cbSTAT_END(cbStatImages, (long long)Width * Height);
+}
+void Colo_rblindImages(cb_impairment *Impairments, int Count, unsigned char *Pixels, int Width, int Height, int Stride,
+                       cb_format Format, unsigned char **Outputs, int OutputStride)
+{ cbTransformImages(0, Impairments, Count, 0, Pixels, Width, Height, Stride, Format, Outputs, 0, OutputStride); }
+void Colo_rblindImagesGamma(cb_impairment *Impairments, int Count, unsigned char *Pixels, int Width, int Height, int Stride,
+                            cb_format Format, unsigned char **Outputs, int OutputStride)
+{ cbTransformImages(0, Impairments, Count, 1, Pixels, Width, Height, Stride, Format, Outputs, 0, OutputStride); }
+void cbMatrixImages(float **Matrices, int Count, unsigned char *Pixels, int Width, int Height, int Stride,
+                    cb_format Format, unsigned char **Outputs, int OutputStride)
+{ cbTransformImages(Matrices, 0, Count, 0, Pixels, Width, Height, Stride, Format, Outputs, 0, OutputStride); }
+void cbMatrixImagesGamma(float **Matrices, int Count, unsigned char *Pixels, int Width, int Height, int Stride,
+                         cb_format Format, unsigned char **Outputs, int OutputStride)
+{ cbTransformImages(Matrices, 0, Count, 1, Pixels, Width, Height, Stride, Format, Outputs, 0, OutputStride); }
+
+/* Deduplication gives up past this many distinct colours, or once it has seen more than one for every
+ * cbUNIQUE_PIXELS_PER_COLOUR pixels (after the first cbUNIQUE_MIN_COLOURS), simulating the rest of the image
+ * directly; with any more, the hash lookups cost more than they save */
+#ifndef cbUNIQUE_MAX_COLOURS
+#define cbUNIQUE_MAX_COLOURS 65536
+#endif/*cbUNIQUE_MAX_COLOURS*/
+#define cbUNIQUE_MIN_COLOURS 1024
+#define cbUNIQUE_PIXELS_PER_COLOUR 8
+#define cbUNIQUE_KEY(P, iR, iG, iB) (0x1000000u | (unsigned int)(P)[iR] << 16 | (unsigned int)(P)[iG] << 8 | (P)[iB])
+
+/* Open addressing with linear probing, from packed colours (with a high bit set so that 0 means empty) to
+ * their packed simulations. It starts small and doubles whenever it gets half full, so it stays in cache for
+ * the usual few thousand colours. */
+typedef struct cb_unique_table {
+    unsigned int *Keys, *Values;
+    unsigned int Mask;
+    int Shift;
+} cb_unique_table;
+
+static unsigned int cbUniqueSlot(cb_unique_table *Table, unsigned int Key) {
+    unsigned int Slot = (Key * 0x9E3779B1u) >> Table->Shift;
+    while(Table->Keys[Slot] && Table->Keys[Slot] != Key) { Slot = (Slot + 1) & Table->Mask; }
+    return Slot;
+}
+
+static int cbUniqueResize(cb_unique_table *Table, unsigned int Capacity, int Shift) {
+    cb_unique_table Old = *Table;
+    Table->Keys   = (unsigned int *)cbMALLOC(sizeof(unsigned int) * Capacity);
+    Table->Values = (unsigned int *)cbMALLOC(sizeof(unsigned int) * Capacity);
+    Table->Mask = Capacity - 1, Table->Shift = Shift;
+    int Success = Table->Keys && Table->Values;
+    if(Success) {
+        memset(Table->Keys, 0, sizeof(unsigned int) * Capacity);
+        for(unsigned int i = 0; Old.Keys && i <= Old.Mask; ++i) {
+            if(! Old.Keys[i]) { continue; }
+            unsigned int Slot = cbUniqueSlot(Table, Old.Keys[i]);
+            Table->Keys[Slot] = Old.Keys[i], Table->Values[Slot] = Old.Values[i];
+        }
+    }
+    cbFREE(Old.Keys), cbFREE(Old.Values);
+    return Success;
+}
+
+static int cbTransformImageUnique(const float *M, int Gamma, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format,
+                                  int *FellBack) {
+    cbSTAT_BEGIN();
+    int iR = cbFormatLayouts[Format][0], iG = cbFormatLayouts[Format][1],
+        iB = cbFormatLayouts[Format][2], Size = cbFormatLayouts[Format][3];
+    cb_unique_table Table;
+    memset(&Table, 0, sizeof(Table));
+    if(cbFormatLayouts[Format][4] != cbComponent8 || Width <= 0 || Height <= 0 || ! cbUniqueResize(&Table, 1024, 22)) {
+        cbFREE(Table.Keys), cbFREE(Table.Values);
+        cbTransformImageRows(M, Gamma, Pixels, Width, Height, Stride, Format);
+        if(FellBack) { *FellBack = Width > 0 && Height > 0; }
+        cbSTAT_END(cbStatUnique, (long long)Width * Height);
+        return 0;
+    }
+
+    /* one pass a chunk at a time: look each pixel up, gather the colours not seen before and simulate them with
+     * one kernel call, then write the chunk back; runs of one colour skip the lookup */
+    float R[cbIMAGE_CHUNK], G[cbIMAGE_CHUNK], B[cbIMAGE_CHUNK];
+    unsigned char Fresh[3 * cbIMAGE_CHUNK];
+    unsigned int Slots[cbIMAGE_CHUNK], FreshSlots[cbIMAGE_CHUNK];
+    cb_matrix_kernel *Kernel = cbMatrixKernel();
+    cbInitTransferTables((cb_transfer)Gamma);
+    int Count = 0;
+    size_t Seen = 0;
+    for(int y = 0; y < Height; ++y) {
+        unsigned char *Row = Pixels + (ptrdiff_t)y * Stride;
+        for(int x = 0; x < Width; x += cbIMAGE_CHUNK) {
+            unsigned char *P = Row + (ptrdiff_t)x * Size;
+            int Run = Width - x < cbIMAGE_CHUNK ? Width - x : cbIMAGE_CHUNK, Fresher = 0, i = 0;
+
+            /* room for a whole chunk of new colours up front, so that no slot moves before the chunk is written */
+            if((unsigned int)(Count + Run) <= Table.Mask / 2 || cbUniqueResize(&Table, 2 * (Table.Mask + 1), Table.Shift - 1)) {
+                unsigned int Last = 0, Slot = 0;
+                for(; i < Run; ++i) {
+                    unsigned char *Q = P + (ptrdiff_t)i * Size;
+                    unsigned int Key = cbUNIQUE_KEY(Q, iR, iG, iB);
+                    if(Key != Last) {
+                        Slot = cbUniqueSlot(&Table, Key);
+                        if(! Table.Keys[Slot]) {
+                            if(Count >= cbUNIQUE_MAX_COLOURS
+                            || (Count >= cbUNIQUE_MIN_COLOURS && (size_t)Count * cbUNIQUE_PIXELS_PER_COLOUR > Seen + x + i)) { break; }
+                            Table.Keys[Slot] = Key, ++Count;
+                            Fresh[3 * Fresher] = Q[iR], Fresh[3 * Fresher + 1] = Q[iG], Fresh[3 * Fresher + 2] = Q[iB];
+                            FreshSlots[Fresher++] = Slot;
+                        }
+                        Last = Key;
+                    }
+                    Slots[i] = Slot;
+                }
+            }
+            if(Fresher) {
+                cbLoadPixels(Fresh, Fresher, cbRGB8, Gamma, R, G, B);
+                Kernel(M, R, G, B, Fresher);
+                cbStorePixels(Fresh, Fresher, cbRGB8, Gamma, R, G, B);
+                for(int j = 0; j < Fresher; ++j) {
+                    Table.Values[FreshSlots[j]] = (unsigned int)Fresh[3 * j] << 16 | (unsigned int)Fresh[3 * j + 1] << 8 | Fresh[3 * j + 2];
+                }
+            }
+            for(int j = 0; j < i; ++j, P += Size) {
+                unsigned int Simulated = Table.Values[Slots[j]];
+                P[iR] = (unsigned char)(Simulated >> 16), P[iG] = (unsigned char)(Simulated >> 8), P[iB] = (unsigned char)Simulated;
+            }
+            if(i < Run) {
+                /* too many colours: simulate the rest of the image directly */
+                cbTransformImageRows(M, Gamma, P, Width - x - i, 1, Stride, Format);
+                cbTransformImageRows(M, Gamma, Row + Stride, Width, Height - y - 1, Stride, Format);
+                cbFREE(Table.Keys), cbFREE(Table.Values);
+                if(FellBack) { *FellBack = 1; }
+                cbSTAT_END(cbStatUnique, (long long)Width * Height);
+                return Count;
+            }
+        }
+        Seen += (size_t)Width;
+    }
+    cbFREE(Table.Keys), cbFREE(Table.Values);
+    if(FellBack) { *FellBack = 0; }
+    cbSTAT_END(cbStatUnique, (long long)Width * Height);
+    return Count;
+}
+
+int Colo_rblindImageUnique(cb_impairment Impairment, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format,
+                       int *FellBack) {
+    if(Impairment > cbUnimpaired && Impairment < cbImpairmentCount)
+    { return cbTransformImageUnique(cbImpairmentMatrices[Impairment], 0, Pixels, Width, Height, Stride, Format, FellBack); }
+    if(FellBack) { *FellBack = 0; }
+    return 0;
+}
+int Colo_rblindImageGammaUnique(cb_impairment Impairment, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format,
+                            int *FellBack) {
+    if(Impairment > cbUnimpaired && Impairment < cbImpairmentCount)
+    { return cbTransformImageUnique(cbImpairmentMatrices[Impairment], 1, Pixels, Width, Height, Stride, Format, FellBack); }
+    if(FellBack) { *FellBack = 0; }
+    return 0;
+}
+int cbMatrixImageUnique(float *Matrix, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format, int *FellBack)
+{ return cbTransformImageUnique(Matrix, 0, Pixels, Width, Height, Stride, Format, FellBack); }
+int cbMatrixImageGammaUnique(float *Matrix, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format, int *FellBack)
+{ return cbTransformImageUnique(Matrix, 1, Pixels, Width, Height, Stride, Format, FellBack); }
+
+
+void Colo_rblindPlanar(cb_impairment Impairment, float *R, float *G, float *B, int Count) {
+    cbSTAT_BEGIN();
+    if(Impairment > cbUnimpaired && Impairment < cbImpairmentCount)
+    { cbMatrixKernel()(cbImpairmentMatrices[Impairment], R, G, B, Count); }
+    cbSTAT_END(cbStatImages, Count);
+}
+void cbMatrixPlanar(float *Matrix, float *R, float *G, float *B, int Count) {
+    cbSTAT_BEGIN();
+    cbMatrixKernel()(Matrix, R, G, B, Count);
+    cbSTAT_END(cbStatImages, Count);
+}
+
+/* in chunks through the same gamma removal as the image functions, rather than a call per colour */
+void cbLuminancePlanar(float *R, float *G, float *B, float *Luminance, int Count) {
+    cbSTAT_BEGIN();
+    float Rl[cbIMAGE_CHUNK], Gl[cbIMAGE_CHUNK], Bl[cbIMAGE_CHUNK];
+    for(int x = 0; x < Count; x += cbIMAGE_CHUNK) {
+        int Chunk = Count - x < cbIMAGE_CHUNK ? Count - x : cbIMAGE_CHUNK;
+        memcpy(Rl, R + x, Chunk * sizeof(float));
+        memcpy(Gl, G + x, Chunk * sizeof(float));
+        memcpy(Bl, B + x, Chunk * sizeof(float));
+        cbRemoveGammaArrays(Rl, Gl, Bl, Chunk);
+        for(int i = 0; i < Chunk; ++i) { Luminance[x + i] = cbLUMINANCE(Rl[i], Gl[i], Bl[i]); }
+    }
+    cbSTAT_END(cbStatLuminance, Count);
+}
+void cbLuminanceImage(unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format, float *Luminance) {
+    cbSTAT_BEGIN();
+    float R[cbIMAGE_CHUNK], G[cbIMAGE_CHUNK], B[cbIMAGE_CHUNK];
+    cbInitGammaTables();
+    for(int y = 0; y < Height; ++y)
+    for(int x = 0; x < Width; x += cbIMAGE_CHUNK) {
+        unsigned char *P = Pixels + (ptrdiff_t)y * Stride + (ptrdiff_t)x * cbFormatLayouts[Format][3];
+        int Count = Width - x < cbIMAGE_CHUNK ? Width - x : cbIMAGE_CHUNK;
+        float *Out = Luminance + (ptrdiff_t)y * Width + x;
+        cbLoadPixels(P, Count, Format, 1, R, G, B);
+        for(int i = 0; i < Count; ++i) { Out[i] = cbLUMINANCE(R[i], G[i], B[i]); }
+    }
+    cbSTAT_END(cbStatLuminance, (long long)Width * Height);
+}
+
+/******************************************************************************
+ * Daltonisation
+ ***************/
+void cbDaltonisationMatrix(cb_impairment Impairment, float Strength, float *Matrix) {
+    float *Full = cbDaltonisationMatrices[Impairment > cbUnimpaired && Impairment < cbImpairmentCount ? Impairment : cbUnimpaired];
+    float *None = cbDaltonisationMatrices[cbUnimpaired];
+    Strength = Strength < 0.f ? 0.f : Strength > 1.f ? 1.f : Strength;
+    for(int i = 0; i < 9; ++i) { Matrix[i] = (1.f - Strength) * None[i] + Strength * Full[i]; } /* exact at both ends */
+}
+
+cb_rgb cbDaltoniseRGB(cb_impairment Impairment, cb_rgb RGB) {
+    if(Impairment > cbUnimpaired && Impairment < cbImpairmentCount)
+    { cbMatrix(cbDaltonisationMatrices[Impairment], &RGB.R, &RGB.G, &RGB.B); }
+    return RGB;
+}
+/* through the image path, which clamps: corrected colours often leave the gamut */
+cb_rgb_255 cbDaltoniseRGB255Gamma(cb_impairment Impairment, cb_rgb_255 RGB) {
+    unsigned char Pixel[3] = { RGB.R, RGB.G, RGB.B };
+    cbDaltoniseImageGamma(Impairment, Pixel, 1, 1, 3, cbRGB8);
+    cb_rgb_255 Result = { Pixel[0], Pixel[1], Pixel[2] };
+    return Result;
+}
+void cbDaltoniseImage(cb_impairment Impairment, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format) {
+    if(Impairment > cbUnimpaired && Impairment < cbImpairmentCount)
+    { cbTransformImage(cbDaltonisationMatrices[Impairment], 0, Pixels, Width, Height, Stride, Format); }
+}
+void cbDaltoniseImageGamma(cb_impairment Impairment, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format) {
+    if(Impairment > cbUnimpaired && Impairment < cbImpairmentCount)
+    { cbTransformImage(cbDaltonisationMatrices[Impairment], 1, Pixels, Width, Height, Stride, Format); }
+}
+
+cb_rgb Colo_rblindRGBAnomaly(cb_anomaly Anomaly, float Severity, cb_rgb RGB) {
+    float *Matrix = cbAnomalyCached(Anomaly, Severity);
+    return Matrix ? cbMatrixRGB(Matrix, RGB) : RGB;
+}
+cb_rgb_255 Colo_rblindRGB255GammaAnomaly(cb_anomaly Anomaly, float Severity, cb_rgb_255 RGB) {
+    float *Matrix = cbAnomalyCached(Anomaly, Severity);
+    return Matrix ? cbMatrixRGB255Gamma(Matrix, RGB) : RGB;
+}
+void Colo_rblindImageAnomaly(cb_anomaly Anomaly, float Severity,
+                             unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format) {
+    float *Matrix = cbAnomalyCached(Anomaly, Severity);
+    if(Matrix) { cbTransformImage(Matrix, 0, Pixels, Width, Height, Stride, Format); }
+}
+void Colo_rblindImageGammaAnomaly(cb_anomaly Anomaly, float Severity,
+                                  unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format) {
+    float *Matrix = cbAnomalyCached(Anomaly, Severity);
+    if(Matrix) { cbTransformImage(Matrix, 1, Pixels, Width, Height, Stride, Format); }
+}
+
+/******************************************************************************
+ * Colour spaces
+ ***************/
+/* falls back to sRGB, and to unimpaired */
+static float *cbSpaceMatrix(cb_space Space, cb_impairment Impairment) {
+    if(Space <= cbSpaceSRGB || Space >= cbSpaceCount)                  { Space = cbSpaceSRGB; }
+    if(Impairment <= cbUnimpaired || Impairment >= cbImpairmentCount) { Impairment = cbUnimpaired; }
+    return cbSpaceMatrices[Space][Impairment];
+}
+
+void cbSpaceImpairmentMatrix(cb_space Space, cb_impairment Impairment, float Severity, float *Matrix) {
+    float *Full = cbSpaceMatrix(Space, Impairment);
+    float *None = cbSpaceMatrix(Space, cbUnimpaired);
+    Severity = Severity < 0.f ? 0.f : Severity > 1.f ? 1.f : Severity;
+    for(int i = 0; i < 9; ++i) { Matrix[i] = (1.f - Severity) * None[i] + Severity * Full[i]; } /* exact at both ends */
+}
+
+cb_rgb Colo_rblindRGBSpace(cb_impairment Impairment, cb_space Space, cb_rgb RGB) {
+    if(Impairment > cbUnimpaired && Impairment < cbImpairmentCount)
+    { cbMatrix(cbSpaceMatrix(Space, Impairment), &RGB.R, &RGB.G, &RGB.B); }
+    return RGB;
+}
+void Colo_rblindImageSpace(cb_impairment Impairment, cb_space Space, cb_transfer Transfer,
+                           unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format) {
+    if(Impairment > cbUnimpaired && Impairment < cbImpairmentCount && Transfer >= cbTransferLinear && Transfer < cbTransferCount)
+    { cbTransformImage(cbSpaceMatrix(Space, Impairment), Transfer, Pixels, Width, Height, Stride, Format); }
+}
+void cbMatrixImageTransfer(float *Matrix, cb_transfer Transfer, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format) {
+    if(Transfer >= cbTransferLinear && Transfer < cbTransferCount)
+    { cbTransformImage(Matrix, Transfer, Pixels, Width, Height, Stride, Format); }
+}
+
+/******************************************************************************
+ * Guideline batches
+ *******************/
+/* Pairs are simulated cbGUIDELINES_CHUNK at a time: the As then the Bs as one row of pixels, so that they go
+ * through the image kernels together and the luminances come out of cbLuminanceImage in one pass. */
+#define cbGUIDELINES_CHUNK (cbIMAGE_CHUNK / 2)
+
+typedef struct cb_guidelines_batch {
+    cb_rgb_255 *As, *Bs;
+    int Count;
+    cb_impairment *Impairments;
+    int ImpairmentCount, Gamma;
+    unsigned int *Masks;
+    float *Scores;
+} cb_guidelines_batch;
+
+static void cbGuidelinesChunk(void *Data, int Chunk) {
+    cb_guidelines_batch *Batch = (cb_guidelines_batch *)Data;
+    cb_rgb_255 Pixels[2 * cbGUIDELINES_CHUNK];
+    float Luminance[2 * cbGUIDELINES_CHUNK];
+    int First = Chunk * cbGUIDELINES_CHUNK;
+    int Count = Batch->Count - First < cbGUIDELINES_CHUNK ? Batch->Count - First : cbGUIDELINES_CHUNK;
+    for(int j = 0; j < Batch->ImpairmentCount; ++j) {
+        cb_impairment Impairment = Batch->Impairments[j];
+        for(int i = 0; i < Count; ++i) { Pixels[i] = Batch->As[First + i], Pixels[Count + i] = Batch->Bs[First + i]; }
+        if(Batch->Gamma) { Colo_rblindImageGamma(Impairment, &Pixels->R, 2*Count, 1, 3*2*Count, cbRGB8); }
+        else             { Colo_rblindImage(     Impairment, &Pixels->R, 2*Count, 1, 3*2*Count, cbRGB8); }
+        cbLuminanceImage(&Pixels->R, 2*Count, 1, 3*2*Count, cbRGB8, Luminance);
+        size_t Row = (size_t)j * Batch->Count + First;
+        for(int i = 0; i < Count; ++i) {
+            float *Scores = Batch->Scores ? Batch->Scores + (Row + i) * cgGuidelineCount : 0;
+            Batch->Masks[Row + i] = cbGuidelinesLuminance(Luminance[i], Luminance[Count + i], Scores);
+        }
+    }
+}
+
+void cbGuidelinesBatch(cb_rgb_255 *As, cb_rgb_255 *Bs, int Count, cb_impairment *Impairments, int ImpairmentCount, int Gamma,
+                       unsigned int *Masks, float *Scores) {
+    cb_guidelines_batch Batch = { As, Bs, Count, Impairments, ImpairmentCount, Gamma, Masks, Scores };
+    if(Count <= 0 || ImpairmentCount <= 0) { return; }
+    for(int Chunk = 0; Chunk * cbGUIDELINES_CHUNK < Count; ++Chunk) { cbGuidelinesChunk(&Batch, Chunk); }
+}
+
+/******************************************************************************
+ * Frame sequences
+ *****************/
+#ifndef cbSEQUENCE_TILE
+#define cbSEQUENCE_TILE 64
+#endif/*cbSEQUENCE_TILE*/
+
+cb_sequence *cbSequenceCreate(cb_impairment *Impairments, int Count, int Gamma, int Width, int Height, cb_format Format, int TileSize) {
+    if(Count <= 0 || Width <= 0 || Height <= 0 || Format < cbRGB8 || Format >= cbFormatCount || TileSize < 0) { return 0; }
+    if(! TileSize) { TileSize = cbSEQUENCE_TILE; }
+    cb_sequence *Sequence = (cb_sequence *)cbMALLOC(sizeof(cb_sequence));
+    if(! Sequence) { return 0; }
+    memset(Sequence, 0, sizeof(cb_sequence));
+    Sequence->Width = Width, Sequence->Height = Height, Sequence->Gamma = Gamma, Sequence->Format = Format;
+    Sequence->Count        = Count;
+    Sequence->OutputStride = Width * cbFormatLayouts[Format][3];
+    Sequence->TileSize     = TileSize;
+    Sequence->TilesAcross  = (Width  + TileSize - 1) / TileSize;
+    Sequence->TilesDown    = (Height + TileSize - 1) / TileSize;
+    size_t Bytes = (size_t)Sequence->OutputStride * Height;
+    Sequence->Impairments = (cb_impairment *)cbMALLOC(sizeof(cb_impairment) * Count);
+    Sequence->Outputs     = (unsigned char **)cbMALLOC(sizeof(unsigned char *) * Count);
+    Sequence->Previous    = (unsigned char *)cbMALLOC(Bytes);
+    Sequence->Dirty       = (unsigned char *)cbMALLOC((size_t)Sequence->TilesAcross * Sequence->TilesDown);
+    if(Sequence->Outputs) { memset(Sequence->Outputs, 0, sizeof(unsigned char *) * Count); }
+    for(int i = 0; Sequence->Outputs && i < Count; ++i) {
+        if(! (Sequence->Outputs[i] = (unsigned char *)cbMALLOC(Bytes))) { break; }
+    }
+    if(! Sequence->Impairments || ! Sequence->Outputs || ! Sequence->Outputs[Count-1] || ! Sequence->Previous || ! Sequence->Dirty) {
+        cbSequenceDestroy(Sequence);
+        return 0;
+    }
+    for(int i = 0; i < Count; ++i) { Sequence->Impairments[i] = Impairments[i]; }
+    cbInitTransferTables((cb_transfer)Gamma); /* so that the first frame doesn't wait for them */
+    return Sequence;
+}
+
+void cbSequenceDestroy(cb_sequence *Sequence) {
+    if(! Sequence) { return; }
+    for(int i = 0; Sequence->Outputs && i < Sequence->Count; ++i) { cbFREE(Sequence->Outputs[i]); }
+    cbFREE(Sequence->Outputs);
+    cbFREE(Sequence->Impairments);
+    cbFREE(Sequence->Previous);
+    cbFREE(Sequence->Dirty);
+    cbFREE(Sequence);
+}
+
+typedef struct cb_sequence_frame {
+    cb_sequence *Sequence;
+    unsigned char *Pixels;
+    int Stride;
+} cb_sequence_frame;
+
+/* Compares the tile's rows with the last frame's, stopping at the first that differs; from there on the rows are
+ * copied in (the ones before it matched), and the whole tile is simulated into every output. */
+static void cbSequenceTile(void *Data, int Index) {
+    cb_sequence_frame *Frame = (cb_sequence_frame *)Data;
+    cb_sequence *Sequence = Frame->Sequence;
+    int Size = cbFormatLayouts[Sequence->Format][3];
+    int x = (Index % Sequence->TilesAcross) * Sequence->TileSize;
+    int y = (Index / Sequence->TilesAcross) * Sequence->TileSize;
+    int Width  = Sequence->Width  - x < Sequence->TileSize ? Sequence->Width  - x : Sequence->TileSize;
+    int Height = Sequence->Height - y < Sequence->TileSize ? Sequence->Height - y : Sequence->TileSize;
+    size_t RowBytes = (size_t)Width * Size;
+    ptrdiff_t Offset = (ptrdiff_t)y * Sequence->OutputStride + (ptrdiff_t)x * Size;
+    unsigned char *Pixels = Frame->Pixels + (ptrdiff_t)y * Frame->Stride + (ptrdiff_t)x * Size;
+    unsigned char *Previous = Sequence->Previous + Offset;
+    int Row = 0;
+    if(Sequence->Frames) {
+        while(Row < Height && ! memcmp(Pixels + (ptrdiff_t)Row * Frame->Stride, Previous + (ptrdiff_t)Row * Sequence->OutputStride, RowBytes)) { ++Row; }
+        if(Row == Height) { Sequence->Dirty[Index] = 0; return; }
+    }
+    for(; Row < Height; ++Row) { memcpy(Previous + (ptrdiff_t)Row * Sequence->OutputStride, Pixels + (ptrdiff_t)Row * Frame->Stride, RowBytes); }
+    cbTransformImages(0, Sequence->Impairments, Sequence->Count, Sequence->Gamma, Previous, Width, Height, Sequence->OutputStride,
+                      Sequence->Format, Sequence->Outputs, Offset, Sequence->OutputStride);
+    Sequence->Dirty[Index] = 1;
+}
+
+static int cbSequenceFinish(cb_sequence *Sequence) {
+    int Tiles = Sequence->TilesAcross * Sequence->TilesDown, Dirty = 0;
+    for(int i = 0; i < Tiles; ++i) { Dirty += Sequence->Dirty[i]; }
+    Sequence->DirtyTiles = Dirty, Sequence->TotalDirtyTiles += Dirty, ++Sequence->Frames;
+    return Dirty;
+}
+
+int cbSequenceFrame(cb_sequence *Sequence, unsigned char *Pixels, int Stride) {
+    cb_sequence_frame Frame = { Sequence, Pixels, Stride };
+    int Tiles = Sequence->TilesAcross * Sequence->TilesDown;
+    for(int i = 0; i < Tiles; ++i) { cbSequenceTile(&Frame, i); }
+    return cbSequenceFinish(Sequence);
+}
+
+/******************************************************************************
+ * Polynomial gamma
+ ******************/
+/* Both curves are powers, so they are computed as exp2(Power * log2(Base)).
+ * log2 splits off the exponent so that the mantissa m is in [sqrt(0.5), sqrt(2)), and approximates
+ * log2(m) as u*P(u) with u = m-1; exp2 splits off the nearest integer and approximates 2^f on [-0.5, 0.5].
+ * The coefficients are minimax fits (absolute error for log2, relative for exp2), and 2^0 is kept at exactly 1.
+ * Like the matrix kernels, the SIMD versions do the same operations in the same order as the scalar one. */
+typedef struct cb_gamma_poly {
+    int LogDegree, ExpDegree;
+    float Log[7], Exp[6];
+} cb_gamma_poly;
+static const cb_gamma_poly cbGammaPolys[cbGammaTierCount] = {
+    /* cbGammaTier8Bit */ { 3, 2,
+        { 1.441760648e+00f, -7.249041520e-01f, 5.175094008e-01f, -3.296298140e-01f },
+        { 1.f, 7.029417940e-01f, 2.398640290e-01f } },
+    /* cbGammaTier1e4 */  { 5, 3,
+        { 1.442713481e+00f, -7.211318588e-01f, 4.793480168e-01f, -3.674899679e-01f, 3.221548210e-01f,
+         -2.065918143e-01f },
+        { 1.f, 6.932829271e-01f, 2.422109593e-01f, 5.500893112e-02f } },
+    /* cbGammaTier1e6 */  { 6, 5,
+        { 1.442699726e+00f, -7.213758714e-01f, 4.804650337e-01f, -3.589618507e-01f, 2.972625867e-01f,
+         -2.726979262e-01f, 1.706345036e-01f },
+        { 1.f, 6.931469776e-01f, 2.402224209e-01f, 5.550733743e-02f, 9.671512640e-03f, 1.326472722e-03f } },
+};
+#define cbGAMMA_SQRT_HALF_BITS 0x3F3504F3 /* sqrt(0.5) */
+#define cbGAMMA_ROUND          12582912.f /* 1.5 * 2^23, adding and subtracting it rounds to an integer */
+#define cbGAMMA_EXP_MAX        127.f      /* keeps the result finite for huge inputs */
+
+/* only valid for positive, finite X */
+static float cbLog2Poly(const cb_gamma_poly *Poly, float X) {
+    union { float F; unsigned int U; } Bits;
+    Bits.F = X;
+    int Exponent = (int)(Bits.U - cbGAMMA_SQRT_HALF_BITS) >> 23;
+    Bits.U -= (unsigned int)Exponent << 23;
+    float U = Bits.F - 1.f, P = Poly->Log[Poly->LogDegree];
+    for(int i = Poly->LogDegree - 1; i >= 0; --i) { P = P*U + Poly->Log[i]; }
+    return (float)Exponent + U*P;
+}
+static float cbExp2Poly(const cb_gamma_poly *Poly, float Y) {
+    Y = Y < cbGAMMA_EXP_MAX ? Y : cbGAMMA_EXP_MAX;
+    float N = (Y + cbGAMMA_ROUND) - cbGAMMA_ROUND, F = Y - N;
+    union { float F; unsigned int U; } Bits;
+    Bits.F = Poly->Exp[Poly->ExpDegree];
+    for(int i = Poly->ExpDegree - 1; i >= 0; --i) { Bits.F = Bits.F*F + Poly->Exp[i]; }
+    Bits.U += (unsigned int)(int)N << 23;
+    return Bits.F;
+}
+
+/* the thresholds and the linear segments are the same as cbRemoveGammaComponent/cbApplyGammaComponent;
+ * applying is written as E + 0.055*(E-1) rather than 1.055*E - 0.055 so that 1 comes back as exactly 1 */
+#define cbREMOVE_THRESHOLD 0.04045f
+#define cbAPPLY_THRESHOLD  0.0031308049535603716f
+float cbRemoveGammaPoly(cb_gamma_tier Tier, float X) {
+    const cb_gamma_poly *Poly = &cbGammaPolys[Tier];
+    if(! (X > cbREMOVE_THRESHOLD)) { return X * (1.f / 12.92f); }
+    return cbExp2Poly(Poly, 2.4f * cbLog2Poly(Poly, X * (1.f / 1.055f) + 0.055f / 1.055f));
+}
+float cbApplyGammaPoly(cb_gamma_tier Tier, float X) {
+    const cb_gamma_poly *Poly = &cbGammaPolys[Tier];
+    if(! (X > cbAPPLY_THRESHOLD)) { return X * 12.92f; }
+    float E = cbExp2Poly(Poly, cbLog2Poly(Poly, X) * (1.f / 2.4f));
+    return E + 0.055f * (E - 1.f);
+}
+
+typedef void cb_gamma_kernel(cb_gamma_tier Tier, int Apply, float *X, int Count);
+
+static void cbGammaKernelScalar(cb_gamma_tier Tier, int Apply, float *X, int Count) {
+    if(Apply) { for(int i = 0; i < Count; ++i) { X[i] = cbApplyGammaPoly(Tier, X[i]); } }
+    else      { for(int i = 0; i < Count; ++i) { X[i] = cbRemoveGammaPoly(Tier, X[i]); } }
+}
+
+/* Every lane works out both segments and picks one; the lanes that end up linear can take the log of
+ * anything (even negative values), and those results are thrown away. */
+#ifdef cbSSE2
+static __m128 cbLog2SSE2(const cb_gamma_poly *Poly, __m128 X) {
+    __m128i Bits = _mm_castps_si128(X);
+    __m128i Exponent = _mm_srai_epi32(_mm_sub_epi32(Bits, _mm_set1_epi32(cbGAMMA_SQRT_HALF_BITS)), 23);
+    __m128 U = _mm_sub_ps(_mm_castsi128_ps(_mm_sub_epi32(Bits, _mm_slli_epi32(Exponent, 23))), _mm_set1_ps(1.f));
+    __m128 P = _mm_set1_ps(Poly->Log[Poly->LogDegree]);
+    for(int i = Poly->LogDegree - 1; i >= 0; --i) { P = _mm_add_ps(_mm_mul_ps(P, U), _mm_set1_ps(Poly->Log[i])); }
+    return _mm_add_ps(_mm_cvtepi32_ps(Exponent), _mm_mul_ps(U, P));
+}
+static __m128 cbExp2SSE2(const cb_gamma_poly *Poly, __m128 Y) {
+    Y = _mm_min_ps(Y, _mm_set1_ps(cbGAMMA_EXP_MAX));
+    __m128 N = _mm_sub_ps(_mm_add_ps(Y, _mm_set1_ps(cbGAMMA_ROUND)), _mm_set1_ps(cbGAMMA_ROUND));
+    __m128 F = _mm_sub_ps(Y, N), Q = _mm_set1_ps(Poly->Exp[Poly->ExpDegree]);
+    for(int i = Poly->ExpDegree - 1; i >= 0; --i) { Q = _mm_add_ps(_mm_mul_ps(Q, F), _mm_set1_ps(Poly->Exp[i])); }
+    return _mm_castsi128_ps(_mm_add_epi32(_mm_castps_si128(Q), _mm_slli_epi32(_mm_cvttps_epi32(N), 23)));
+}
+#define cbSELECT_SSE2(Mask, A, B) _mm_or_ps(_mm_and_ps(Mask, A), _mm_andnot_ps(Mask, B))
+static void cbGammaKernelSSE2(cb_gamma_tier Tier, int Apply, float *X, int Count) {
+    const cb_gamma_poly *Poly = &cbGammaPolys[Tier];
+    int i = 0;
+    if(Apply) {
+        for(; i + 4 <= Count; i += 4) {
+            __m128 x = _mm_loadu_ps(X+i);
+            __m128 E = cbExp2SSE2(Poly, _mm_mul_ps(cbLog2SSE2(Poly, x), _mm_set1_ps(1.f / 2.4f)));
+            E = _mm_add_ps(E, _mm_mul_ps(_mm_set1_ps(0.055f), _mm_sub_ps(E, _mm_set1_ps(1.f))));
+            __m128 Linear = _mm_mul_ps(x, _mm_set1_ps(12.92f));
+            _mm_storeu_ps(X+i, cbSELECT_SSE2(_mm_cmpgt_ps(x, _mm_set1_ps(cbAPPLY_THRESHOLD)), E, Linear));
+        }
+    } else {
+        for(; i + 4 <= Count; i += 4) {
+            __m128 x = _mm_loadu_ps(X+i);
+            __m128 Base = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.f / 1.055f)), _mm_set1_ps(0.055f / 1.055f));
+            __m128 E = cbExp2SSE2(Poly, _mm_mul_ps(_mm_set1_ps(2.4f), cbLog2SSE2(Poly, Base)));
+            __m128 Linear = _mm_mul_ps(x, _mm_set1_ps(1.f / 12.92f));
+            _mm_storeu_ps(X+i, cbSELECT_SSE2(_mm_cmpgt_ps(x, _mm_set1_ps(cbREMOVE_THRESHOLD)), E, Linear));
+        }
+    }
+    cbGammaKernelScalar(Tier, Apply, X+i, Count-i);
+}
+#undef cbSELECT_SSE2
+#endif/*cbSSE2*/
+
+#ifdef cbAVX2
+cbTARGET_AVX2
+static __m256 cbLog2AVX2(const cb_gamma_poly *Poly, __m256 X) {
+    __m256i Bits = _mm256_castps_si256(X);
+    __m256i Exponent = _mm256_srai_epi32(_mm256_sub_epi32(Bits, _mm256_set1_epi32(cbGAMMA_SQRT_HALF_BITS)), 23);
+    __m256 U = _mm256_sub_ps(_mm256_castsi256_ps(_mm256_sub_epi32(Bits, _mm256_slli_epi32(Exponent, 23))),
+                             _mm256_set1_ps(1.f));
+    __m256 P = _mm256_set1_ps(Poly->Log[Poly->LogDegree]);
+    for(int i = Poly->LogDegree - 1; i >= 0; --i)
+    { P = _mm256_add_ps(_mm256_mul_ps(P, U), _mm256_set1_ps(Poly->Log[i])); }
+    return _mm256_add_ps(_mm256_cvtepi32_ps(Exponent), _mm256_mul_ps(U, P));
+}
+cbTARGET_AVX2
+static __m256 cbExp2AVX2(const cb_gamma_poly *Poly, __m256 Y) {
+    Y = _mm256_min_ps(Y, _mm256_set1_ps(cbGAMMA_EXP_MAX));
+    __m256 N = _mm256_sub_ps(_mm256_add_ps(Y, _mm256_set1_ps(cbGAMMA_ROUND)), _mm256_set1_ps(cbGAMMA_ROUND));
+    __m256 F = _mm256_sub_ps(Y, N), Q = _mm256_set1_ps(Poly->Exp[Poly->ExpDegree]);
+    for(int i = Poly->ExpDegree - 1; i >= 0; --i)
+    { Q = _mm256_add_ps(_mm256_mul_ps(Q, F), _mm256_set1_ps(Poly->Exp[i])); }
+    return _mm256_castsi256_ps(_mm256_add_epi32(_mm256_castps_si256(Q), _mm256_slli_epi32(_mm256_cvttps_epi32(N), 23)));
+}
+cbTARGET_AVX2
+static void cbGammaKernelAVX2(cb_gamma_tier Tier, int Apply, float *X, int Count) {
+    const cb_gamma_poly *Poly = &cbGammaPolys[Tier];
+    int i = 0;
+    if(Apply) {
+        for(; i + 8 <= Count; i += 8) {
+            __m256 x = _mm256_loadu_ps(X+i);
+            __m256 E = cbExp2AVX2(Poly, _mm256_mul_ps(cbLog2AVX2(Poly, x), _mm256_set1_ps(1.f / 2.4f)));
+            E = _mm256_add_ps(E, _mm256_mul_ps(_mm256_set1_ps(0.055f), _mm256_sub_ps(E, _mm256_set1_ps(1.f))));
+            __m256 Linear = _mm256_mul_ps(x, _mm256_set1_ps(12.92f));
+            _mm256_storeu_ps(X+i, _mm256_blendv_ps(Linear, E, _mm256_cmp_ps(x, _mm256_set1_ps(cbAPPLY_THRESHOLD), _CMP_GT_OQ)));
+        }
+    } else {
+        for(; i + 8 <= Count; i += 8) {
+            __m256 x = _mm256_loadu_ps(X+i);
+            __m256 Base = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.f / 1.055f)), _mm256_set1_ps(0.055f / 1.055f));
+            __m256 E = cbExp2AVX2(Poly, _mm256_mul_ps(_mm256_set1_ps(2.4f), cbLog2AVX2(Poly, Base)));
+            __m256 Linear = _mm256_mul_ps(x, _mm256_set1_ps(1.f / 12.92f));
+            _mm256_storeu_ps(X+i, _mm256_blendv_ps(Linear, E, _mm256_cmp_ps(x, _mm256_set1_ps(cbREMOVE_THRESHOLD), _CMP_GT_OQ)));
+        }
+    }
+    /* as in cbMatrixKernelAVX2 */
+    _mm256_zeroupper();
+    cbGammaKernelSSE2(Tier, Apply, X+i, Count-i);
+}
+#endif/*cbAVX2*/
+#undef cbREMOVE_THRESHOLD
+#undef cbAPPLY_THRESHOLD
+
+static cb_gamma_kernel *cbGammaKernel(void) {
+    static cb_gamma_kernel *Kernel;
+    static volatile long State; /* see cbMatrixKernel */
+    if(cbOnceBegin(&State)) {
+        cb_gamma_kernel *Best = cbGammaKernelScalar;
+#ifdef cbSSE2
+        Best = cbGammaKernelSSE2;
+#endif/*cbSSE2*/
+#ifdef cbAVX2
+        if(cbCpuHasAVX2()) { Best = cbGammaKernelAVX2; }
+#endif/*cbAVX2*/
+        Kernel = Best;
+        cbOnceEnd(&State);
+    }
+    return Kernel;
+}
+
+void cbRemoveGammaPlanar(cb_gamma_tier Tier, float *X, int Count)
+{ cbGammaKernel()(Tier, 0, X, Count); }
+void cbApplyGammaPlanar(cb_gamma_tier Tier, float *X, int Count)
+{ cbGammaKernel()(Tier, 1, X, Count); }
+
+/******************************************************************************
+ * Fixed point
+ *************/
+/* Q14 matrices, applied to 0-255 values or Q14 linear ones; products are summed in 32 bits and rounded */
+#define cbFIXED_BITS 14
+#define cbFIXED_ONE  (1 << cbFIXED_BITS)
+#define cbFIXED_HALF (1 << (cbFIXED_BITS - 1))
+#define cbFIXED_ROW(M, r, g, b, Max) cbFixedClamp((M[0]*(r) + M[1]*(g) + M[2]*(b) + cbFIXED_HALF) >> cbFIXED_BITS, Max)
+
+static short         cbFixedDecodeTable[256];           /* sRGB 0-255 to linear Q14 */
+static unsigned char cbFixedEncodeTable[cbFIXED_ONE + 1]; /* linear Q14 to sRGB 0-255 */
+static short         cbImpairmentFixed[cbImpairmentCount][9];
+static volatile long cbFixedTablesState;
+
+#define cbFIXED_ROUND(X) ((int)((X) * cbFIXED_ONE + ((X) < 0.f ? -0.5f : 0.5f)))
+#define cbFIXED_ABS(X)   ((X) < 0.f ? -(X) : (X))
+void cbFixedMatrix(float *Matrix, short *Fixed) {
+    for(int Row = 0; Row < 9; Row += 3) {
+        /* round each coefficient, then put the rounding of the row's sum on its largest one */
+        float Sum = 0.f;
+        int FixedSum = 0, Largest = Row;
+        for(int i = Row; i < Row + 3; ++i) {
+            float X = Matrix[i] < -2.f ? -2.f : Matrix[i] > 32767.f / cbFIXED_ONE ? 32767.f / cbFIXED_ONE : Matrix[i];
+            Fixed[i] = (short)cbFIXED_ROUND(X);
+            Sum += X, FixedSum += Fixed[i];
+            if(cbFIXED_ABS(X) > cbFIXED_ABS(Matrix[Largest])) { Largest = i; }
+        }
+        int Adjusted = Fixed[Largest] + cbFIXED_ROUND(Sum) - FixedSum;
+        if(Adjusted >= -32768 && Adjusted <= 32767) { Fixed[Largest] = (short)Adjusted; }
+    }
+}
+#undef cbFIXED_ABS
+#undef cbFIXED_ROUND
+
+void cbInitFixedTables(void) {
+    if(! cbOnceBegin(&cbFixedTablesState)) { return; }
+    cbInitGammaTables();
+    for(int i = 0; i < 256; ++i)
+    { cbFixedDecodeTable[i] = (short)(cbGammaDecodeTable[i] * cbFIXED_ONE + 0.5f); }
+    for(int i = 0; i <= cbFIXED_ONE; ++i)
+    { cbFixedEncodeTable[i] = cbApplyGammaTableUnchecked((float)i / cbFIXED_ONE); }
+    for(int i = 0; i < cbImpairmentCount; ++i)
+    { cbFixedMatrix(cbImpairmentMatrices[i], cbImpairmentFixed[i]); }
+    cbOnceEnd(&cbFixedTablesState);
+}
+
+static int cbFixedClamp(int X, int Max) { return X < 0 ? 0 : X > Max ? Max : X; }
+
+/* Like the float matrix kernels, these work in place on separate runs of R, G and B values,
+ * and the SSE2 version gives identical results to the scalar one. Results are clamped to 0-Max. */
+typedef void cb_fixed_kernel(const short *M, short *R, short *G, short *B, int Count, int Max);
+
+static void cbFixedKernelScalar(const short *M, short *R, short *G, short *B, int Count, int Max) {
+    for(int i = 0; i < Count; ++i) {
+        int r = R[i], g = G[i], b = B[i];
+        R[i] = (short)cbFIXED_ROW((M+0), r, g, b, Max);
+        G[i] = (short)cbFIXED_ROW((M+3), r, g, b, Max);
+        B[i] = (short)cbFIXED_ROW((M+6), r, g, b, Max);
+    }
+}
+
+#ifdef cbSSE2
+/* pmaddwd multiplies interleaved pairs of 16-bit values and adds each pair in 32 bits, so interleaving R with G
+ * and B with 1 gives a row of the matrix (plus rounding) from two of them, for four pixels at a time */
+#define cbFIXED_PAIR(a, b) _mm_set1_epi32((int)((unsigned int)(unsigned short)(a) | (unsigned int)(unsigned short)(b) << 16))
+#define cbFIXED_ROW_SSE2(Row) \
+    _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32( \
+        _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(RGLo, RG[Row]), _mm_madd_epi16(BLo, BH[Row])), cbFIXED_BITS), \
+        _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(RGHi, RG[Row]), _mm_madd_epi16(BHi, BH[Row])), cbFIXED_BITS)), \
+        Zero), Top)
+static void cbFixedKernelSSE2(const short *M, short *R, short *G, short *B, int Count, int Max) {
+    __m128i Zero = _mm_setzero_si128(), One = _mm_set1_epi16(1), Top = _mm_set1_epi16((short)Max);
+    __m128i RG[3], BH[3];
+    for(int Row = 0; Row < 3; ++Row)
+    { RG[Row] = cbFIXED_PAIR(M[3*Row], M[3*Row + 1]), BH[Row] = cbFIXED_PAIR(M[3*Row + 2], cbFIXED_HALF); }
+    int i = 0;
+    for(; i + 8 <= Count; i += 8) {
+        __m128i r = _mm_loadu_si128((__m128i *)(R+i)), g = _mm_loadu_si128((__m128i *)(G+i)), b = _mm_loadu_si128((__m128i *)(B+i));
+        __m128i RGLo = _mm_unpacklo_epi16(r, g), RGHi = _mm_unpackhi_epi16(r, g);
+        __m128i BLo  = _mm_unpacklo_epi16(b, One), BHi = _mm_unpackhi_epi16(b, One);
+        _mm_storeu_si128((__m128i *)(R+i), cbFIXED_ROW_SSE2(0));
+        _mm_storeu_si128((__m128i *)(G+i), cbFIXED_ROW_SSE2(1));
+        _mm_storeu_si128((__m128i *)(B+i), cbFIXED_ROW_SSE2(2));
+    }
+    cbFixedKernelScalar(M, R+i, G+i, B+i, Count-i, Max);
+}
+#undef cbFIXED_ROW_SSE2
+#undef cbFIXED_PAIR
+#endif/*cbSSE2*/
+
+static cb_fixed_kernel *cbFixedKernel(void) {
+#ifdef cbSSE2
+    return cbFixedKernelSSE2;
+#else
+    return cbFixedKernelScalar;
+#endif/*cbSSE2*/
+}
+
+static void cbTransformImageFixed(const short *M, int Gamma, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format) {
+    if(cbFormatLayouts[Format][4] != cbComponent8) {
+        float Matrix[9];
+        for(int i = 0; i < 9; ++i) { Matrix[i] = (float)M[i] / cbFIXED_ONE; }
+        cbTransformImage(Matrix, Gamma, Pixels, Width, Height, Stride, Format);
+        return;
+    }
+    cbSTAT_BEGIN();
+    short R[cbIMAGE_CHUNK], G[cbIMAGE_CHUNK], B[cbIMAGE_CHUNK];
+    cb_fixed_kernel *Kernel = cbFixedKernel();
+    int iR = cbFormatLayouts[Format][0], iG = cbFormatLayouts[Format][1],
+        iB = cbFormatLayouts[Format][2], Size = cbFormatLayouts[Format][3];
+    if(Gamma) { cbInitFixedTables(); }
+
+    for(int y = 0; y < Height; ++y) {
+        unsigned char *Row = Pixels + (ptrdiff_t)y * Stride;
+        for(int x = 0; x < Width; x += cbIMAGE_CHUNK) {
+            unsigned char *P = Row + (ptrdiff_t)x * Size;
+            int Count = Width - x < cbIMAGE_CHUNK ? Width - x : cbIMAGE_CHUNK;
+            if(Gamma) {
+                for(int i = 0; i < Count; ++i) {
+                    R[i] = cbFixedDecodeTable[P[i*Size + iR]];
+                    G[i] = cbFixedDecodeTable[P[i*Size + iG]];
+                    B[i] = cbFixedDecodeTable[P[i*Size + iB]];
+                }
+                Kernel(M, R, G, B, Count, cbFIXED_ONE);
+                for(int i = 0; i < Count; ++i) {
+                    P[i*Size + iR] = cbFixedEncodeTable[R[i]];
+                    P[i*Size + iG] = cbFixedEncodeTable[G[i]];
+                    P[i*Size + iB] = cbFixedEncodeTable[B[i]];
+                }
+            } else {
+                for(int i = 0; i < Count; ++i)
+                { R[i] = P[i*Size + iR], G[i] = P[i*Size + iG], B[i] = P[i*Size + iB]; }
+                Kernel(M, R, G, B, Count, 255);
+                for(int i = 0; i < Count; ++i) {
+                    P[i*Size + iR] = (unsigned char)R[i];
+                    P[i*Size + iG] = (unsigned char)G[i];
+                    P[i*Size + iB] = (unsigned char)B[i];
+                }
+            }
+        }
+    }
+    cbSTAT_END(cbStatFixed, (long long)Width * Height);
+}
+
+cb_rgb_255 cbFixedRGB255(short *Fixed, cb_rgb_255 RGB) {
+    cbSTAT_BEGIN();
+    cb_rgb_255 Result = { (unsigned char)cbFIXED_ROW((Fixed+0), RGB.R, RGB.G, RGB.B, 255),
+                          (unsigned char)cbFIXED_ROW((Fixed+3), RGB.R, RGB.G, RGB.B, 255),
+                          (unsigned char)cbFIXED_ROW((Fixed+6), RGB.R, RGB.G, RGB.B, 255) };
+    cbSTAT_END(cbStatFixed, 1);
+    return Result;
+}
+cb_rgb_255 cbFixedRGB255Gamma(short *Fixed, cb_rgb_255 RGB) {
+    cbSTAT_BEGIN();
+    cbInitFixedTables();
+    int R = cbFixedDecodeTable[RGB.R], G = cbFixedDecodeTable[RGB.G], B = cbFixedDecodeTable[RGB.B];
+    cb_rgb_255 Result = { cbFixedEncodeTable[cbFIXED_ROW((Fixed+0), R, G, B, cbFIXED_ONE)],
+                          cbFixedEncodeTable[cbFIXED_ROW((Fixed+3), R, G, B, cbFIXED_ONE)],
+                          cbFixedEncodeTable[cbFIXED_ROW((Fixed+6), R, G, B, cbFIXED_ONE)] };
+    cbSTAT_END(cbStatFixed, 1);
+    return Result;
+}
+void cbFixedImage(short *Fixed, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format)
+{ cbTransformImageFixed(Fixed, 0, Pixels, Width, Height, Stride, Format); }
+void cbFixedImageGamma(short *Fixed, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format)
+{ cbTransformImageFixed(Fixed, 1, Pixels, Width, Height, Stride, Format); }
+
+cb_rgb_255 Colo_rblindRGB255Fixed(cb_impairment Impairment, cb_rgb_255 RGB) {
+    if(Impairment <= cbUnimpaired || Impairment >= cbImpairmentCount) { return RGB; }
+    cbInitFixedTables();
+    return cbFixedRGB255(cbImpairmentFixed[Impairment], RGB);
+}
+cb_rgb_255 Colo_rblindRGB255GammaFixed(cb_impairment Impairment, cb_rgb_255 RGB) {
+    if(Impairment <= cbUnimpaired || Impairment >= cbImpairmentCount) { return RGB; }
+    cbInitFixedTables();
+    return cbFixedRGB255Gamma(cbImpairmentFixed[Impairment], RGB);
+}
+void Colo_rblindImageFixed(cb_impairment Impairment, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format) {
+    if(Impairment > cbUnimpaired && Impairment < cbImpairmentCount)
+    {
+        cbInitFixedTables();
+        cbTransformImageFixed(cbImpairmentFixed[Impairment], 0, Pixels, Width, Height, Stride, Format);
+    }
+}
+void Colo_rblindImageGammaFixed(cb_impairment Impairment, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format) {
+    if(Impairment > cbUnimpaired && Impairment < cbImpairmentCount)
+    {
+        cbInitFixedTables();
+        cbTransformImageFixed(cbImpairmentFixed[Impairment], 1, Pixels, Width, Height, Stride, Format);
+    }
+}
+#undef cbFIXED_ROW
+
+#ifdef cbTHREADS
+/******************************************************************************
+ * Threads
+ *********/
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif/*WIN32_LEAN_AND_MEAN*/
+#include <windows.h>
+typedef CRITICAL_SECTION   cb_mutex;
+typedef CONDITION_VARIABLE cb_cond;
+typedef HANDLE             cb_thread;
+#define cbMutexInit(m)      InitializeCriticalSection(m)
+#define cbMutexDestroy(m)   DeleteCriticalSection(m)
+#define cbMutexLock(m)      EnterCriticalSection(m)
+#define cbMutexUnlock(m)    LeaveCriticalSection(m)
+#define cbCondInit(c)       InitializeConditionVariable(c)
+#define cbCondDestroy(c)
+#define cbCondWait(c, m)    SleepConditionVariableCS(c, m, INFINITE)
+#define cbCondBroadcast(c)  WakeAllConditionVariable(c)
+#define cbAtomicAdd(p, v)   InterlockedExchangeAdd((p), (v))
+#else /* _WIN32 */
+#include <pthread.h>
+#include <unistd.h> /* sysconf */
+typedef pthread_mutex_t cb_mutex;
+typedef pthread_cond_t  cb_cond;
+typedef pthread_t       cb_thread;
+#define cbMutexInit(m)      pthread_mutex_init(m, 0)
+#define cbMutexDestroy(m)   pthread_mutex_destroy(m)
+#define cbMutexLock(m)      pthread_mutex_lock(m)
+#define cbMutexUnlock(m)    pthread_mutex_unlock(m)
+#define cbCondInit(c)       pthread_cond_init(c, 0)
+#define cbCondDestroy(c)    pthread_cond_destroy(c)
+#define cbCondWait(c, m)    pthread_cond_wait(c, m)
+#define cbCondBroadcast(c)  pthread_cond_broadcast(c)
+#define cbAtomicAdd(p, v)   __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+#endif/* _WIN32 */
+
+/* each thread's share of the jobs, padded out to avoid false sharing */
+typedef struct cb_pool_range {
+    volatile long Next;
+    long End;
+    char Padding[64 - 2*sizeof(long)];
+} cb_pool_range;
+
+typedef struct cb_pool_worker {
+    cb_pool *Pool;
+    int Index;
+} cb_pool_worker;
+
+struct cb_pool {
+    int ThreadCount;
+    cb_thread      *Threads; /* ThreadCount-1 of these; the caller is worker 0 */
+    cb_pool_worker *Workers;
+    cb_pool_range  *Ranges;
+
+    cb_mutex Mutex;
+    cb_cond  Start, Done;
+    int Generation, Busy, Quit;
+
+    void (*Job)(void *Data, int Index);
+    void *Data;
+};
+
+static void cbPoolWork(cb_pool *Pool, int Worker) {
+    for(int i = 0; i < Pool->ThreadCount; ++i) {
+        /* own range first, then steal from the others in turn */
+        cb_pool_range *Range = &Pool->Ranges[(Worker + i) % Pool->ThreadCount];
+        for(long Index; (Index = cbAtomicAdd(&Range->Next, 1)) < Range->End;)
+        { Pool->Job(Pool->Data, (int)Index); }
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI cbPoolThread(void *Param)
+#else
+static void *cbPoolThread(void *Param)
+#endif
+{
+    cb_pool_worker *Worker = (cb_pool_worker *)Param;
+    cb_pool *Pool = Worker->Pool;
+    int Generation = 0;
+    for(;;) {
+        cbMutexLock(&Pool->Mutex);
+        while(Pool->Generation == Generation && ! Pool->Quit)
+        { cbCondWait(&Pool->Start, &Pool->Mutex); }
+        Generation = Pool->Generation;
+        int Quit = Pool->Quit;
+        cbMutexUnlock(&Pool->Mutex);
+        if(Quit) { break; }
+
+        cbPoolWork(Pool, Worker->Index);
+
+        cbMutexLock(&Pool->Mutex);
+        if(--Pool->Busy == 0) { cbCondBroadcast(&Pool->Done); }
+        cbMutexUnlock(&Pool->Mutex);
+    }
+#ifdef cbSTATS
+    cbStatsThreadEnd(); /* so that the next pool's threads reuse this one's block */
+#endif/*cbSTATS*/
+    return 0;
+}
+
+static int cbCpuCount(void) {
+#ifdef _WIN32
+    SYSTEM_INFO Info;
+    GetSystemInfo(&Info);
+    return (int)Info.dwNumberOfProcessors;
+#else
+    long Count = sysconf(_SC_NPROCESSORS_ONLN);
+    return Count > 0 ? (int)Count : 1;
+#endif
+}
+
+cb_pool *cbPoolCreate(int ThreadCount) {
+    if(ThreadCount <= 0) { ThreadCount = cbCpuCount(); }
+    cb_pool *Pool = (cb_pool *)cbMALLOC(sizeof(cb_pool));
+    if(! Pool) { return 0; }
+    Pool->ThreadCount = ThreadCount;
+    Pool->Threads = (cb_thread *)cbMALLOC(sizeof(cb_thread) * ThreadCount);
+    Pool->Workers = (cb_pool_worker *)cbMALLOC(sizeof(cb_pool_worker) * ThreadCount);
+    Pool->Ranges  = (cb_pool_range *)cbMALLOC(sizeof(cb_pool_range) * ThreadCount);
+    if(! Pool->Threads || ! Pool->Workers || ! Pool->Ranges) {
+        cbFREE(Pool->Threads), cbFREE(Pool->Workers), cbFREE(Pool->Ranges), cbFREE(Pool);
+        return 0;
+    }
+    Pool->Generation = Pool->Busy = Pool->Quit = 0;
+    cbMutexInit(&Pool->Mutex);
+    cbCondInit(&Pool->Start);
+    cbCondInit(&Pool->Done);
+
+    for(int i = 1; i < ThreadCount; ++i) {
+        Pool->Workers[i].Pool  = Pool;
+        Pool->Workers[i].Index = i;
+#ifdef _WIN32
+        Pool->Threads[i] = CreateThread(0, 0, cbPoolThread, &Pool->Workers[i], 0, 0);
+        int Failed = Pool->Threads[i] == 0;
+#else
+        int Failed = pthread_create(&Pool->Threads[i], 0, cbPoolThread, &Pool->Workers[i]) != 0;
+#endif
+        /* carry on with however many threads we managed to start */
+        if(Failed) { Pool->ThreadCount = i; break; }
+    }
+    return Pool;
+}
+
+void cbPoolDestroy(cb_pool *Pool) {
+    if(! Pool) { return; }
+    cbMutexLock(&Pool->Mutex);
+    Pool->Quit = 1;
+    cbCondBroadcast(&Pool->Start);
+    cbMutexUnlock(&Pool->Mutex);
+    for(int i = 1; i < Pool->ThreadCount; ++i) {
+#ifdef _WIN32
+        WaitForSingleObject(Pool->Threads[i], INFINITE);
+        CloseHandle(Pool->Threads[i]);
+#else
+        pthread_join(Pool->Threads[i], 0);
+#endif
+    }
+    cbCondDestroy(&Pool->Done);
+    cbCondDestroy(&Pool->Start);
+    cbMutexDestroy(&Pool->Mutex);
+    cbFREE(Pool->Threads), cbFREE(Pool->Workers), cbFREE(Pool->Ranges), cbFREE(Pool);
+}
+
+int cbPoolThreadCount(cb_pool *Pool)
+{ return Pool ? Pool->ThreadCount : 1; }
+
+void cbPoolFor(cb_pool *Pool, int JobCount, void (*Job)(void *Data, int Index), void *Data) {
+    if(! Pool || Pool->ThreadCount == 1 || JobCount <= 1) {
+        for(int i = 0; i < JobCount; ++i) { Job(Data, i); }
+        return;
+    }
+    int ThreadCount = Pool->ThreadCount;
+    for(int i = 0; i < ThreadCount; ++i) {
+        Pool->Ranges[i].Next = (long)JobCount *  i      / ThreadCount;
+        Pool->Ranges[i].End  = (long)JobCount * (i + 1) / ThreadCount;
+    }
+
+    cbMutexLock(&Pool->Mutex);
+    Pool->Job  = Job;
+    Pool->Data = Data;
+    Pool->Busy = ThreadCount - 1;
+    ++Pool->Generation;
+    cbCondBroadcast(&Pool->Start);
+    cbMutexUnlock(&Pool->Mutex);
+
+    cbPoolWork(Pool, 0);
+
+    cbMutexLock(&Pool->Mutex);
+    while(Pool->Busy) { cbCondWait(&Pool->Done, &Pool->Mutex); }
+    cbMutexUnlock(&Pool->Mutex);
+}
+
+/* Tiles are kept to roughly this many bytes of pixels so that each one stays in cache */
+#ifndef cbTILE_BYTES
+#define cbTILE_BYTES (64 * 1024)
+#endif/*cbTILE_BYTES*/
+#define cbTILE_MAX_WIDTH 1024
+
+typedef struct cb_image_tiles {
+    float *M;
+    int Gamma;
+    unsigned char *Pixels;
+    int Width, Height, Stride;
+    cb_format Format;
+    int TileWidth, TileHeight, TilesAcross;
+    /* for the multiple output versions, which use these instead of M */
+    float **Matrices;
+    cb_impairment *Impairments;
+    int Count;
+    unsigned char **Outputs;
+    int OutputStride;
+} cb_image_tiles;
+
+static void cbImageTile(void *Data, int Index) {
+    cb_image_tiles *Tiles = (cb_image_tiles *)Data;
+    int x = (Index % Tiles->TilesAcross) * Tiles->TileWidth;
+    int y = (Index / Tiles->TilesAcross) * Tiles->TileHeight;
+    int Width  = Tiles->Width  - x < Tiles->TileWidth  ? Tiles->Width  - x : Tiles->TileWidth;
+    int Height = Tiles->Height - y < Tiles->TileHeight ? Tiles->Height - y : Tiles->TileHeight;
+    ptrdiff_t Offset = (ptrdiff_t)x * cbFormatLayouts[Tiles->Format][3];
+    unsigned char *Pixels = Tiles->Pixels + (ptrdiff_t)y * Tiles->Stride + Offset;
+    if(Tiles->Outputs) {
+        cbTransformImages(Tiles->Matrices, Tiles->Impairments, Tiles->Count, Tiles->Gamma, Pixels, Width, Height, Tiles->Stride,
+                          Tiles->Format, Tiles->Outputs, (ptrdiff_t)y * Tiles->OutputStride + Offset, Tiles->OutputStride);
+    } else {
+        cbTransformImage(Tiles->M, Tiles->Gamma, Pixels, Width, Height, Tiles->Stride, Tiles->Format);
+    }
+}
+
+/* Splits the image into tiles of about cbTILE_BYTES, counting the source and every output, and runs them on the pool */
+static void cbImageTilesFor(cb_pool *Pool, cb_image_tiles *Tiles) {
+    if(Tiles->Width <= 0 || Tiles->Height <= 0) { return; }
+    int Images = Tiles->Outputs ? 1 + Tiles->Count : 1;
+    Tiles->TileWidth   = Tiles->Width < cbTILE_MAX_WIDTH ? Tiles->Width : cbTILE_MAX_WIDTH;
+    Tiles->TileHeight  = cbTILE_BYTES / (Tiles->TileWidth * cbFormatLayouts[Tiles->Format][3] * Images);
+    if(Tiles->TileHeight < 1) { Tiles->TileHeight = 1; }
+    Tiles->TilesAcross = (Tiles->Width + Tiles->TileWidth - 1) / Tiles->TileWidth;
+    int TilesDown      = (Tiles->Height + Tiles->TileHeight - 1) / Tiles->TileHeight;
+
+    cbInitTransferTables((cb_transfer)Tiles->Gamma); /* once here, rather than with every worker waiting on it */
+    cbPoolFor(Pool, Tiles->TilesAcross * TilesDown, cbImageTile, Tiles);
+}
+
+static void cbTransformImageThreaded(cb_pool *Pool, float *M, int Gamma, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format) {
+    cb_image_tiles Tiles = { 0 };
+    Tiles.M = M, Tiles.Gamma = Gamma, Tiles.Pixels = Pixels, Tiles.Format = Format;
+    Tiles.Width = Width, Tiles.Height = Height, Tiles.Stride = Stride;
+    cbImageTilesFor(Pool, &Tiles);
+}
+
+static void cbTransformImagesThreaded(cb_pool *Pool, float **Matrices, cb_impairment *Impairments, int Count, int Gamma,
+                                      unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format,
+                                      unsigned char **Outputs, int OutputStride) {
+    cb_image_tiles Tiles = { 0 };
+    Tiles.Gamma = Gamma, Tiles.Pixels = Pixels, Tiles.Format = Format;
+    Tiles.Width = Width, Tiles.Height = Height, Tiles.Stride = Stride;
+    Tiles.Matrices = Matrices, Tiles.Impairments = Impairments, Tiles.Count = Count;
+    Tiles.Outputs = Outputs, Tiles.OutputStride = OutputStride;
+    if(Count > 0) { cbImageTilesFor(Pool, &Tiles); }
+}
+
+void Colo_rblindImageThreaded(cb_pool *Pool, cb_impairment Impairment, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format) {
+    if(Impairment > cbUnimpaired && Impairment < cbImpairmentCount)
+    { cbTransformImageThreaded(Pool, cbImpairmentMatrices[Impairment], 0, Pixels, Width, Height, Stride, Format); }
+}
+void Colo_rblindImageGammaThreaded(cb_pool *Pool, cb_impairment Impairment, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format) {
+    if(Impairment > cbUnimpaired && Impairment < cbImpairmentCount)
+    { cbTransformImageThreaded(Pool, cbImpairmentMatrices[Impairment], 1, Pixels, Width, Height, Stride, Format); }
+}
+void cbMatrixImageThreaded(cb_pool *Pool, float *Matrix, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format)
+{ cbTransformImageThreaded(Pool, Matrix, 0, Pixels, Width, Height, Stride, Format); }
+void cbMatrixImageGammaThreaded(cb_pool *Pool, float *Matrix, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format)
+{ cbTransformImageThreaded(Pool, Matrix, 1, Pixels, Width, Height, Stride, Format); }
+void Colo_rblindImagesThreaded(cb_pool *Pool, cb_impairment *Impairments, int Count, unsigned char *Pixels, int Width, int Height,
+                               int Stride, cb_format Format, unsigned char **Outputs, int OutputStride)
+{ cbTransformImagesThreaded(Pool, 0, Impairments, Count, 0, Pixels, Width, Height, Stride, Format, Outputs, OutputStride); }
+void Colo_rblindImagesGammaThreaded(cb_pool *Pool, cb_impairment *Impairments, int Count, unsigned char *Pixels, int Width, int Height,
+                                    int Stride, cb_format Format, unsigned char **Outputs, int OutputStride)
+{ cbTransformImagesThreaded(Pool, 0, Impairments, Count, 1, Pixels, Width, Height, Stride, Format, Outputs, OutputStride); }
+void cbMatrixImagesThreaded(cb_pool *Pool, float **Matrices, int Count, unsigned char *Pixels, int Width, int Height,
+                            int Stride, cb_format Format, unsigned char **Outputs, int OutputStride)
+{ cbTransformImagesThreaded(Pool, Matrices, 0, Count, 0, Pixels, Width, Height, Stride, Format, Outputs, OutputStride); }
+void cbMatrixImagesGammaThreaded(cb_pool *Pool, float **Matrices, int Count, unsigned char *Pixels, int Width, int Height,
+                                 int Stride, cb_format Format, unsigned char **Outputs, int OutputStride)
+{ cbTransformImagesThreaded(Pool, Matrices, 0, Count, 1, Pixels, Width, Height, Stride, Format, Outputs, OutputStride); }
+void Colo_rblindImageSpaceThreaded(cb_pool *Pool, cb_impairment Impairment, cb_space Space, cb_transfer Transfer,
+                                   unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format) {
+    if(Impairment > cbUnimpaired && Impairment < cbImpairmentCount && Transfer >= cbTransferLinear && Transfer < cbTransferCount)
+    { cbTransformImageThreaded(Pool, cbSpaceMatrix(Space, Impairment), Transfer, Pixels, Width, Height, Stride, Format); }
+}
+void cbGuidelinesBatchThreaded(cb_pool *Pool, cb_rgb_255 *As, cb_rgb_255 *Bs, int Count, cb_impairment *Impairments,
+                               int ImpairmentCount, int Gamma, unsigned int *Masks, float *Scores) {
+    cb_guidelines_batch Batch = { As, Bs, Count, Impairments, ImpairmentCount, Gamma, Masks, Scores };
+    if(Count <= 0 || ImpairmentCount <= 0) { return; }
+    cbInitGammaTables(); /* cbLuminanceImage uses them either way; built here rather than with every worker waiting */
+    cbPoolFor(Pool, (Count + cbGUIDELINES_CHUNK - 1) / cbGUIDELINES_CHUNK, cbGuidelinesChunk, &Batch);
+}
+int cbSequenceFrameThreaded(cb_pool *Pool, cb_sequence *Sequence, unsigned char *Pixels, int Stride) {
+    cb_sequence_frame Frame = { Sequence, Pixels, Stride };
+    cbPoolFor(Pool, Sequence->TilesAcross * Sequence->TilesDown, cbSequenceTile, &Frame);
+    return cbSequenceFinish(Sequence);
+}
+#endif/*cbTHREADS*/
+
+/******************************************************************************
+ * 3D LUTs
+ *********/
+#define cbLUT_MAX_SIZE 256
+
+static cb_lut *cbLutAlloc(int Size) {
+    if(Size < 2 || Size > cbLUT_MAX_SIZE) { return 0; }
+    cb_lut *Lut = (cb_lut *)cbMALLOC(sizeof(cb_lut));
+    if(! Lut) { return 0; }
+    Lut->Size  = Size;
+    Lut->Table = (float *)cbMALLOC(sizeof(float) * 3 * Size*Size*Size);
+    if(! Lut->Table) { cbFREE(Lut); return 0; }
+    return Lut;
+}
+
+void cbLutDestroy(cb_lut *Lut) {
+    if(Lut) {
+        cbFREE(Lut->Table);
+        cbFREE(Lut);
+    }
+}
+
+cb_lut *cbLutCreate(cb_impairment Impairment, int Size) {
+    if(Impairment < cbUnimpaired || Impairment >= cbImpairmentCount) { return 0; }
+    cb_lut *Lut = cbLutAlloc(Size);
+    if(! Lut) { return 0; }
+    float *M = cbImpairmentMatrices[Impairment], *Out = Lut->Table;
+    for(int b = 0; b < Size; ++b)
+    for(int g = 0; g < Size; ++g)
+    for(int r = 0; r < Size; ++r) {
+        float R = (float)r / (Size-1), G = (float)g / (Size-1), B = (float)b / (Size-1);
+        R = cbRemoveGammaComponent(R), G = cbRemoveGammaComponent(G), B = cbRemoveGammaComponent(B);
+        float Sim[3] = {
+            M[0]*R + M[1]*G + M[2]*B,
+            M[3]*R + M[4]*G + M[5]*B,
+            M[6]*R + M[7]*G + M[8]*B,
+        };
+        /* left unclamped so that interpolation stays smooth at the edges of the gamut */
+        for(int c = 0; c < 3; ++c)
+        { *Out++ = cbApplyGammaComponent(Sim[c]); }
+    }
+    return Lut;
+}
+
+/* R, G, B are in lattice units, i.e. 0 to Size-1 */
+static void cbLutTetrahedral(cb_lut *Lut, float R, float G, float B, float *Out) {
+    int N = Lut->Size;
+    int r = (int)R, g = (int)G, b = (int)B;
+    if(r > N-2) { r = N-2; }
+    if(g > N-2) { g = N-2; }
+    if(b > N-2) { b = N-2; }
+    float fr = R - r, fg = G - g, fb = B - b;
+
+    /* strides to the neighbouring lattice points */
+    int dr = 3, dg = 3*N, db = 3*N*N;
+    float *P000 = Lut->Table + r*dr + g*dg + b*db;
+    float *P111 = P000 + dr + dg + db;
+    float *P1, *P2, w0, w1, w2, w3;
+
+    /* pick which of the 6 tetrahedra in the cube contains the point */
+    if(fr > fg) {
+        if(fg > fb)      { P1 = P000 + dr;      P2 = P000 + dr + dg; w0 = 1-fr, w1 = fr-fg, w2 = fg-fb, w3 = fb; }
+        else if(fr > fb) { P1 = P000 + dr;      P2 = P000 + dr + db; w0 = 1-fr, w1 = fr-fb, w2 = fb-fg, w3 = fg; }
+        else             { P1 = P000 + db;      P2 = P000 + dr + db; w0 = 1-fb, w1 = fb-fr, w2 = fr-fg, w3 = fg; }
+    } else {
+        if(fb > fg)      { P1 = P000 + db;      P2 = P000 + dg + db; w0 = 1-fb, w1 = fb-fg, w2 = fg-fr, w3 = fr; }
+        else if(fb > fr) { P1 = P000 + dg;      P2 = P000 + dg + db; w0 = 1-fg, w1 = fg-fb, w2 = fb-fr, w3 = fr; }
+        else             { P1 = P000 + dg;      P2 = P000 + dr + dg; w0 = 1-fg, w1 = fg-fr, w2 = fr-fb, w3 = fb; }
+    }
+    for(int c = 0; c < 3; ++c)
+    { Out[c] = w0*P000[c] + w1*P1[c] + w2*P2[c] + w3*P111[c]; }
+}
+
+cb_rgb cbLutRGB(cb_lut *Lut, cb_rgb RGB) {
+    cbSTAT_BEGIN();
+    float Scale = (float)(Lut->Size - 1), In[3] = { RGB.R, RGB.G, RGB.B }, Out[3];
+    for(int c = 0; c < 3; ++c)
+    { In[c] = ! (In[c] > 0.f) ? 0.f : In[c] > 1.f ? Scale : In[c] * Scale; } /* NaN goes to 0 */
+    cbLutTetrahedral(Lut, In[0], In[1], In[2], Out);
+    cb_rgb Result = { Out[0], Out[1], Out[2] };
+    cbSTAT_END(cbStatLut, 1);
+    return Result;
+}
+
+cb_rgb_255 cbLutRGB255(cb_lut *Lut, cb_rgb_255 RGB) {
+    cbSTAT_BEGIN();
+    float Scale = (float)(Lut->Size - 1) / 255.f, Out[3];
+    cbLutTetrahedral(Lut, RGB.R * Scale, RGB.G * Scale, RGB.B * Scale, Out);
+    cb_rgb_255 Result = { cbClampDenormComponent(Out[0]), cbClampDenormComponent(Out[1]), cbClampDenormComponent(Out[2]) };
+    cbSTAT_END(cbStatLut, 1);
+    return Result;
+}
+
+void cbLutImage(cb_lut *Lut, unsigned char *Pixels, int Width, int Height, int Stride, cb_format Format) {
+    cbSTAT_BEGIN();
+    if(cbFormatLayouts[Format][4] != cbComponent8) {
+        float R[cbIMAGE_CHUNK], G[cbIMAGE_CHUNK], B[cbIMAGE_CHUNK], Out[3], Scale = (float)(Lut->Size - 1);
+        for(int y = 0; y < Height; ++y)
+        for(int x = 0; x < Width; x += cbIMAGE_CHUNK) {
+            unsigned char *P = Pixels + (ptrdiff_t)y * Stride + (ptrdiff_t)x * cbFormatLayouts[Format][3];
+            int Count = Width - x < cbIMAGE_CHUNK ? Width - x : cbIMAGE_CHUNK;
+            cbLoadPixels(P, Count, Format, 0, R, G, B);
+            for(int i = 0; i < Count; ++i) {
+#define cbCLAMP01(X) ((X) > 0.f ? (X) < 1.f ? (X) : 1.f : 0.f)
+                cbLutTetrahedral(Lut, cbCLAMP01(R[i]) * Scale, cbCLAMP01(G[i]) * Scale, cbCLAMP01(B[i]) * Scale, Out);
+#undef cbCLAMP01
+                R[i] = Out[0], G[i] = Out[1], B[i] = Out[2];
+            }
+            cbStorePixels(P, Count, Format, 0, R, G, B);
+        }
+        cbSTAT_END(cbStatLut, (long long)Width * Height);
+        return;
+    }
+    int iR = cbFormatLayouts[Format][0], iG = cbFormatLayouts[Format][1],
+        iB = cbFormatLayouts[Format][2], Size = cbFormatLayouts[Format][3];
+    float Scale = (float)(Lut->Size - 1) / 255.f, Out[3];
+    for(int y = 0; y < Height; ++y) {
+        unsigned char *P = Pixels + (ptrdiff_t)y * Stride;
+        for(int x = 0; x < Width; ++x, P += Size) {
+            cbLutTetrahedral(Lut, P[iR] * Scale, P[iG] * Scale, P[iB] * Scale, Out);
+            P[iR] = cbClampDenormComponent(Out[0]);
+            P[iG] = cbClampDenormComponent(Out[1]);
+            P[iB] = cbClampDenormComponent(Out[2]);
+        }
+    }
+    cbSTAT_END(cbStatLut, (long long)Width * Height);
+}
+
+int cbLutMaxError(cb_lut *Lut, cb_impairment Impairment, int Step) {
+    unsigned char Exact[256*3], Approx[256*3];
+    int MaxError = 0;
+    if(Step < 1) { Step = 1; }
+    for(int b = 0; b < 256; b += Step)
+    for(int g = 0; g < 256; g += Step) {
+        int Count = 0;
+        for(int r = 0; r < 256; r += Step, ++Count) {
+            Exact[3*Count + 0] = (unsigned char)r;
+            Exact[3*Count + 1] = (unsigned char)g;
+            Exact[3*Count + 2] = (unsigned char)b;
+        }
+        for(int i = 0; i < 3*Count; ++i) { Approx[i] = Exact[i]; }
+        Colo_rblindImageGamma(Impairment, Exact, Count, 1, 3*Count, cbRGB8);
+        cbLutImage(Lut, Approx, Count, 1, 3*Count, cbRGB8);
+        for(int i = 0; i < 3*Count; ++i) {
+            int Error = Exact[i] > Approx[i] ? Exact[i] - Approx[i] : Approx[i] - Exact[i];
+            if(Error > MaxError) { MaxError = Error; }
+        }
+    }
+    return MaxError;
+}
+
+#ifndef cbNO_STDIO
+#include <stdio.h>  /* fopen, fprintf, fgets */
+#include <string.h> /* strncmp */
+
+int cbLutSave(cb_lut *Lut, char *Path) {
+    FILE *File = fopen(Path, "w");
+    if(! File) { return 0; }
+    int N = Lut->Size;
+    fprintf(File, "# Created by colourblind.h\nLUT_3D_SIZE %d\nDOMAIN_MIN 0 0 0\nDOMAIN_MAX 1 1 1\n", N);
+    for(int i = 0; i < N*N*N; ++i)
+    { fprintf(File, "%.6f %.6f %.6f\n", Lut->Table[3*i], Lut->Table[3*i + 1], Lut->Table[3*i + 2]); }
+    int Success = ! ferror(File);
+    return fclose(File) == 0 && Success;
+}
+
+cb_lut *cbLutLoad(char *Path) {
+    FILE *File = fopen(Path, "r");
+    if(! File) { return 0; }
+    char Line[256];
+    cb_lut *Lut = 0;
+    int Count = 0, Total = 0, Failed = 0;
+    while(! Failed && fgets(Line, sizeof(Line), File)) {
+        char *C = Line;
+        while(*C == ' ' || *C == '\t') { ++C; }
+        float R, G, B;
+        int Size;
+        if(*C == '#' || *C == '\n' || *C == '\r' || *C == '\0') { continue; }
+        else if(sscanf(C, "LUT_3D_SIZE %d", &Size) == 1) {
+            if(Lut || ! (Lut = cbLutAlloc(Size))) { Failed = 1; }
+            else                                  { Total = Size*Size*Size; }
+        }
+        /* the lattice always covers 0-1, so other domains are refused rather than silently misread */
+        else if(sscanf(C, "DOMAIN_MIN %f %f %f", &R, &G, &B) == 3) { Failed = R != 0.f || G != 0.f || B != 0.f; }
+        else if(sscanf(C, "DOMAIN_MAX %f %f %f", &R, &G, &B) == 3) { Failed = R != 1.f || G != 1.f || B != 1.f; }
+        else if(sscanf(C, "LUT_3D_INPUT_RANGE %f %f", &R, &G) == 2) { Failed = R != 0.f || G != 1.f; }
+        else if(! strncmp(C, "LUT_1D_SIZE", 11)) { Failed = 1; } /* its entries would be read as the 3D ones */
+        else if((*C >= 'A' && *C <= 'Z') || (*C >= 'a' && *C <= 'z') || *C == '_') { continue; } /* TITLE etc. */
+        else if(Lut && Count < Total && sscanf(C, "%f %f %f", &R, &G, &B) == 3) {
+            Lut->Table[3*Count + 0] = R;
+            Lut->Table[3*Count + 1] = G;
+            Lut->Table[3*Count + 2] = B;
+            ++Count;
+        }
+        else { Failed = 1; } /* entries before the size, too many entries... */
+    }
+    fclose(File);
+    if(Failed || ! Lut || Count != Total) {
+        cbLutDestroy(Lut);
+        return 0;
+    }
+    return Lut;
+}
+#endif/*cbNO_STDIO*/
+
+/******************************************************************************
+ * Palettes
+ **********/
+#define cbPALETTE_BLOCK 64
+
+cb_palette *cbPaletteCreate(cb_rgb_255 *Colours, int Count, int Gamma) {
+    if(Count <= 0) { return 0; }
+    size_t N = (size_t)Count, Pairs = cbImpairmentCount * N*N;
+    cb_palette *Palette = (cb_palette *)cbMALLOC(sizeof(cb_palette));
+    if(! Palette) { return 0; }
+    Palette->Count              = Count;
+    Palette->Gamma              = Gamma;
+    Palette->Colours            = (cb_rgb_255 *)cbMALLOC(sizeof(cb_rgb_255) * N);
+    Palette->Simulated          = (cb_rgb_255 *)cbMALLOC(sizeof(cb_rgb_255) * cbImpairmentCount * N);
+    Palette->Luminance          = (float *)cbMALLOC(sizeof(float) * cbImpairmentCount * N);
+    Palette->Lab                = (float *)cbMALLOC(sizeof(float) * cbImpairmentCount * 3 * N);
+    Palette->Luv                = (float *)cbMALLOC(sizeof(float) * cbImpairmentCount * 3 * N);
+    Palette->Contrast           = (float *)cbMALLOC(sizeof(float) * Pairs);
+    Palette->ContrastModulation = (float *)cbMALLOC(sizeof(float) * Pairs);
+    Palette->ContrastRatio      = (float *)cbMALLOC(sizeof(float) * Pairs);
+    Palette->LightnessContrast  = (float *)cbMALLOC(sizeof(float) * Pairs);
+    Palette->Powers             = (float *)cbMALLOC(sizeof(float) * cbImpairmentCount * cbAPCA_PowerCount * N);
+    Palette->LightnessState     = 0;
+    if(! Palette->Colours  || ! Palette->Simulated          || ! Palette->Luminance     ||
+       ! Palette->Lab      || ! Palette->Luv                || ! Palette->Powers        ||
+       ! Palette->Contrast || ! Palette->ContrastModulation || ! Palette->ContrastRatio ||
+       ! Palette->LightnessContrast) {
+        cbPaletteDestroy(Palette);
+        return 0;
+    }
+
+    cbInitGammaTables();
+    for(int i = 0; i < Count; ++i) { Palette->Colours[i] = Colours[i]; }
+    for(int Impairment = 0; Impairment < cbImpairmentCount; ++Impairment) {
+        cb_rgb_255 *Simulated = Palette->Simulated + Impairment * N;
+        float      *Luminance = Palette->Luminance + Impairment * N;
+        for(int i = 0; i < Count; ++i) { Simulated[i] = Colours[i]; }
+        if(Gamma) { Colo_rblindImageGamma((cb_impairment)Impairment, &Simulated->R, Count, 1, 3*Count, cbRGB8); }
+        else      { Colo_rblindImage(     (cb_impairment)Impairment, &Simulated->R, Count, 1, 3*Count, cbRGB8); }
+        float *Lab = Palette->Lab + Impairment * 3 * N, *Luv = Palette->Luv + Impairment * 3 * N;
+        for(int i = 0; i < Count; ++i) {
+            cb_rgb_255 C = Simulated[i];
+            float Coordinates[3];
+            Luminance[i] = cbLUMINANCE(cbGammaDecodeTable[C.R], cbGammaDecodeTable[C.G], cbGammaDecodeTable[C.B]);
+            cbLab255(C.R, C.G, C.B, Coordinates);
+            Lab[i] = Coordinates[0], Lab[N + i] = Coordinates[1], Lab[2*N + i] = Coordinates[2];
+            cbLuv255(C.R, C.G, C.B, Coordinates);
+            Luv[i] = Coordinates[0], Luv[N + i] = Coordinates[1], Luv[2*N + i] = Coordinates[2];
+        }
+
+        /* Blocked so that a run of B luminances stays in L1 while every A is compared against it.
+         * The inner loops have no branches so that they can be vectorised, and give the same results
+         * as the cbContrast*Luminance functions. */
+        for(int B0 = 0; B0 < Count; B0 += cbPALETTE_BLOCK) {
+            int B1 = B0 + cbPALETTE_BLOCK < Count ? B0 + cbPALETTE_BLOCK : Count;
+            for(int A = 0; A < Count; ++A) {
+                size_t Row = (Impairment * N + A) * N;
+                float *Contrast   = Palette->Contrast           + Row;
+                float *Modulation = Palette->ContrastModulation + Row;
+                float *Ratio      = Palette->ContrastRatio      + Row;
+                float LumA = Luminance[A];
+                for(int B = B0; B < B1; ++B) {
+                    float LumB = Luminance[B];
+                    float High = LumA > LumB ? LumA : LumB;
+                    float Low  = LumA > LumB ? LumB : LumA;
+                    Contrast[B]   = (High + 0.05f) / (Low + 0.05f);
+                    Ratio[B]      = High / Low;
+                    Modulation[B] = High == Low ? 0.f : (High - Low) / (High + Low);
+                }
+            }
+        }
+    }
+    return Palette;
+}
+
+/* the powers are found once per colour, and as the score is symmetric only half of the pairs are worked out */
+static float *cbPaletteLightnessContrasts(cb_palette *Palette) {
+    if(! cbOnceBegin(&Palette->LightnessState)) { return Palette->LightnessContrast; }
+    size_t N = (size_t)Palette->Count;
+    for(int Impairment = 0; Impairment < cbImpairmentCount; ++Impairment) {
+        float *Luminance = Palette->Luminance + Impairment * N;
+        float *Powers    = Palette->Powers + Impairment * cbAPCA_PowerCount * N;
+        for(int i = 0; i < Palette->Count; ++i) { cbAPCAPowers(Luminance[i], Powers + i * cbAPCA_PowerCount); }
+        for(int A = 0; A < Palette->Count; ++A) {
+            float *Lightness = Palette->LightnessContrast + (Impairment * N + A) * N;
+            float *PowersA   = Powers + A * cbAPCA_PowerCount;
+            Lightness[A] = 0.f;
+            for(int B = A + 1; B < Palette->Count; ++B) {
+                float *PowersB = Powers + B * cbAPCA_PowerCount;
+                float AOnB = fabsf(cbAPCAFromPowers(PowersA, PowersB)), BOnA = fabsf(cbAPCAFromPowers(PowersB, PowersA));
+                Lightness[B] = Palette->LightnessContrast[(Impairment * N + B) * N + A] = AOnB < BOnA ? AOnB : BOnA;
+            }
+        }
+    }
+    cbOnceEnd(&Palette->LightnessState);
+    return Palette->LightnessContrast;
+}
+
+void cbPaletteDestroy(cb_palette *Palette) {
+    if(! Palette) { return; }
+    cbFREE(Palette->Colours);
+    cbFREE(Palette->Simulated);
+    cbFREE(Palette->Luminance);
+    cbFREE(Palette->Lab);
+    cbFREE(Palette->Luv);
+    cbFREE(Palette->Contrast);
+    cbFREE(Palette->ContrastModulation);
+    cbFREE(Palette->ContrastRatio);
+    cbFREE(Palette->LightnessContrast);
+    cbFREE(Palette->Powers);
+    cbFREE(Palette);
+}
+
+#define cbPALETTE_SCORE(test) \
+float cbPalette##test(cb_palette *Palette, cb_impairment Impairment, int A, int B) \
+{ return Palette->test[((size_t)Impairment * Palette->Count + A) * Palette->Count + B]; }
+cbPALETTE_SCORE(Contrast)
+cbPALETTE_SCORE(ContrastModulation)
+cbPALETTE_SCORE(ContrastRatio)
+#undef cbPALETTE_SCORE
+float cbPaletteLightnessContrast(cb_palette *Palette, cb_impairment Impairment, int A, int B)
+{ return cbPaletteLightnessContrasts(Palette)[((size_t)Impairment * Palette->Count + A) * Palette->Count + B]; }
+
+static float *cbPaletteGuidelineScores(cb_palette *Palette, cb_guideline Guideline) {
+#ifdef cbGUIDELINE_APCA
+    if(Guideline == cbAPCA_LightnessContrast_Body) { return cbPaletteLightnessContrasts(Palette); }
+#endif/*cbGUIDELINE_APCA*/
+    switch(Guideline) {
+#define COL_GUIDELINE(source, testname, rating, comparison, value) \
+        case cb## source ##_## testname ##_## rating: return Palette->testname;
+        COL_GUIDELINES
+#undef COL_GUIDELINE
+        default: return 0;
+    }
+}
+
+int cbPaletteWorstPairs(cb_palette *Palette, cb_guideline Guideline, cb_pair *Pairs, int MaxPairs) {
+    float *Scores = cbPaletteGuidelineScores(Palette, Guideline);
+    int N = Palette->Count, Found = 0;
+    if(! Scores || MaxPairs <= 0) { return 0; }
+    /* all of the guidelines pass at or above their value, so the worst pairs have the lowest scores */
+    for(int Impairment = 0; Impairment < cbImpairmentCount; ++Impairment)
+    for(int A = 0; A < N; ++A) {
+        float *Row = Scores + ((size_t)Impairment * N + A) * N;
+        for(int B = A + 1; B < N; ++B) {
+            float Score = Row[B];
+            if(Found == MaxPairs && ! (Score < Pairs[Found-1].Score)) { continue; }
+            int i = Found < MaxPairs ? Found++ : Found - 1;
+            for(; i > 0 && Score < Pairs[i-1].Score; --i) { Pairs[i] = Pairs[i-1]; }
+            Pairs[i].A = A, Pairs[i].B = B, Pairs[i].Impairment = (cb_impairment)Impairment, Pairs[i].Score = Score;
+        }
+    }
+    return Found;
+}
+
+/* the colour's L*, a*, b* (or L*, u*, v*) gathered from the palette's planes */
+static void cbPaletteCoordinates(cb_palette *Palette, cb_delta_e Metric, cb_impairment Impairment, int i, float *Coordinates) {
+    size_t N = (size_t)Palette->Count;
+    float *Planes = (Metric == cbDeltaE_CIELUV ? Palette->Luv : Palette->Lab) + Impairment * 3 * N;
+    Coordinates[0] = Planes[i], Coordinates[1] = Planes[N + i], Coordinates[2] = Planes[2*N + i];
+}
+
+float cbPaletteDeltaE(cb_palette *Palette, cb_delta_e Metric, cb_impairment Impairment, int A, int B) {
+    float CoordinatesA[3], CoordinatesB[3];
+    cbPaletteCoordinates(Palette, Metric, Impairment, A, CoordinatesA);
+    cbPaletteCoordinates(Palette, Metric, Impairment, B, CoordinatesB);
+    return Metric == cbDeltaE_CIEDE2000 ? cbDeltaE2000Lab(CoordinatesA, CoordinatesB)
+                                        : cbDeltaE76Lab(CoordinatesA, CoordinatesB);
+}
+
+/* Differences from colour A to each of Count others, with the coordinates in planes of N. The distances are
+ * vectorised (with the same operations in the same order as cbDeltaE76Lab, so identical results), and CIEDE2000,
+ * which needs trigonometry for every pair, is done one at a time. */
+static void cbPaletteRow(cb_palette *Palette, cb_delta_e Metric, cb_impairment Impairment, int A, int B0, int Count, float *Row) {
+    size_t N = (size_t)Palette->Count;
+    float *L = (Metric == cbDeltaE_CIELUV ? Palette->Luv : Palette->Lab) + Impairment * 3 * N, *U = L + N, *V = U + N;
+    int B = 0;
+    if(Metric == cbDeltaE_CIEDE2000) {
+        float CoordinatesA[3], CoordinatesB[3];
+        cbPaletteCoordinates(Palette, Metric, Impairment, A, CoordinatesA);
+        for(; B < Count; ++B) {
+            cbPaletteCoordinates(Palette, Metric, Impairment, B0 + B, CoordinatesB);
+            Row[B] = cbDeltaE2000Lab(CoordinatesA, CoordinatesB);
+        }
+        return;
+    }
+    L += B0, U += B0, V += B0;
+#ifdef cbSSE2
+    __m128 LA = _mm_set1_ps(L[A - B0]), UA = _mm_set1_ps(U[A - B0]), VA = _mm_set1_ps(V[A - B0]);
+    for(; B + 4 <= Count; B += 4) {
+        __m128 DL = _mm_sub_ps(LA, _mm_loadu_ps(L + B));
+        __m128 DU = _mm_sub_ps(UA, _mm_loadu_ps(U + B));
+        __m128 DV = _mm_sub_ps(VA, _mm_loadu_ps(V + B));
+        __m128 Sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(DL, DL), _mm_mul_ps(DU, DU)), _mm_mul_ps(DV, DV));
+        _mm_storeu_ps(Row + B, _mm_sqrt_ps(Sum));
+    }
+#endif/*cbSSE2*/
+    for(; B < Count; ++B) {
+        float DL = L[A - B0] - L[B], DU = U[A - B0] - U[B], DV = V[A - B0] - V[B];
+        Row[B] = sqrtf(DL*DL + DU*DU + DV*DV);
+    }
+}
+
+void cbPaletteDifferences(cb_palette *Palette, cb_delta_e Metric, cb_impairment Impairment, float *Differences) {
+    size_t N = (size_t)Palette->Count;
+    if(Metric != cbDeltaE_CIEDE2000) {
+        for(int A = 0; A < (int)N; ++A) { cbPaletteRow(Palette, Metric, Impairment, A, 0, (int)N, Differences + A * N); }
+        return;
+    }
+    /* CIEDE2000 is symmetric (down to the rounding, as every step either commutes or flips sign before squaring),
+     * so only half of it is worked out */
+    for(int A = 0; A < (int)N; ++A) {
+        Differences[A * N + A] = 0.f;
+        cbPaletteRow(Palette, Metric, Impairment, A, A + 1, (int)N - A - 1, Differences + A * N + A + 1);
+        for(size_t B = A + 1; B < N; ++B) { Differences[B * N + A] = Differences[A * N + B]; }
+    }
+}
+
+int cbPaletteConfusedPairs(cb_palette *Palette, cb_delta_e Metric, cb_impairment Impairment, float Threshold,
+                           cb_pair *Pairs, int MaxPairs) {
+    float Row[cbPALETTE_BLOCK];
+    int N = Palette->Count, Found = 0;
+    for(int A = 0; A < N; ++A)
+    for(int B0 = A + 1; B0 < N; B0 += cbPALETTE_BLOCK) {
+        int Count = N - B0 < cbPALETTE_BLOCK ? N - B0 : cbPALETTE_BLOCK;
+        cbPaletteRow(Palette, Metric, Impairment, A, B0, Count, Row);
+        for(int B = 0; B < Count; ++B) {
+            if(! (Row[B] < Threshold)) { continue; }
+            if(Found < MaxPairs) {
+                cb_pair *Pair = &Pairs[Found];
+                Pair->A = A, Pair->B = B0 + B, Pair->Impairment = Impairment, Pair->Score = Row[B];
+            }
+            ++Found;
+        }
+    }
+    return Found;
+}
+
+/******************************************************************************
+ * Local contrast
+ ****************/
+#define cbCONTRAST_STRIP 16 /* lines filtered together */
+
+/* Sliding-window maximum of Max and minimum of Min (in place) along Count values Step apart, for up to
+ * cbCONTRAST_STRIP lines LineStep apart. This is van Herk/Gil-Werman: running extremes are taken forwards and
+ * backwards within blocks the size of the window, and every window spans at most two blocks, so each value
+ * costs three comparisons whatever the Radius. The ends are padded so that windows get cut off there.
+ * The lines are interleaved in Scratch (4 * (Count + 2*Radius) * cbCONTRAST_STRIP floats) and padded to a full
+ * strip, so the scans work on a whole strip at a time with SIMD where available (giving identical results). */
+#ifdef cbSSE2
+#define cbEXTREMES_WIDTH 4
+#define cbMAX(Out, A, B) _mm_storeu_ps(Out, _mm_max_ps(_mm_loadu_ps(A), _mm_loadu_ps(B)))
+#define cbMIN(Out, A, B) _mm_storeu_ps(Out, _mm_min_ps(_mm_loadu_ps(A), _mm_loadu_ps(B)))
+#else
+#define cbEXTREMES_WIDTH 1
+#define cbMAX(Out, A, B) (*(Out) = *(A) > *(B) ? *(A) : *(B))
+#define cbMIN(Out, A, B) (*(Out) = *(A) < *(B) ? *(A) : *(B))
+#endif/*cbSSE2*/
+static void cbSlidingExtremes(float *Max, float *Min, int Count, ptrdiff_t Step, int Lines, ptrdiff_t LineStep,
+                              int Radius, float *Scratch) {
+    enum { L = cbCONTRAST_STRIP };
+    int Window = 2*Radius + 1, Padded = Count + 2*Radius;
+    float *ForwardMax = Scratch, *BackwardMax = ForwardMax + (ptrdiff_t)Padded * L,
+          *ForwardMin = BackwardMax + (ptrdiff_t)Padded * L, *BackwardMin = ForwardMin + (ptrdiff_t)Padded * L;
+
+    /* the padded input goes in the backward arrays, which are then scanned in place */
+    for(int p = 0; p < Padded; ++p) {
+        float *BMax = BackwardMax + (ptrdiff_t)p * L, *BMin = BackwardMin + (ptrdiff_t)p * L;
+        int i = p - Radius, l = 0;
+        if(i >= 0 && i < Count) {
+            for(; l < Lines; ++l) { BMax[l] = Max[i*Step + l*LineStep], BMin[l] = Min[i*Step + l*LineStep]; }
+        }
+        for(; l < L; ++l) { BMax[l] = -1e30f, BMin[l] = 1e30f; }
+    }
+    for(int Start = 0; Start < Padded; Start += Window) {
+        int End = Start + Window < Padded ? Start + Window : Padded;
+        float *FMax = ForwardMax + (ptrdiff_t)Start * L, *FMin = ForwardMin + (ptrdiff_t)Start * L;
+        float *BMax = BackwardMax + (ptrdiff_t)Start * L, *BMin = BackwardMin + (ptrdiff_t)Start * L;
+        for(int l = 0; l < L; ++l) { FMax[l] = BMax[l], FMin[l] = BMin[l]; }
+        for(int p = Start + 1; p < End; ++p) {
+            FMax += L, FMin += L, BMax += L, BMin += L;
+            for(int l = 0; l < L; l += cbEXTREMES_WIDTH) {
+                cbMAX(FMax + l, BMax + l, FMax + l - L);
+                cbMIN(FMin + l, BMin + l, FMin + l - L);
+            }
+        }
+        for(int p = End - 2; p >= Start; --p) {
+            BMax -= L, BMin -= L;
+            for(int l = 0; l < L; l += cbEXTREMES_WIDTH) {
+                cbMAX(BMax + l, BMax + l, BMax + l + L);
+                cbMIN(BMin + l, BMin + l, BMin + l + L);
+            }
+        }
+    }
+    /* the window starting at padded position i covers the end of one block and the start of the next */
+    for(int i = 0; i < Count; ++i) {
+        float *BMax = BackwardMax + (ptrdiff_t)i * L, *FMax = ForwardMax + (ptrdiff_t)(i + 2*Radius) * L;
+        float *BMin = BackwardMin + (ptrdiff_t)i * L, *FMin = ForwardMin + (ptrdiff_t)(i + 2*Radius) * L;
+        for(int l = 0; l < L; l += cbEXTREMES_WIDTH) {
+            cbMAX(BMax + l, BMax + l, FMax + l);
+            cbMIN(BMin + l, BMin + l, FMin + l);
+        }
+        for(int l = 0; l < Lines; ++l) { Max[i*Step + l*LineStep] = BMax[l], Min[i*Step + l*LineStep] = BMin[l]; }
+    }
+}
+#undef cbEXTREMES_WIDTH
+#undef cbMAX
+#undef cbMIN
+
+cb_contrast_map *cbContrastMapCreate(cb_impairment Impairment, unsigned char *Pixels, int Width, int Height, int Stride,
+                                     cb_format Format, int Radius) {
+    if(Impairment < cbUnimpaired || Impairment >= cbImpairmentCount || Width <= 0 || Height <= 0 || Radius < 0)
+    { return 0; }
+    size_t Area = (size_t)Width * Height;
+    size_t Scratch = 4 * (size_t)((Width > Height ? Width : Height) + 2*Radius) * cbCONTRAST_STRIP;
+    cb_contrast_map *Map = (cb_contrast_map *)cbMALLOC(sizeof(cb_contrast_map));
+    if(! Map) { return 0; }
+    Map->Width = Width, Map->Height = Height, Map->Radius = Radius, Map->Impairment = Impairment;
+    Map->Luminance = (float *)cbMALLOC(sizeof(float) * Area);
+    Map->Lightest  = (float *)cbMALLOC(sizeof(float) * Area);
+    Map->Darkest   = (float *)cbMALLOC(sizeof(float) * Area);
+    Map->Mask      = (unsigned char *)cbMALLOC(Area);
+    /* packed 8-bit colours, whose extremes only match where the window is a single colour */
+    float *ColourMax = (float *)cbMALLOC(sizeof(float) * Area), *ColourMin = (float *)cbMALLOC(sizeof(float) * Area);
+    float *Work = (float *)cbMALLOC(sizeof(float) * Scratch);
+    if(! Map->Luminance || ! Map->Lightest || ! Map->Darkest || ! Map->Mask || ! ColourMax || ! ColourMin || ! Work) {
+        cbFREE(ColourMax), cbFREE(ColourMin), cbFREE(Work);
+        cbContrastMapDestroy(Map);
+        return 0;
+    }
+
+    float R[cbIMAGE_CHUNK], G[cbIMAGE_CHUNK], B[cbIMAGE_CHUNK];
+    const float *M = cbImpairmentMatrices[Impairment];
+    cb_matrix_kernel *Kernel = cbMatrixKernel();
+    int iR = cbFormatLayouts[Format][0], iG = cbFormatLayouts[Format][1], iB = cbFormatLayouts[Format][2];
+    int Size = cbFormatLayouts[Format][3], Quantise = cbFormatLayouts[Format][4] == cbComponent8;
+    cbInitGammaTables();
+    /* the horizontal pass runs on each strip of rows straight after it's loaded, while it's still in cache */
+    for(int y0 = 0; y0 < Height; y0 += cbCONTRAST_STRIP) {
+        int Lines = Height - y0 < cbCONTRAST_STRIP ? Height - y0 : cbCONTRAST_STRIP;
+        for(int y = y0; y < y0 + Lines; ++y)
+        for(int x = 0; x < Width; x += cbIMAGE_CHUNK) {
+            unsigned char *P = Pixels + (ptrdiff_t)y * Stride + (ptrdiff_t)x * Size;
+            int Count = Width - x < cbIMAGE_CHUNK ? Width - x : cbIMAGE_CHUNK;
+            size_t Row = (size_t)y * Width + x;
+            if(Quantise) {
+                for(int i = 0; i < Count; ++i)
+                { ColourMax[Row + i] = ColourMin[Row + i] = (float)(P[i*Size + iR] << 16 | P[i*Size + iG] << 8 | P[i*Size + iB]); }
+            } else {
+                cbLoadPixels(P, Count, Format, 0, R, G, B);
+                for(int i = 0; i < Count; ++i) {
+                    ColourMax[Row + i] = ColourMin[Row + i] = (float)(cbClampDenormComponent(R[i]) << 16 |
+                                                                      cbClampDenormComponent(G[i]) << 8 |
+                                                                      cbClampDenormComponent(B[i]));
+                }
+            }
+            cbLoadPixels(P, Count, Format, 1, R, G, B);
+            Kernel(M, R, G, B, Count);
+            /* 8-bit results are rounded to what the ImageGamma functions would store */
+            for(int i = 0; i < Count; ++i) {
+                float r, g, b;
+                if(Quantise) {
+                    r = cbGammaDecodeTable[cbApplyGammaTableUnchecked(R[i])];
+                    g = cbGammaDecodeTable[cbApplyGammaTableUnchecked(G[i])];
+                    b = cbGammaDecodeTable[cbApplyGammaTableUnchecked(B[i])];
+                } else {
+                    r = R[i] > 0.f ? R[i] < 1.f ? R[i] : 1.f : 0.f;
+                    g = G[i] > 0.f ? G[i] < 1.f ? G[i] : 1.f : 0.f;
+                    b = B[i] > 0.f ? B[i] < 1.f ? B[i] : 1.f : 0.f;
+                }
+                Map->Luminance[Row + i] = Map->Lightest[Row + i] = Map->Darkest[Row + i] = cbLUMINANCE(r, g, b);
+            }
+        }
+        size_t Row = (size_t)y0 * Width;
+        cbSlidingExtremes(Map->Lightest + Row, Map->Darkest + Row, Width, 1, Lines, Width, Radius, Work);
+        cbSlidingExtremes(ColourMax + Row, ColourMin + Row, Width, 1, Lines, Width, Radius, Work);
+    }
+    for(int x = 0; x < Width; x += cbCONTRAST_STRIP) {
+        int Lines = Width - x < cbCONTRAST_STRIP ? Width - x : cbCONTRAST_STRIP;
+        cbSlidingExtremes(Map->Lightest + x, Map->Darkest + x, Height, Width, Lines, 1, Radius, Work);
+        cbSlidingExtremes(ColourMax + x, ColourMin + x, Height, Width, Lines, 1, Radius, Work);
+    }
+
+    Map->Edges = 0;
+    for(int g = 0; g < cgGuidelineCount; ++g) {
+        Map->Stats[g].Failures = 0, Map->Stats[g].Worst = 0.f;
+        Map->Stats[g].WorstX = Map->Stats[g].WorstY = -1;
+    }
+    for(int y = 0; y < Height; ++y)
+    for(int x = 0; x < Width; ++x) {
+        size_t i = (size_t)y * Width + x;
+        unsigned char Mask = 0;
+        if(ColourMax[i] != ColourMin[i]) {
+            float Lightest = Map->Lightest[i], Darkest = Map->Darkest[i], Score;
+            Mask = cbCONTRAST_EDGE;
+            ++Map->Edges;
+#define COL_GUIDELINE(source, testname, rating, comparison, value) { \
+            cb_contrast_stats *Stats = &Map->Stats[cb## source ##_## testname ##_## rating]; \
+            Score = cb## testname ##Luminance(Lightest, Darkest); \
+            if(! (Score comparison value)) { \
+                Mask |= 1 << cb## source ##_## testname ##_## rating; \
+                ++Stats->Failures; \
+            } \
+            if(Stats->WorstX < 0 || Score < Stats->Worst) { Stats->Worst = Score, Stats->WorstX = x, Stats->WorstY = y; } \
+            }
+            COL_GUIDELINES
+#undef COL_GUIDELINE
+        }
+        Map->Mask[i] = Mask;
+    }
+    cbFREE(ColourMax), cbFREE(ColourMin), cbFREE(Work);
+    return Map;
+}
+
+void cbContrastMapDestroy(cb_contrast_map *Map) {
+    if(! Map) { return; }
+    cbFREE(Map->Luminance);
+    cbFREE(Map->Lightest);
+    cbFREE(Map->Darkest);
+    cbFREE(Map->Mask);
+    cbFREE(Map);
+}
+
+void cbContrastMapScores(cb_contrast_map *Map, cb_guideline Guideline, float *Scores) {
+    size_t Count = (size_t)Map->Width * Map->Height;
+    switch(Guideline) {
+#define COL_GUIDELINE(source, testname, rating, comparison, value) \
+        case cb## source ##_## testname ##_## rating: \
+            for(size_t i = 0; i < Count; ++i) { Scores[i] = cb## testname ##Luminance(Map->Lightest[i], Map->Darkest[i]); } \
+            break;
+        COL_GUIDELINES
+#undef COL_GUIDELINE
+        default: break;
+    }
+}
+
+/******************************************************************************
+ * Guideline repair
+ ******************/
+#include <math.h> /* cbrtf */
+#define cbREPAIR_SCAN  32 /* steps along the mix */
+#define cbREPAIR_STEPS 12 /* bisections within a step, to about 1/131072 of the mix */
+/* the impairments a repair has to pass under: unimpaired and the dichromacies, but not the (rare) monochromacies,
+ * which would reject colours that every dichromat can read */
+#define cbREPAIR_IMPAIRMENTS (cbTritanopia + 1)
+
+/* luminance of a colour after going through the same steps as RGB255Gamma (with clamping) */
+static float cbSimulatedLuminance(float *M, float R, float G, float B) {
+    float Rs = M[0]*R + M[1]*G + M[2]*B;
+    float Gs = M[3]*R + M[4]*G + M[5]*B;
+    float Bs = M[6]*R + M[7]*G + M[8]*B;
+    return cbLUMINANCE(cbGammaDecodeTable[cbApplyGammaTableUnchecked(Rs)],
+                       cbGammaDecodeTable[cbApplyGammaTableUnchecked(Gs)],
+                       cbGammaDecodeTable[cbApplyGammaTableUnchecked(Bs)]);
+}
+
+/* CIE L*, for judging which result is closer */
+static float cbLightness(float Y)
+{ return Y > 216.f/24389.f ? 116.f * cbrtf(Y) - 16.f : Y * 24389.f/27.f; }
+
+typedef struct cb_repair {
+    cb_guideline Guideline;
+    float FixedLuminance[cbREPAIR_IMPAIRMENTS];
+    float Linear[3], Target;
+} cb_repair;
+
+/* quantises the candidate mixed Amount of the way towards the target, and checks it under each impairment */
+static int cbRepairPasses(cb_repair *Repair, float Amount, cb_rgb_255 *Colour) {
+    unsigned char C[3];
+    float Linear[3];
+    for(int c = 0; c < 3; ++c) {
+        C[c]      = cbApplyGammaTableUnchecked(Repair->Linear[c] + Amount * (Repair->Target - Repair->Linear[c]));
+        Linear[c] = cbGammaDecodeTable[C[c]];
+    }
+    Colour->R = C[0], Colour->G = C[1], Colour->B = C[2];
+    for(int Impairment = 0; Impairment < cbREPAIR_IMPAIRMENTS; ++Impairment) {
+        float Luminance = cbSimulatedLuminance(cbImpairmentMatrices[Impairment], Linear[0], Linear[1], Linear[2]);
+        if(! cbGuidelinePassLuminance(Repair->Guideline, Repair->FixedLuminance[Impairment], Luminance)) { return 0; }
+    }
+    return 1;
+}
+
+int cbNearestPassingRGB255(cb_rgb_255 Fixed, cb_rgb_255 Candidate, cb_guideline Guideline, cb_rgb_255 *Result) {
+    cbInitGammaTables();
+    cb_repair Repair;
+    Repair.Guideline = Guideline;
+    Repair.Linear[0] = cbGammaDecodeTable[Candidate.R];
+    Repair.Linear[1] = cbGammaDecodeTable[Candidate.G];
+    Repair.Linear[2] = cbGammaDecodeTable[Candidate.B];
+    for(int Impairment = 0; Impairment < cbREPAIR_IMPAIRMENTS; ++Impairment) {
+        Repair.FixedLuminance[Impairment] = cbSimulatedLuminance(cbImpairmentMatrices[Impairment],
+            cbGammaDecodeTable[Fixed.R], cbGammaDecodeTable[Fixed.G], cbGammaDecodeTable[Fixed.B]);
+    }
+
+    Repair.Target = 0.f; /* unused at 0, but 0 * garbage can still be NaN */
+    if(cbRepairPasses(&Repair, 0.f, Result)) { return 1; }
+
+    float CandidateLightness = cbLightness(cbLUMINANCE(Repair.Linear[0], Repair.Linear[1], Repair.Linear[2]));
+    float BestDifference = -1.f;
+    for(int Direction = 0; Direction < 2; ++Direction) {
+        cb_rgb_255 Colour;
+        Repair.Target = (float)Direction; /* black, then white */
+        if(! cbRepairPasses(&Repair, 1.f, &Colour)) { continue; }
+
+        /* Passing isn't monotonic in the mix: the contrast against a mid-luminance colour dips and then rises again,
+         * at a different point for each impairment. So step out to the first passing amount, then bisect within
+         * that step, keeping Lo failing and Hi passing (a passing window narrower than a step can be missed). */
+        float Lo = 0.f, Hi = 1.f;
+        for(int Step = 1; Step < cbREPAIR_SCAN; ++Step) {
+            float Amount = (float)Step / cbREPAIR_SCAN;
+            cb_rgb_255 StepColour;
+            if(cbRepairPasses(&Repair, Amount, &StepColour)) { Hi = Amount, Colour = StepColour; break; }
+            Lo = Amount;
+        }
+        for(int Step = 0; Step < cbREPAIR_STEPS; ++Step) {
+            float Mid = 0.5f * (Lo + Hi);
+            cb_rgb_255 MidColour;
+            if(cbRepairPasses(&Repair, Mid, &MidColour)) { Hi = Mid, Colour = MidColour; }
+            else                                         { Lo = Mid; }
+        }
+
+        float Y = cbLUMINANCE(cbGammaDecodeTable[Colour.R], cbGammaDecodeTable[Colour.G], cbGammaDecodeTable[Colour.B]);
+        float Difference = fabsf(cbLightness(Y) - CandidateLightness);
+        if(BestDifference < 0.f || Difference < BestDifference) {
+            BestDifference = Difference;
+            *Result = Colour;
+        }
+    }
+    return BestDifference >= 0.f;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif/* cbIMPLEMENTATION */
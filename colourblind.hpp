@@ -0,0 +1,300 @@
+/* ISC License Copyright (c) 2018 Andrew Reece
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* C++14 interface to the colourblindness simulations in colourblind.h.
+ * The impairment and gamma mode are template parameters, so each function inlines to a single
+ * matrix multiply with no dispatch. Its matrices are composed at compile time from the colour-space
+ * and LMS matrices (as described in colourblind.glsl), so a new one only needs its LMS projection
+ * adding here; static_asserts check that colourblind.h's hand-written table still agrees with them.
+ *
+ * The simulation functions are header-only; the luminance and contrast wrappers call the C
+ * functions, so need cbIMPLEMENTATION defined in one file. The struct versions work with
+ * cb_rgb/cb_rgb_255, or any other struct with R, G & B members.
+ */
+#ifndef COLOURBLIND_HPP
+#define COLOURBLIND_HPP
+
+#include <cmath> /* pow, sqrt */
+#include "colourblind.h"
+
+#ifdef I_PREFER_THE_AMERICAN_SPELLING_OF_COLOR_BECAUSE_I_AM_SILLY
+#define Colo_rblindRGB255Gamma ColorblindRGB255Gamma
+#else
+#define Colo_rblindRGB255Gamma ColourblindRGB255Gamma
+#endif/*I_PREFER_THE_AMERICAN_SPELLING_OF_COLOR_BECAUSE_I_AM_SILLY*/
+
+namespace cb {
+
+enum impairment {
+    Unimpaired           = cbUnimpaired,
+    Protanopia           = cbProtanopia,
+    Deuteranopia         = cbDeuteranopia,
+    Tritanopia           = cbTritanopia,
+    Achromatopsia        = cbAchromatopsia,
+    BlueConeMonochromacy = cbBlueConeMonochromacy,
+    ImpairmentCount      = cbImpairmentCount,
+};
+/* the default curves, cbGAMMA_FAST and cbGAMMA_FASTER respectively */
+enum gamma { GammaAccurate, GammaFast, GammaFaster };
+
+/******************************************************************************
+ * Matrices
+ **********/
+/* Row-major, so that e.g. Red = M[0]*R + M[1]*G + M[2]*B */
+struct matrix { double M[9]; };
+
+constexpr matrix Multiply(matrix A, matrix B) {
+    matrix Result = {};
+    for(int Row = 0; Row < 3; ++Row)
+    for(int Col = 0; Col < 3; ++Col)
+    for(int i = 0; i < 3; ++i)
+    { Result.M[3*Row + Col] += A.M[3*Row + i] * B.M[3*i + Col]; }
+    return Result;
+}
+
+constexpr matrix Inverse(matrix A) {
+    const double *M = A.M;
+    matrix Adjugate = {{
+        M[4]*M[8] - M[5]*M[7],  M[2]*M[7] - M[1]*M[8],  M[1]*M[5] - M[2]*M[4],
+        M[5]*M[6] - M[3]*M[8],  M[0]*M[8] - M[2]*M[6],  M[2]*M[3] - M[0]*M[5],
+        M[3]*M[7] - M[4]*M[6],  M[1]*M[6] - M[0]*M[7],  M[0]*M[4] - M[1]*M[3],
+    }};
+    double Determinant = M[0]*Adjugate.M[0] + M[1]*Adjugate.M[3] + M[2]*Adjugate.M[6];
+    for(int i = 0; i < 9; ++i) { Adjugate.M[i] /= Determinant; }
+    return Adjugate;
+}
+
+constexpr matrix Identity = {{ 1, 0, 0,  0, 1, 0,  0, 0, 1 }};
+
+/* Linear sRGB to XYZ (D65) */
+constexpr matrix XYZFromRGB = {{
+    0.4124564, 0.3575761, 0.1804375,
+    0.2126729, 0.7151522, 0.0721750,
+    0.0193339, 0.1191920, 0.9503041,
+}};
+/* Hunt-Pointer-Estevez, normalised to D65 */
+constexpr matrix LMSFromXYZ = {{
+     0.4002, 0.7076, -0.0808,
+    -0.2263, 1.1653,  0.0457,
+     0,      0,       0.9182,
+}};
+constexpr matrix LMSFromRGB = Multiply(LMSFromXYZ, XYZFromRGB);
+constexpr matrix RGBFromLMS = Inverse(LMSFromRGB);
+
+/* Each dichromat's missing cone response, reconstructed from the other two */
+constexpr matrix ProtanopiaLMS = {{
+    0, 1.05118294, -0.05116099,
+    0, 1,           0,
+    0, 0,           1,
+}};
+constexpr matrix DeuteranopiaLMS = {{
+    1,         0, 0,
+    0.9513092, 0, 0.04866992,
+    0,         0, 1,
+}};
+constexpr matrix TritanopiaLMS = {{
+     1,          0,          0,
+     0,          1,          0,
+    -0.86744736, 1.86727089, 0,
+}};
+
+/* Every channel becomes the luminance (as in cbLuminance) */
+constexpr matrix AchromatopsiaRGB = {{
+    0.2126, 0.7152, 0.0722,
+    0.2126, 0.7152, 0.0722,
+    0.2126, 0.7152, 0.0722,
+}};
+/* Every channel becomes the S cone response, scaled so that white stays white */
+constexpr matrix BlueConeMonochromacyRGB() {
+    const double *S = LMSFromRGB.M + 6;
+    double Scale = 1 / (S[0] + S[1] + S[2]);
+    return {{ S[0]*Scale, S[1]*Scale, S[2]*Scale,
+              S[0]*Scale, S[1]*Scale, S[2]*Scale,
+              S[0]*Scale, S[1]*Scale, S[2]*Scale }};
+}
+
+constexpr matrix LMSSimulationMatrix(impairment Impairment) {
+    return Impairment == Protanopia   ? ProtanopiaLMS   :
+           Impairment == Deuteranopia ? DeuteranopiaLMS :
+           Impairment == Tritanopia   ? TritanopiaLMS   : Identity;
+}
+/* RGB -> LMS -> simulated LMS -> RGB */
+constexpr matrix SimulationMatrix(impairment Impairment) {
+    return Impairment == Achromatopsia        ? AchromatopsiaRGB         :
+           Impairment == BlueConeMonochromacy ? BlueConeMonochromacyRGB() :
+           Impairment == Unimpaired || Impairment >= ImpairmentCount ? Identity :
+           Multiply(RGBFromLMS, Multiply(LMSSimulationMatrix(Impairment), LMSFromRGB));
+}
+
+/* The matrices the functions below use, rounded to float */
+struct float_matrices { float M[ImpairmentCount][9]; };
+constexpr float_matrices ComposeMatrices() {
+    float_matrices Result = {};
+    for(int Impairment = 0; Impairment < ImpairmentCount; ++Impairment)
+    for(int i = 0; i < 9; ++i)
+    { Result.M[Impairment][i] = (float)SimulationMatrix((impairment)Impairment).M[i]; }
+    return Result;
+}
+constexpr float_matrices ComposedMatrices = ComposeMatrices();
+constexpr const float (&Matrices)[ImpairmentCount][9] = ComposedMatrices.M;
+
+/* colourblind.h's table, which its own functions use */
+constexpr float CMatrices[ImpairmentCount][9] = cbIMPAIRMENT_MATRICES;
+constexpr bool MatchesComposed(impairment Impairment) {
+    for(int i = 0; i < 9; ++i) {
+        double Difference = (double)Matrices[Impairment][i] - CMatrices[Impairment][i];
+        if(Difference > 1e-7 || Difference < -1e-7) { return false; }
+    }
+    return true;
+}
+static_assert(MatchesComposed(Protanopia),           "Protanopia matrix in colourblind.h differs from the composed one");
+static_assert(MatchesComposed(Deuteranopia),         "Deuteranopia matrix in colourblind.h differs from the composed one");
+static_assert(MatchesComposed(Tritanopia),           "Tritanopia matrix in colourblind.h differs from the composed one");
+static_assert(MatchesComposed(Achromatopsia),        "Achromatopsia matrix in colourblind.h differs from the composed one");
+static_assert(MatchesComposed(BlueConeMonochromacy), "Blue cone monochromacy matrix in colourblind.h differs from the composed one");
+
+/******************************************************************************
+ * Gamma
+ *******/
+/* These do the same calculations as the C macros, so give identical results */
+template<gamma Gamma> inline float RemoveGammaComponent(float X);
+template<gamma Gamma> inline float ApplyGammaComponent(float X);
+
+template<> inline float RemoveGammaComponent<GammaAccurate>(float X)
+{ return (float)(X > 0.04045 ? std::pow((X + 0.055) / 1.055, 2.4) : X / 12.92); }
+template<> inline float ApplyGammaComponent<GammaAccurate>(float X)
+{ return (float)(X > 0.00313080495356037151702786377709 ? 1.055 * std::pow((double)X, 0.4166666666) - 0.055 : X * 12.92); }
+
+template<> inline float RemoveGammaComponent<GammaFast>(float X)
+{ return (float)std::pow((double)X, 2.2); }
+template<> inline float ApplyGammaComponent<GammaFast>(float X)
+{ return (float)std::pow((double)X, 0.454545454545454545454545454545454545454545); }
+
+template<> inline float RemoveGammaComponent<GammaFaster>(float X)
+{ return X * X; }
+template<> inline float ApplyGammaComponent<GammaFaster>(float X)
+{ return (float)std::sqrt((double)X); }
+
+inline float         NormComponent(unsigned char X) { return (float)X / 255.f; }
+/* saturates, as cbDenorm does */
+inline unsigned char DenormComponent(float X)
+{ return X <= 0 ? 0 : X >= 1 ? 255 : (unsigned char)(X * 255.f + 0.5f); }
+
+/******************************************************************************
+ * Colourblindness
+ *****************/
+/* assumes values in 0-1 */
+template<impairment Impairment>
+inline void Colo_rblind(float *Red, float *Green, float *Blue) {
+    if(Impairment == Unimpaired) { return; }
+    const float *M = Matrices[Impairment];
+    float R = *Red, G = *Green, B = *Blue;
+    *Red   = M[0]*R + M[1]*G + M[2]*B;
+    *Green = M[3]*R + M[4]*G + M[5]*B;
+    *Blue  = M[6]*R + M[7]*G + M[8]*B;
+}
+
+template<impairment Impairment>
+inline void Colo_rblind255(unsigned char *R, unsigned char *G, unsigned char *B) {
+    float Rf = NormComponent(*R), Gf = NormComponent(*G), Bf = NormComponent(*B);
+    Colo_rblind<Impairment>(&Rf, &Gf, &Bf);
+    *R = DenormComponent(Rf);
+    *G = DenormComponent(Gf);
+    *B = DenormComponent(Bf);
+}
+
+/* assumes values in 0-1 */
+template<impairment Impairment, typename rgb>
+inline rgb Colo_rblindRGB(rgb RGB) {
+    Colo_rblind<Impairment>(&RGB.R, &RGB.G, &RGB.B);
+    return RGB;
+}
+
+/* take and return rgb as 0-255 */
+template<impairment Impairment, typename rgb_255>
+inline rgb_255 Colo_rblindRGB255(rgb_255 RGB) {
+    Colo_rblind255<Impairment>(&RGB.R, &RGB.G, &RGB.B);
+    return RGB;
+}
+
+/* take and return gamma-corrected rgb as 0-255 */
+template<impairment Impairment, gamma Gamma = GammaAccurate, typename rgb_255>
+inline rgb_255 Colo_rblindRGB255Gamma(rgb_255 RGB) {
+    if(Impairment == Unimpaired) { return RGB; }
+    float R = RemoveGammaComponent<Gamma>(NormComponent(RGB.R)),
+          G = RemoveGammaComponent<Gamma>(NormComponent(RGB.G)),
+          B = RemoveGammaComponent<Gamma>(NormComponent(RGB.B));
+    Colo_rblind<Impairment>(&R, &G, &B);
+    RGB.R = DenormComponent(ApplyGammaComponent<Gamma>(R));
+    RGB.G = DenormComponent(ApplyGammaComponent<Gamma>(G));
+    RGB.B = DenormComponent(ApplyGammaComponent<Gamma>(B));
+    return RGB;
+}
+
+/******************************************************************************
+ * Luminance & contrast
+ **********************/
+/* These call the C functions (see colourblind.h) with any struct with R, G & B members */
+template<typename rgb>
+inline float LuminanceRGB(rgb RGB) { return cbLuminance(RGB.R, RGB.G, RGB.B); }
+template<typename rgb_255>
+inline float LuminanceRGB255(rgb_255 RGB) { return cbLuminance255(RGB.R, RGB.G, RGB.B); }
+
+template<typename rgb>
+inline float ContrastRGB(rgb A, rgb B) { return cbContrast(A.R, A.G, A.B, B.R, B.G, B.B); }
+template<typename rgb_255>
+inline float ContrastRGB255(rgb_255 A, rgb_255 B) { return cbContrast255(A.R, A.G, A.B, B.R, B.G, B.B); }
+
+template<typename rgb>
+inline float ContrastModulationRGB(rgb A, rgb B) { return cbContrastModulation(A.R, A.G, A.B, B.R, B.G, B.B); }
+template<typename rgb_255>
+inline float ContrastModulationRGB255(rgb_255 A, rgb_255 B) { return cbContrastModulation255(A.R, A.G, A.B, B.R, B.G, B.B); }
+
+template<typename rgb>
+inline float ContrastRatioRGB(rgb A, rgb B) { return cbContrastRatio(A.R, A.G, A.B, B.R, B.G, B.B); }
+template<typename rgb_255>
+inline float ContrastRatioRGB255(rgb_255 A, rgb_255 B) { return cbContrastRatio255(A.R, A.G, A.B, B.R, B.G, B.B); }
+
+template<typename rgb>
+inline float LightnessContrastRGB(rgb A, rgb B) { return cbLightnessContrast(A.R, A.G, A.B, B.R, B.G, B.B); }
+template<typename rgb_255>
+inline float LightnessContrastRGB255(rgb_255 A, rgb_255 B) { return cbLightnessContrast255(A.R, A.G, A.B, B.R, B.G, B.B); }
+
+/* Calls Fn with a tag holding a compile-time impairment (as value) chosen from a runtime one,
+ * so the switch can be hoisted out of a loop that uses the templates above. e.g.:
+ *     cb::Specialise(Impairment, [&](auto Tag) {
+ *         for(int i = 0; i < Count; ++i) { Pixels[i] = cb::ColourblindRGB255Gamma<decltype(Tag)::value>(Pixels[i]); }
+ *     });
+ */
+template<impairment Impairment> struct impairment_tag { static constexpr impairment value = Impairment; };
+template<impairment Impairment> constexpr impairment impairment_tag<Impairment>::value;
+
+template<typename fn>
+inline void Specialise(impairment Impairment, fn Fn) {
+    switch(Impairment) {
+        case Protanopia:   Fn(impairment_tag<Protanopia>());   break;
+        case Deuteranopia: Fn(impairment_tag<Deuteranopia>()); break;
+        case Tritanopia:   Fn(impairment_tag<Tritanopia>());   break;
+        case Achromatopsia:        Fn(impairment_tag<Achromatopsia>());        break;
+        case BlueConeMonochromacy: Fn(impairment_tag<BlueConeMonochromacy>()); break;
+        default:           Fn(impairment_tag<Unimpaired>());
+    }
+}
+
+} /* namespace cb */
+
+#undef Colo_rblindRGB255Gamma
+
+#endif/*COLOURBLIND_HPP*/
@@ -0,0 +1,553 @@
+/* Audits the colours in design-token and stylesheet files for contrast under every impairment.
+ *
+ * usage: colourblind_audit [-j threads] [-g guideline] [-i impairment] path...
+ *     path        files, or directories to search for .json, .css, .scss, .sass and .less files
+ *     -j          number of threads (including the main one); defaults to one per CPU
+ *     -g          only check this guideline (e.g. "WCAG Contrast AA", or its cb_guideline number)
+ *     -i          only check this impairment (e.g. deuteranopia, or its cb_impairment number)
+ *
+ * Every block ({ ... } in CSS or JSON) that declares both a foreground colour (color, foreground, fg, text...)
+ * and a background colour (background, background-color, bg...) is a pair. Token formats that nest the value,
+ * like "foreground": { "$value": "#fff" }, count too. Colours can be #rgb, #rgba, #rrggbb, #rrggbbaa, rgb() or
+ * rgba(); a translucent foreground is blended over its background first, and the background's alpha is ignored.
+ *
+ * Files are memory-mapped and scanned in parallel on the library's thread pool. Each distinct colour is then
+ * simulated once per impairment (as in ColourblindImageGamma), and every pair is checked against every
+ * guideline in COL_GUIDELINES under every impairment. Failures go to stdout, worst first (by score relative to
+ * what the guideline needs), one line per pair and guideline with the impairment it does worst under:
+ *     file:line: #fg on #bg fails <guideline> under <impairment> (score, needs >= value; fails under n impairments)
+ * A summary goes to stderr. Exits with 1 if anything failed, or 2 for usage and file errors.
+ *
+ * build: cc -O2 -o colourblind_audit examples/colourblind_audit.c -lm -pthread
+ */
+#define _DEFAULT_SOURCE /* madvise, nftw */
+#define _XOPEN_SOURCE 700
+#include <ctype.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define cbTHREADS
+#define cbIMPLEMENTATION
+#include "../colourblind.h"
+
+#define MAX_DEPTH 64 /* deeper blocks are scanned but can't hold pairs */
+
+/* colours are packed as 0xRRGGBBAA */
+typedef struct pair {
+    unsigned int Foreground, Background;
+    int Line;
+} pair;
+
+typedef struct file {
+    char *Path;
+    pair *Pairs;
+    int PairCount, PairCapacity;
+    long Colours; /* literals of any kind */
+    size_t Size;
+    int Error;
+} file;
+
+typedef struct audit {
+    file *Files;
+    int FileCount, FileCapacity;
+} audit;
+
+/******************************************************************************
+ * Finding files
+ ***************/
+static audit *Audit; /* for nftw's callback */
+
+static int HasTokenExtension(const char *Path) {
+    static const char *Extensions[] = { ".json", ".css", ".scss", ".sass", ".less" };
+    const char *Dot = strrchr(Path, '.');
+    if(! Dot || strchr(Dot, '/')) { return 0; }
+    for(size_t i = 0; i < sizeof(Extensions) / sizeof(*Extensions); ++i) {
+        if(! strcasecmp(Dot, Extensions[i])) { return 1; }
+    }
+    return 0;
+}
+
+static int AddFile(const char *Path) {
+    if(Audit->FileCount == Audit->FileCapacity) {
+        int Capacity = Audit->FileCapacity ? 2 * Audit->FileCapacity : 1024;
+        file *Files = realloc(Audit->Files, sizeof(file) * Capacity);
+        if(! Files) { return 0; }
+        Audit->Files = Files, Audit->FileCapacity = Capacity;
+    }
+    file *File = &Audit->Files[Audit->FileCount];
+    memset(File, 0, sizeof(*File));
+    if(! (File->Path = strdup(Path))) { return 0; }
+    ++Audit->FileCount;
+    return 1;
+}
+
+static int VisitFile(const char *Path, const struct stat *Info, int Type, struct FTW *Walk) {
+    (void)Info, (void)Walk;
+    if(Type == FTW_F && HasTokenExtension(Path) && ! AddFile(Path)) { return 1; }
+    return 0;
+}
+
+/******************************************************************************
+ * Scanning
+ **********/
+enum { PropertyNone, PropertyForeground, PropertyBackground, PropertyValue };
+
+typedef struct block {
+    unsigned int Colours[2]; /* foreground and background */
+    int Lines[2];            /* 0 until declared */
+    int Inherit;             /* the property this block is the value of, for nested tokens */
+} block;
+
+/* property names are compared without case, dashes or underscores */
+static int ClassifyProperty(const char *Name, int Length) {
+    static const char *Foregrounds[] = { "color", "colour", "foreground", "foregroundcolor", "foregroundcolour",
+                                         "fg", "text", "textcolor", "textcolour" };
+    static const char *Backgrounds[] = { "background", "backgroundcolor", "backgroundcolour", "bg" };
+    char Key[32];
+    int KeyLength = 0;
+    for(int i = 0; i < Length && KeyLength < (int)sizeof(Key) - 1; ++i) {
+        if(Name[i] != '-' && Name[i] != '_' && Name[i] != '$') { Key[KeyLength++] = (char)tolower((unsigned char)Name[i]); }
+    }
+    Key[KeyLength] = '\0';
+    for(size_t i = 0; i < sizeof(Foregrounds) / sizeof(*Foregrounds); ++i) {
+        if(! strcmp(Key, Foregrounds[i])) { return PropertyForeground; }
+    }
+    for(size_t i = 0; i < sizeof(Backgrounds) / sizeof(*Backgrounds); ++i) {
+        if(! strcmp(Key, Backgrounds[i])) { return PropertyBackground; }
+    }
+    return ! strcmp(Key, "value") ? PropertyValue : PropertyNone;
+}
+
+static int HexDigit(int C) {
+    return C >= '0' && C <= '9' ? C - '0' : C >= 'a' && C <= 'f' ? C - 'a' + 10 : C >= 'A' && C <= 'F' ? C - 'A' + 10 : -1;
+}
+
+/* parses #rgb, #rgba, #rrggbb or #rrggbbaa at P (just after the #), returning its length or 0 */
+static size_t ParseHex(const unsigned char *P, const unsigned char *End, unsigned int *Colour) {
+    size_t Length = 0;
+    while(P + Length < End && HexDigit(P[Length]) >= 0) { ++Length; }
+    if(P + Length < End && (isalnum(P[Length]) || P[Length] == '_' || P[Length] == '-')) { return 0; }
+    unsigned int Value = 0;
+    switch(Length) {
+        case 3: case 4:
+            for(size_t i = 0; i < Length; ++i) { Value = Value << 8 | (unsigned int)HexDigit(P[i]) * 17; }
+            if(Length == 3) { Value = Value << 8 | 0xFF; }
+            break;
+        case 6: case 8:
+            for(size_t i = 0; i < Length; ++i) { Value = Value << 4 | (unsigned int)HexDigit(P[i]); }
+            if(Length == 6) { Value = Value << 8 | 0xFF; }
+            break;
+        default: return 0;
+    }
+    *Colour = Value;
+    return Length;
+}
+
+/* parses the arguments of rgb() or rgba() at P (just after the bracket), returning their length or 0.
+ * Components can be 0-255 or percentages, and alpha 0-1 or a percentage, separated by commas or spaces. */
+static size_t ParseRGB(const unsigned char *P, const unsigned char *End, unsigned int *Colour) {
+    const unsigned char *Start = P;
+    float Values[4] = { 0.f, 0.f, 0.f, 1.f };
+    int Count = 0;
+    while(P < End && *P != ')') {
+        if(*P == ',' || *P == '/' || isspace(*P)) { ++P; continue; }
+        char Number[32];
+        int Length = 0;
+        while(P < End && (isdigit(*P) || *P == '.' || *P == '-') && Length < (int)sizeof(Number) - 1) { Number[Length++] = (char)*P++; }
+        if(! Length || Count == 4) { return 0; }
+        Number[Length] = '\0';
+        float Value = (float)atof(Number);
+        if(P < End && *P == '%') { Value *= Count < 3 ? 2.55f : 0.01f, ++P; }
+        Values[Count++] = Value;
+    }
+    if(P == End || Count < 3) { return 0; }
+    unsigned int Packed = 0;
+    for(int i = 0; i < 4; ++i) {
+        float Value = i < 3 ? Values[i] : Values[i] * 255.f;
+        Value = Value < 0.f ? 0.f : Value > 255.f ? 255.f : Value;
+        Packed = Packed << 8 | (unsigned int)(Value + 0.5f);
+    }
+    *Colour = Packed;
+    return (size_t)(P + 1 - Start);
+}
+
+/* parses a colour literal starting at P, returning its length or 0 */
+static size_t ParseColour(const unsigned char *P, const unsigned char *End, unsigned int *Colour) {
+    if(*P == '#') {
+        size_t Length = ParseHex(P + 1, End, Colour);
+        return Length ? Length + 1 : 0;
+    }
+    if(End - P > 4 && ! strncasecmp((const char *)P, "rgb", 3)) {
+        const unsigned char *Bracket = P + 3 + (P[3] == 'a' || P[3] == 'A');
+        size_t Length = *Bracket == '(' ? ParseRGB(Bracket + 1, End, Colour) : 0;
+        return Length ? (size_t)(Bracket + 1 - P) + Length : 0;
+    }
+    return 0;
+}
+
+static int AddPair(file *File, unsigned int Foreground, unsigned int Background, int Line) {
+    if(File->PairCount == File->PairCapacity) {
+        int Capacity = File->PairCapacity ? 2 * File->PairCapacity : 16;
+        pair *Pairs = realloc(File->Pairs, sizeof(pair) * Capacity);
+        if(! Pairs) { return 0; }
+        File->Pairs = Pairs, File->PairCapacity = Capacity;
+    }
+    pair Pair = { Foreground, Background, Line };
+    File->Pairs[File->PairCount++] = Pair;
+    return 1;
+}
+
+typedef struct scanner {
+    file *File;
+    block Blocks[MAX_DEPTH + 1];
+    int Depth, Line, Property, Expecting;
+    const unsigned char *Name;
+    int NameLength;
+} scanner;
+
+/* gives a colour to the property being declared, or to the enclosing block's if this is a nested value */
+static void AssignColour(scanner *Scan, unsigned int Colour) {
+    ++Scan->File->Colours;
+    if(! Scan->Expecting || Scan->Depth > MAX_DEPTH) { return; }
+    Scan->Expecting = 0;
+    block *Block = &Scan->Blocks[Scan->Depth];
+    int Property = Scan->Property;
+    if(Property == PropertyValue && Scan->Depth > 0 && Block->Inherit) { Property = Block->Inherit, --Block; }
+    if(Property == PropertyForeground || Property == PropertyBackground) {
+        int Slot = Property == PropertyBackground;
+        Block->Colours[Slot] = Colour, Block->Lines[Slot] = Scan->Line;
+    }
+}
+
+static void CloseBlock(scanner *Scan, block *Block) {
+    if(Block->Lines[0] && Block->Lines[1] && ! AddPair(Scan->File, Block->Colours[0], Block->Colours[1], Block->Lines[0]))
+    { Scan->File->Error = 1; }
+}
+
+static int IsNameCharacter(int C) { return isalnum(C) || C == '-' || C == '_' || C == '$' || C == '@'; }
+
+static void ScanText(file *File, const unsigned char *Text, size_t Size) {
+    scanner Scan;
+    memset(&Scan, 0, sizeof(Scan));
+    Scan.File = File, Scan.Line = 1;
+    const unsigned char *P = Text, *End = Text + Size;
+    while(P < End) {
+        unsigned char C = *P;
+        unsigned int Colour;
+        size_t Length;
+        if(C == '\n') { ++Scan.Line, ++P, Scan.Expecting = 0; continue; }
+
+        /* comments, but not the // in a url */
+        if(C == '/' && P + 1 < End && P[1] == '*') {
+            for(P += 2; P < End && ! (*P == '*' && P + 1 < End && P[1] == '/'); ++P) { Scan.Line += *P == '\n'; }
+            P = P < End ? P + 2 : End; /* unterminated comments run to the end */
+            continue;
+        }
+        if(C == '/' && P + 1 < End && P[1] == '/' && (P == Text || P[-1] != ':')) {
+            while(P < End && *P != '\n') { ++P; }
+            continue;
+        }
+
+        /* strings are either names (JSON keys) or values that may hold a colour */
+        if(C == '"' || C == '\'') {
+            const unsigned char *Start = ++P;
+            while(P < End && *P != C && *P != '\n') { P += *P == '\\' && P + 1 < End ? 2 : 1; }
+            if(! Scan.Expecting) { Scan.Name = Start, Scan.NameLength = (int)(P - Start); }
+            for(const unsigned char *Q = Start; Scan.Expecting && Q < P; ++Q) {
+                if((Q == Start || ! IsNameCharacter(Q[-1])) && (Length = ParseColour(Q, P, &Colour))) {
+                    AssignColour(&Scan, Colour);
+                    Q += Length - 1;
+                }
+            }
+            P += P < End;
+            continue;
+        }
+
+        if((Length = ParseColour(P, End, &Colour)) && (P == Text || ! IsNameCharacter(P[-1]))) {
+            AssignColour(&Scan, Colour);
+            P += Length;
+            continue;
+        }
+        if(IsNameCharacter(C)) {
+            const unsigned char *Start = P;
+            while(P < End && IsNameCharacter(*P)) { ++P; }
+            if(! Scan.Expecting) { Scan.Name = Start, Scan.NameLength = (int)(P - Start); }
+            continue;
+        }
+
+        switch(C) {
+            case ':':
+                Scan.Property  = Scan.Name ? ClassifyProperty((const char *)Scan.Name, Scan.NameLength) : PropertyNone;
+                Scan.Expecting = Scan.Property != PropertyNone;
+                break;
+            case '{':
+                if(++Scan.Depth <= MAX_DEPTH) {
+                    block *Block = &Scan.Blocks[Scan.Depth];
+                    memset(Block, 0, sizeof(*Block));
+                    if(Scan.Expecting && Scan.Property != PropertyValue) { Block->Inherit = Scan.Property; }
+                }
+                Scan.Expecting = 0, Scan.Name = 0;
+                break;
+            case '}':
+                if(Scan.Depth > 0 && Scan.Depth <= MAX_DEPTH) { CloseBlock(&Scan, &Scan.Blocks[Scan.Depth]); }
+                Scan.Depth -= Scan.Depth > 0;
+                Scan.Expecting = 0, Scan.Name = 0;
+                break;
+            case ';': case ',': case '[':
+                Scan.Expecting = 0, Scan.Name = 0;
+                break;
+        }
+        ++P;
+    }
+    /* pairs declared outside any block, e.g. in a flat token file */
+    CloseBlock(&Scan, &Scan.Blocks[0]);
+}
+
+static void ScanFile(void *Data, int Index) {
+    file *File = &((audit *)Data)->Files[Index];
+    int Fd = open(File->Path, O_RDONLY);
+    struct stat Info;
+    if(Fd < 0 || fstat(Fd, &Info) != 0) {
+        if(Fd >= 0) { close(Fd); }
+        File->Error = 1;
+        return;
+    }
+    File->Size = (size_t)Info.st_size;
+    if(File->Size) {
+        void *Map = mmap(0, File->Size, PROT_READ, MAP_PRIVATE, Fd, 0);
+        if(Map == MAP_FAILED) { File->Error = 1; }
+        else {
+            madvise(Map, File->Size, MADV_SEQUENTIAL);
+            ScanText(File, (const unsigned char *)Map, File->Size);
+            munmap(Map, File->Size);
+        }
+    }
+    close(Fd);
+}
+
+/******************************************************************************
+ * Checking
+ **********/
+typedef struct failure {
+    int File, Pair;
+    cb_guideline Guideline;
+    cb_impairment Impairment; /* the worst */
+    float Score, Relative;    /* the worst score, and it over what the guideline needs */
+    int Impairments;          /* how many it fails under */
+} failure;
+
+typedef struct checker {
+    audit *Audit;
+    unsigned int *Colours; /* sorted, distinct 0xRRGGBB */
+    int ColourCount;
+    float *Luminances;     /* [cbImpairmentCount][ColourCount] */
+    int Guideline, Impairment; /* -1 for all */
+    failure **Failures;    /* per file */
+    int *FailureCounts;
+} checker;
+
+/* a translucent foreground is blended over the background (in sRGB, as browsers do); the result is 0xRRGGBB */
+static unsigned int Blend(unsigned int Foreground, unsigned int Background) {
+    unsigned int Alpha = Foreground & 0xFF, Result = 0;
+    for(int Shift = 24; Shift >= 8; Shift -= 8) {
+        unsigned int F = (Foreground >> Shift) & 0xFF, B = (Background >> Shift) & 0xFF;
+        Result = Result << 8 | (F * Alpha + B * (255 - Alpha) + 127) / 255;
+    }
+    return Result;
+}
+
+static int CompareColours(const void *A, const void *B) {
+    unsigned int X = *(const unsigned int *)A, Y = *(const unsigned int *)B;
+    return X < Y ? -1 : X > Y;
+}
+
+static int FindColour(checker *Check, unsigned int Colour) {
+    unsigned int *Found = bsearch(&Colour, Check->Colours, Check->ColourCount, sizeof(unsigned int), CompareColours);
+    return (int)(Found - Check->Colours);
+}
+
+static void CheckFile(void *Data, int Index) {
+    checker *Check = (checker *)Data;
+    file *File = &Check->Audit->Files[Index];
+    int Capacity = 0, Count = 0;
+    failure *Failures = 0;
+    for(int p = 0; p < File->PairCount; ++p) {
+        pair *Pair = &File->Pairs[p];
+        int A = FindColour(Check, Blend(Pair->Foreground, Pair->Background)), B = FindColour(Check, Pair->Background >> 8);
+        failure PairFailures[cgGuidelineCount];
+        for(int g = 0; g < cgGuidelineCount; ++g) {
+            failure Failure = { Index, p, (cb_guideline)g, cbUnimpaired, 0.f, 0.f, 0 };
+            PairFailures[g] = Failure;
+        }
+        /* every guideline is scored in one pass per impairment */
+        for(int i = 0; i < cbImpairmentCount; ++i) {
+            if(Check->Impairment >= 0 && i != Check->Impairment) { continue; }
+            float *Luminances = Check->Luminances + (size_t)i * Check->ColourCount, Scores[cgGuidelineCount];
+            unsigned int Passed = cbGuidelinesLuminance(Luminances[A], Luminances[B], Scores);
+            for(int g = 0; g < cgGuidelineCount; ++g) {
+                failure *Failure = &PairFailures[g];
+                if(Passed & (1u << g) || (Check->Guideline >= 0 && g != Check->Guideline)) { continue; }
+                if(! Failure->Impairments++ || Scores[g] < Failure->Score) { Failure->Score = Scores[g], Failure->Impairment = (cb_impairment)i; }
+            }
+        }
+        for(int g = 0; g < cgGuidelineCount; ++g) {
+            failure Failure = PairFailures[g];
+            if(! Failure.Impairments) { continue; }
+            Failure.Relative = Failure.Score / cbGuidelineScores[g];
+            if(Count == Capacity) {
+                failure *Grown = realloc(Failures, sizeof(failure) * (Capacity = Capacity ? 2 * Capacity : 16));
+                if(! Grown) { File->Error = 1; break; }
+                Failures = Grown;
+            }
+            Failures[Count++] = Failure;
+        }
+    }
+    Check->Failures[Index] = Failures, Check->FailureCounts[Index] = Count;
+}
+
+static audit *SortAudit; /* for qsort's comparison */
+static int CompareFailures(const void *A, const void *B) {
+    const failure *X = (const failure *)A, *Y = (const failure *)B;
+    if(X->Relative != Y->Relative) { return X->Relative < Y->Relative ? -1 : 1; }
+    if(X->File != Y->File) { return strcmp(SortAudit->Files[X->File].Path, SortAudit->Files[Y->File].Path); }
+    int LineX = SortAudit->Files[X->File].Pairs[X->Pair].Line, LineY = SortAudit->Files[Y->File].Pairs[Y->Pair].Line;
+    if(LineX != LineY) { return LineX < LineY ? -1 : 1; }
+    return X->Guideline - Y->Guideline;
+}
+
+static void PrintColour(FILE *Out, unsigned int Colour) {
+    if((Colour & 0xFF) == 0xFF) { fprintf(Out, "#%06X", Colour >> 8); }
+    else                        { fprintf(Out, "#%08X", Colour); }
+}
+
+static int ParseName(char *Name, char **Names, int Count) {
+    for(int i = 0; i < Count; ++i) {
+        if(! strcasecmp(Name, Names[i])) { return i; }
+    }
+    char *End;
+    long Number = strtol(Name, &End, 10);
+    return *End == '\0' && Number >= 0 && Number < Count ? (int)Number : -1;
+}
+
+static double Now(void) {
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return Time.tv_sec + Time.tv_nsec * 1e-9;
+}
+
+int main(int ArgCount, char **Args) {
+    int Threads = 0, Guideline = -1, Impairment = -1, Arg = 1, Usage = 0;
+    for(; Arg < ArgCount && Args[Arg][0] == '-' && Args[Arg][1]; ++Arg) {
+        char *Option = Args[Arg];
+        if(Arg + 1 == ArgCount) { Usage = 1; break; }
+        if     (! strcmp(Option, "-j")) { Threads    = atoi(Args[++Arg]); }
+        else if(! strcmp(Option, "-g")) { Guideline  = ParseName(Args[++Arg], cbGuidelineStrings, cgGuidelineCount);  Usage |= Guideline < 0; }
+        else if(! strcmp(Option, "-i")) { Impairment = ParseName(Args[++Arg], cbImpairmentStrings, cbImpairmentCount); Usage |= Impairment < 0; }
+        else { Usage = 1; }
+    }
+    if(Usage || Arg == ArgCount) {
+        fprintf(stderr, "usage: %s [-j threads] [-g guideline] [-i impairment] path...\n", Args[0]);
+        return 2;
+    }
+
+    double Start = Now();
+    audit Files = { 0 };
+    Audit = &Files;
+    for(; Arg < ArgCount; ++Arg) {
+        struct stat Info;
+        if(stat(Args[Arg], &Info) != 0) { perror(Args[Arg]); return 2; }
+        int Added = S_ISDIR(Info.st_mode) ? nftw(Args[Arg], VisitFile, 64, FTW_PHYS) == 0 : AddFile(Args[Arg]);
+        if(! Added) { fprintf(stderr, "could not list %s\n", Args[Arg]); return 2; }
+    }
+
+    cb_pool *Pool = cbPoolCreate(Threads);
+    cbPoolFor(Pool, Files.FileCount, ScanFile, &Files);
+
+    /* simulate every distinct colour once, under every impairment in one pass */
+    checker Check = { &Files, 0, 0, 0, Guideline, Impairment, 0, 0 };
+    size_t PairCount = 0, Bytes = 0;
+    long Literals = 0;
+    int Errors = 0;
+    for(int f = 0; f < Files.FileCount; ++f) {
+        PairCount += (size_t)Files.Files[f].PairCount, Bytes += Files.Files[f].Size, Literals += Files.Files[f].Colours;
+        if(Files.Files[f].Error) { fprintf(stderr, "could not read %s\n", Files.Files[f].Path), ++Errors; }
+    }
+    Check.Colours = malloc(sizeof(unsigned int) * (2 * PairCount + 1));
+    Check.Failures = calloc((size_t)Files.FileCount + 1, sizeof(failure *));
+    Check.FailureCounts = calloc((size_t)Files.FileCount + 1, sizeof(int));
+    if(! Check.Colours || ! Check.Failures || ! Check.FailureCounts) { fprintf(stderr, "out of memory\n"); return 2; }
+    for(int f = 0; f < Files.FileCount; ++f)
+    for(int p = 0; p < Files.Files[f].PairCount; ++p) {
+        pair *Pair = &Files.Files[f].Pairs[p];
+        Check.Colours[Check.ColourCount++] = Blend(Pair->Foreground, Pair->Background);
+        Check.Colours[Check.ColourCount++] = Pair->Background >> 8;
+    }
+    qsort(Check.Colours, Check.ColourCount, sizeof(unsigned int), CompareColours);
+    int Distinct = 0;
+    for(int i = 0; i < Check.ColourCount; ++i) {
+        if(! Distinct || Check.Colours[i] != Check.Colours[Distinct - 1]) { Check.Colours[Distinct++] = Check.Colours[i]; }
+    }
+    Check.ColourCount = Distinct;
+
+    size_t N = (size_t)Distinct;
+    unsigned char *Pixels = malloc(3 * N + 1), *Simulated = malloc(cbImpairmentCount * 3 * N + 1);
+    Check.Luminances = malloc(sizeof(float) * cbImpairmentCount * N + 1);
+    if(! Pixels || ! Simulated || ! Check.Luminances) { fprintf(stderr, "out of memory\n"); return 2; }
+    cb_impairment Impairments[cbImpairmentCount];
+    unsigned char *Outputs[cbImpairmentCount];
+    for(size_t i = 0; i < N; ++i) {
+        Pixels[3*i] = (unsigned char)(Check.Colours[i] >> 16), Pixels[3*i + 1] = (unsigned char)(Check.Colours[i] >> 8);
+        Pixels[3*i + 2] = (unsigned char)Check.Colours[i];
+    }
+    for(int i = 0; i < cbImpairmentCount; ++i) { Impairments[i] = (cb_impairment)i, Outputs[i] = Simulated + i * 3 * N; }
+    if(N) { ColourblindImagesGammaThreaded(Pool, Impairments, cbImpairmentCount, Pixels, Distinct, 1, 3 * Distinct, cbRGB8, Outputs, 3 * Distinct); }
+    for(int i = 0; i < cbImpairmentCount; ++i)
+    for(size_t c = 0; c < N; ++c) {
+        unsigned char *RGB = Outputs[i] + 3 * c;
+        Check.Luminances[i * N + c] = cbLuminance255(RGB[0], RGB[1], RGB[2]);
+    }
+
+    cbPoolFor(Pool, Files.FileCount, CheckFile, &Check);
+
+    /* gather, sort and report the failures */
+    size_t FailureCount = 0;
+    for(int f = 0; f < Files.FileCount; ++f) { FailureCount += (size_t)Check.FailureCounts[f]; }
+    failure *Failures = malloc(sizeof(failure) * FailureCount + 1);
+    if(! Failures) { fprintf(stderr, "out of memory\n"); return 2; }
+    FailureCount = 0;
+    for(int f = 0; f < Files.FileCount; ++f) {
+        if(Check.FailureCounts[f]) { memcpy(Failures + FailureCount, Check.Failures[f], sizeof(failure) * Check.FailureCounts[f]); }
+        FailureCount += (size_t)Check.FailureCounts[f];
+    }
+    SortAudit = &Files;
+    qsort(Failures, FailureCount, sizeof(failure), CompareFailures);
+    for(size_t i = 0; i < FailureCount; ++i) {
+        failure *Failure = &Failures[i];
+        file *File = &Files.Files[Failure->File];
+        pair *Pair = &File->Pairs[Failure->Pair];
+        printf("%s:%d: ", File->Path, Pair->Line);
+        PrintColour(stdout, Pair->Foreground);
+        printf(" on ");
+        PrintColour(stdout, Pair->Background);
+        printf(" fails %s under %s (%.2f, needs >= %.2f; fails under %d impairment%s)\n",
+               cbGuidelineStrings[Failure->Guideline], cbImpairmentStrings[Failure->Impairment], Failure->Score,
+               cbGuidelineScores[Failure->Guideline], Failure->Impairments, Failure->Impairments == 1 ? "" : "s");
+    }
+    fflush(stdout);
+    fprintf(stderr, "%d files (%.1f MB), %ld colours, %zu pairs of %d distinct colours, %zu failures in %.2fs on %d threads\n",
+            Files.FileCount, Bytes / 1e6, Literals, PairCount, Distinct, FailureCount, Now() - Start, cbPoolThreadCount(Pool));
+
+    cbPoolDestroy(Pool);
+    for(int f = 0; f < Files.FileCount; ++f) { free(Files.Files[f].Path), free(Files.Files[f].Pairs), free(Check.Failures[f]); }
+    free(Files.Files), free(Check.Colours), free(Check.Failures), free(Check.FailureCounts), free(Check.Luminances);
+    free(Pixels), free(Simulated), free(Failures);
+    return Errors ? 2 : FailureCount ? 1 : 0;
+}
@@ -0,0 +1,314 @@
+/* Simulates colourblindness on binary PPM (P6) and PAM (P7) images.
+ *
+ * usage: colourblind_ppm [-l] impairment [input [output]]
+ *     impairment  protanopia, deuteranopia, tritanopia, achromatopsia, blueconemonochromacy or unimpaired
+ *                 (in any case, or the cb_impairment number)
+ *     -l          apply the simulation directly to the sRGB values, without removing gamma first
+ *     input       defaults to stdin; output defaults to stdout. '-' also means these.
+ *
+ * Images are processed a batch of rows at a time, so memory use doesn't depend on the image size.
+ * Regular files are memory-mapped and simulated in place in a private mapping, which is written
+ * straight out and then dropped. Other inputs (e.g. pipes) are read into a fixed ring of row buffers
+ * by a second thread while the main thread simulates and writes the previous ones.
+ * Several images in one stream are all processed. Only 8-bit RGB and RGB_ALPHA images are supported.
+ *
+ * build: cc -O2 -o colourblind_ppm examples/colourblind_ppm.c -lm -pthread
+ */
+#define _DEFAULT_SOURCE /* madvise */
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define cbIMPLEMENTATION
+#include "../colourblind.h"
+
+#define BATCH_BYTES (1 << 20) /* roughly how much of the image is processed at once */
+#define RING_SLOTS  4
+
+typedef struct input {
+    int Fd;
+    unsigned char *Map; /* only for regular files */
+    size_t Size, Offset;
+} input;
+
+typedef struct image {
+    int Width, Height, Depth, Pam;
+    char TupleType[32];
+} image;
+
+static int ReadByte(input *In) {
+    if(In->Map) { return In->Offset < In->Size ? In->Map[In->Offset++] : EOF; }
+    unsigned char C;
+    ssize_t Read;
+    while((Read = read(In->Fd, &C, 1)) < 0 && errno == EINTR) {}
+    return Read == 1 ? C : EOF;
+}
+
+/* reads a whitespace-separated token, skipping # comments */
+static int ReadToken(input *In, char *Token, int Max) {
+    int C = ReadByte(In), Length = 0;
+    for(;;) {
+        while(C == ' ' || C == '\t' || C == '\n' || C == '\r') { C = ReadByte(In); }
+        if(C != '#') { break; }
+        while(C != '\n' && C != EOF) { C = ReadByte(In); }
+    }
+    while(C != EOF && C != ' ' && C != '\t' && C != '\n' && C != '\r') {
+        if(Length < Max - 1) { Token[Length++] = (char)C; }
+        C = ReadByte(In);
+    }
+    Token[Length] = '\0';
+    return Length;
+}
+
+/* returns 1 for an image, 0 at a clean end of input, -1 for errors */
+static int ReadHeader(input *In, image *Image) {
+    char Token[64];
+    int MaxVal = 0;
+    if(! ReadToken(In, Token, sizeof(Token))) { return 0; }
+    memset(Image, 0, sizeof(*Image));
+    if(! strcmp(Token, "P6")) {
+        char W[16], H[16], M[16];
+        /* a single whitespace byte ends the header, which ReadToken has already consumed */
+        if(! ReadToken(In, W, sizeof(W)) || ! ReadToken(In, H, sizeof(H)) || ! ReadToken(In, M, sizeof(M))) { return -1; }
+        Image->Width = atoi(W), Image->Height = atoi(H), MaxVal = atoi(M), Image->Depth = 3;
+        strcpy(Image->TupleType, "RGB");
+    } else if(! strcmp(Token, "P7")) {
+        Image->Pam = 1;
+        while(ReadToken(In, Token, sizeof(Token)) && strcmp(Token, "ENDHDR")) {
+            char Value[32];
+            if(! ReadToken(In, Value, sizeof(Value))) { return -1; }
+            if     (! strcmp(Token, "WIDTH"))    { Image->Width  = atoi(Value); }
+            else if(! strcmp(Token, "HEIGHT"))   { Image->Height = atoi(Value); }
+            else if(! strcmp(Token, "DEPTH"))    { Image->Depth  = atoi(Value); }
+            else if(! strcmp(Token, "MAXVAL"))   { MaxVal        = atoi(Value); }
+            else if(! strcmp(Token, "TUPLTYPE")) { strcpy(Image->TupleType, Value); }
+        }
+    } else {
+        fprintf(stderr, "not a binary PPM or PAM image\n");
+        return -1;
+    }
+    /* TUPLTYPE is optional, but when given it has to agree with DEPTH (so GRAYSCALE_ALPHA isn't read as RGB) */
+    char *Expected = Image->Depth == 3 ? "RGB" : "RGB_ALPHA";
+    if(Image->Width <= 0 || Image->Height <= 0 || MaxVal != 255 || (Image->Depth != 3 && Image->Depth != 4) ||
+       (Image->TupleType[0] && strcmp(Image->TupleType, Expected))) {
+        fprintf(stderr, "only 8-bit RGB and RGB_ALPHA images are supported\n");
+        return -1;
+    }
+    strcpy(Image->TupleType, Expected);
+    return 1;
+}
+
+static int WriteAll(int Fd, void *Data, size_t Size) {
+    unsigned char *Bytes = (unsigned char *)Data;
+    while(Size) {
+        ssize_t Written = write(Fd, Bytes, Size);
+        if(Written < 0) {
+            if(errno == EINTR) { continue; }
+            return 0;
+        }
+        Bytes += Written, Size -= (size_t)Written;
+    }
+    return 1;
+}
+
+static int WriteHeader(int Fd, image *Image) {
+    char Header[256];
+    int Length = Image->Pam
+        ? snprintf(Header, sizeof(Header), "P7\nWIDTH %d\nHEIGHT %d\nDEPTH %d\nMAXVAL 255\nTUPLTYPE %s\nENDHDR\n",
+                   Image->Width, Image->Height, Image->Depth, Image->TupleType)
+        : snprintf(Header, sizeof(Header), "P6\n%d %d\n255\n", Image->Width, Image->Height);
+    return WriteAll(Fd, Header, (size_t)Length);
+}
+
+typedef struct job {
+    cb_impairment Impairment;
+    int Linear;
+    int Out;
+} job;
+
+static void Simulate(job *Job, image *Image, unsigned char *Rows, int RowCount) {
+    cb_format Format = Image->Depth == 4 ? cbRGBA8 : cbRGB8;
+    int Stride = Image->Width * Image->Depth;
+    if(Job->Linear) { ColourblindImage(     Job->Impairment, Rows, Image->Width, RowCount, Stride, Format); }
+    else            { ColourblindImageGamma(Job->Impairment, Rows, Image->Width, RowCount, Stride, Format); }
+}
+
+/* Regular files: simulate each batch in place in the private mapping, write it, then let the kernel drop it */
+static int ProcessMapped(job *Job, input *In, image *Image) {
+    size_t Stride = (size_t)Image->Width * Image->Depth, Page = (size_t)sysconf(_SC_PAGESIZE);
+    int BatchRows = BATCH_BYTES / Stride > 0 ? (int)(BATCH_BYTES / Stride) : 1;
+    if(In->Size - In->Offset < Stride * Image->Height) {
+        fprintf(stderr, "image data is truncated\n");
+        return 0;
+    }
+    for(int y = 0; y < Image->Height; y += BatchRows) {
+        int RowCount = Image->Height - y < BatchRows ? Image->Height - y : BatchRows;
+        unsigned char *Rows = In->Map + In->Offset;
+        Simulate(Job, Image, Rows, RowCount);
+        if(! WriteAll(Job->Out, Rows, Stride * RowCount)) { return 0; }
+        In->Offset += Stride * RowCount;
+
+        size_t Start = (size_t)(Rows - In->Map) & ~(Page - 1), End = In->Offset & ~(Page - 1);
+        if(End > Start) { madvise(In->Map + Start, End - Start, MADV_DONTNEED); }
+    }
+    return 1;
+}
+
+/* Streams: a reader thread fills a ring of batches while this thread simulates and writes them */
+typedef struct ring {
+    pthread_mutex_t Mutex;
+    pthread_cond_t  Changed;
+    unsigned char *Slots[RING_SLOTS];
+    int RowCounts[RING_SLOTS]; /* 0 while a slot is free, -1 on a read error */
+    int Filled, Consumed;      /* running totals of batches */
+    int Stop;                  /* set if the writer gives up early */
+    int BatchRows, Height, Fd;
+    size_t Stride;
+} ring;
+
+static void *ReadRing(void *Param) {
+    ring *Ring = (ring *)Param;
+    for(int y = 0, Batch = 0; y < Ring->Height; ++Batch) {
+        int Slot = Batch % RING_SLOTS;
+        pthread_mutex_lock(&Ring->Mutex);
+        while(Batch - Ring->Consumed >= RING_SLOTS && ! Ring->Stop) { pthread_cond_wait(&Ring->Changed, &Ring->Mutex); }
+        int Stop = Ring->Stop;
+        pthread_mutex_unlock(&Ring->Mutex);
+        if(Stop) { break; }
+
+        int RowCount = Ring->Height - y < Ring->BatchRows ? Ring->Height - y : Ring->BatchRows;
+        size_t Want = Ring->Stride * RowCount, Got = 0;
+        while(Got < Want) {
+            ssize_t Read = read(Ring->Fd, Ring->Slots[Slot] + Got, Want - Got);
+            if(Read < 0 && errno == EINTR) { continue; }
+            if(Read <= 0) { break; }
+            Got += (size_t)Read;
+        }
+
+        pthread_mutex_lock(&Ring->Mutex);
+        Ring->RowCounts[Slot] = Got == Want ? RowCount : -1;
+        ++Ring->Filled;
+        pthread_cond_broadcast(&Ring->Changed);
+        pthread_mutex_unlock(&Ring->Mutex);
+        if(Got != Want) { break; }
+        y += RowCount;
+    }
+    return 0;
+}
+
+static int ProcessStream(job *Job, input *In, image *Image) {
+    ring Ring;
+    memset(&Ring, 0, sizeof(Ring));
+    pthread_mutex_init(&Ring.Mutex, 0);
+    pthread_cond_init(&Ring.Changed, 0);
+    Ring.Stride    = (size_t)Image->Width * Image->Depth;
+    Ring.BatchRows = BATCH_BYTES / Ring.Stride > 0 ? (int)(BATCH_BYTES / Ring.Stride) : 1;
+    Ring.Height    = Image->Height;
+    Ring.Fd        = In->Fd;
+    int Success = 1;
+    for(int i = 0; i < RING_SLOTS; ++i) {
+        if(! (Ring.Slots[i] = malloc(Ring.Stride * Ring.BatchRows))) { Success = 0; }
+    }
+    pthread_t Reader;
+    if(! Success || pthread_create(&Reader, 0, ReadRing, &Ring)) {
+        for(int i = 0; i < RING_SLOTS; ++i) { free(Ring.Slots[i]); }
+        pthread_cond_destroy(&Ring.Changed);
+        pthread_mutex_destroy(&Ring.Mutex);
+        fprintf(stderr, "could not set up the read buffers\n");
+        return 0;
+    }
+
+    for(int y = 0, Batch = 0; Success && y < Image->Height; ++Batch) {
+        int Slot = Batch % RING_SLOTS;
+        pthread_mutex_lock(&Ring.Mutex);
+        while(Ring.Filled <= Batch) { pthread_cond_wait(&Ring.Changed, &Ring.Mutex); }
+        int RowCount = Ring.RowCounts[Slot];
+        pthread_mutex_unlock(&Ring.Mutex);
+
+        if(RowCount < 0) {
+            fprintf(stderr, "image data is truncated\n");
+            Success = 0;
+            break;
+        }
+        Simulate(Job, Image, Ring.Slots[Slot], RowCount);
+        Success = WriteAll(Job->Out, Ring.Slots[Slot], Ring.Stride * RowCount);
+        y += RowCount;
+
+        pthread_mutex_lock(&Ring.Mutex);
+        Ring.RowCounts[Slot] = 0;
+        ++Ring.Consumed;
+        pthread_cond_broadcast(&Ring.Changed);
+        pthread_mutex_unlock(&Ring.Mutex);
+    }
+
+    if(! Success) {
+        pthread_mutex_lock(&Ring.Mutex);
+        Ring.Stop = 1;
+        pthread_cond_broadcast(&Ring.Changed);
+        pthread_mutex_unlock(&Ring.Mutex);
+    }
+    pthread_join(Reader, 0);
+    for(int i = 0; i < RING_SLOTS; ++i) { free(Ring.Slots[i]); }
+    pthread_cond_destroy(&Ring.Changed);
+    pthread_mutex_destroy(&Ring.Mutex);
+    return Success;
+}
+
+static int ParseImpairment(char *Name) {
+    for(int i = 0; i < cbImpairmentCount; ++i) {
+        if(! strcasecmp(Name, cbImpairmentStrings[i])) { return i; }
+    }
+    char *End;
+    long Number = strtol(Name, &End, 10);
+    return *End == '\0' && Number >= 0 && Number < cbImpairmentCount ? (int)Number : -1;
+}
+
+int main(int ArgCount, char **Args) {
+    job Job = { cbUnimpaired, 0, STDOUT_FILENO };
+    int Arg = 1;
+    if(Arg < ArgCount && ! strcmp(Args[Arg], "-l")) { Job.Linear = 1, ++Arg; }
+    int Impairment = Arg < ArgCount ? ParseImpairment(Args[Arg++]) : -1;
+    if(Impairment < 0 || ArgCount - Arg > 2) {
+        fprintf(stderr, "usage: %s [-l] protanopia|deuteranopia|tritanopia|achromatopsia|blueconemonochromacy|unimpaired [input [output]]\n", Args[0]);
+        return 2;
+    }
+    Job.Impairment = (cb_impairment)Impairment;
+
+    input In = { STDIN_FILENO };
+    if(Arg < ArgCount && strcmp(Args[Arg], "-")) {
+        if((In.Fd = open(Args[Arg], O_RDONLY)) < 0) { perror(Args[Arg]); return 1; }
+    }
+    ++Arg;
+    if(Arg < ArgCount && strcmp(Args[Arg], "-")) {
+        if((Job.Out = open(Args[Arg], O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) { perror(Args[Arg]); return 1; }
+    }
+
+    struct stat Info;
+    if(fstat(In.Fd, &Info) == 0 && S_ISREG(Info.st_mode) && Info.st_size > 0) {
+        In.Size = (size_t)Info.st_size;
+        In.Map  = mmap(0, In.Size, PROT_READ | PROT_WRITE, MAP_PRIVATE, In.Fd, 0);
+        if(In.Map == MAP_FAILED) { In.Map = 0; } /* fall back to streaming */
+        else                     { madvise(In.Map, In.Size, MADV_SEQUENTIAL); }
+    }
+
+    cbInitGammaTables();
+    int Result, Images = 0, Success = 1;
+    image Image;
+    while(Success && (Result = ReadHeader(&In, &Image)) != 0) {
+        Success = Result > 0 && WriteHeader(Job.Out, &Image) &&
+                  (In.Map ? ProcessMapped(&Job, &In, &Image) : ProcessStream(&Job, &In, &Image));
+        ++Images;
+    }
+    if(Success && ! Images) { fprintf(stderr, "no image found\n"); Success = 0; }
+
+    if(In.Map) { munmap(In.Map, In.Size); }
+    if(Job.Out != STDOUT_FILENO && close(Job.Out) != 0) { perror("close"); Success = 0; }
+    return Success ? 0 : 1;
+}
@@ -0,0 +1,471 @@
+/* Benchmarks for colourblind.h
+ * Output is CSV on stdout: benchmark,variant,mode,threads,metric,value
+ *
+ * Throughput is measured over arrays of independent inputs, and latency by feeding each result into the next call.
+ * The Error rows compare the gamma mode this was built with against a double-precision version of the accurate curve,
+ * along with each of the polynomial gamma tiers (which don't depend on the mode).
+ * To compare modes, build it once per mode and concatenate the results, e.g.:
+ *     for m in EXACT cbGAMMA_TABLE cbGAMMA_FAST cbGAMMA_FASTER cbGAMMA_POLY=cbGammaTier1e4; do
+ *         cc -O2 -D$m -o bench_$m tests/bench_colourblind.c -lm -pthread && ./bench_$m | tail -n +2
+ *     done
+ *
+ * usage: bench_colourblind [width height [max threads]]
+ */
+#define _POSIX_C_SOURCE 199309L /* clock_gettime */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define cbTHREADS
+#define cbIMPLEMENTATION
+#include "../colourblind.h"
+
+#if   defined(cbGAMMA_POLY)
+#define Mode "poly"
+#elif defined(cbGAMMA_FASTER)
+#define Mode "faster"
+#elif defined(cbGAMMA_FAST)
+#define Mode "fast"
+#elif defined(cbGAMMA_TABLE)
+#define Mode "table"
+#else
+#define Mode "exact"
+#endif
+
+#ifdef _WIN32
+static double Seconds(void) {
+	LARGE_INTEGER Count, Frequency;
+	QueryPerformanceCounter(&Count);
+	QueryPerformanceFrequency(&Frequency);
+	return (double)Count.QuadPart / (double)Frequency.QuadPart;
+}
+#else
+#include <time.h>
+static double Seconds(void) {
+	struct timespec Time;
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	return Time.tv_sec + Time.tv_nsec * 1e-9;
+}
+#endif
+
+/* Runs the body repeatedly until at least MinSeconds have passed, and gives the best time for one run */
+#define MinSeconds 0.25
+#define BEST_TIME(Best, ...) do { \
+	double Start_ = Seconds(), Now_ = Start_; \
+	(Best) = 1e30; \
+	while(Now_ - Start_ < MinSeconds) { \
+		double Before_ = Now_; \
+		__VA_ARGS__; \
+		Now_ = Seconds(); \
+		if(Now_ - Before_ < (Best)) { (Best) = Now_ - Before_; } \
+	} \
+} while(0)
+
+static void Report(char *Benchmark, char *Variant, int Threads, char *Metric, double Value)
+{ printf("%s,%s,%s,%d,%s,%.6g\n", Benchmark, Variant, Mode, Threads, Metric, Value); }
+
+/* The accurate sRGB curves, in double precision */
+static double ReferenceRemoveGamma(double X)
+{ return X > 0.04045 ? pow((X + 0.055) / 1.055, 2.4) : X / 12.92; }
+static double ReferenceApplyGamma(double X)
+{ return X > 0.0031308 ? 1.055 * pow(X, 1 / 2.4) - 0.055 : X * 12.92; }
+static double ReferenceLuminance255(cb_rgb_255 C) {
+	return 0.2126 * ReferenceRemoveGamma(C.R / 255.0) +
+	       0.7152 * ReferenceRemoveGamma(C.G / 255.0) +
+	       0.0722 * ReferenceRemoveGamma(C.B / 255.0);
+}
+
+typedef struct error { double Max, Sum; long Count; } error;
+static void AddError(error *Error, double Difference) {
+	Difference = fabs(Difference);
+	if(Difference > Error->Max) { Error->Max = Difference; }
+	Error->Sum += Difference;
+	++Error->Count;
+}
+static void ReportError(char *Variant, char *Unit, error Error) {
+	char Metric[64];
+	snprintf(Metric, sizeof(Metric), "max %s", Unit);
+	Report("Error", Variant, 1, Metric, Error.Max);
+	snprintf(Metric, sizeof(Metric), "mean %s", Unit);
+	Report("Error", Variant, 1, Metric, Error.Sum / Error.Count);
+}
+
+enum { Count = 1 << 16 };
+static cb_rgb_255 Colours[Count], Others[Count];
+static cb_rgb     Norms[Count], OtherNorms[Count];
+static float      PlanarR[Count], PlanarG[Count], PlanarB[Count], PlanarGamma[Count];
+static volatile float Sink;
+
+/* Times Body (which can use i) over every colour; Unit is what each iteration counts as */
+#define THROUGHPUT(Benchmark, Variant, Unit, ...) do { \
+	double Time_; \
+	float Sum_ = 0.f; \
+	BEST_TIME(Time_, for(int i = 0; i < Count; ++i) { __VA_ARGS__; }); \
+	Sink += Sum_; \
+	Report(Benchmark, Variant, 1, "M" Unit "/s", Count / Time_ / 1e6); \
+	Report(Benchmark, Variant, 1, "ns/" Unit, Time_ / Count * 1e9); \
+} while(0)
+
+/* Times a chain of Count calls, each depending on the last; Result stops the chain being optimised away */
+#define LATENCY(Benchmark, Variant, Init, Result, ...) do { \
+	double Time_; \
+	BEST_TIME(Time_, Init; for(int i = 0; i < Count; ++i) { __VA_ARGS__; } Sink += (Result)); \
+	Report(Benchmark, Variant, 1, "latency ns", Time_ / Count * 1e9); \
+} while(0)
+
+int main(int ArgCount, char **Args)
+{
+	int Width = 3840, Height = 2160, MaxThreads = 0;
+	if(ArgCount >= 3) { Width = atoi(Args[1]), Height = atoi(Args[2]); }
+	if(ArgCount >= 4) { MaxThreads = atoi(Args[3]); }
+	if(MaxThreads <= 0) {
+		cb_pool *Pool = cbPoolCreate(0);
+		MaxThreads = cbPoolThreadCount(Pool);
+		cbPoolDestroy(Pool);
+	}
+
+	int Stride = Width * 4;
+	unsigned char *Pixels = malloc((size_t)Stride * Height);
+	if(! Pixels) { fprintf(stderr, "could not allocate a %dx%d image\n", Width, Height); return 1; }
+	unsigned int Seed = 1;
+	for(size_t i = 0; i < (size_t)Stride * Height; ++i) {
+		Seed = Seed * 1103515245u + 12345u;
+		Pixels[i] = (unsigned char)(Seed >> 16);
+	}
+	for(int i = 0; i < Count; ++i) {
+		Seed = Seed * 1103515245u + 12345u;
+		Colours[i].R = (unsigned char)(Seed >> 8), Colours[i].G = (unsigned char)(Seed >> 16), Colours[i].B = (unsigned char)(Seed >> 24);
+		Seed = Seed * 1103515245u + 12345u;
+		Others[i].R = (unsigned char)(Seed >> 8), Others[i].G = (unsigned char)(Seed >> 16), Others[i].B = (unsigned char)(Seed >> 24);
+		Norms[i] = cbNorm(Colours[i]), OtherNorms[i] = cbNorm(Others[i]);
+		PlanarR[i] = Norms[i].R, PlanarG[i] = Norms[i].G, PlanarB[i] = Norms[i].B;
+	}
+	double Megapixels = (double)Width * Height / 1e6, Time;
+
+	printf("benchmark,variant,mode,threads,metric,value\n");
+
+	/* Per-colour simulation, for each calling convention */
+	THROUGHPUT("Simulate", "Float", "pixel",
+		float R = Norms[i].R, G = Norms[i].G, B = Norms[i].B;
+		Deuteranopia(&R, &G, &B);
+		Sum_ += R + G + B);
+	THROUGHPUT("Simulate", "255", "pixel",
+		unsigned char R = Colours[i].R, G = Colours[i].G, B = Colours[i].B;
+		Deuteranopia255(&R, &G, &B);
+		Sum_ += R + G + B);
+	THROUGHPUT("Simulate", "RGB", "pixel",
+		cb_rgb C = DeuteranopiaRGB(Norms[i]);
+		Sum_ += C.R + C.G + C.B);
+	THROUGHPUT("Simulate", "RGB255", "pixel",
+		cb_rgb_255 C = DeuteranopiaRGB255(Colours[i]);
+		Sum_ += C.R + C.G + C.B);
+	THROUGHPUT("Simulate", "RGB255Gamma", "pixel",
+		cb_rgb_255 C = DeuteranopiaRGB255Gamma(Colours[i]);
+		Sum_ += C.R + C.G + C.B);
+	THROUGHPUT("Simulate", "RGB255Fixed", "pixel",
+		cb_rgb_255 C = ColourblindRGB255Fixed(cbDeuteranopia, Colours[i]);
+		Sum_ += C.R + C.G + C.B);
+	THROUGHPUT("Simulate", "RGB255GammaFixed", "pixel",
+		cb_rgb_255 C = ColourblindRGB255GammaFixed(cbDeuteranopia, Colours[i]);
+		Sum_ += C.R + C.G + C.B);
+	THROUGHPUT("Simulate", "ColourblindRGB255", "pixel",
+		cb_rgb_255 C = ColourblindRGB255(cbDeuteranopia, Colours[i]);
+		Sum_ += C.R + C.G + C.B);
+
+	BEST_TIME(Time, ColourblindPlanar(cbDeuteranopia, PlanarR, PlanarG, PlanarB, Count));
+	Report("Simulate", "Planar", 1, "Mpixel/s", Count / Time / 1e6);
+	Report("Simulate", "Planar", 1, "ns/pixel", Time / Count * 1e9);
+
+	LATENCY("Simulate", "RGB", cb_rgb C = Norms[0], C.R, C = DeuteranopiaRGB(C));
+	LATENCY("Simulate", "RGB255Gamma", cb_rgb_255 C = Colours[0], C.R, C = DeuteranopiaRGB255Gamma(C));
+
+	/* Whole images on one thread */
+	BEST_TIME(Time, ColourblindImage(cbDeuteranopia, Pixels, Width, Height, Stride, cbRGBA8));
+	Report("Image", "Linear", 1, "Mpixel/s", Megapixels / Time);
+	BEST_TIME(Time, ColourblindImageGamma(cbDeuteranopia, Pixels, Width, Height, Stride, cbRGBA8));
+	Report("Image", "Gamma", 1, "Mpixel/s", Megapixels / Time);
+	BEST_TIME(Time, cbDaltoniseImageGamma(cbDeuteranopia, Pixels, Width, Height, Stride, cbRGBA8));
+	Report("Image", "DaltoniseGamma", 1, "Mpixel/s", Megapixels / Time);
+	BEST_TIME(Time, ColourblindImageSpace(cbDeuteranopia, cbSpaceDisplayP3, cbTransferSRGB, Pixels, Width, Height, Stride, cbRGBA8));
+	Report("Image", "GammaP3", 1, "Mpixel/s", Megapixels / Time);
+	BEST_TIME(Time, ColourblindImageSpace(cbDeuteranopia, cbSpaceRec2020, cbTransferPQ, Pixels, Width, Height, Stride, cbRGBA8));
+	Report("Image", "PQRec2020", 1, "Mpixel/s", Megapixels / Time);
+	BEST_TIME(Time, ColourblindImageFixed(cbDeuteranopia, Pixels, Width, Height, Stride, cbRGBA8));
+	Report("Image", "LinearFixed", 1, "Mpixel/s", Megapixels / Time);
+	BEST_TIME(Time, ColourblindImageGammaFixed(cbDeuteranopia, Pixels, Width, Height, Stride, cbRGBA8));
+	Report("Image", "GammaFixed", 1, "Mpixel/s", Megapixels / Time);
+	/* the same buffer as half as many 8-byte pixels */
+	BEST_TIME(Time, ColourblindImage(cbDeuteranopia, Pixels, Width/2, Height, Stride, cbRGBA16));
+	Report("Image", "Linear16", 1, "Mpixel/s", Megapixels/2 / Time);
+	BEST_TIME(Time, ColourblindImageGamma(cbDeuteranopia, Pixels, Width/2, Height, Stride, cbRGBA16));
+	Report("Image", "Gamma16", 1, "Mpixel/s", Megapixels/2 / Time);
+	BEST_TIME(Time, ColourblindImageSpace(cbDeuteranopia, cbSpaceRec2020, cbTransferPQ, Pixels, Width/2, Height, Stride, cbRGBA16));
+	Report("Image", "PQRec2020_16", 1, "Mpixel/s", Megapixels/2 / Time);
+	BEST_TIME(Time, ColourblindImage(cbDeuteranopia, Pixels, Width/2, Height, Stride, cbRGBA16F));
+	Report("Image", "LinearHalf", 1, "Mpixel/s", Megapixels/2 / Time);
+
+	/* A four-panel comparison (unimpaired and the dichromacies), as copies simulated one by one and fused into one pass */
+	{
+		cb_impairment Panels[4] = { cbUnimpaired, cbProtanopia, cbDeuteranopia, cbTritanopia };
+		unsigned char *Outputs[4];
+		for(int i = 0; i < 4; ++i) { Outputs[i] = malloc((size_t)Stride * Height); }
+		if(Outputs[0] && Outputs[1] && Outputs[2] && Outputs[3]) {
+			struct { char *Name; cb_format Format; int Width; } Cases[] = { { "8", cbRGBA8, Width }, { "16", cbRGBA16, Width/2 } };
+			for(int c = 0; c < 2; ++c) {
+				char Variant[32];
+				cb_format Format = Cases[c].Format;
+				int PanelWidth = Cases[c].Width;
+				double PanelMegapixels = 4. * PanelWidth * Height / 1e6;
+				BEST_TIME(Time,
+					for(int i = 0; i < 4; ++i) {
+						memcpy(Outputs[i], Pixels, (size_t)Stride * Height);
+						ColourblindImageGamma(Panels[i], Outputs[i], PanelWidth, Height, Stride, Format);
+					});
+				snprintf(Variant, sizeof(Variant), "Separate%s", Cases[c].Name);
+				Report("FourPanels", Variant, 1, "Mpixel/s", PanelMegapixels / Time);
+				BEST_TIME(Time, ColourblindImagesGamma(Panels, 4, Pixels, PanelWidth, Height, Stride, Format, Outputs, Stride));
+				snprintf(Variant, sizeof(Variant), "Fused%s", Cases[c].Name);
+				Report("FourPanels", Variant, 1, "Mpixel/s", PanelMegapixels / Time);
+			}
+		}
+		for(int i = 0; i < 4; ++i) { free(Outputs[i]); }
+	}
+
+	/* Deduplicated simulation of a flat UI-like image (panels of text in a few colours, with some antialiasing),
+	 * and of the noise image, where it falls back after the first few rows */
+	{
+		unsigned char *Flat = malloc((size_t)Stride * Height);
+		static const unsigned char Swatches[8][3] = { { 255, 255, 255 }, { 32, 32, 32 }, { 239, 63, 109 }, { 51, 102, 153 },
+		                                              { 0, 170, 173 }, { 136, 0, 39 }, { 240, 240, 240 }, { 128, 128, 128 } };
+		if(Flat) {
+			for(int y = 0; y < Height; ++y)
+			for(int x = 0; x < Width; ++x) {
+				int Panel = (x/640 + y/540*6) % 8, Alpha = 0;
+				Seed = Seed * 1103515245u + 12345u;
+				if(y%24 >= 6 && y%24 < 18 && x%12 < 9 && (Seed >> 16) & 3) { Alpha = (Seed >> 20) & 7 ? 255 : (Seed >> 8) & 255; }
+				unsigned char *P = Flat + (size_t)y*Stride + x*4;
+				for(int k = 0; k < 3; ++k) { P[k] = (unsigned char)((Swatches[(Panel + 3) % 8][k]*Alpha + Swatches[Panel][k]*(255 - Alpha)) / 255); }
+				P[3] = 255;
+			}
+			BEST_TIME(Time, ColourblindImageGamma(cbDeuteranopia, Flat, Width, Height, Stride, cbRGBA8));
+			Report("Unique", "FlatDirect", 1, "Mpixel/s", Megapixels / Time);
+			BEST_TIME(Time, ColourblindImageGammaUnique(cbDeuteranopia, Flat, Width, Height, Stride, cbRGBA8, 0));
+			Report("Unique", "Flat", 1, "Mpixel/s", Megapixels / Time);
+			BEST_TIME(Time, ColourblindImageGammaUnique(cbDeuteranopia, Pixels, Width, Height, Stride, cbRGBA8, 0));
+			Report("Unique", "Noise", 1, "Mpixel/s", Megapixels / Time);
+		}
+		free(Flat);
+	}
+
+	/* Luminance and contrast */
+	THROUGHPUT("Luminance", "Float", "colour", Sum_ += cbLuminance(Norms[i].R, Norms[i].G, Norms[i].B));
+	THROUGHPUT("Luminance", "255", "colour", Sum_ += cbLuminance255(Colours[i].R, Colours[i].G, Colours[i].B));
+	THROUGHPUT("Luminance", "RGB", "colour", Sum_ += cbLuminanceRGB(Norms[i]));
+	THROUGHPUT("Luminance", "RGB255", "colour", Sum_ += cbLuminanceRGB255(Colours[i]));
+	LATENCY("Luminance", "Float", float L = 0.5f, L, L = cbLuminance(L, L, L));
+	THROUGHPUT("DeltaE", "CIE76RGB255", "pair", Sum_ += cbDeltaE76RGB255(Colours[i], Others[i]));
+	THROUGHPUT("DeltaE", "CIEDE2000RGB255", "pair", Sum_ += cbDeltaE2000RGB255(Colours[i], Others[i]));
+	THROUGHPUT("DeltaE", "CIELUVRGB255", "pair", Sum_ += cbDeltaEuvRGB255(Colours[i], Others[i]));
+
+	/* Float gamma conversions, one at a time in this build's mode and in place with each polynomial tier */
+	static char *TierNames[cbGammaTierCount] = { "8Bit", "1e4", "1e6" };
+	THROUGHPUT("RemoveGamma", "Component", "value", Sum_ += cbRemoveGammaComponent(PlanarR[i]));
+	THROUGHPUT("ApplyGamma", "Component", "value", Sum_ += cbApplyGammaComponent(PlanarR[i]));
+	for(int Tier = 0; Tier < cbGammaTierCount; ++Tier) {
+		char Variant[32];
+		snprintf(Variant, sizeof(Variant), "Planar%s", TierNames[Tier]);
+		memcpy(PlanarGamma, PlanarR, sizeof(PlanarGamma));
+		BEST_TIME(Time, cbRemoveGammaPlanar((cb_gamma_tier)Tier, PlanarGamma, Count));
+		Report("RemoveGamma", Variant, 1, "Mvalue/s", Count / Time / 1e6);
+		BEST_TIME(Time, cbApplyGammaPlanar((cb_gamma_tier)Tier, PlanarGamma, Count));
+		Report("ApplyGamma", Variant, 1, "Mvalue/s", Count / Time / 1e6);
+	}
+
+#define CONTRAST(fn) \
+	THROUGHPUT(#fn, "Float", "pair", Sum_ += fn(Norms[i].R, Norms[i].G, Norms[i].B, OtherNorms[i].R, OtherNorms[i].G, OtherNorms[i].B)); \
+	THROUGHPUT(#fn, "255", "pair", Sum_ += fn##255(Colours[i].R, Colours[i].G, Colours[i].B, Others[i].R, Others[i].G, Others[i].B)); \
+	THROUGHPUT(#fn, "RGB", "pair", Sum_ += fn##RGB(Norms[i], OtherNorms[i])); \
+	THROUGHPUT(#fn, "RGB255", "pair", Sum_ += fn##RGB255(Colours[i], Others[i]));
+	CONTRAST(cbContrast)
+	CONTRAST(cbContrastRatio)
+	CONTRAST(cbContrastModulation)
+#undef CONTRAST
+
+	/* Accuracy of this build's gamma mode */
+	{
+		error Remove = {0}, Apply = {0}, Luminance = {0}, Contrast = {0}, Simulated = {0};
+		for(int i = 0; i <= 1000000; ++i) {
+			float X = i / 1000000.f;
+			AddError(&Remove, cbRemoveGammaComponent(X) - ReferenceRemoveGamma(X));
+			AddError(&Apply,  cbApplyGammaComponent(X)  - ReferenceApplyGamma(X));
+		}
+		for(int i = 0; i < Count; ++i) {
+			double LumA = ReferenceLuminance255(Colours[i]), LumB = ReferenceLuminance255(Others[i]);
+			double High = LumA > LumB ? LumA : LumB, Low = LumA > LumB ? LumB : LumA;
+			AddError(&Luminance, cbLuminanceRGB255(Colours[i]) - LumA);
+			AddError(&Contrast, cbContrastRGB255(Colours[i], Others[i]) - (High + 0.05) / (Low + 0.05));
+		}
+
+		/* the image version of RGB255Gamma, which uses the same curve but saturates instead of wrapping */
+		unsigned char *Simulation = malloc(sizeof(Colours));
+		memcpy(Simulation, Colours, sizeof(Colours));
+		ColourblindImageGamma(cbDeuteranopia, Simulation, Count, 1, sizeof(Colours), cbRGB8);
+		float *M = cbImpairmentMatrices[cbDeuteranopia];
+		for(int i = 0; i < Count; ++i) {
+			double In[3] = { ReferenceRemoveGamma(Colours[i].R / 255.0), ReferenceRemoveGamma(Colours[i].G / 255.0),
+			                 ReferenceRemoveGamma(Colours[i].B / 255.0) };
+			for(int c = 0; c < 3; ++c) {
+				double Out = M[3*c]*In[0] + M[3*c + 1]*In[1] + M[3*c + 2]*In[2];
+				Out = Out < 0 ? 0 : Out > 1 ? 255 : 255 * ReferenceApplyGamma(Out);
+				AddError(&Simulated, Simulation[3*i + c] - Out);
+			}
+		}
+		free(Simulation);
+
+		ReportError("RemoveGamma", "abs", Remove);
+		ReportError("ApplyGamma", "abs", Apply);
+		for(int Tier = 0; Tier < cbGammaTierCount; ++Tier) {
+			error PolyRemove = {0}, PolyApply = {0};
+			char Variant[32];
+			for(int i = 0; i <= 1000000; ++i) {
+				float X = i / 1000000.f;
+				AddError(&PolyRemove, cbRemoveGammaPoly((cb_gamma_tier)Tier, X) - ReferenceRemoveGamma(X));
+				AddError(&PolyApply,  cbApplyGammaPoly((cb_gamma_tier)Tier, X)  - ReferenceApplyGamma(X));
+			}
+			snprintf(Variant, sizeof(Variant), "RemoveGammaPoly%s", TierNames[Tier]);
+			ReportError(Variant, "abs", PolyRemove);
+			snprintf(Variant, sizeof(Variant), "ApplyGammaPoly%s", TierNames[Tier]);
+			ReportError(Variant, "abs", PolyApply);
+		}
+		ReportError("Luminance255", "abs", Luminance);
+		ReportError("Contrast255", "abs", Contrast);
+		ReportError("RGB255Gamma", "levels", Simulated);
+	}
+
+	/* Thread scaling of the tiled image functions */
+	for(int Threads = 1; Threads <= MaxThreads; ++Threads) {
+		cb_pool *Pool = cbPoolCreate(Threads);
+		BEST_TIME(Time, ColourblindImageThreaded(Pool, cbDeuteranopia, Pixels, Width, Height, Stride, cbRGBA8));
+		Report("ImageThreaded", "Linear", Threads, "Mpixel/s", Megapixels / Time);
+		BEST_TIME(Time, ColourblindImageGammaThreaded(Pool, cbDeuteranopia, Pixels, Width, Height, Stride, cbRGBA8));
+		Report("ImageThreaded", "Gamma", Threads, "Mpixel/s", Megapixels / Time);
+		cbPoolDestroy(Pool);
+	}
+
+	/* 1440p frame sequences, where each frame changes nothing, a 320x180 region, or every row */
+	{
+		enum { FrameWidth = 2560, FrameHeight = 1440, Region = 320 };
+		static char *Variants[] = { "Static", "Region", "Full" };
+		int FrameStride = 4 * FrameWidth;
+		unsigned char *Frame = malloc((size_t)FrameStride * FrameHeight);
+		cb_impairment Deuteranopia = cbDeuteranopia;
+		for(int Threads = 1; Frame && Threads <= MaxThreads; ++Threads)
+		for(int v = 0; v < 3; ++v) {
+			cb_pool *Pool = cbPoolCreate(Threads);
+			cb_sequence *Sequence = cbSequenceCreate(&Deuteranopia, 1, 1, FrameWidth, FrameHeight, cbRGBA8, 0);
+			int Rows = v == 0 ? 0 : v == 1 ? Region * 9 / 16 : FrameHeight, Columns = v == 2 ? FrameWidth : Region;
+			int Top = v == 2 ? 0 : 600, Left = v == 2 ? 0 : 1000;
+			for(int i = 0; i < FrameStride * FrameHeight; ++i) { Frame[i] = Pixels[i % (Stride * Height)]; }
+			cbSequenceFrame(Sequence, Frame, FrameStride);
+			BEST_TIME(Time,
+				for(int y = Top; y < Top + Rows; ++y) { for(int x = Left; x < Left + Columns; ++x) { Frame[y * FrameStride + 4*x] ^= 1; } }
+				cbSequenceFrameThreaded(Pool, Sequence, Frame, FrameStride));
+			Report("Sequence", Variants[v], Threads, "frame/s", 1 / Time);
+			Report("Sequence", Variants[v], Threads, "dirty %", 100.0 * Sequence->DirtyTiles / (Sequence->TilesAcross * Sequence->TilesDown));
+			cbSequenceDestroy(Sequence);
+			cbPoolDestroy(Pool);
+		}
+		free(Frame);
+	}
+
+	/* Contrast matrices for a design-system-sized palette, against calling the pair functions directly */
+	{
+		enum { PaletteSize = 500 };
+		double Pairs = (double)cbImpairmentCount * PaletteSize * PaletteSize;
+		float Sum = 0.f;
+
+		BEST_TIME(Time, cbPaletteDestroy(cbPaletteCreate(Colours, PaletteSize, 0)));
+		Report("Palette", "Create", 1, "Mpair/s", Pairs / Time / 1e6);
+
+		BEST_TIME(Time,
+			for(cb_impairment Impairment = cbUnimpaired; Impairment < cbImpairmentCount; ++Impairment)
+			for(int A = 0; A < PaletteSize; ++A)
+			for(int B = 0; B < PaletteSize; ++B) {
+				cb_rgb_255 SimA = ColourblindRGB255(Impairment, Colours[A]), SimB = ColourblindRGB255(Impairment, Colours[B]);
+				Sum += cbContrastRGB255(SimA, SimB) + cbContrastRatioRGB255(SimA, SimB) + cbContrastModulationRGB255(SimA, SimB);
+			});
+		Sink += Sum;
+		Report("Palette", "PairFunctions", 1, "Mpair/s", Pairs / Time / 1e6);
+
+		/* colour differences under one impairment, from the palette's cached coordinates */
+		static char *MetricNames[cbDeltaECount] = { "CIE76", "CIEDE2000", "CIELUV" };
+		double ImpairmentPairs = (double)PaletteSize * PaletteSize;
+		float *Differences = malloc(sizeof(float) * PaletteSize * PaletteSize);
+		cb_pair Confused[64];
+		cb_palette *Palette = cbPaletteCreate(Colours, PaletteSize, 1);
+		for(cb_delta_e Metric = cbDeltaE_CIE76; Palette && Differences && Metric < cbDeltaECount; ++Metric) {
+			char Variant[32];
+			snprintf(Variant, sizeof(Variant), "Differences%s", MetricNames[Metric]);
+			BEST_TIME(Time, cbPaletteDifferences(Palette, Metric, cbDeuteranopia, Differences));
+			Report("Palette", Variant, 1, "Mpair/s", ImpairmentPairs / Time / 1e6);
+			snprintf(Variant, sizeof(Variant), "Confused%s", MetricNames[Metric]);
+			BEST_TIME(Time, Sink += (float)cbPaletteConfusedPairs(Palette, Metric, cbDeuteranopia, 2.3f, Confused, 64));
+			Report("Palette", Variant, 1, "Mpair/s", ImpairmentPairs / 2 / Time / 1e6);
+		}
+		cbPaletteDestroy(Palette);
+		free(Differences);
+	}
+
+	/* Every guideline for every impairment, for (Colours[i], Others[i]) pairs: the batch against a guideline at a time */
+	{
+		static unsigned int Masks[cbImpairmentCount * Count];
+		cb_impairment Impairments[cbImpairmentCount];
+		double Pairs = (double)cbImpairmentCount * Count;
+		for(int j = 0; j < cbImpairmentCount; ++j) { Impairments[j] = (cb_impairment)j; }
+
+		BEST_TIME(Time,
+			for(int j = 0; j < cbImpairmentCount; ++j)
+			for(int i = 0; i < Count; ++i) {
+				cb_rgb_255 A = Colours[i], B = Others[i];
+				unsigned int Mask = 0;
+				ColourblindImageGamma(Impairments[j], &A.R, 1, 1, 3, cbRGB8);
+				ColourblindImageGamma(Impairments[j], &B.R, 1, 1, 3, cbRGB8);
+				float LumA = cbLuminanceRGB255(A), LumB = cbLuminanceRGB255(B);
+				for(int g = 0; g < cgGuidelineCount; ++g) { Mask |= (unsigned int)cbGuidelinePassLuminance((cb_guideline)g, LumA, LumB) << g; }
+				Masks[j * Count + i] = Mask;
+			});
+		Report("Guidelines", "EachGuideline", 1, "Mpair/s", Pairs / Time / 1e6);
+		BEST_TIME(Time, cbGuidelinesBatch(Colours, Others, Count, Impairments, cbImpairmentCount, 1, Masks, 0));
+		Report("Guidelines", "Batch", 1, "Mpair/s", Pairs / Time / 1e6);
+		for(int Threads = 2; Threads <= MaxThreads; ++Threads) {
+			cb_pool *Pool = cbPoolCreate(Threads);
+			BEST_TIME(Time, cbGuidelinesBatchThreaded(Pool, Colours, Others, Count, Impairments, cbImpairmentCount, 1, Masks, 0));
+			Report("Guidelines", "Batch", Threads, "Mpair/s", Pairs / Time / 1e6);
+			cbPoolDestroy(Pool);
+		}
+		Sink += (float)Masks[Count];
+	}
+
+	/* Guideline repair queries, e.g. from a colour picker */
+	{
+		enum { Queries = 1000 };
+		cb_rgb_255 White = { 0xFF,0xFF,0xFF }, Result;
+		int Found = 0;
+		BEST_TIME(Time, for(int i = 0; i < Queries; ++i) { Found += cbNearestPassingRGB255(White, Colours[i], cbWCAG_Contrast_AA, &Result); });
+		Sink += (float)Found;
+		Report("NearestPassing", "RGB255", 1, "query/s", Queries / Time);
+	}
+
+	/* Local contrast maps of the whole image (noise, so every pixel is an edge), which shouldn't depend on the radius */
+	for(int Radius = 1; Radius <= 16; Radius *= 4) {
+		char Variant[32];
+		snprintf(Variant, sizeof(Variant), "Radius%d", Radius);
+		BEST_TIME(Time, cbContrastMapDestroy(cbContrastMapCreate(cbDeuteranopia, Pixels, Width, Height, Stride, cbRGBA8, Radius)));
+		Report("ContrastMap", Variant, 1, "Mpixel/s", Megapixels / Time);
+		Report("ContrastMap", Variant, 1, "ms", Time * 1e3);
+	}
+
+	free(Pixels);
+	return 0;
+}
@@ -1,11 +1,25 @@
 #define Assert(x) Test(x)
 #define _CRT_SECURE_NO_WARNINGS
 #include <sweet/sweet.h>
+#include <stdlib.h> /* abs */
+#include <string.h> /* memcpy, memcmp */
+#include <math.h>   /* pow, fabs */
 
 /* #define cbGAMMA_FAST */
+#define cbTHREADS
 #define cbIMPLEMENTATION
 #include "colourblind.h"
 
+/* The known colours below come from the accurate sRGB curve. cbGAMMA_FAST and cbGAMMA_FASTER are pure powers,
+ * so they give colours a few levels away, and the fixed-point tables and LUTs (which sample the curve) follow
+ * them less closely near black, where they have no linear segment. The tests added since allow for that. */
+#if defined(cbGAMMA_FAST) || defined(cbGAMMA_FASTER)
+#define APPROXIMATE_GAMMA 1
+#else
+#define APPROXIMATE_GAMMA 0
+#endif
+#define KNOWN_EXTRA (APPROXIMATE_GAMMA ? 7 : 0) /* levels away from a known colour */
+
 int main()
 {
 	cb_rgb_255 Black255 = {0,0,0}, Red255 = {255,0,0}, White255 = {255,255,255};
@@ -19,6 +33,22 @@ int main()
 		TestVEqEps(cbNormComponent(cbDenormComponent(0.6)), 0.6, 0.01f, "%f");
 	} EndTestGroup;
 
+	TestGroup("Gamma tables")
+	{
+		int DecodeMismatches = 0, EncodeMismatches = 0;
+		for(int i = 0; i < 256; ++i)
+		{ DecodeMismatches += cbRemoveGammaTable((unsigned char)i) != cbRemoveGammaComponent(cbNormComponent(i)); }
+		/* sample the floats in 0-1 by bit pattern */
+		union { float F; unsigned int U; } X;
+		for(X.U = 0; X.F <= 1.f; X.U += 997) {
+			float Exact = cbApplyGammaComponent(X.F);
+			EncodeMismatches += cbApplyGammaTable(X.F) != cbClampDenormComponent(Exact);
+		}
+		TestVEqEps(DecodeMismatches, 0, 0, "%d");
+		TestVEqEps(EncodeMismatches, 0, 0, "%d");
+		Test(cbApplyGammaTable(-0.5f) == 0 && cbApplyGammaTable(1.5f) == 255);
+	} EndTestGroup;
+
 	TestGroup("Conversions")
 	{
 		TestGroup("Colourblind")
@@ -86,6 +116,38 @@ int main()
 				EndTestGroup;
 #undef TEST
 			} EndTestGroup;
+
+			TestGroup("Out of range")
+			{
+				/* simulated colours can leave 0-1, and the 255 versions saturate rather than wrap */
+				cb_rgb_255 Denormed = cbDenorm((cb_rgb){ -0.25f, 1.5f, 1.f });
+				Test(Denormed.R == 0 && Denormed.G == 255 && Denormed.B == 255);
+				cb_rgb_255 (*Gammas[cbImpairmentCount])(cb_rgb_255) = { 0, ProtanopiaRGB255Gamma, DeuteranopiaRGB255Gamma,
+					TritanopiaRGB255Gamma, AchromatopsiaRGB255Gamma, BlueConeMonochromacyRGB255Gamma };
+				int Outside = 0, Mismatches = 0, MaxGammaDiff = 0;
+				for(cb_impairment Impairment = cbProtanopia; Impairment < cbImpairmentCount; ++Impairment)
+				for(int i = 0; i < 16*16*16; ++i) {
+					cb_rgb_255 In = { (unsigned char)(i >> 8) * 17, (unsigned char)(i >> 4 & 15) * 17, (unsigned char)(i & 15) * 17 };
+					cb_rgb RGB = ColourblindRGB(Impairment, cbNorm(In));
+					Outside += RGB.R < 0.f || RGB.G < 0.f || RGB.B < 0.f || RGB.R > 1.f || RGB.G > 1.f || RGB.B > 1.f;
+					unsigned char R = In.R, G = In.G, B = In.B;
+					Colourblind255(Impairment, &R, &G, &B);
+					Mismatches += R != cbClampDenormComponent(RGB.R) || G != cbClampDenormComponent(RGB.G) || B != cbClampDenormComponent(RGB.B);
+
+					RGB = ColourblindRGB(Impairment, cbRemoveGammaRGB(cbNorm(In)));
+					RGB.R = RGB.R < 0.f ? 0.f : RGB.R > 1.f ? 1.f : RGB.R;
+					RGB.G = RGB.G < 0.f ? 0.f : RGB.G > 1.f ? 1.f : RGB.G;
+					RGB.B = RGB.B < 0.f ? 0.f : RGB.B > 1.f ? 1.f : RGB.B;
+					cb_rgb_255 Expected = cbDenorm(cbApplyGammaRGB(RGB)), Out = Gammas[Impairment](In);
+					int Diffs[3] = { abs(Expected.R - Out.R), abs(Expected.G - Out.G), abs(Expected.B - Out.B) };
+					for(int c = 0; c < 3; ++c) { if(Diffs[c] > MaxGammaDiff) { MaxGammaDiff = Diffs[c]; } }
+				}
+				Test(Outside > 0);
+				TestVEqEps(Mismatches, 0, 0, "%d");
+#if !defined(cbGAMMA_FAST) && !defined(cbGAMMA_FASTER)
+				TestVEqEps(MaxGammaDiff, 0, 1, "%d");
+#endif
+			} EndTestGroup;
 		} EndTestGroup;
 
 	} EndTestGroup;
@@ -106,6 +168,1048 @@ int main()
 	}
 	EndTestGroup;
 
+	TestGroup("Images")
+	{
+		/* a coarse grid over every channel, with a padded stride and alpha that should be left alone */
+		enum { Step = 15, N = 256/Step + 1, Width = N*N, Height = N, Stride = Width*4 + 8 };
+		static unsigned char Original[Height*Stride], Pixels[Height*Stride];
+		for(int y = 0; y < Height; ++y) for(int x = 0; x < Width; ++x) {
+			unsigned char *P = Original + y*Stride + x*4;
+			P[0] = (unsigned char)(Step * (x / N)), P[1] = (unsigned char)(Step * (x % N)), P[2] = (unsigned char)(Step * y);
+			P[3] = (unsigned char)(x + y);
+		}
+
+		for(int Gamma = 0; Gamma <= 1; ++Gamma)
+		for(cb_impairment Impairment = cbUnimpaired; Impairment < cbImpairmentCount; ++Impairment) {
+			int MaxDiff = 0, AlphaChanged = 0;
+			memcpy(Pixels, Original, sizeof(Pixels));
+			if(Gamma) { ColourblindImageGamma(Impairment, Pixels, Width, Height, Stride, cbRGBA8); }
+			else      { ColourblindImage(     Impairment, Pixels, Width, Height, Stride, cbRGBA8); }
+
+			for(int y = 0; y < Height; ++y) for(int x = 0; x < Width; ++x) {
+				unsigned char *In = Original + y*Stride + x*4, *Out = Pixels + y*Stride + x*4;
+				cb_rgb RGB = cbNorm((cb_rgb_255){ In[0], In[1], In[2] });
+				if(Gamma) { RGB = cbApplyGammaRGB(ColourblindRGB(Impairment, cbRemoveGammaRGB(RGB))); }
+				else      { RGB = ColourblindRGB(Impairment, RGB); }
+				int Expected[3] = { cbClampDenormComponent(RGB.R), cbClampDenormComponent(RGB.G), cbClampDenormComponent(RGB.B) };
+				if(Impairment == cbUnimpaired) { Expected[0] = In[0], Expected[1] = In[1], Expected[2] = In[2]; }
+				for(int c = 0; c < 3; ++c) {
+					int Diff = abs(Expected[c] - Out[c]);
+					if(Diff > MaxDiff) { MaxDiff = Diff; }
+				}
+				AlphaChanged |= In[3] != Out[3];
+			}
+			TestVEqEps(MaxDiff, 0, 0, "%d");
+			Test(! AlphaChanged);
+			Test(! memcmp(Pixels + Width*4, Original + Width*4, 8)); /* row padding */
+		}
+
+		TestGroup("Formats agree")
+		{
+			unsigned char RGB[] = { 0x88,0x00,0x27, 0x00,0xAA,0xAD, 0xEF,0x3F,0x6D };
+			unsigned char BGRA[] = { 0x27,0x00,0x88,1, 0xAD,0xAA,0x00,2, 0x6D,0x3F,0xEF,3 };
+			ColourblindImageGamma(cbDeuteranopia, RGB,  3, 1, sizeof(RGB),  cbRGB8);
+			ColourblindImageGamma(cbDeuteranopia, BGRA, 3, 1, sizeof(BGRA), cbBGRA8);
+			for(int i = 0; i < 3; ++i) {
+				Test(RGB[3*i + 0] == BGRA[4*i + 2] && RGB[3*i + 1] == BGRA[4*i + 1] && RGB[3*i + 2] == BGRA[4*i + 0]);
+				Test(BGRA[4*i + 3] == i + 1);
+			}
+			TestVEqEps(RGB[0], 0x51, 1 + KNOWN_EXTRA, "%X"); /* Burgundy, as above */
+		} EndTestGroup;
+	}
+	EndTestGroup;
+
+	TestGroup("Threads")
+	{
+		enum { Width = 1500, Height = 301, Stride = Width*3 + 5 };
+		static unsigned char Original[Height*Stride], Gamma[Height*Stride], Linear[Height*Stride], Threaded[Height*Stride];
+		unsigned int Seed = 12345;
+		for(int i = 0; i < Height*Stride; ++i) {
+			Seed = Seed * 1103515245u + 12345u;
+			Original[i] = (unsigned char)(Seed >> 16);
+		}
+		memcpy(Gamma,  Original, sizeof(Original));
+		memcpy(Linear, Original, sizeof(Original));
+		ColourblindImageGamma(cbTritanopia, Gamma,  Width, Height, Stride, cbRGB8);
+		ColourblindImage(     cbProtanopia, Linear, Width, Height, Stride, cbRGB8);
+
+		int ThreadCounts[] = { 1, 3, 4 };
+		for(int i = 0; i < 3; ++i) {
+			cb_pool *Pool = cbPoolCreate(ThreadCounts[i]);
+			Test(cbPoolThreadCount(Pool) == ThreadCounts[i]);
+			/* the same pool is reused across calls */
+			memcpy(Threaded, Original, sizeof(Original));
+			ColourblindImageGammaThreaded(Pool, cbTritanopia, Threaded, Width, Height, Stride, cbRGB8);
+			Test(! memcmp(Threaded, Gamma, sizeof(Gamma)));
+			memcpy(Threaded, Original, sizeof(Original));
+			ColourblindImageThreaded(Pool, cbProtanopia, Threaded, Width, Height, Stride, cbRGB8);
+			Test(! memcmp(Threaded, Linear, sizeof(Linear)));
+			cbPoolDestroy(Pool);
+		}
+	}
+	EndTestGroup;
+
+	TestGroup("Multiple impairments")
+	{
+		/* the fused versions should match copying the image and simulating each copy */
+		enum { Width = 300, Height = 37, Stride = Width*4 + 4, Count = 4, CompositeStride = Count*Width*4 };
+		static unsigned char Original[Height*Stride], Separate[Count][Height*Stride], Fused[Count][Height*Stride];
+		static unsigned char Composite[Height*CompositeStride], InPlace[Height*Stride];
+		cb_impairment Impairments[Count] = { cbUnimpaired, cbProtanopia, cbDeuteranopia, cbTritanopia };
+		unsigned int Seed = 99;
+		for(int i = 0; i < Height*Stride; ++i) {
+			Seed = Seed * 1103515245u + 12345u;
+			Original[i] = (unsigned char)(Seed >> 16);
+		}
+		cb_pool *Pool = cbPoolCreate(3);
+		cb_format Formats[] = { cbRGBA8, cbRGB8, cbRGBA16, cbRGB16F };
+		for(int f = 0; f < 4; ++f)
+		for(int Gamma = 0; Gamma <= 1; ++Gamma) {
+			cb_format Format = Formats[f];
+			int Size = Format == cbRGBA8 ? 4 : Format == cbRGB8 ? 3 : Format == cbRGBA16 ? 8 : 6;
+			int Pixels = Width*4 / Size, Mismatches = 0;
+			unsigned char *Outputs[Count], *Tiles[Count];
+			for(int i = 0; i < Count; ++i) {
+				memcpy(Separate[i], Original, sizeof(Original));
+				if(Gamma) { ColourblindImageGamma(Impairments[i], Separate[i], Pixels, Height, Stride, Format); }
+				else      { ColourblindImage(     Impairments[i], Separate[i], Pixels, Height, Stride, Format); }
+				Outputs[i] = Fused[i];
+				Tiles[i] = Composite + i*Pixels*Size;
+			}
+			memcpy(InPlace, Original, sizeof(Original));
+			Outputs[2] = InPlace;
+			if(Gamma) { ColourblindImagesGamma(Impairments, Count, InPlace, Pixels, Height, Stride, Format, Outputs, Stride); }
+			else      { ColourblindImages(     Impairments, Count, InPlace, Pixels, Height, Stride, Format, Outputs, Stride); }
+			Outputs[2] = Fused[2];
+			memcpy(Fused[2], InPlace, sizeof(InPlace));
+			for(int i = 0; i < Count; ++i)
+			for(int y = 0; y < Height; ++y)
+			{ Mismatches += memcmp(Fused[i] + y*Stride, Separate[i] + y*Stride, Pixels*Size) != 0; }
+
+			/* side by side, across threads */
+			if(Gamma) { ColourblindImagesGammaThreaded(Pool, Impairments, Count, Original, Pixels, Height, Stride, Format, Tiles, CompositeStride); }
+			else      { ColourblindImagesThreaded(     Pool, Impairments, Count, Original, Pixels, Height, Stride, Format, Tiles, CompositeStride); }
+			for(int i = 0; i < Count; ++i)
+			for(int y = 0; y < Height; ++y)
+			{ Mismatches += memcmp(Tiles[i] + y*CompositeStride, Separate[i] + y*Stride, Pixels*Size) != 0; }
+			TestVEqEps(Mismatches, 0, 0, "%d");
+		}
+
+		/* matrices, where a null one copies */
+		float Protanomaly[9];
+		cbAnomalyMatrix(cbProtanomaly, 0.5f, Protanomaly);
+		float *Matrices[2] = { Protanomaly, 0 };
+		unsigned char *Outputs[2] = { Fused[0], Fused[1] };
+		memcpy(Separate[0], Original, sizeof(Original));
+		cbMatrixImageGamma(Protanomaly, Separate[0], Width, Height, Stride, cbRGBA8);
+		cbMatrixImagesGamma(Matrices, 2, Original, Width, Height, Stride, cbRGBA8, Outputs, Stride);
+		int Mismatches = 0;
+		for(int y = 0; y < Height; ++y) {
+			Mismatches += memcmp(Fused[0] + y*Stride, Separate[0] + y*Stride, Width*4) != 0;
+			Mismatches += memcmp(Fused[1] + y*Stride, Original + y*Stride, Width*4) != 0;
+		}
+		TestVEqEps(Mismatches, 0, 0, "%d");
+
+		/* an in-place output listed before the others mustn't change what they copy */
+		for(int Threaded = 0; Threaded <= 1; ++Threaded) {
+			unsigned char Source[2*3] = { 200,30,40, 200,30,40 }, Copy[2*3];
+			cb_impairment InPlaceFirst[2] = { cbProtanopia, cbUnimpaired };
+			unsigned char *SourceOutputs[2] = { Source, Copy };
+			if(Threaded) { ColourblindImagesThreaded(Pool, InPlaceFirst, 2, Source, 2, 1, 2*3, cbRGB8, SourceOutputs, 2*3); }
+			else         { ColourblindImages(InPlaceFirst, 2, Source, 2, 1, 2*3, cbRGB8, SourceOutputs, 2*3); }
+			cb_rgb_255 Expected = ColourblindRGB255(cbProtanopia, (cb_rgb_255){ 200,30,40 });
+			Test(Copy[3] == 200 && Copy[4] == 30 && Copy[5] == 40);
+			Test(Source[3] == Expected.R && Source[4] == Expected.G && Source[5] == Expected.B);
+		}
+		cbPoolDestroy(Pool);
+	}
+	EndTestGroup;
+
+	TestGroup("Unique colours")
+	{
+		/* deduplicated simulation should match simulating every pixel, and fall back for noise and 16-bit */
+		enum { Width = 300, Height = 37, Stride = Width*4 + 4, Colours = 40 };
+		static unsigned char Original[Height*Stride], Direct[Height*Stride], Unique[Height*Stride];
+		unsigned char Palette[Colours][3];
+		unsigned int Seed = 7;
+		for(int i = 0; i < Colours*3; ++i) {
+			Seed = Seed * 1103515245u + 12345u;
+			Palette[i/3][i%3] = (unsigned char)(Seed >> 16);
+		}
+		cb_format Formats[] = { cbRGBA8, cbBGR8, cbRGBA8, cbRGBA16 };
+		for(int f = 0; f < 4; ++f)
+		for(int Gamma = 0; Gamma <= 1; ++Gamma) {
+			cb_format Format = Formats[f];
+			int Size = Format == cbRGBA8 ? 4 : Format == cbBGR8 ? 3 : 8, Pixels = Width*4 / Size, Mismatches = 0;
+			int Noise = f >= 2, FellBack = -1;
+			for(int y = 0; y < Height; ++y)
+			for(int x = 0; x < Stride; ++x) {
+				/* flat runs of each colour, or noise */
+				Seed = Seed * 1103515245u + 12345u;
+				Original[y*Stride + x] = Noise ? (unsigned char)(Seed >> 16) : Palette[(x/Size/7 + y) % Colours][x%Size % 3];
+			}
+			memcpy(Direct, Original, sizeof(Original));
+			memcpy(Unique, Original, sizeof(Original));
+			int Count;
+			if(Gamma) { ColourblindImageGamma(cbDeuteranopia, Direct, Pixels, Height, Stride, Format); Count = ColourblindImageGammaUnique(cbDeuteranopia, Unique, Pixels, Height, Stride, Format, &FellBack); }
+			else      { ColourblindImage(     cbDeuteranopia, Direct, Pixels, Height, Stride, Format); Count = ColourblindImageUnique(     cbDeuteranopia, Unique, Pixels, Height, Stride, Format, &FellBack); }
+			Mismatches += memcmp(Direct, Unique, sizeof(Direct)) != 0;
+			TestVEqEps(Mismatches, 0, 0, "%d");
+			TestVEqEps(FellBack, Noise, 0, "%d");
+			/* noise falls back after the colours seen so far, while 16-bit isn't deduplicated at all */
+			if(! Noise)                 { TestVEqEps(Count, Colours, 0, "%d"); }
+			else if(Format == cbRGBA16) { TestVEqEps(Count, 0, 0, "%d"); }
+			else                        { Test(Count >= cbUNIQUE_MIN_COLOURS); }
+		}
+
+		/* matrices */
+		float Protanomaly[9];
+		cbAnomalyMatrix(cbProtanomaly, 0.5f, Protanomaly);
+		memcpy(Direct, Original, sizeof(Original));
+		memcpy(Unique, Original, sizeof(Original));
+		cbMatrixImageGamma(Protanomaly, Direct, Width, Height, Stride, cbRGBA8);
+		cbMatrixImageGammaUnique(Protanomaly, Unique, Width, Height, Stride, cbRGBA8, 0);
+		Test(memcmp(Direct, Unique, sizeof(Direct)) == 0);
+	}
+	EndTestGroup;
+
+	TestGroup("Fixed point")
+	{
+		/* every 8-bit colour, once each, should be within 1 of the float versions */
+		enum { Width = 4096, Height = 4096, Stride = Width*3 };
+		unsigned char *Original = malloc((size_t)Stride*Height), *Float = malloc((size_t)Stride*Height), *Fixed = malloc((size_t)Stride*Height);
+		Assert(Original && Float && Fixed);
+		for(int i = 0; i < Width*Height; ++i)
+		{ Original[3*i] = (unsigned char)(i >> 16), Original[3*i + 1] = (unsigned char)(i >> 8), Original[3*i + 2] = (unsigned char)i; }
+		for(int Impairment = cbProtanopia; Impairment < cbImpairmentCount; ++Impairment)
+		for(int Gamma = 0; Gamma <= 1; ++Gamma) {
+			memcpy(Float, Original, (size_t)Stride*Height);
+			memcpy(Fixed, Original, (size_t)Stride*Height);
+			if(Gamma) { ColourblindImageGamma((cb_impairment)Impairment, Float, Width, Height, Stride, cbRGB8); ColourblindImageGammaFixed((cb_impairment)Impairment, Fixed, Width, Height, Stride, cbRGB8); }
+			else      { ColourblindImage(     (cb_impairment)Impairment, Float, Width, Height, Stride, cbRGB8); ColourblindImageFixed(     (cb_impairment)Impairment, Fixed, Width, Height, Stride, cbRGB8); }
+			int MaxError = 0, Mismatches = 0;
+			for(size_t i = 0; i < (size_t)Stride*Height; ++i) {
+				int Error = abs(Float[i] - Fixed[i]);
+				MaxError = Error > MaxError ? Error : MaxError;
+			}
+			/* the single-colour versions match the image ones */
+			for(int i = 0; i < Width*Height; i += 997) {
+				cb_rgb_255 Colour = { Original[3*i], Original[3*i + 1], Original[3*i + 2] };
+				cb_rgb_255 Result = Gamma ? ColourblindRGB255GammaFixed((cb_impairment)Impairment, Colour) : ColourblindRGB255Fixed((cb_impairment)Impairment, Colour);
+				Mismatches += Result.R != Fixed[3*i] || Result.G != Fixed[3*i + 1] || Result.B != Fixed[3*i + 2];
+			}
+			TestVEqEps(MaxError, 0, APPROXIMATE_GAMMA ? 3 : 1, "%d");
+			TestVEqEps(Mismatches, 0, 0, "%d");
+		}
+		free(Original), free(Float), free(Fixed);
+
+		/* rows that sum to 1 keep their sum, so greys stay grey */
+		float Protanomaly[9];
+		short Matrix[9];
+		cbAnomalyMatrix(cbProtanomaly, 0.7f, Protanomaly);
+		cbFixedMatrix(Protanomaly, Matrix);
+		TestVEqEps(Matrix[0] + Matrix[1] + Matrix[2], 16384, 0, "%d");
+		TestVEqEps(Matrix[3] + Matrix[4] + Matrix[5], 16384, 0, "%d");
+		TestVEqEps(Matrix[6] + Matrix[7] + Matrix[8], 16384, 0, "%d");
+		for(int Grey = 0; Grey < 256; Grey += 15) {
+			cb_rgb_255 Colour = { (unsigned char)Grey, (unsigned char)Grey, (unsigned char)Grey };
+			cb_rgb_255 Result = cbFixedRGB255Gamma(Matrix, Colour);
+			Test(Result.R == Grey && Result.G == Grey && Result.B == Grey);
+		}
+
+		/* 16-bit images fall back to the float functions */
+		unsigned short Deep[4] = { 65535, 1000, 30000, 7 }, DeepFloat[4];
+		float Rounded[9];
+		memcpy(DeepFloat, Deep, sizeof(Deep));
+		for(int i = 0; i < 9; ++i) { Rounded[i] = Matrix[i] / 16384.f; }
+		cbFixedImageGamma(Matrix, (unsigned char *)Deep, 1, 1, 8, cbRGBA16);
+		cbMatrixImageGamma(Rounded, (unsigned char *)DeepFloat, 1, 1, 8, cbRGBA16);
+		Test(memcmp(Deep, DeepFloat, sizeof(Deep)) == 0);
+	}
+	EndTestGroup;
+
+	TestGroup("Planar and high bit depth")
+	{
+		enum { Count = 1000 };
+		static float R[Count], G[Count], B[Count], Luminance[Count];
+		static unsigned short Pixels16[Count*4], Original16[Count*4], Threaded16[Count*4];
+		unsigned int Seed = 1;
+		for(int i = 0; i < Count; ++i) {
+			Seed = Seed * 1103515245u + 12345u; R[i] = (Seed >> 8 & 0xFFFF) / 65535.f;
+			Seed = Seed * 1103515245u + 12345u; G[i] = (Seed >> 8 & 0xFFFF) / 65535.f;
+			Seed = Seed * 1103515245u + 12345u; B[i] = (Seed >> 8 & 0xFFFF) / 65535.f;
+			Original16[4*i] = (unsigned short)(R[i] * 65535.f + 0.5f), Original16[4*i+1] = (unsigned short)(G[i] * 65535.f + 0.5f);
+			Original16[4*i+2] = (unsigned short)(B[i] * 65535.f + 0.5f), Original16[4*i+3] = (unsigned short)i;
+		}
+
+		int LuminanceMismatches = 0, PlanarMismatches = 0;
+		cbLuminancePlanar(R, G, B, Luminance, Count);
+		for(int i = 0; i < Count; ++i) { LuminanceMismatches += Luminance[i] != cbLuminance(R[i], G[i], B[i]); }
+		cb_rgb Expected[Count];
+		for(int i = 0; i < Count; ++i) { Expected[i] = ColourblindRGB(cbTritanopia, (cb_rgb){ R[i], G[i], B[i] }); }
+		ColourblindPlanar(cbTritanopia, R, G, B, Count);
+		for(int i = 0; i < Count; ++i) { PlanarMismatches += R[i] != Expected[i].R || G[i] != Expected[i].G || B[i] != Expected[i].B; }
+		TestVEqEps(LuminanceMismatches, 0, 0, "%d");
+		TestVEqEps(PlanarMismatches, 0, 0, "%d");
+
+		/* every half round-trips through float */
+		int HalfMismatches = 0;
+		for(int h = 0; h < 0x10000; ++h) {
+			if((h & 0x7C00) == 0x7C00 && (h & 0x3FF)) { continue; } /* NaN */
+			HalfMismatches += cbFloatToHalf(cbHalfToFloat((unsigned short)h)) != h;
+		}
+		TestVEqEps(HalfMismatches, 0, 0, "%d");
+		Test(cbFloatToHalf(1.f) == 0x3C00 && cbFloatToHalf(0.1f) == 0x2E66 && cbFloatToHalf(-2.f) == 0xC000);
+		Test(cbFloatToHalf(65504.f) == 0x7BFF && cbFloatToHalf(65520.f) == 0x7C00 && cbFloatToHalf(5.9604645e-8f) == 0x0001);
+
+		for(int Gamma = 0; Gamma <= 1; ++Gamma)
+		for(int Half = 0; Half <= 1; ++Half) {
+			cb_format Format = Half ? cbRGBA16F : cbRGBA16;
+			int Mismatches = 0, AlphaChanged = 0;
+			for(int i = 0; i < Count*4; ++i)
+			{ Pixels16[i] = Half && i % 4 != 3 ? cbFloatToHalf(Original16[i] / 65535.f) : Original16[i]; }
+			memcpy(Threaded16, Pixels16, sizeof(Pixels16));
+			for(int i = 0; i < Count; ++i) {
+				cb_rgb In;
+				if(Half) { In = (cb_rgb){ cbHalfToFloat(Pixels16[4*i]), cbHalfToFloat(Pixels16[4*i+1]), cbHalfToFloat(Pixels16[4*i+2]) }; }
+				else     { In = (cb_rgb){ Pixels16[4*i] / 65535.f, Pixels16[4*i+1] / 65535.f, Pixels16[4*i+2] / 65535.f }; }
+				Expected[i] = Gamma ? cbApplyGammaRGB(ColourblindRGB(cbProtanopia, cbRemoveGammaRGB(In)))
+				                    : ColourblindRGB(cbProtanopia, In);
+			}
+			if(Gamma) { ColourblindImageGamma(cbProtanopia, (unsigned char *)Pixels16, Count, 1, sizeof(Pixels16), Format); }
+			else      { ColourblindImage(     cbProtanopia, (unsigned char *)Pixels16, Count, 1, sizeof(Pixels16), Format); }
+			for(int i = 0; i < Count; ++i) {
+				if(Half) {
+					Mismatches += Pixels16[4*i] != cbFloatToHalf(Expected[i].R) || Pixels16[4*i+1] != cbFloatToHalf(Expected[i].G) ||
+					              Pixels16[4*i+2] != cbFloatToHalf(Expected[i].B);
+				} else {
+					Mismatches += Pixels16[4*i] != cbClampDenorm16Component(Expected[i].R) ||
+					              Pixels16[4*i+1] != cbClampDenorm16Component(Expected[i].G) ||
+					              Pixels16[4*i+2] != cbClampDenorm16Component(Expected[i].B);
+				}
+				AlphaChanged |= Pixels16[4*i+3] != Original16[4*i+3];
+			}
+			TestVEqEps(Mismatches, 0, 0, "%d");
+			Test(! AlphaChanged);
+
+			cb_pool *Pool = cbPoolCreate(2);
+			if(Gamma) { ColourblindImageGammaThreaded(Pool, cbProtanopia, (unsigned char *)Threaded16, Count, 1, sizeof(Threaded16), Format); }
+			else      { ColourblindImageThreaded(     Pool, cbProtanopia, (unsigned char *)Threaded16, Count, 1, sizeof(Threaded16), Format); }
+			cbPoolDestroy(Pool);
+			Test(! memcmp(Threaded16, Pixels16, sizeof(Pixels16)));
+		}
+
+		/* the components can be at any alignment */
+		static unsigned char Unaligned[1 + sizeof(Pixels16)];
+		memcpy(Unaligned + 1, Original16, sizeof(Original16));
+		memcpy(Pixels16, Original16, sizeof(Original16));
+		ColourblindImageGamma(cbProtanopia, Unaligned + 1, Count, 1, sizeof(Pixels16), cbRGBA16);
+		ColourblindImageGamma(cbProtanopia, (unsigned char *)Pixels16, Count, 1, sizeof(Pixels16), cbRGBA16);
+		Test(! memcmp(Unaligned + 1, Pixels16, sizeof(Pixels16)));
+
+		/* luminance planes match the per-colour functions */
+		float Luminance8[Count], Luminance16[Count];
+		unsigned char Pixels8[Count*4];
+		for(int i = 0; i < Count*4; ++i) { Pixels8[i] = (unsigned char)(Original16[i] >> 8); }
+		cbLuminanceImage(Pixels8, Count, 1, sizeof(Pixels8), cbRGBA8, Luminance8);
+		cbLuminanceImage((unsigned char *)Original16, Count, 1, sizeof(Original16), cbRGBA16, Luminance16);
+		float MaxDiff8 = 0.f, MaxDiff16 = 0.f;
+		for(int i = 0; i < Count; ++i) {
+			float Diff8 = fabsf(Luminance8[i] - cbLuminance255(Pixels8[4*i], Pixels8[4*i+1], Pixels8[4*i+2]));
+			float Diff16 = fabsf(Luminance16[i] - cbLuminance(Original16[4*i] / 65535.f, Original16[4*i+1] / 65535.f, Original16[4*i+2] / 65535.f));
+			if(Diff8 > MaxDiff8) { MaxDiff8 = Diff8; }
+			if(Diff16 > MaxDiff16) { MaxDiff16 = Diff16; }
+		}
+		TestVEqEps(MaxDiff8, 0.f, 0.f, "%g");
+		TestVEqEps(MaxDiff16, 0.f, 1e-6f, "%g");
+
+		/* 3D LUTs work on the wider formats too */
+		cb_lut *Lut = cbLutCreate(cbDeuteranopia, 33);
+		memcpy(Pixels16, Original16, sizeof(Pixels16));
+		memcpy(Threaded16, Original16, sizeof(Pixels16));
+		cbLutImage(Lut, (unsigned char *)Pixels16, Count, 1, sizeof(Pixels16), cbRGBA16);
+		ColourblindImageGamma(cbDeuteranopia, (unsigned char *)Threaded16, Count, 1, sizeof(Threaded16), cbRGBA16);
+		int LutError = 0;
+		for(int i = 0; i < Count*4; ++i) {
+			int Error = abs(Pixels16[i] - Threaded16[i]);
+			if(Error > LutError) { LutError = Error; }
+		}
+		TestVEqEps(LutError, 0, (APPROXIMATE_GAMMA ? 20 : 2)*257, "%d"); /* as for 8-bit: within 2 of 255 */
+		cbLutDestroy(Lut);
+	}
+	EndTestGroup;
+
+	TestGroup("Polynomial gamma")
+	{
+		/* the published maximum errors, against the exact curve in double precision */
+		const float RemoveBound[cbGammaTierCount] = { 1.6e-3f, 8.2e-5f, 4.9e-7f };
+		const float ApplyBound[cbGammaTierCount]  = { 1.8e-3f, 8.6e-5f, 2.6e-7f };
+		enum { Count = 4096 };
+		static float In[Count+1], Removed[Count+1], Applied[Count+1]; /* room to add 1 to the last run */
+		for(int Tier = 0; Tier < cbGammaTierCount; ++Tier) {
+			double RemoveError = 0, ApplyError = 0;
+			int Mismatches = 0;
+			/* a spread of bit patterns covers every exponent in 0-1 evenly */
+			for(unsigned int Start = 0; Start <= 0x3F800000u; Start += Count * 127) {
+				union { unsigned int U; float F; } Bits;
+				int n = 0;
+				for(Bits.U = Start; n < Count && Bits.U <= 0x3F800000u; Bits.U += 127) { In[n++] = Bits.F; }
+				if(Start + Count * 127 > 0x3F800000u) { In[n++] = 1.f; }
+				memcpy(Removed, In, n * sizeof(float)), memcpy(Applied, In, n * sizeof(float));
+				cbRemoveGammaPlanar((cb_gamma_tier)Tier, Removed, n);
+				cbApplyGammaPlanar((cb_gamma_tier)Tier, Applied, n);
+				for(int i = 0; i < n; ++i) {
+					double X = In[i];
+					double Remove = X > 0.04045 ? pow((X + 0.055) / 1.055, 2.4) : X / 12.92;
+					double Apply  = X > 0.00313080495356037151702786377709 ? 1.055 * pow(X, 1 / 2.4) - 0.055 : X * 12.92;
+					if(fabs(Removed[i] - Remove) > RemoveError) { RemoveError = fabs(Removed[i] - Remove); }
+					if(fabs(Applied[i] - Apply)  > ApplyError)  { ApplyError  = fabs(Applied[i] - Apply); }
+					Mismatches += Removed[i] != cbRemoveGammaPoly((cb_gamma_tier)Tier, In[i]) ||
+					              Applied[i] != cbApplyGammaPoly((cb_gamma_tier)Tier, In[i]);
+				}
+			}
+			TestVEqEps(RemoveError, 0, RemoveBound[Tier], "%g");
+			TestVEqEps(ApplyError,  0, ApplyBound[Tier],  "%g");
+			TestVEqEps(Mismatches, 0, 0, "%d");
+			Test(cbRemoveGammaPoly((cb_gamma_tier)Tier, 0.f) == 0.f && cbRemoveGammaPoly((cb_gamma_tier)Tier, 1.f) == 1.f);
+			Test(cbApplyGammaPoly((cb_gamma_tier)Tier, 0.f) == 0.f && cbApplyGammaPoly((cb_gamma_tier)Tier, 1.f) == 1.f);
+		}
+	}
+	EndTestGroup;
+
+	TestGroup("Monochromacy")
+	{
+		cb_rgb_255 Colours[] = { { 0xFF,0xFF,0xFF }, { 0x80,0x80,0x80 }, { 0x88,0x00,0x27 }, { 0x00,0xAA,0xAD } };
+		for(int i = 0; i < 4; ++i) {
+			cb_rgb_255 Achromat = AchromatopsiaRGB255Gamma(Colours[i]), BlueCone = BlueConeMonochromacyRGB255Gamma(Colours[i]);
+			Test(Achromat.R == Achromat.G && Achromat.G == Achromat.B);
+			Test(BlueCone.R == BlueCone.G && BlueCone.G == BlueCone.B);
+			if(i < 2) { Test(Achromat.R == Colours[i].R && BlueCone.R == Colours[i].R); } /* greys are unchanged */
+		}
+		/* the achromat sees exactly the luminance */
+		cb_rgb Teal = cbRemoveGammaRGB(cbNorm(Colours[3]));
+		TestVEqEps(AchromatopsiaRGB(Teal).G, cbLuminanceRGB255(Colours[3]), 0.000001, "%f");
+		/* and the blue cone monochromat can't tell red from green */
+		cb_rgb_255 Red = { 0xFF,0x00,0x00 }, Green = { 0x00,0xFF,0x00 };
+		TestVEqEps(BlueConeMonochromacyRGB255(Red).R, BlueConeMonochromacyRGB255(Green).R, 0x20, "%X");
+	}
+	EndTestGroup;
+
+	TestGroup("Anomalous trichromacy")
+	{
+		float Matrix[9];
+		int NoneMismatches = 0, FullMismatches = 0;
+		for(cb_impairment Impairment = cbUnimpaired; Impairment < cbImpairmentCount; ++Impairment) {
+			cbImpairmentMatrix(Impairment, 0.f, Matrix);
+			NoneMismatches += memcmp(Matrix, cbImpairmentMatrices[cbUnimpaired], sizeof(Matrix)) != 0;
+			cbImpairmentMatrix(Impairment, 1.f, Matrix);
+			FullMismatches += memcmp(Matrix, cbImpairmentMatrices[Impairment], sizeof(Matrix)) != 0;
+		}
+		TestVEqEps(NoneMismatches, 0, 0, "%d");
+		TestVEqEps(FullMismatches, 0, 0, "%d");
+
+		/* a blend should move steadily from the original to the full simulation */
+		cb_rgb_255 Pink = { 0xEF,0x3F,0x6D }, Previous = Pink;
+		for(int Step = 0; Step <= 10; ++Step) {
+			cbImpairmentMatrix(cbDeuteranopia, Step / 10.f, Matrix);
+			cb_rgb_255 Simulated = cbMatrixRGB255Gamma(Matrix, Pink);
+			Test(Simulated.R <= Previous.R && Simulated.G >= Previous.G);
+			Previous = Simulated;
+		}
+		cb_rgb_255 Full = DeuteranopiaRGB255Gamma(Pink);
+		Test(Previous.R == Full.R && Previous.G == Full.G && Previous.B == Full.B);
+
+		/* the anomalies give Machado et al.'s matrices at each step, and interpolate between them */
+		int StepMismatches = 0;
+		for(cb_anomaly Anomaly = cbProtanomaly; Anomaly < cbAnomalyCount; ++Anomaly)
+		for(int Step = 0; Step <= cbANOMALY_STEPS; ++Step) {
+			cbAnomalyMatrix(Anomaly, (float)Step / cbANOMALY_STEPS, Matrix);
+			for(int i = 0; i < 9; ++i) { StepMismatches += fabsf(Matrix[i] - cbAnomalyMatrices[Anomaly][Step][i]) > 1e-6f; }
+		}
+		TestVEqEps(StepMismatches, 0, 0, "%d");
+		cbAnomalyMatrix(cbDeuteranomaly, 0.25f, Matrix);
+		TestVEqEps(Matrix[0], (cbAnomalyMatrices[cbDeuteranomaly][2][0] + cbAnomalyMatrices[cbDeuteranomaly][3][0]) / 2, 1e-6f, "%f");
+		cbAnomalyMatrix(cbTritanomaly, -1.f, Matrix);
+		Test(! memcmp(Matrix, cbImpairmentMatrices[cbUnimpaired], sizeof(Matrix)));
+		cbAnomalyMatrix(cbTritanomaly, 2.f, Matrix);
+		Test(! memcmp(Matrix, cbAnomalyMatrices[cbTritanomaly][cbANOMALY_STEPS], sizeof(Matrix)));
+
+		/* every row keeps white, and a red-green sweep takes pink steadily towards its dichromat simulation */
+		int WhiteMismatches = 0;
+		for(cb_anomaly Anomaly = cbProtanomaly; Anomaly < cbAnomalyCount; ++Anomaly)
+		for(int Step = 0; Step <= 20; ++Step) {
+			cb_rgb_255 White = { 0xFF,0xFF,0xFF };
+			White = ColourblindRGB255GammaAnomaly(Anomaly, Step / 20.f, White);
+			WhiteMismatches += White.R != 0xFF || White.G != 0xFF || White.B != 0xFF;
+		}
+		TestVEqEps(WhiteMismatches, 0, 0, "%d");
+		Previous = Pink;
+		for(int Step = 0; Step <= 10; ++Step) {
+			cb_rgb_255 Simulated = ColourblindRGB255GammaAnomaly(cbDeuteranomaly, Step / 10.f, Pink);
+			Test(Simulated.R <= Previous.R && Simulated.G >= Previous.G);
+			Previous = Simulated;
+		}
+		TestVEqEps(Previous.R, Full.R, 0x10, "%X");
+		TestVEqEps(Previous.G, Full.G, 0x10, "%X");
+		TestVEqEps(Previous.B, Full.B, 0x10, "%X");
+
+		/* the cached severities are rounded to the nearest 1/cbANOMALY_CACHE_STEPS */
+		{
+			unsigned char Pixels[3*256], Cached[3*256];
+			for(int i = 0; i < 3*256; ++i) { Pixels[i] = (unsigned char)(i * 7); }
+			memcpy(Cached, Pixels, sizeof(Pixels));
+			cbAnomalyMatrix(cbProtanomaly, 0.37f, Matrix);
+			cbMatrixImageGamma(Matrix, Pixels, 256, 1, sizeof(Pixels), cbRGB8);
+			ColourblindImageGammaAnomaly(cbProtanomaly, 0.3703f, Cached, 256, 1, sizeof(Cached), cbRGB8);
+			Test(! memcmp(Pixels, Cached, sizeof(Pixels)));
+			cb_rgb Linear = { 0.2f, 0.5f, 0.9f }, Expected = cbMatrixRGB(Matrix, Linear);
+			cb_rgb Result = ColourblindRGBAnomaly(cbProtanomaly, 0.3697f, Linear);
+			Test(Result.R == Expected.R && Result.G == Expected.G && Result.B == Expected.B);
+		}
+
+		/* the image versions match their per-pixel equivalents */
+		unsigned char Pixels[3*256], Threaded[3*256];
+		for(int i = 0; i < 3*256; ++i) { Pixels[i] = (unsigned char)(i * 7); }
+		memcpy(Threaded, Pixels, sizeof(Pixels));
+		cbImpairmentMatrix(cbProtanopia, 0.6f, Matrix);
+		int Mismatches = 0;
+		for(int i = 0; i < 256; ++i) {
+			cb_rgb_255 In = { Pixels[3*i], Pixels[3*i+1], Pixels[3*i+2] };
+			cb_rgb RGB = cbApplyGammaRGB(cbMatrixRGB(Matrix, cbRemoveGammaRGB(cbNorm(In))));
+			cb_rgb_255 Expected = { cbClampDenormComponent(RGB.R), cbClampDenormComponent(RGB.G), cbClampDenormComponent(RGB.B) };
+			cbMatrixImageGamma(Matrix, Pixels + 3*i, 1, 1, 3, cbRGB8);
+			Mismatches += Expected.R != Pixels[3*i] || Expected.G != Pixels[3*i+1] || Expected.B != Pixels[3*i+2];
+		}
+		TestVEqEps(Mismatches, 0, 0, "%d");
+		cbMatrixImageGammaThreaded(0, Matrix, Threaded, 256, 1, sizeof(Threaded), cbRGB8);
+		Test(! memcmp(Pixels, Threaded, sizeof(Pixels)));
+	}
+	EndTestGroup;
+
+	TestGroup("Daltonisation")
+	{
+		/* the folded matrices should match folding the simulation matrices here */
+		float RedGreen[9] = { 0,0,0, .7f,1,0, .7f,0,1 }, BlueYellow[9] = { 1,0,.7f, 0,1,.7f, 0,0,0 };
+		float MaxError = 0.f;
+		for(cb_impairment Impairment = cbProtanopia; Impairment <= cbTritanopia; ++Impairment) {
+			float *E = Impairment == cbTritanopia ? BlueYellow : RedGreen, *S = cbImpairmentMatrices[Impairment];
+			for(int Row = 0; Row < 3; ++Row)
+			for(int Col = 0; Col < 3; ++Col) {
+				float Folded = Row == Col;
+				for(int k = 0; k < 3; ++k) { Folded += E[3*Row + k] * ((k == Col) - S[3*k + Col]); }
+				float Error = fabsf(Folded - cbDaltonisationMatrices[Impairment][3*Row + Col]);
+				MaxError = Error > MaxError ? Error : MaxError;
+			}
+		}
+		TestVEqEps(MaxError, 0.f, 1e-6f, "%g");
+
+		/* strength blends from the identity to the full matrix, and the image versions go through it */
+		float Matrix[9];
+		int NoneMismatches = 0, FullMismatches = 0;
+		for(cb_impairment Impairment = cbUnimpaired; Impairment < cbImpairmentCount; ++Impairment) {
+			cbDaltonisationMatrix(Impairment, 0.f, Matrix);
+			NoneMismatches += memcmp(Matrix, cbImpairmentMatrices[cbUnimpaired], sizeof(Matrix)) != 0;
+			cbDaltonisationMatrix(Impairment, 1.f, Matrix);
+			FullMismatches += memcmp(Matrix, cbDaltonisationMatrices[Impairment], sizeof(Matrix)) != 0;
+		}
+		TestVEqEps(NoneMismatches, 0, 0, "%d");
+		TestVEqEps(FullMismatches, 0, 0, "%d");
+		unsigned char Pixels[3*256], Folded[3*256];
+		for(int i = 0; i < 3*256; ++i) { Pixels[i] = Folded[i] = (unsigned char)(i * 7); }
+		cbDaltonisationMatrix(cbDeuteranopia, 1.f, Matrix);
+		cbDaltoniseImageGamma(cbDeuteranopia, Pixels, 256, 1, sizeof(Pixels), cbRGB8);
+		cbMatrixImageGamma(Matrix, Folded, 256, 1, sizeof(Folded), cbRGB8);
+		Test(! memcmp(Pixels, Folded, sizeof(Pixels)));
+
+		/* pairs that are confused should be told apart after correction (CIEDE2000 between the simulations) */
+		struct { cb_impairment Impairment; cb_rgb_255 A, B; float Before, After; } Pairs[] = {
+			{ cbDeuteranopia, { 0xFF,0x00,0x00 }, { 0x50,0xB5,0x00 }, APPROXIMATE_GAMMA ? 3.f : 2.f, 20.f },
+			{ cbProtanopia,   { 0xFF,0x00,0x00 }, { 0x50,0xB5,0x00 }, 25.f, 30.f },
+			{ cbTritanopia,   { 0x00,0x80,0xFF }, { 0x00,0xC0,0x80 }, 15.f, 20.f },
+		};
+		for(int i = 0; i < 3; ++i) {
+			cb_impairment Impairment = Pairs[i].Impairment;
+			cb_rgb_255 A = cbDaltoniseRGB255Gamma(Impairment, Pairs[i].A), B = cbDaltoniseRGB255Gamma(Impairment, Pairs[i].B);
+			unsigned char Before[6] = { Pairs[i].A.R, Pairs[i].A.G, Pairs[i].A.B, Pairs[i].B.R, Pairs[i].B.G, Pairs[i].B.B };
+			unsigned char After[6] = { A.R, A.G, A.B, B.R, B.G, B.B };
+			ColourblindImageGamma(Impairment, Before, 2, 1, 6, cbRGB8);
+			ColourblindImageGamma(Impairment, After, 2, 1, 6, cbRGB8);
+			Test(cbDeltaE2000255(Before[0], Before[1], Before[2], Before[3], Before[4], Before[5]) < Pairs[i].Before);
+			Test(cbDeltaE2000255(After[0], After[1], After[2], After[3], After[4], After[5]) > Pairs[i].After);
+		}
+
+		/* greys are left alone */
+		int GreyMismatches = 0;
+		for(cb_impairment Impairment = cbProtanopia; Impairment < cbImpairmentCount; ++Impairment)
+		for(int Grey = 0; Grey < 256; Grey += 5) {
+			cb_rgb_255 Colour = { (unsigned char)Grey, (unsigned char)Grey, (unsigned char)Grey };
+			cb_rgb_255 Result = cbDaltoniseRGB255Gamma(Impairment, Colour);
+			GreyMismatches += Result.R != Grey || Result.G != Grey || Result.B != Grey;
+		}
+		TestVEqEps(GreyMismatches, 0, 0, "%d");
+	}
+	EndTestGroup;
+
+	TestGroup("Colour spaces")
+	{
+		/* sRGB is the plain simulation, and Display P3 agrees with converting through it */
+		Test(! memcmp(cbSpaceMatrices[cbSpaceSRGB], cbImpairmentMatrices, sizeof(cbImpairmentMatrices)));
+		float P3ToSRGB[9] = {  1.2249007937f, -0.2249006035f, -0.0000000365f,
+		                      -0.0420634155f,  1.0420632249f,  0.0000000030f,
+		                      -0.0196447504f, -0.0786535401f,  1.0982983109f };
+		float SRGBToP3[9] = {  0.8224884361f,  0.1775114439f,  0.0000000268f,
+		                       0.0332001667f,  0.9668000111f, -0.0000000016f,
+		                       0.0170890645f,  0.0724114848f,  0.9104994431f };
+		float MaxError = 0.f, MaxWhiteError = 0.f;
+		for(cb_impairment Impairment = cbProtanopia; Impairment <= cbTritanopia; ++Impairment)
+		for(int i = 0; i < 64; ++i) {
+			cb_rgb P3 = { (i & 3) / 3.f, ((i >> 2) & 3) / 3.f, (i >> 4) / 3.f };
+			cb_rgb Direct  = ColourblindRGBSpace(Impairment, cbSpaceDisplayP3, P3);
+			cb_rgb Through = cbMatrixRGB(SRGBToP3, ColourblindRGB(Impairment, cbMatrixRGB(P3ToSRGB, P3)));
+			float Errors[3] = { fabsf(Direct.R - Through.R), fabsf(Direct.G - Through.G), fabsf(Direct.B - Through.B) };
+			for(int c = 0; c < 3; ++c) { MaxError = Errors[c] > MaxError ? Errors[c] : MaxError; }
+		}
+		TestVEqEps(MaxError, 0.f, 1e-5f, "%g");
+		/* and white stays white in every space */
+		for(cb_space Space = cbSpaceSRGB; Space < cbSpaceCount; ++Space)
+		for(cb_impairment Impairment = cbUnimpaired; Impairment < cbImpairmentCount; ++Impairment) {
+			cb_rgb White = ColourblindRGBSpace(Impairment, Space, WhiteNorm);
+			float Errors[3] = { fabsf(White.R - 1.f), fabsf(White.G - 1.f), fabsf(White.B - 1.f) };
+			for(int c = 0; c < 3; ++c) { MaxWhiteError = Errors[c] > MaxWhiteError ? Errors[c] : MaxWhiteError; }
+		}
+		TestVEqEps(MaxWhiteError, 0.f, 1e-5f, "%g");
+
+		/* reference points of the curves */
+		TestVEqEps(cbRemoveTransfer(cbTransferPQ, 1.f), 1.f, 1e-5f, "%g");
+		TestVEqEps(cbApplyTransfer(cbTransferPQ, 0.01f), 0.50808f, 1e-4f, "%g"); /* 100 cd/m2 */
+		TestVEqEps(cbRemoveTransfer(cbTransferHLG, 0.5f), 1.f / 12.f, 1e-6f, "%g");
+		TestVEqEps(cbApplyTransfer(cbTransferHLG, 1.f), 1.f, 1e-5f, "%g");
+		TestVEqEps(cbRemoveTransfer(cbTransferGamma24, 0.5f), 0.189465f, 1e-5f, "%g");
+
+		/* 8-bit pixels go through tables that match the curves exactly, and every level round trips */
+		float Identity[9] = { 1,0,0, 0,1,0, 0,0,1 };
+		int RoundTripMismatches = 0, TableMismatches = 0;
+		for(cb_transfer Transfer = cbTransferLinear; Transfer < cbTransferCount; ++Transfer) {
+			unsigned char Levels[3*256];
+			for(int i = 0; i < 3*256; ++i) { Levels[i] = (unsigned char)(i / 3); }
+			cbMatrixImageTransfer(Identity, Transfer, Levels, 256, 1, sizeof(Levels), cbRGB8);
+			for(int i = 0; i < 3*256; ++i) { RoundTripMismatches += Levels[i] != i / 3; }
+
+			unsigned int Seed = 777;
+			for(cb_space Space = cbSpaceSRGB; Space < cbSpaceCount; ++Space)
+			for(int i = 0; i < 2048; ++i) {
+				Seed = Seed * 1103515245u + 12345u;
+				unsigned char Pixel[3] = { (unsigned char)(Seed >> 8), (unsigned char)(Seed >> 16), (unsigned char)(Seed >> 24) };
+				cb_rgb Linear = { cbRemoveTransfer(Transfer, Pixel[0] / 255.f), cbRemoveTransfer(Transfer, Pixel[1] / 255.f),
+				                  cbRemoveTransfer(Transfer, Pixel[2] / 255.f) };
+				Linear = ColourblindRGBSpace(cbDeuteranopia, Space, Linear);
+				float Encoded[3] = { cbApplyTransfer(Transfer, Linear.R), cbApplyTransfer(Transfer, Linear.G), cbApplyTransfer(Transfer, Linear.B) };
+				ColourblindImageSpace(cbDeuteranopia, Space, Transfer, Pixel, 1, 1, 3, cbRGB8);
+				for(int c = 0; c < 3; ++c) { TableMismatches += Pixel[c] != cbClampDenormComponent(Encoded[c]); }
+			}
+		}
+		TestVEqEps(RoundTripMismatches, 0, 0, "%d");
+		TestVEqEps(TableMismatches, 0, 0, "%d");
+
+		/* 16-bit pixels evaluate the curve, and the threaded version matches */
+		enum { Width = 700, Height = 5 };
+		static unsigned short Deep[3*Width*Height], Threaded[3*Width*Height];
+		for(int i = 0; i < 3*Width*Height; ++i) { Deep[i] = Threaded[i] = (unsigned short)(i * 2749u); }
+		float Expected = cbApplyTransfer(cbTransferPQ,
+			ColourblindRGBSpace(cbProtanopia, cbSpaceRec2020, (cb_rgb){ cbRemoveTransfer(cbTransferPQ, Deep[3] / 65535.f),
+				cbRemoveTransfer(cbTransferPQ, Deep[4] / 65535.f), cbRemoveTransfer(cbTransferPQ, Deep[5] / 65535.f) }).R);
+		ColourblindImageSpace(cbProtanopia, cbSpaceRec2020, cbTransferPQ, (unsigned char *)Deep, Width, Height, 6*Width, cbRGB16);
+		TestVEqEps(Deep[3], (int)(Expected * 65535.f + 0.5f), 0, "%d");
+		cb_pool *Pool = cbPoolCreate(3);
+		ColourblindImageSpaceThreaded(Pool, cbProtanopia, cbSpaceRec2020, cbTransferPQ, (unsigned char *)Threaded, Width, Height, 6*Width, cbRGB16);
+		Test(! memcmp(Deep, Threaded, sizeof(Deep)));
+		cbPoolDestroy(Pool);
+	}
+	EndTestGroup;
+
+	TestGroup("Palettes")
+	{
+		cb_rgb_255 Colours[] = {
+			{ 0x88,0x00,0x27 }, { 0x00,0xAA,0xAD }, { 0xEF,0x3F,0x6D }, { 0xFF,0xFF,0xFF },
+			{ 0x00,0x00,0x00 }, { 0xFF,0x00,0x00 }, { 0x00,0x80,0x00 }, { 0x33,0x66,0x99 },
+		};
+		enum { Count = sizeof(Colours)/sizeof(*Colours) };
+		cb_palette *Palette = cbPaletteCreate(Colours, Count, 1);
+		Test(Palette != 0);
+
+		int Mismatches = 0;
+#define DIFFERENT(x, y) ((x) != (y) && ((x) == (x) || (y) == (y))) /* black/black ratios are NaN */
+		for(cb_impairment Impairment = cbUnimpaired; Impairment < cbImpairmentCount; ++Impairment)
+		for(int A = 0; A < Count; ++A)
+		for(int B = 0; B < Count; ++B) {
+			cb_rgb_255 SimA = Palette->Simulated[Impairment*Count + A], SimB = Palette->Simulated[Impairment*Count + B];
+			Mismatches += DIFFERENT(cbPaletteContrast(          Palette, Impairment, A, B), cbContrastRGB255(          SimA, SimB));
+			Mismatches += DIFFERENT(cbPaletteContrastModulation(Palette, Impairment, A, B), cbContrastModulationRGB255(SimA, SimB));
+			Mismatches += DIFFERENT(cbPaletteContrastRatio(     Palette, Impairment, A, B), cbContrastRatioRGB255(     SimA, SimB));
+			Mismatches += DIFFERENT(cbPaletteLightnessContrast( Palette, Impairment, A, B), cbLightnessContrastRGB255( SimA, SimB));
+		}
+#undef DIFFERENT
+		TestVEqEps(Mismatches, 0, 0, "%d");
+		cb_rgb_255 Sim = Palette->Simulated[cbDeuteranopia*Count + 0];
+		/* Burgundy, as above */
+		TestVEqEps(Sim.R, 0x51, KNOWN_EXTRA, "%X");
+		TestVEqEps(Sim.G, 0x51, KNOWN_EXTRA, "%X");
+		TestVEqEps(Sim.B, 0x1F, KNOWN_EXTRA, "%X");
+
+		cb_pair Worst[5];
+		int Found = cbPaletteWorstPairs(Palette, cbWCAG_Contrast_AA, Worst, 5);
+		Test(Found == 5);
+		for(int i = 1; i < Found; ++i) { Test(Worst[i-1].Score <= Worst[i].Score); }
+		float Lowest = 100.f;
+		for(cb_impairment Impairment = cbUnimpaired; Impairment < cbImpairmentCount; ++Impairment)
+		for(int A = 0; A < Count; ++A)
+		for(int B = A+1; B < Count; ++B) {
+			float Score = cbPaletteContrast(Palette, Impairment, A, B);
+			if(Score < Lowest) { Lowest = Score; }
+		}
+		Test(Worst[0].Score == Lowest && Worst[0].A < Worst[0].B);
+#ifdef cbGUIDELINE_APCA
+		/* APCA's scores are filled in on first use, here by the worst pairs */
+		cbPaletteDestroy(Palette);
+		Palette = cbPaletteCreate(Colours, Count, 1);
+		Test(cbPaletteWorstPairs(Palette, cbAPCA_LightnessContrast_Body, Worst, 1) == 1);
+		Test(Worst[0].Score == cbLightnessContrastRGB255(Palette->Simulated[Worst[0].Impairment*Count + Worst[0].A],
+		                                                 Palette->Simulated[Worst[0].Impairment*Count + Worst[0].B]));
+#endif/*cbGUIDELINE_APCA*/
+		cbPaletteDestroy(Palette);
+	}
+	EndTestGroup;
+
+	TestGroup("Guidelines")
+	{
+		/* APCA's reference values */
+		cb_rgb_255 Grey = { 0x88,0x88,0x88 };
+		TestVEqEps(cbAPCARGB255(Grey, White255), 63.06f, 0.1f, "%f");
+		TestVEqEps(cbAPCARGB255(White255, Grey), -68.54f, 0.1f, "%f");
+		TestVEqEps(cbAPCARGB255(Black255, White255), 106.04f, 0.1f, "%f");
+		TestVEqEps(cbAPCARGB255(Grey, Grey), 0.f, 0.f, "%f");
+		Test(cbLightnessContrastRGB255(Grey, White255) == cbLightnessContrastRGB255(White255, Grey));
+
+		/* the one-pass evaluator agrees with each guideline's own test */
+		int Mismatches = 0;
+		for(int i = 0; i < 4096; ++i) {
+			cb_rgb_255 A = { (unsigned char)(i * 37), (unsigned char)(i * 101 >> 2), (unsigned char)(i * 13 >> 3) };
+			cb_rgb_255 B = { (unsigned char)(i * 59 >> 4), (unsigned char)(255 - i * 7), (unsigned char)(i * 211) };
+			float LumA = cbLuminanceRGB255(A), LumB = cbLuminanceRGB255(B), Scores[cgGuidelineCount];
+			unsigned int Mask = cbGuidelinesLuminance(LumA, LumB, Scores);
+			Mismatches += Mask != cbGuidelinesRGB255(A, B, 0);
+			for(int g = 0; g < cgGuidelineCount; ++g) {
+				Mismatches += !(Mask & (1u << g)) != ! cbGuidelinePassLuminance((cb_guideline)g, LumA, LumB);
+			}
+			Mismatches += Scores[cbWCAG_Contrast_AA] != cbContrastLuminance(LumA, LumB);
+#ifdef cbGUIDELINE_APCA
+			Mismatches += Scores[cbAPCA_LightnessContrast_Body] != cbLightnessContrastLuminance(LumA, LumB);
+#endif/*cbGUIDELINE_APCA*/
+		}
+		TestVEqEps(Mismatches, 0, 0, "%d");
+
+		/* batches match simulating each pair, threaded or not */
+		enum { Count = 1000 };
+		static cb_rgb_255 As[Count], Bs[Count];
+		static unsigned int Masks[cbImpairmentCount*Count], ThreadedMasks[cbImpairmentCount*Count];
+		static float Scores[cbImpairmentCount*Count*cgGuidelineCount], ThreadedScores[cbImpairmentCount*Count*cgGuidelineCount];
+		cb_impairment Impairments[cbImpairmentCount];
+		for(int j = 0; j < cbImpairmentCount; ++j) { Impairments[j] = (cb_impairment)j; }
+		for(int i = 0; i < Count; ++i) {
+			As[i] = (cb_rgb_255){ (unsigned char)(i * 73), (unsigned char)(i * 31 >> 1), (unsigned char)(i * 5) };
+			Bs[i] = (cb_rgb_255){ (unsigned char)(255 - i * 3), (unsigned char)(i * 17 >> 2), (unsigned char)(i * 127) };
+		}
+		cbGuidelinesBatch(As, Bs, Count, Impairments, cbImpairmentCount, 1, Masks, Scores);
+		Mismatches = 0;
+		for(int j = 0; j < cbImpairmentCount; ++j)
+		for(int i = 0; i < Count; ++i) {
+			cb_rgb_255 A = As[i], B = Bs[i];
+			ColourblindImageGamma(Impairments[j], &A.R, 1, 1, 3, cbRGB8);
+			ColourblindImageGamma(Impairments[j], &B.R, 1, 1, 3, cbRGB8);
+			float Expected[cgGuidelineCount];
+			Mismatches += Masks[j*Count + i] != cbGuidelinesRGB255(A, B, Expected);
+			Mismatches += memcmp(Expected, Scores + (j*Count + i) * cgGuidelineCount, sizeof(Expected)) != 0;
+		}
+		TestVEqEps(Mismatches, 0, 0, "%d");
+		cb_pool *Pool = cbPoolCreate(3);
+		cbGuidelinesBatchThreaded(Pool, As, Bs, Count, Impairments, cbImpairmentCount, 1, ThreadedMasks, ThreadedScores);
+		Test(! memcmp(Masks, ThreadedMasks, sizeof(Masks)) && ! memcmp(Scores, ThreadedScores, sizeof(Scores)));
+		cbPoolDestroy(Pool);
+	}
+	EndTestGroup;
+
+	TestGroup("Frame sequences")
+	{
+		/* tiles that don't divide the frame, and a padded input stride */
+		enum { Width = 150, Height = 70, Stride = 4*Width + 12 };
+		static unsigned char Frame[Stride*Height], Expected[2][4*Width*Height];
+		cb_impairment Impairments[2] = { cbDeuteranopia, cbTritanopia };
+		cb_sequence *Sequence = cbSequenceCreate(Impairments, 2, 1, Width, Height, cbRGBA8, 32);
+		cb_sequence *Threaded = cbSequenceCreate(Impairments, 2, 1, Width, Height, cbRGBA8, 32);
+		cb_pool *Pool = cbPoolCreate(3);
+		Test(Sequence != 0 && Threaded != 0);
+		for(int i = 0; i < Stride*Height; ++i) { Frame[i] = (unsigned char)(i * 2654435761u >> 24); }
+
+		int Mismatches = 0;
+		for(int f = 0; f < 4; ++f) {
+			if(f == 2) { Frame[40*Stride + 4*100 + 1] ^= 0x55; } /* one pixel, in one tile */
+			if(f == 3) { for(int x = 0; x < 4*Width; ++x) { Frame[69*Stride + x] += 1; } } /* the last row of tiles */
+			int Dirty = cbSequenceFrame(Sequence, Frame, Stride);
+			Mismatches += Dirty != cbSequenceFrameThreaded(Pool, Threaded, Frame, Stride);
+			Mismatches += Dirty != (f == 0 ? 5*3 : f == 1 ? 0 : f == 2 ? 1 : 5);
+			Mismatches += memcmp(Sequence->Dirty, Threaded->Dirty, 5*3) != 0;
+			for(int j = 0; j < 2; ++j) {
+				for(int y = 0; y < Height; ++y) { memcpy(Expected[j] + y*4*Width, Frame + y*Stride, 4*Width); }
+				ColourblindImageGamma(Impairments[j], Expected[j], Width, Height, 4*Width, cbRGBA8);
+				Mismatches += memcmp(Sequence->Outputs[j], Expected[j], sizeof(Expected[j])) != 0;
+				Mismatches += memcmp(Threaded->Outputs[j], Expected[j], sizeof(Expected[j])) != 0;
+			}
+		}
+		TestVEqEps(Mismatches, 0, 0, "%d");
+		Test(Sequence->Dirty[2*5 + 0] && ! Sequence->Dirty[1*5 + 3] && Sequence->Frames == 4 && Sequence->TotalDirtyTiles == 15 + 0 + 1 + 5);
+		cbPoolDestroy(Pool);
+		cbSequenceDestroy(Sequence);
+		cbSequenceDestroy(Threaded);
+	}
+	EndTestGroup;
+
+	TestGroup("Colour difference")
+	{
+		/* pairs from Sharma, Wu and Dalal's CIEDE2000 test data */
+		float Sharma[][7] = {
+			{ 50, 2.6772f, -79.7751f,  50, 0, -82.7485f,  2.0425f },
+			{ 50, 0, 0,  50, -1, 2,  2.3669f },
+			{ 50, 2.49f, -0.001f,  50, -2.49f, 0.0009f,  7.1792f },
+			{ 50, 2.5f, 0,  73, 25, -18,  27.1492f },
+			{ 50, 2.5f, 0,  50, 3.1736f, 0.5854f,  1.f },
+			{ 60.2574f, -34.0099f, 36.2677f,  60.4626f, -34.1751f, 39.4387f,  1.2644f },
+			{ 2.0776f, 0.0795f, -1.135f,  0.9033f, -0.0636f, -0.5514f,  0.9082f },
+		};
+		for(int i = 0; i < (int)(sizeof(Sharma)/sizeof(*Sharma)); ++i) {
+			TestVEqEps(cbDeltaE2000Lab(Sharma[i], Sharma[i] + 3), Sharma[i][6], 0.0001f, "%f");
+			TestVEqEps(cbDeltaE2000Lab(Sharma[i] + 3, Sharma[i]), Sharma[i][6], 0.0001f, "%f");
+		}
+
+		float Lab[3], Luv[3];
+		cbLab255(0xFF, 0xFF, 0xFF, Lab);
+		TestVEqEps(Lab[0], 100.f, 0.001f, "%f");
+		TestVEqEps(Lab[1], 0.f, 0.001f, "%f");
+		TestVEqEps(Lab[2], 0.f, 0.001f, "%f");
+		cbLab255(0xFF, 0x00, 0x00, Lab);
+		cbLuv255(0xFF, 0x00, 0x00, Luv);
+		TestVEqEps(Lab[0], 53.24f, 0.05f, "%f");
+		TestVEqEps(Lab[1], 80.09f, 0.05f, "%f");
+		TestVEqEps(Lab[2], 67.20f, 0.05f, "%f");
+		TestVEqEps(Luv[1], 175.0f, 0.1f, "%f");
+		TestVEqEps(Luv[2], 37.76f, 0.05f, "%f");
+		cbLuv255(0, 0, 0, Luv);
+		Test(Luv[0] == 0.f && Luv[1] == 0.f && Luv[2] == 0.f);
+
+		/* the cube root's error over every float it's used for */
+		union { float F; unsigned int U; } X;
+		double MaxError = 0.;
+		for(X.F = 216.f/24389.f; X.F <= 1.1f; X.U += 7) {
+			double Error = fabs(cbCubeRoot(X.F) - pow(X.F, 1./3.));
+			if(Error > MaxError) { MaxError = Error; }
+		}
+		TestVEqEps(MaxError, 0., 3e-7, "%g");
+
+		cb_rgb_255 Red = { 0xFF,0x00,0x00 };
+		TestVEqEps(cbDeltaE76RGB255(Red, Red), 0.f, 0.f, "%f");
+
+		/* the palette versions match calling the functions on the simulated colours */
+		cb_rgb_255 Colours[] = {
+			{ 0x88,0x00,0x27 }, { 0x00,0xAA,0xAD }, { 0xEF,0x3F,0x6D }, { 0xFF,0xFF,0xFF }, { 0x00,0x00,0x00 },
+			{ 0xFF,0x00,0x00 }, { 0x50,0xB5,0x00 }, { 0x33,0x66,0x99 }, { 0x80,0x80,0x00 }, { 0x7F,0x7F,0x00 },
+		};
+		enum { Count = sizeof(Colours)/sizeof(*Colours) };
+		cb_palette *Palette = cbPaletteCreate(Colours, Count, 1);
+		float Differences[Count][Count];
+		int Mismatches = 0;
+		for(cb_delta_e Metric = cbDeltaE_CIE76; Metric < cbDeltaECount; ++Metric)
+		for(cb_impairment Impairment = cbUnimpaired; Impairment < cbImpairmentCount; ++Impairment) {
+			cbPaletteDifferences(Palette, Metric, Impairment, &Differences[0][0]);
+			for(int A = 0; A < Count; ++A)
+			for(int B = 0; B < Count; ++B) {
+				cb_rgb_255 SimA = Palette->Simulated[Impairment*Count + A], SimB = Palette->Simulated[Impairment*Count + B];
+				float Expected = Metric == cbDeltaE_CIE76     ? cbDeltaE76RGB255(SimA, SimB) :
+				                 Metric == cbDeltaE_CIEDE2000 ? cbDeltaE2000RGB255(SimA, SimB) : cbDeltaEuvRGB255(SimA, SimB);
+				Mismatches += cbPaletteDeltaE(Palette, Metric, Impairment, A, B) != Expected;
+				Mismatches += Differences[A][B] != Expected;
+			}
+		}
+		TestVEqEps(Mismatches, 0, 0, "%d");
+
+		/* the two olives are confused by anyone, and the red and green (far apart otherwise) under deuteranopia */
+		cb_pair Pairs[Count*Count];
+		int Found = cbPaletteConfusedPairs(Palette, cbDeltaE_CIEDE2000, cbUnimpaired, 2.f, Pairs, Count*Count);
+		Test(Found == 1 && Pairs[0].A == 8 && Pairs[0].B == 9 && Pairs[0].Score < 2.f);
+		cbPaletteDifferences(Palette, cbDeltaE_CIEDE2000, cbDeuteranopia, &Differences[0][0]);
+		int Expected = 0;
+		for(int A = 0; A < Count; ++A) for(int B = A+1; B < Count; ++B) { Expected += Differences[A][B] < 10.f; }
+		Found = cbPaletteConfusedPairs(Palette, cbDeltaE_CIEDE2000, cbDeuteranopia, 10.f, Pairs, 2);
+		TestVEqEps(Found, Expected, 0, "%d");
+		Test(Found > 2 && Pairs[0].A < Pairs[1].A + (Pairs[0].A == Pairs[1].A) * Pairs[1].B);
+		Test(cbPaletteDeltaE(Palette, cbDeltaE_CIEDE2000, cbUnimpaired, 5, 6) > 50.f);
+		Found = cbPaletteConfusedPairs(Palette, cbDeltaE_CIEDE2000, cbDeuteranopia, APPROXIMATE_GAMMA ? 3.f : 2.f, Pairs, Count*Count);
+		int RedGreen = 0;
+		for(int i = 0; i < Found; ++i) { RedGreen |= Pairs[i].A == 5 && Pairs[i].B == 6; }
+		Test(RedGreen);
+		cbPaletteDestroy(Palette);
+	}
+	EndTestGroup;
+
+	TestGroup("Guideline repair")
+	{
+		cb_rgb_255 Colours[][2] = {
+			{ { 0xFF,0xFF,0xFF }, { 0xEF,0x3F,0x6D } }, /* pink on white, fixed by darkening */
+			{ { 0x20,0x20,0x20 }, { 0x33,0x66,0x99 } }, /* blue on dark grey, fixed by lightening */
+			{ { 0x00,0x00,0x00 }, { 0xFF,0xFF,0xFF } }, /* already passes */
+		};
+		for(int i = 0; i < 3; ++i) {
+			cb_rgb_255 Fixed = Colours[i][0], Candidate = Colours[i][1], Result;
+			Test(cbNearestPassingRGB255(Fixed, Candidate, cbWCAG_Contrast_AA, &Result));
+			if(i == 2) { Test(Result.R == 0xFF && Result.G == 0xFF && Result.B == 0xFF); }
+			float Worst = 100.f;
+			for(cb_impairment Impairment = cbUnimpaired; Impairment <= cbTritanopia; ++Impairment) {
+				unsigned char Pair[] = { Fixed.R, Fixed.G, Fixed.B, Result.R, Result.G, Result.B };
+				ColourblindImageGamma(Impairment, Pair, 2, 1, sizeof(Pair), cbRGB8);
+				float Contrast = cbContrast255(Pair[0], Pair[1], Pair[2], Pair[3], Pair[4], Pair[5]);
+				if(Contrast < Worst) { Worst = Contrast; }
+			}
+			Test(Worst >= cbGuidelineScores[cbWCAG_Contrast_AA]);
+			if(i < 2) { Test(Worst < cbGuidelineScores[cbWCAG_Contrast_AA] + 0.25f); } /* no further than needed */
+		}
+		/* against a mid-luminance green, passing dips and rises again along the mix, so the nearest pass
+		 * (a darker pink) is well short of where bisecting the whole mix would end up (near black) */
+		cb_rgb_255 Green = { 0x90,0xC5,0x09 }, Pink = { 0xDC,0x53,0xCD }, Darker;
+		Test(cbNearestPassingRGB255(Green, Pink, cbISO9241_3_ContrastRatio_Pass, &Darker));
+		Test(Darker.R > 0x80 && Darker.B > 0x80);
+		/* pure blue on white passes for the dichromats, so it's kept although blue cone monochromats can't read it */
+		cb_rgb_255 White = { 0xFF,0xFF,0xFF }, Blue = { 0x00,0x00,0xFF }, Kept;
+		Test(cbNearestPassingRGB255(White, Blue, cbWCAG_Contrast_AA, &Kept));
+		Test(Kept.R == Blue.R && Kept.G == Blue.G && Kept.B == Blue.B);
+		/* nothing passes AAA against mid-grey */
+		cb_rgb_255 Grey = { 0x80,0x80,0x80 }, Result;
+		Test(! cbNearestPassingRGB255(Grey, Grey, cbWCAG_Contrast_AAA, &Result));
+	}
+	EndTestGroup;
+
+	TestGroup("Contrast maps")
+	{
+		/* compare against brute force on a small image of a few colours, with windows cut off at the edges */
+		enum { Width = 37, Height = 23 };
+		static unsigned char Pixels[Height][Width][4];
+		unsigned Seed = 7;
+		for(int i = 0; i < Width*Height*4; ++i) { Seed = Seed*1103515245u + 12345u; (&Pixels[0][0][0])[i] = (Seed >> 16) % 4 * 60; }
+		for(int Radius = 1; Radius <= 5; Radius += 2) {
+			cb_contrast_map *Map = cbContrastMapCreate(cbDeuteranopia, &Pixels[0][0][0], Width, Height, Width*4, cbRGBA8, Radius);
+			Test(Map != 0);
+			int Mismatches = 0, Edges = 0, Failures = 0;
+			float Worst = 100.f;
+			for(int y = 0; y < Height; ++y)
+			for(int x = 0; x < Width; ++x) {
+				float Lightest = 0.f, Darkest = 1.f;
+				int Edge = 0;
+				for(int wy = y-Radius; wy <= y+Radius; ++wy)
+				for(int wx = x-Radius; wx <= x+Radius; ++wx) {
+					if(wy < 0 || wy >= Height || wx < 0 || wx >= Width) { continue; }
+					float Luminance = Map->Luminance[wy*Width + wx];
+					if(Luminance > Lightest) { Lightest = Luminance; }
+					if(Luminance < Darkest)  { Darkest = Luminance; }
+					Edge |= memcmp(Pixels[wy][wx], Pixels[y][x], 3) != 0;
+				}
+				unsigned char Simulated[3] = { Pixels[y][x][0], Pixels[y][x][1], Pixels[y][x][2] };
+				ColourblindImageGamma(cbDeuteranopia, Simulated, 1, 1, sizeof(Simulated), cbRGB8);
+				Mismatches += Map->Luminance[y*Width + x] != cbLuminance255(Simulated[0], Simulated[1], Simulated[2]);
+				Mismatches += Map->Lightest[y*Width + x] != Lightest || Map->Darkest[y*Width + x] != Darkest;
+				Mismatches += ! (Map->Mask[y*Width + x] & cbCONTRAST_EDGE) != ! Edge;
+				if(Edge) {
+					float Score = cbContrastLuminance(Lightest, Darkest);
+					int Fails = Score < cbGuidelineScores[cbWCAG_Contrast_AA];
+					Mismatches += ! (Map->Mask[y*Width + x] & 1 << cbWCAG_Contrast_AA) != ! Fails;
+					Edges += 1, Failures += Fails;
+					if(Score < Worst) { Worst = Score; }
+				}
+			}
+			TestVEqEps(Mismatches, 0, 0, "%d");
+			TestVEqEps(Map->Edges, Edges, 0, "%d");
+			TestVEqEps(Map->Stats[cbWCAG_Contrast_AA].Failures, Failures, 0, "%d");
+			TestVEqEps(Map->Stats[cbWCAG_Contrast_AA].Worst, Worst, 0, "%f");
+			cb_contrast_stats *Stats = &Map->Stats[cbWCAG_Contrast_AA];
+			Test(Map->Mask[Stats->WorstY*Width + Stats->WorstX] & cbCONTRAST_EDGE);
+			float Scores[Height][Width];
+			cbContrastMapScores(Map, cbWCAG_Contrast_AA, &Scores[0][0]);
+			Test(Scores[Stats->WorstY][Stats->WorstX] == Worst);
+			cbContrastMapDestroy(Map);
+		}
+
+		/* pink text on white fails AA for a protanope but black text doesn't, and the page around it isn't an edge */
+		static unsigned char Page[32][64][3];
+		memset(Page, 0xFF, sizeof(Page));
+		for(int y = 8; y < 16; ++y) for(int x = 8; x < 24; x += 2) { Page[y][x][0] = 0xEF, Page[y][x][1] = 0x3F, Page[y][x][2] = 0x6D; }
+		for(int y = 8; y < 16; ++y) for(int x = 40; x < 56; x += 2) { Page[y][x][0] = Page[y][x][1] = Page[y][x][2] = 0; }
+		cb_contrast_map *Map = cbContrastMapCreate(cbProtanopia, &Page[0][0][0], 64, 32, 64*3, cbRGB8, 2);
+		Test(Map != 0);
+		Test(Map->Mask[12*64 + 16] & 1 << cbWCAG_Contrast_AA);
+		Test(Map->Mask[12*64 + 48] == cbCONTRAST_EDGE);
+		Test(Map->Mask[0] == 0 && Map->Mask[12*64 + 32] == 0);
+		Test(Map->Stats[cbWCAG_Contrast_AA].WorstX < 32);
+		Test(Map->Stats[cbWCAG_Contrast_AA].Failures > 0 && Map->Stats[cbWCAG_Contrast_AAA].Failures >= Map->Stats[cbWCAG_Contrast_AA].Failures);
+		cbContrastMapDestroy(Map);
+
+		/* a blank page has no edges */
+		memset(Page, 0x80, sizeof(Page));
+		Map = cbContrastMapCreate(cbProtanopia, &Page[0][0][0], 64, 32, 64*3, cbRGB8, 2);
+		Test(Map->Edges == 0 && Map->Mask[0] == 0 && Map->Stats[cbWCAG_Contrast_AA].Failures == 0 && Map->Stats[cbWCAG_Contrast_AA].WorstX == -1);
+		cbContrastMapDestroy(Map);
+		Test(cbContrastMapCreate(cbProtanopia, &Page[0][0][0], 0, 32, 64*3, cbRGB8, 2) == 0);
+	}
+	EndTestGroup;
+
+	TestGroup("3D LUTs")
+	{
+		cb_lut *Lut = cbLutCreate(cbProtanopia, 33);
+		Test(Lut != 0);
+		TestVEqEps(cbLutMaxError(Lut, cbProtanopia, 3), 0, APPROXIMATE_GAMMA ? 16 : 1, "%d");
+		cb_rgb_255 Burgundy = { 0x88,0x00,0x27 }, Simulated = cbLutRGB255(Lut, Burgundy);
+		TestVEqEps(Simulated.R, 0x3A, 1 + KNOWN_EXTRA, "%X");
+		TestVEqEps(Simulated.B, 0x26, 1 + KNOWN_EXTRA, "%X");
+
+		Test(cbLutSave(Lut, "test_colourblind.cube"));
+		cb_lut *Loaded = cbLutLoad("test_colourblind.cube");
+		remove("test_colourblind.cube");
+		Test(Loaded != 0 && Loaded->Size == 33);
+		float MaxDiff = 0.f;
+		for(int i = 0; Loaded && i < 3*33*33*33; ++i) {
+			float Diff = fabsf(Loaded->Table[i] - Lut->Table[i]);
+			if(Diff > MaxDiff) { MaxDiff = Diff; }
+		}
+		TestVEqEps(MaxDiff, 0.f, 1e-6f, "%f");
+		Test(cbLutLoad("no such file.cube") == 0);
+
+		/* keywords it doesn't use are skipped, but other domains are refused */
+		FILE *Cube = fopen("test_colourblind.cube", "w");
+		fprintf(Cube, "TITLE \"2\"\nLUT_3D_SIZE 2\nLUT_3D_INPUT_RANGE 0.0 1.0\nLUT_1D_INPUT_RANGE 0 1\n");
+		for(int i = 0; i < 8; ++i) { fprintf(Cube, "%d %d %d\n", i & 1, i >> 1 & 1, i >> 2); }
+		fclose(Cube);
+		cb_lut *Identity = cbLutLoad("test_colourblind.cube");
+		Test(Identity != 0 && Identity->Size == 2);
+		Cube = fopen("test_colourblind.cube", "a");
+		fprintf(Cube, "DOMAIN_MAX 2 2 2\n");
+		fclose(Cube);
+		Test(cbLutLoad("test_colourblind.cube") == 0);
+		remove("test_colourblind.cube");
+		if(Identity) {
+			cb_rgb NaN = { NAN, 2.f, -1.f }, Clamped = cbLutRGB(Identity, NaN);
+			Test(Clamped.R == 0.f && Clamped.G == 1.f && Clamped.B == 0.f);
+		}
+		cbLutDestroy(Identity);
+		cbLutDestroy(Loaded);
+		cbLutDestroy(Lut);
+	}
+	EndTestGroup;
+
 	return PrintTestResults(1);
 }
 
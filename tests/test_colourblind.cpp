@@ -0,0 +1,154 @@
+#define Assert(x) Test(x)
+#define _CRT_SECURE_NO_WARNINGS
+#include <sweet/sweet.h>
+
+#define cbIMPLEMENTATION
+#include "colourblind.hpp"
+
+struct rgb_255 { unsigned char R, G, B; };
+struct rgb     { float R, G, B; };
+
+int main()
+{
+	TestGroup("Matrices")
+	{
+		/* the RGB <-> LMS pair should round-trip */
+		cb::matrix RoundTrip = cb::Multiply(cb::RGBFromLMS, cb::LMSFromRGB);
+		for(int i = 0; i < 9; ++i) { TestVEqEps(RoundTrip.M[i], cb::Identity.M[i], 1e-12, "%g"); }
+		/* the composed matrices should match the ones the C functions use */
+		for(int Impairment = cb::Protanopia; Impairment < cb::ImpairmentCount; ++Impairment)
+		for(int i = 0; i < 9; ++i)
+		{ TestVEqEps(cb::SimulationMatrix((cb::impairment)Impairment).M[i], cbImpairmentMatrices[Impairment][i], 1e-7, "%g"); }
+	} EndTestGroup;
+
+	TestGroup("Fixed points")
+	{
+		rgb White = {1, 1, 1}, Blue = {0, 0, 1}, Red = {1, 0, 0}, C;
+#define TEST(nopia, In, r2, g2, b2) \
+		TestGroup(#nopia) \
+			C = cb::ColourblindRGB<cb::nopia>(In); \
+			TestVEqEps(C.R, r2, 0.0000001, "%lf"); \
+			TestVEqEps(C.G, g2, 0.0000001, "%lf"); \
+			TestVEqEps(C.B, b2, 0.0000001, "%lf"); \
+		EndTestGroup
+		TEST(Protanopia,   White, 1, 1, 1);
+		TEST(Deuteranopia, White, 1, 1, 1);
+		TEST(Tritanopia,   White, 1, 1, 1);
+		TEST(Protanopia,   Blue,  0, 0, 1);
+		TEST(Deuteranopia, Blue,  0, 0, 1);
+		TEST(Tritanopia,   Red,   1, 0, 0);
+		TEST(Unimpaired,   Red,   1, 0, 0);
+#undef TEST
+	} EndTestGroup;
+
+	TestGroup("Known colours")
+	{
+		rgb_255 C;
+#define TEST(nopia, r1, g1, b1, r2, g2, b2) \
+		TestGroup(#nopia) \
+			C.R=r1, C.G=g1, C.B=b1; \
+			C = cb::ColourblindRGB255Gamma<cb::nopia>(C); \
+			TestVEqEps(C.R, r2, 1, "%X"); \
+			TestVEqEps(C.G, g2, 1, "%X"); \
+			TestVEqEps(C.B, b2, 1, "%X"); \
+		EndTestGroup
+		TestGroup("Burgundy")
+			TEST(Protanopia,   0x88,0x00,0x27, 0x3A,0x3A,0x26);
+			TEST(Deuteranopia, 0x88,0x00,0x27, 0x51,0x51,0x1F);
+			TEST(Tritanopia,   0x88,0x00,0x27, 0x87,0x08,0x08);
+		EndTestGroup;
+		TestGroup("Teal")
+			TEST(Protanopia,   0x00,0xAA,0xAD, 0x9C,0x9C,0xAD);
+			TEST(Deuteranopia, 0x00,0xAA,0xAD, 0x8E,0x8E,0xAF);
+		EndTestGroup;
+		TestGroup("Pink")
+			TEST(Protanopia,   0xEF,0x3F,0x6D, 0x78,0x78,0x6C);
+			TEST(Deuteranopia, 0xEF,0x3F,0x6D, 0x99,0x99,0x65);
+			TEST(Tritanopia,   0xEF,0x3F,0x6D, 0xED,0x47,0x47);
+		EndTestGroup;
+#undef TEST
+	} EndTestGroup;
+
+	TestGroup("Calling conventions")
+	{
+		/* every form should agree with the float pointer version */
+		int Mismatches = 0;
+		for(int R = 0; R < 256; R += 5) for(int G = 0; G < 256; G += 5) for(int B = 0; B < 256; B += 5) {
+			rgb_255 C = { (unsigned char)R, (unsigned char)G, (unsigned char)B };
+			float Rf = cb::NormComponent(C.R), Gf = cb::NormComponent(C.G), Bf = cb::NormComponent(C.B);
+			cb::Colourblind<cb::Deuteranopia>(&Rf, &Gf, &Bf);
+			unsigned char R8 = C.R, G8 = C.G, B8 = C.B;
+			cb::Colourblind255<cb::Deuteranopia>(&R8, &G8, &B8);
+			rgb_255 Struct = cb::ColourblindRGB255<cb::Deuteranopia>(C);
+			Mismatches += R8 != cb::DenormComponent(Rf) || G8 != cb::DenormComponent(Gf) || B8 != cb::DenormComponent(Bf) ||
+			              Struct.R != R8 || Struct.G != G8 || Struct.B != B8;
+		}
+		TestVEqEps(Mismatches, 0, 0, "%d");
+	} EndTestGroup;
+
+	TestGroup("Gamma modes")
+	{
+		for(int i = 0; i <= 100; ++i) {
+			float X = i / 100.f;
+			TestVEqEps(cb::ApplyGammaComponent<cb::GammaAccurate>(cb::RemoveGammaComponent<cb::GammaAccurate>(X)), X, 0.0001f, "%f");
+			TestVEqEps(cb::ApplyGammaComponent<cb::GammaFast>(cb::RemoveGammaComponent<cb::GammaFast>(X)),         X, 0.0001f, "%f");
+			TestVEqEps(cb::ApplyGammaComponent<cb::GammaFaster>(cb::RemoveGammaComponent<cb::GammaFaster>(X)),     X, 0.0001f, "%f");
+		}
+		rgb_255 Grey = { 0x80, 0x80, 0x80 };
+		rgb_255 Fast = cb::ColourblindRGB255Gamma<cb::Protanopia, cb::GammaFaster>(Grey);
+		Test(Fast.R == 0x80 && Fast.G == 0x80 && Fast.B == 0x80);
+	} EndTestGroup;
+
+	TestGroup("C agreement")
+	{
+		/* the templates should give the same results as the C functions */
+		int Mismatches = 0;
+		for(int R = 0; R < 256; R += 15) for(int G = 0; G < 256; G += 15) for(int B = 0; B < 256; B += 15) {
+			rgb_255 C = { (unsigned char)R, (unsigned char)G, (unsigned char)B };
+			cb_rgb_255 CC = { C.R, C.G, C.B };
+			rgb_255 Template = cb::ColourblindRGB255<cb::Tritanopia>(C);
+			cb_rgb_255 Runtime = ColourblindRGB255(cbTritanopia, CC);
+			Mismatches += Template.R != Runtime.R || Template.G != Runtime.G || Template.B != Runtime.B;
+		}
+		TestVEqEps(Mismatches, 0, 0, "%d");
+	} EndTestGroup;
+
+	TestGroup("Luminance & contrast")
+	{
+		rgb_255 Black = { 0, 0, 0 }, White = { 255, 255, 255 }, Teal = { 0x00, 0xAA, 0xAD };
+		rgb     WhiteF = { 1, 1, 1 }, BlackF = { 0, 0, 0 };
+		cb_rgb_255 CTeal = { 0x00, 0xAA, 0xAD }, CWhite = { 255, 255, 255 };
+		TestVEqEps(cb::LuminanceRGB255(White), 1.f, 0.0001f, "%f");
+		TestVEqEps(cb::LuminanceRGB(WhiteF),   1.f, 0.0001f, "%f");
+		TestVEqEps(cb::LuminanceRGB255(Teal), cbLuminanceRGB255(CTeal), 0, "%f");
+		TestVEqEps(cb::ContrastRGB255(Black, White), 21.f, 0.001f, "%f");
+		TestVEqEps(cb::ContrastRGB(BlackF, WhiteF),  21.f, 0.001f, "%f");
+		TestVEqEps(cb::ContrastModulationRGB255(Black, White), 1.f, 0.0001f, "%f");
+		TestVEqEps(cb::ContrastRatioRGB255(Teal, White),       cbContrastRatioRGB255(CTeal, CWhite),       0, "%f");
+		TestVEqEps(cb::LightnessContrastRGB255(Teal, White),   cbLightnessContrastRGB255(CTeal, CWhite),   0, "%f");
+		TestVEqEps(cb::ContrastModulationRGB(WhiteF, BlackF),  1.f, 0.0001f, "%f");
+	} EndTestGroup;
+
+	TestGroup("Specialise")
+	{
+		rgb_255 Pink = { 0xEF, 0x3F, 0x6D };
+		for(int Impairment = cb::Unimpaired; Impairment < cb::ImpairmentCount; ++Impairment) {
+			rgb_255 Specialised = Pink, Direct = Pink;
+			cb::Specialise((cb::impairment)Impairment, [&](auto Tag) {
+				Specialised = cb::ColourblindRGB255Gamma<decltype(Tag)::value>(Specialised);
+			});
+			switch(Impairment) {
+				case cb::Protanopia:   Direct = cb::ColourblindRGB255Gamma<cb::Protanopia>(Pink);   break;
+				case cb::Deuteranopia: Direct = cb::ColourblindRGB255Gamma<cb::Deuteranopia>(Pink); break;
+				case cb::Tritanopia:   Direct = cb::ColourblindRGB255Gamma<cb::Tritanopia>(Pink);   break;
+				case cb::Achromatopsia:        Direct = cb::ColourblindRGB255Gamma<cb::Achromatopsia>(Pink);        break;
+				case cb::BlueConeMonochromacy: Direct = cb::ColourblindRGB255Gamma<cb::BlueConeMonochromacy>(Pink); break;
+			}
+			Test(Specialised.R == Direct.R && Specialised.G == Direct.G && Specialised.B == Direct.B);
+		}
+	} EndTestGroup;
+
+	return PrintTestResults(1);
+}
+
+SWEET_END_TESTS;
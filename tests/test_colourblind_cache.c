@@ -0,0 +1,183 @@
+#define Assert(x) Test(x)
+#define _CRT_SECURE_NO_WARNINGS
+#include <sweet/sweet.h>
+#include <string.h> /* strstr */
+
+/* The statistics and the cache change what the hot paths do, so they are tested here rather than in
+ * test_colourblind.c, which uses the default options. Build this with and without cbCACHE_PROMOTE. */
+#define cbTHREADS
+#define cbSTATS
+#define cbCACHE
+#define cbCACHE_ENTRIES 1024 /* small, so that the tests evict */
+#define cbIMPLEMENTATION
+#include "colourblind.h"
+
+/* looks up colours from several threads at once, counting any that differ from the uncached functions */
+static int CacheMismatches[16];
+static void CacheJob(void *Data, int Index) {
+	(void)Data;
+	for(int i = 0; i < 20000; ++i) {
+		unsigned int Seed = (unsigned int)(i % 3000) * 2654435761u + (unsigned int)Index;
+		cb_rgb_255 C = { (unsigned char)(Seed >> 8), (unsigned char)(Seed >> 16), (unsigned char)(Seed >> 24) };
+		cb_rgb_255 A = TritanopiaRGB255Gamma(C), B = TritanopiaRGB255GammaUncached(C);
+		CacheMismatches[Index] += A.R != B.R || A.G != B.G || A.B != B.B;
+		CacheMismatches[Index] += cbLuminanceRGB255(C) != cbLuminance255Uncached(C.R, C.G, C.B);
+	}
+}
+
+int main()
+{
+	cb_rgb_255 Red255 = {255,0,0}, White255 = {255,255,255};
+
+	TestGroup("Caches")
+	{
+		cb_cache_stats Stats;
+		cbCacheClear();
+		cbCacheRead(&Stats);
+		Test(Stats.Entries == 1024 && Stats.Used == 0 && Stats.SimulatedHits == 0 && Stats.LuminanceMisses == 0);
+
+		/* the same results as the uncached functions, whether hit or missed, and whatever was evicted */
+		int Mismatches = 0;
+		for(int Pass = 0; Pass < 2; ++Pass)
+		for(int i = 0; i < 4000; ++i) {
+			cb_rgb_255 C = { (unsigned char)(i * 37), (unsigned char)(i * 101 >> 3), (unsigned char)(i * 7 >> 1) };
+			cb_rgb_255 A = DeuteranopiaRGB255Gamma(C), B = DeuteranopiaRGB255GammaUncached(C);
+			cb_rgb_255 L = ProtanopiaRGB255(C), M = ProtanopiaRGB255Uncached(C);
+			Mismatches += A.R != B.R || A.G != B.G || A.B != B.B;
+			Mismatches += L.R != M.R || L.G != M.G || L.B != M.B;
+			Mismatches += cbLuminance255(C.R, C.G, C.B) != cbLuminance255Uncached(C.R, C.G, C.B);
+		}
+		TestVEqEps(Mismatches, 0, 0, "%d");
+
+		/* a few repeated colours hit */
+		cbCacheClear();
+		for(int i = 0; i < 100; ++i) { cbContrastRGB255(Red255, White255); }
+		cbCacheRead(&Stats);
+		Test(Stats.LuminanceMisses == 2 && Stats.LuminanceHits == 198 && Stats.Used == 2);
+		ColourblindRGB255(cbTritanopia, Red255);
+		ColourblindRGB255(cbTritanopia, Red255);
+		ColourblindRGB255(cbDeuteranopia, Red255);
+		cbCacheRead(&Stats);
+		Test(Stats.SimulatedMisses == 2 && Stats.SimulatedHits == 1);
+
+		cb_pool *Pool = cbPoolCreate(4);
+		cbPoolFor(Pool, 16, CacheJob, 0);
+		cbPoolDestroy(Pool);
+		Mismatches = 0;
+		for(int i = 0; i < 16; ++i) { Mismatches += CacheMismatches[i]; }
+		TestVEqEps(Mismatches, 0, 0, "%d");
+		cbCacheRead(&Stats);
+		Test(Stats.SimulatedHits + Stats.SimulatedMisses == 3 + 16 * 20000 && Stats.SimulatedHits > 0);
+	}
+	EndTestGroup;
+
+	TestGroup("Statistics")
+	{
+		enum { Width = 600, Height = 40 };
+		static unsigned char Pixels[3*Width*Height];
+		cb_stat_counts Counts[cbStatCount];
+		cbStatsReset();
+		cbStatsRead(Counts);
+		Test(Counts[cbStatConversions].Calls == 0 && Counts[cbStatImages].Items == 0);
+
+		for(int i = 0; i < 10; ++i) { DeuteranopiaRGB255(Red255); }
+		ColourblindRGB255(cbTritanopia, Red255); /* dispatches to TritanopiaRGB255 */
+		for(int i = 0; i < 5; ++i) { cbLuminance(0.5f, 0.5f, 0.5f); }
+		cbContrastRGB255(Red255, White255);
+		ColourblindImage(cbProtanopia, Pixels, Width, Height, 3*Width, cbRGB8);
+		/* threads count into their own blocks, which are summed */
+		cb_pool *Pool = cbPoolCreate(3);
+		ColourblindImageThreaded(Pool, cbProtanopia, Pixels, Width, Height, 3*Width, cbRGB8);
+		cbPoolDestroy(Pool);
+		cbStatsRead(Counts);
+		Test(Counts[cbStatConversions].Calls == 11 && Counts[cbStatConversions].Items == 11);
+		Test(Counts[cbStatLuminance].Calls == 5 + 2);
+		Test(Counts[cbStatContrast].Calls == 1);
+		Test(Counts[cbStatImages].Calls > 2 && Counts[cbStatImages].Items == 2*Width*Height);
+#if !defined(cbGAMMA_POLY) && !defined(cbGAMMA_FASTER)
+		Test(Counts[cbStatGamma].Calls >= 5*3); /* the float luminances always evaluate the curve */
+#endif
+
+		/* the fixed-point, LUT and unique-colour paths count on their own */
+		cb_lut *Lut = cbLutCreate(cbProtanopia, 17);
+		cbStatsReset();
+		ColourblindImageFixed(cbProtanopia, Pixels, Width, Height, 3*Width, cbRGB8);
+		ColourblindRGB255Fixed(cbProtanopia, Red255);
+		cbLutImage(Lut, Pixels, Width, Height, 3*Width, cbRGB8);
+		cbLutRGB255(Lut, Red255);
+		ColourblindImageUnique(cbProtanopia, Pixels, Width, Height, 3*Width, cbRGB8, 0);
+		cbLutDestroy(Lut);
+		cbStatsRead(Counts);
+		Test(Counts[cbStatFixed].Calls == 2 && Counts[cbStatFixed].Items == Width*Height + 1);
+		Test(Counts[cbStatLut].Calls == 2 && Counts[cbStatLut].Items == Width*Height + 1);
+		Test(Counts[cbStatUnique].Calls == 1 && Counts[cbStatUnique].Items == Width*Height);
+		Test(Counts[cbStatImages].Calls == 0); /* none of them counted twice */
+
+		/* pools' threads hand their blocks on, keeping the counts */
+		for(int i = 0; i < 4; ++i) {
+			Pool = cbPoolCreate(3);
+			ColourblindImageThreaded(Pool, cbProtanopia, Pixels, Width, Height, 3*Width, cbRGB8);
+			cbPoolDestroy(Pool);
+		}
+		cbStatsRead(Counts);
+		Test(Counts[cbStatImages].Items >= 4*Width*Height);
+
+		cbStatsReset();
+		cbStatsRead(Counts);
+		Test(Counts[cbStatImages].Calls == 0 && Counts[cbStatLuminance].Items == 0);
+		char Report[1024];
+		int Length = cbStatsReport(Report, sizeof(Report));
+		Test(Length > 0 && Length < (int)sizeof(Report) && strstr(Report, "Conversions") && strstr(Report, "Gamma"));
+		Test(cbStatsReport(0, 0) == Length);
+
+		/* Free starts again from zero, and counting carries on afterwards */
+		DeuteranopiaRGB255(Red255);
+		cbStatsFree();
+		cbStatsRead(Counts);
+		Test(Counts[cbStatConversions].Calls == 0 && Counts[cbStatImages].Calls == 0);
+		DeuteranopiaRGB255(Red255);
+		cbStatsRead(Counts);
+		Test(Counts[cbStatConversions].Calls == 1);
+	}
+	EndTestGroup;
+
+
+	TestGroup("Cache eviction")
+	{
+		/* cbCACHE_WAYS + 4 colours that all fall in one set */
+		cb_rgb_255 Colours[cbCACHE_WAYS + 4];
+		unsigned long long *Set = 0;
+		int Found = 0;
+		for(unsigned int i = 0; i < (1u << 24) && Found < cbCACHE_WAYS + 4; ++i) {
+			cb_rgb_255 C = { (unsigned char)(i >> 16), (unsigned char)(i >> 8), (unsigned char)i };
+			unsigned long long *CSet = cbCacheSet(cbCacheTag(cbCacheLuminance, 0, 1, C));
+			if(! Set) { Set = CSet; }
+			if(CSet == Set) { Colours[Found++] = C; }
+		}
+		Test(Found == cbCACHE_WAYS + 4);
+
+		/* fill the set, keep hitting the last colour in, then miss on the rest */
+		cb_cache_stats Stats;
+		cbCacheClear();
+		for(int i = 0; i < cbCACHE_WAYS; ++i) { cbLuminance255(Colours[i].R, Colours[i].G, Colours[i].B); }
+		cb_rgb_255 Hot = Colours[cbCACHE_WAYS - 1];
+		for(int i = 0; i < cbCACHE_WAYS; ++i) { cbLuminance255(Hot.R, Hot.G, Hot.B); }
+		for(int i = cbCACHE_WAYS; i < cbCACHE_WAYS + 4; ++i) { cbLuminance255(Colours[i].R, Colours[i].G, Colours[i].B); }
+		cbCacheRead(&Stats);
+		Test(Stats.LuminanceMisses == cbCACHE_WAYS + 4 && Stats.LuminanceHits == cbCACHE_WAYS);
+		cbLuminance255(Hot.R, Hot.G, Hot.B);
+		cbCacheRead(&Stats);
+#ifdef cbCACHE_PROMOTE
+		/* it rose to the top way, and the misses only replaced the bottom one */
+		Test(Stats.LuminanceHits == cbCACHE_WAYS + 1 && (unsigned int)Set[0] == cbCacheTag(cbCacheLuminance, 0, 1, Hot));
+#else
+		/* replacing the ways in turn evicts it, however often it hit */
+		Test(Stats.LuminanceHits == cbCACHE_WAYS);
+#endif/*cbCACHE_PROMOTE*/
+	}
+	EndTestGroup;
+
+	return PrintTestResults(1);
+}
+
+SWEET_END_TESTS;
@@ -0,0 +1,330 @@
+/* Exhaustive verification of colourblind.h's 8-bit functions
+ * Every 24-bit colour goes through each impairment and each 8-bit entry point (the single-colour, image,
+ * fixed-point, unique-colour, multi-impairment and threaded functions, with and without gamma, the daltonisation
+ * and wide-gamut image functions, and cbLuminance255), and is compared with a double-precision version using the
+ * same matrices and the accurate sRGB curve. The colours are split over a thread pool, a red value per job; the
+ * threaded functions can't run inside its jobs, so they go afterwards, on slabs of reds that the pool then checks.
+ * The wide-gamut functions are checked in the spaces whose 8-bit curves have a reference here: Display P3 with
+ * the sRGB curve and Rec.2020 linear.
+ * For each entry point and impairment it reports the largest error (in 8-bit levels), a histogram of the errors,
+ * and the first colour that is out by more than the allowed error.
+ * It needs nothing but the header, so it can gate each mode, e.g.:
+ *     for m in EXACT cbGAMMA_TABLE cbGAMMA_FAST cbNO_SIMD; do
+ *         cc -O2 -D$m -o verify_$m tests/verify_colourblind.c -lm -pthread && ./verify_$m || echo "$m failed"
+ *     done
+ *
+ * usage: verify_colourblind [max error [threads]]
+ * Exits with 1 if any entry point is out by more than max error (default 1 level) for any colour.
+ */
+#define _POSIX_C_SOURCE 199309L /* clock_gettime */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define cbTHREADS
+#define cbIMPLEMENTATION
+#include "../colourblind.h"
+
+#if   defined(cbGAMMA_POLY)
+#define Mode "poly"
+#elif defined(cbGAMMA_FASTER)
+#define Mode "faster"
+#elif defined(cbGAMMA_FAST)
+#define Mode "fast"
+#elif defined(cbGAMMA_TABLE)
+#define Mode "table"
+#else
+#define Mode "exact"
+#endif
+
+#ifdef _WIN32
+static double Seconds(void) {
+	LARGE_INTEGER Count, Frequency;
+	QueryPerformanceCounter(&Count);
+	QueryPerformanceFrequency(&Frequency);
+	return (double)Count.QuadPart / (double)Frequency.QuadPart;
+}
+#else
+#include <time.h>
+static double Seconds(void) {
+	struct timespec Time;
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	return Time.tv_sec + Time.tv_nsec * 1e-9;
+}
+#endif
+
+typedef enum entry {
+	RGB255, RGB255Gamma, Image, ImageGamma, RGB255Fixed, RGB255GammaFixed, ImageFixed, ImageGammaFixed,
+	ImageUnique, ImageGammaUnique, Images, ImagesGamma, DaltoniseRGB255Gamma, DaltoniseImage, DaltoniseImageGamma,
+	ImageSpaceP3, ImageSpaceRec2020Linear,
+	ImageThreaded, ImageGammaThreaded, ImagesThreaded, ImagesGammaThreaded, ImageSpaceP3Threaded, /* on slabs */
+	Luminance255,
+	EntryCount
+} entry;
+static char *EntryNames[EntryCount] = {
+	"RGB255", "RGB255Gamma", "Image", "ImageGamma", "RGB255Fixed", "RGB255GammaFixed", "ImageFixed", "ImageGammaFixed",
+	"ImageUnique", "ImageGammaUnique", "Images", "ImagesGamma", "DaltoniseRGB255Gamma", "DaltoniseImage", "DaltoniseImageGamma",
+	"ImageSpaceP3", "ImageSpaceRec2020Linear",
+	"ImageThreaded", "ImageGammaThreaded", "ImagesThreaded", "ImagesGammaThreaded", "ImageSpaceP3Threaded",
+	"Luminance255"
+};
+
+/* errors of 0, 1, 2, 3, 4-7, 8-15 and 16 or more levels */
+enum { BinCount = 7 };
+static char *BinNames[BinCount] = { "0", "1", "2", "3", "4-7", "8-15", "16+" };
+static int Bin(double Error) {
+	int Levels = (int)Error;
+	return Levels < 4 ? Levels : Levels < 8 ? 4 : Levels < 16 ? 5 : 6;
+}
+
+typedef struct result {
+	double Max;
+	long long Histogram[BinCount];
+	long long Failures;
+	long First; /* the lowest failing colour as 0xRRGGBB, or -1 */
+} result;
+
+/* one job per red value, each with its own results so that nothing is shared until they are merged */
+static result Results[256][EntryCount][cbImpairmentCount];
+static double MaxError = 1.0;
+
+/* the accurate curve in double precision; Thresholds[k] is the lowest linear value that rounds to k (k = 1-255) */
+static double Decode[256], Thresholds[256];
+static double ReferenceRemoveGamma(double X)
+{ return X > 0.04045 ? pow((X + 0.055) / 1.055, 2.4) : X / 12.92; }
+static int ReferenceEncode(double Linear) {
+	int Low = 0, High = 255; /* the largest k with Thresholds[k] <= Linear */
+	while(Low < High) {
+		int Middle = (Low + High + 1) / 2;
+		if(Thresholds[Middle] <= Linear) { Low = Middle; } else { High = Middle - 1; }
+	}
+	return Low;
+}
+static int ReferenceDenorm(double X) {
+	X = X < 0.0 ? 0.0 : X > 1.0 ? 1.0 : X;
+	return (int)floor(X * 255.0 + 0.5);
+}
+/* Expected is the matrix applied to the 8-bit values as they are, ExpectedGamma to them linearised and re-encoded */
+static void ReferenceMatrix(const float *M, int R, int G, int B, int *Expected, int *ExpectedGamma) {
+	double Linear[3] = { R / 255.0, G / 255.0, B / 255.0 }, Decoded[3] = { Decode[R], Decode[G], Decode[B] };
+	for(int c = 0; c < 3; ++c) {
+		double Value = (double)M[3*c] * Linear[0] + (double)M[3*c+1] * Linear[1] + (double)M[3*c+2] * Linear[2];
+		double Gamma = (double)M[3*c] * Decoded[0] + (double)M[3*c+1] * Decoded[1] + (double)M[3*c+2] * Decoded[2];
+		Expected[c] = ReferenceDenorm(Value);
+		if(ExpectedGamma) { ExpectedGamma[c] = ReferenceEncode(Gamma); }
+	}
+}
+
+static cb_rgb_255 (*GammaFunctions[cbImpairmentCount])(cb_rgb_255) = {
+	0, ProtanopiaRGB255Gamma, DeuteranopiaRGB255Gamma, TritanopiaRGB255Gamma, AchromatopsiaRGB255Gamma, BlueConeMonochromacyRGB255Gamma
+};
+
+static void Record(result *Result, double Error, long Colour) {
+	if(Error > Result->Max) { Result->Max = Error; }
+	++Result->Histogram[Bin(Error)];
+	if(Error > MaxError) {
+		if(! Result->Failures++) { Result->First = Colour; }
+	}
+}
+static void Compare(result *Result, cb_rgb_255 Got, int *Expected, long Colour) {
+	int Error = abs(Got.R - Expected[0]), G = abs(Got.G - Expected[1]), B = abs(Got.B - Expected[2]);
+	if(G > Error) { Error = G; }
+	if(B > Error) { Error = B; }
+	Record(Result, Error, Colour);
+}
+static void ComparePixel(result *Result, const unsigned char *Got, int *Expected, long Colour) {
+	cb_rgb_255 RGB = { Got[0], Got[1], Got[2] };
+	Compare(Result, RGB, Expected, Colour);
+}
+
+static void VerifyRed(void *Data, int R) {
+	(void)Data;
+	enum { RowCount = 11 };
+	cb_rgb_255 Row[256], Rows[RowCount][256], Multiple[2][cbImpairmentCount][256];
+	cb_impairment Impaired[cbImpairmentCount - 1];
+	unsigned char *Outputs[2][cbImpairmentCount - 1];
+	for(int i = cbProtanopia; i < cbImpairmentCount; ++i) {
+		Impaired[i - 1] = (cb_impairment)i;
+		Outputs[0][i - 1] = &Multiple[0][i]->R, Outputs[1][i - 1] = &Multiple[1][i]->R;
+	}
+	for(int e = 0; e < EntryCount; ++e)
+	for(int i = 0; i < cbImpairmentCount; ++i) { Results[R][e][i].First = -1; }
+
+	for(int G = 0; G < 256; ++G) {
+		for(int B = 0; B < 256; ++B) { Row[B].R = (unsigned char)R, Row[B].G = (unsigned char)G, Row[B].B = (unsigned char)B; }
+
+		/* luminance doesn't depend on the impairment, so it is kept with cbUnimpaired */
+		for(int B = 0; B < 256; ++B) {
+			double Reference = 0.2126 * Decode[R] + 0.7152 * Decode[G] + 0.0722 * Decode[B];
+			double Error = fabs(cbLuminance255((unsigned char)R, (unsigned char)G, (unsigned char)B) - Reference) * 255.0;
+			Record(&Results[R][Luminance255][cbUnimpaired], Error, (long)R << 16 | G << 8 | B);
+		}
+
+		ColourblindImages(     Impaired, cbImpairmentCount - 1, &Row->R, 256, 1, sizeof(Row), cbRGB8, Outputs[0], sizeof(Row));
+		ColourblindImagesGamma(Impaired, cbImpairmentCount - 1, &Row->R, 256, 1, sizeof(Row), cbRGB8, Outputs[1], sizeof(Row));
+
+		for(int i = cbProtanopia; i < cbImpairmentCount; ++i) {
+			cb_impairment Impairment = (cb_impairment)i;
+			for(int r = 0; r < RowCount; ++r) { memcpy(Rows[r], Row, sizeof(Row)); }
+			ColourblindImage(          Impairment, &Rows[0]->R, 256, 1, sizeof(Row), cbRGB8);
+			ColourblindImageGamma(     Impairment, &Rows[1]->R, 256, 1, sizeof(Row), cbRGB8);
+			ColourblindImageFixed(     Impairment, &Rows[2]->R, 256, 1, sizeof(Row), cbRGB8);
+			ColourblindImageGammaFixed(Impairment, &Rows[3]->R, 256, 1, sizeof(Row), cbRGB8);
+			ColourblindImageUnique(     Impairment, &Rows[4]->R, 256, 1, sizeof(Row), cbRGB8, 0);
+			ColourblindImageGammaUnique(Impairment, &Rows[5]->R, 256, 1, sizeof(Row), cbRGB8, 0);
+			cbDaltoniseImage(     Impairment, &Rows[6]->R, 256, 1, sizeof(Row), cbRGB8);
+			cbDaltoniseImageGamma(Impairment, &Rows[7]->R, 256, 1, sizeof(Row), cbRGB8);
+			ColourblindImageSpace(Impairment, cbSpaceDisplayP3, cbTransferSRGB,   &Rows[8]->R, 256, 1, sizeof(Row), cbRGB8);
+			ColourblindImageSpace(Impairment, cbSpaceRec2020,   cbTransferLinear, &Rows[9]->R, 256, 1, sizeof(Row), cbRGB8);
+
+			for(int B = 0; B < 256; ++B) {
+				long Colour = (long)R << 16 | G << 8 | B;
+				int Expected[3], ExpectedGamma[3], Daltonised[3], DaltonisedGamma[3], P3Gamma[3], Rec2020[3], Unused[3];
+				ReferenceMatrix(cbImpairmentMatrices[i], R, G, B, Expected, ExpectedGamma);
+				ReferenceMatrix(cbDaltonisationMatrices[i], R, G, B, Daltonised, DaltonisedGamma);
+				ReferenceMatrix(cbSpaceMatrices[cbSpaceDisplayP3][i], R, G, B, Unused, P3Gamma);
+				ReferenceMatrix(cbSpaceMatrices[cbSpaceRec2020][i], R, G, B, Rec2020, 0);
+				Compare(&Results[R][RGB255][i],           ColourblindRGB255(Impairment, Row[B]),           Expected,      Colour);
+				Compare(&Results[R][RGB255Gamma][i],      GammaFunctions[i](Row[B]),                       ExpectedGamma, Colour);
+				Compare(&Results[R][RGB255Fixed][i],      ColourblindRGB255Fixed(Impairment, Row[B]),      Expected,      Colour);
+				Compare(&Results[R][RGB255GammaFixed][i], ColourblindRGB255GammaFixed(Impairment, Row[B]), ExpectedGamma, Colour);
+				Compare(&Results[R][DaltoniseRGB255Gamma][i], cbDaltoniseRGB255Gamma(Impairment, Row[B]),  DaltonisedGamma, Colour);
+				Compare(&Results[R][Image][i],            Rows[0][B], Expected,      Colour);
+				Compare(&Results[R][ImageGamma][i],       Rows[1][B], ExpectedGamma, Colour);
+				Compare(&Results[R][ImageFixed][i],       Rows[2][B], Expected,      Colour);
+				Compare(&Results[R][ImageGammaFixed][i],  Rows[3][B], ExpectedGamma, Colour);
+				Compare(&Results[R][ImageUnique][i],      Rows[4][B], Expected,      Colour);
+				Compare(&Results[R][ImageGammaUnique][i], Rows[5][B], ExpectedGamma, Colour);
+				Compare(&Results[R][DaltoniseImage][i],   Rows[6][B], Daltonised,    Colour);
+				Compare(&Results[R][DaltoniseImageGamma][i], Rows[7][B], DaltonisedGamma, Colour);
+				Compare(&Results[R][ImageSpaceP3][i],     Rows[8][B], P3Gamma,       Colour);
+				Compare(&Results[R][ImageSpaceRec2020Linear][i], Rows[9][B], Rec2020, Colour);
+				Compare(&Results[R][Images][i],           Multiple[0][i][B], Expected,      Colour);
+				Compare(&Results[R][ImagesGamma][i],      Multiple[1][i][B], ExpectedGamma, Colour);
+			}
+		}
+	}
+}
+
+/* The threaded functions run on SlabReds reds at a time, as one image with a row per red and a column per green
+ * and blue, each into its own output; then the pool checks a red per job */
+enum { SlabReds = 16, SlabWidth = 256 * 256, SlabStride = 3 * SlabWidth };
+enum { SlabEntries = ImageSpaceP3Threaded - ImageThreaded + 1 };
+typedef struct slab {
+	int Red;
+	unsigned char *Source, *Outputs[SlabEntries][cbImpairmentCount];
+} slab;
+
+static void VerifySlabRed(void *Data, int r) {
+	slab *Slab = (slab *)Data;
+	int R = Slab->Red + r;
+	for(int i = cbProtanopia; i < cbImpairmentCount; ++i)
+	for(int G = 0; G < 256; ++G)
+	for(int B = 0; B < 256; ++B) {
+		long Colour = (long)R << 16 | G << 8 | B;
+		ptrdiff_t Offset = (ptrdiff_t)r * SlabStride + 3 * (G * 256 + B);
+		int Expected[3], ExpectedGamma[3], P3Gamma[3], Unused[3];
+		ReferenceMatrix(cbImpairmentMatrices[i], R, G, B, Expected, ExpectedGamma);
+		ReferenceMatrix(cbSpaceMatrices[cbSpaceDisplayP3][i], R, G, B, Unused, P3Gamma);
+		for(int e = ImageThreaded; e <= ImageSpaceP3Threaded; ++e) {
+			int *Wanted = e == ImageSpaceP3Threaded ? P3Gamma : e == ImageThreaded || e == ImagesThreaded ? Expected : ExpectedGamma;
+			ComparePixel(&Results[R][e][i], Slab->Outputs[e - ImageThreaded][i] + Offset, Wanted, Colour);
+		}
+	}
+}
+
+static int VerifyThreaded(cb_pool *Pool) {
+	slab Slab;
+	memset(&Slab, 0, sizeof(Slab));
+	int Success = (Slab.Source = (unsigned char *)malloc((size_t)SlabReds * SlabStride)) != 0;
+	for(int e = 0; e < SlabEntries; ++e)
+	for(int i = cbProtanopia; i < cbImpairmentCount; ++i) {
+		Success = Success && (Slab.Outputs[e][i] = (unsigned char *)malloc((size_t)SlabReds * SlabStride)) != 0;
+	}
+	cb_impairment Impaired[cbImpairmentCount - 1];
+	unsigned char *Outputs[2][cbImpairmentCount - 1];
+	for(int i = cbProtanopia; Success && i < cbImpairmentCount; ++i) {
+		Impaired[i - 1] = (cb_impairment)i;
+		Outputs[0][i - 1] = Slab.Outputs[ImagesThreaded - ImageThreaded][i];
+		Outputs[1][i - 1] = Slab.Outputs[ImagesGammaThreaded - ImageThreaded][i];
+	}
+
+	for(Slab.Red = 0; Success && Slab.Red < 256; Slab.Red += SlabReds) {
+		for(int r = 0; r < SlabReds; ++r)
+		for(int x = 0; x < SlabWidth; ++x) {
+			unsigned char *P = Slab.Source + (ptrdiff_t)r * SlabStride + 3 * x;
+			P[0] = (unsigned char)(Slab.Red + r), P[1] = (unsigned char)(x >> 8), P[2] = (unsigned char)x;
+		}
+		for(int i = cbProtanopia; i < cbImpairmentCount; ++i) {
+			cb_impairment Impairment = (cb_impairment)i;
+			unsigned char *Plain = Slab.Outputs[ImageThreaded - ImageThreaded][i],
+			              *Gamma = Slab.Outputs[ImageGammaThreaded - ImageThreaded][i],
+			              *Space = Slab.Outputs[ImageSpaceP3Threaded - ImageThreaded][i];
+			memcpy(Plain, Slab.Source, (size_t)SlabReds * SlabStride);
+			memcpy(Gamma, Slab.Source, (size_t)SlabReds * SlabStride);
+			memcpy(Space, Slab.Source, (size_t)SlabReds * SlabStride);
+			ColourblindImageThreaded(     Pool, Impairment, Plain, SlabWidth, SlabReds, SlabStride, cbRGB8);
+			ColourblindImageGammaThreaded(Pool, Impairment, Gamma, SlabWidth, SlabReds, SlabStride, cbRGB8);
+			ColourblindImageSpaceThreaded(Pool, Impairment, cbSpaceDisplayP3, cbTransferSRGB, Space, SlabWidth, SlabReds, SlabStride, cbRGB8);
+		}
+		ColourblindImagesThreaded(     Pool, Impaired, cbImpairmentCount - 1, Slab.Source, SlabWidth, SlabReds, SlabStride, cbRGB8,
+		                               Outputs[0], SlabStride);
+		ColourblindImagesGammaThreaded(Pool, Impaired, cbImpairmentCount - 1, Slab.Source, SlabWidth, SlabReds, SlabStride, cbRGB8,
+		                               Outputs[1], SlabStride);
+		cbPoolFor(Pool, SlabReds, VerifySlabRed, &Slab);
+	}
+
+	free(Slab.Source);
+	for(int e = 0; e < SlabEntries; ++e)
+	for(int i = 0; i < cbImpairmentCount; ++i) { free(Slab.Outputs[e][i]); }
+	return Success;
+}
+
+int main(int ArgCount, char **Args)
+{
+	int Threads = 0;
+	if(ArgCount >= 2) { MaxError = atof(Args[1]); }
+	if(ArgCount >= 3) { Threads = atoi(Args[2]); }
+
+	for(int i = 0; i < 256; ++i) { Decode[i] = ReferenceRemoveGamma(i / 255.0); }
+	Thresholds[0] = -1e30;
+	for(int k = 1; k < 256; ++k) { Thresholds[k] = ReferenceRemoveGamma((k - 0.5) / 255.0); }
+
+	double Start = Seconds();
+	cb_pool *Pool = cbPoolCreate(Threads);
+	if(! Pool) { fprintf(stderr, "couldn't create the thread pool\n"); return 2; }
+	cbPoolFor(Pool, 256, VerifyRed, 0);
+	if(! VerifyThreaded(Pool)) { fprintf(stderr, "couldn't allocate the slabs for the threaded functions\n"); return 2; }
+	double Elapsed = Seconds() - Start;
+
+	printf("mode %s, max error %g levels, %d colours, %.1fs on %d threads\n",
+	       Mode, MaxError, 1 << 24, Elapsed, cbPoolThreadCount(Pool));
+	printf("%-23s %-22s %8s %10s %8s", "entry", "impairment", "max", "failures", "first");
+	for(int b = 0; b < BinCount; ++b) { printf(" %10s", BinNames[b]); }
+	printf("\n");
+	long long Failures = 0;
+	for(int e = 0; e < EntryCount; ++e)
+	for(int i = 0; i < cbImpairmentCount; ++i) {
+		if((e == Luminance255) != (i == cbUnimpaired)) { continue; }
+		result Total = { 0 };
+		Total.First = -1;
+		for(int R = 0; R < 256; ++R) {
+			result *Result = &Results[R][e][i];
+			if(Result->Max > Total.Max) { Total.Max = Result->Max; }
+			for(int b = 0; b < BinCount; ++b) { Total.Histogram[b] += Result->Histogram[b]; }
+			if(Result->Failures && Total.First < 0) { Total.First = Result->First; } /* in order of red */
+			Total.Failures += Result->Failures;
+		}
+		Failures += Total.Failures;
+		char First[24] = "-";
+		if(Total.First >= 0) { snprintf(First, sizeof(First), "%06lX", Total.First); }
+		printf("%-23s %-22s %8.3f %10lld %8s", EntryNames[e], e == Luminance255 ? "-" : cbImpairmentStrings[i],
+		       Total.Max, Total.Failures, First);
+		for(int b = 0; b < BinCount; ++b) { printf(" %10lld", Total.Histogram[b]); }
+		printf("\n");
+	}
+	cbPoolDestroy(Pool);
+	printf("%s\n", Failures ? "FAILED" : "passed");
+	return Failures ? 1 : 0;
+}